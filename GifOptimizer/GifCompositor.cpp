@@ -0,0 +1,69 @@
+#include "GifCompositor.h"
+#include <algorithm>
+
+GifCompositor::GifCompositor(uint8_t const* data, size_t size, GifIndex const& index) : m_index(index), m_decoder(data, size, index)
+{
+    m_canvas.resize(static_cast<size_t>(index.Width) * index.Height);
+    m_kernels.reserve(index.FrameCount());
+    for (size_t i = 0; i < index.FrameCount(); i++)
+    {
+        m_kernels.push_back(SelectFrameBlendKernel(index.TransparentIndex[i] < 0 ? FrameBlendClass::Opaque : FrameBlendClass::Keyed));
+    }
+}
+
+bool GifCompositor::Next()
+{
+    if (m_frame >= m_index.FrameCount())
+    {
+        return false;
+    }
+    int32_t canvasWidth = m_index.Width;
+    int32_t canvasHeight = m_index.Height;
+
+    // Undo the last frame if it asked for it
+    if (m_frame > 0)
+    {
+        auto last = m_frame - 1;
+        auto disposal = m_index.Disposal[last];
+        if (disposal == GifDisposal::RestoreToBackground)
+        {
+            auto left = std::min<int32_t>(m_index.Left[last], canvasWidth);
+            auto top = std::min<int32_t>(m_index.Top[last], canvasHeight);
+            auto right = std::min<int32_t>(left + m_index.FrameWidth[last], canvasWidth);
+            auto bottom = std::min<int32_t>(top + m_index.FrameHeight[last], canvasHeight);
+            for (auto y = top; y < bottom; y++)
+            {
+                std::fill_n(m_canvas.begin() + static_cast<size_t>(y) * canvasWidth + left, right - left, 0u);
+            }
+        }
+        else if (disposal == GifDisposal::RestoreToPrevious)
+        {
+            m_canvas = m_previous;
+        }
+    }
+    if (m_index.Disposal[m_frame] == GifDisposal::RestoreToPrevious)
+    {
+        m_previous = m_canvas;
+    }
+
+    int32_t frameWidth = m_index.FrameWidth[m_frame];
+    int32_t frameHeight = m_index.FrameHeight[m_frame];
+    m_framePixels.resize(static_cast<size_t>(frameWidth) * frameHeight);
+    m_decoder.Decode(m_frame, reinterpret_cast<uint8_t*>(m_framePixels.data()), static_cast<uint32_t>(frameWidth) * 4);
+
+    // Only the part that lands on the canvas gets drawn
+    int32_t left = m_index.Left[m_frame];
+    int32_t top = m_index.Top[m_frame];
+    auto visibleWidth = std::max(std::min(frameWidth, canvasWidth - left), 0);
+    auto visibleHeight = std::max(std::min(frameHeight, canvasHeight - top), 0);
+    if (visibleWidth > 0 && visibleHeight > 0)
+    {
+        m_kernels[m_frame](
+            reinterpret_cast<uint8_t*>(m_canvas.data() + static_cast<size_t>(top) * canvasWidth + left), static_cast<uint32_t>(canvasWidth) * 4,
+            reinterpret_cast<uint8_t const*>(m_framePixels.data()), static_cast<uint32_t>(frameWidth) * 4,
+            static_cast<uint32_t>(visibleWidth), static_cast<uint32_t>(visibleHeight));
+    }
+
+    m_frame++;
+    return true;
+}
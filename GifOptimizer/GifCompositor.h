@@ -0,0 +1,33 @@
+#pragma once
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+#include "../VisitorGag/GifIndex.h"
+#include "../VisitorGag/FrameBlendKernels.h"
+#include "../VisitorGag/GifFrameDecoder.h"
+
+// Plays a gif back frame by frame onto a full-size canvas, following each
+// frame's disposal the way browsers do (the background is transparent).
+// Pixels are BGRA8 packed into a uint32_t, transparent pixels are zero.
+// Each frame's blend kernel is bound up front from the index: frames
+// without a transparent color are copied, the rest are keyed.
+struct GifCompositor
+{
+    GifCompositor(uint8_t const* data, size_t size, GifIndex const& index);
+
+    // Composites the next frame, false once every frame has been shown
+    bool Next();
+    // What's on screen while the current frame is shown
+    std::vector<uint32_t> const& Canvas() const noexcept { return m_canvas; }
+    // The frame that was just composited
+    size_t Frame() const noexcept { return m_frame - 1; }
+
+private:
+    GifIndex const& m_index;
+    GifFrameDecoder m_decoder;
+    std::vector<uint32_t> m_canvas;
+    std::vector<uint32_t> m_previous;
+    std::vector<uint32_t> m_framePixels;
+    std::vector<FrameBlendKernel> m_kernels;
+    size_t m_frame = 0;
+};
@@ -0,0 +1,250 @@
+#include "GifEncoder.h"
+#include <algorithm>
+#include <stdexcept>
+
+namespace
+{
+    constexpr uint32_t MaxCodeSize = 12;
+    constexpr uint32_t MaxCodes = 1 << MaxCodeSize;
+    // Comfortably more than MaxCodes so that probes stay short
+    constexpr uint32_t HashTableSize = 1 << 14;
+
+    inline void WriteUInt16(std::vector<uint8_t>& bytes, uint16_t value)
+    {
+        bytes.push_back(static_cast<uint8_t>(value & 0xFF));
+        bytes.push_back(static_cast<uint8_t>(value >> 8));
+    }
+
+    inline uint32_t HashKey(uint32_t key) noexcept
+    {
+        return (key * 2654435761u) >> (32 - 14);
+    }
+
+    // Packs codes LSB-first into 255 byte sub-blocks
+    struct CodeWriter
+    {
+        CodeWriter(std::vector<uint8_t>& output) : m_output(output) {}
+
+        void Write(uint32_t code, uint32_t codeSize)
+        {
+            m_bits |= code << m_count;
+            m_count += codeSize;
+            while (m_count >= 8)
+            {
+                PutByte(static_cast<uint8_t>(m_bits & 0xFF));
+                m_bits >>= 8;
+                m_count -= 8;
+            }
+        }
+
+        void Finish()
+        {
+            if (m_count > 0)
+            {
+                PutByte(static_cast<uint8_t>(m_bits & 0xFF));
+            }
+            FlushBlock();
+            m_output.push_back(0);
+        }
+
+    private:
+        void PutByte(uint8_t value)
+        {
+            m_block[m_blockSize++] = value;
+            if (m_blockSize == 255)
+            {
+                FlushBlock();
+            }
+        }
+
+        void FlushBlock()
+        {
+            if (m_blockSize == 0)
+            {
+                return;
+            }
+            m_output.push_back(static_cast<uint8_t>(m_blockSize));
+            m_output.insert(m_output.end(), m_block, m_block + m_blockSize);
+            m_blockSize = 0;
+        }
+
+    private:
+        std::vector<uint8_t>& m_output;
+        uint32_t m_bits = 0;
+        uint32_t m_count = 0;
+        uint8_t m_block[255] = {};
+        size_t m_blockSize = 0;
+    };
+}
+
+uint32_t GifPaletteBits(size_t entries) noexcept
+{
+    uint32_t bits = 1;
+    while (bits < 8 && (static_cast<size_t>(1) << bits) < entries)
+    {
+        bits++;
+    }
+    return bits;
+}
+
+GifLzwEncoder::GifLzwEncoder()
+{
+    m_keys.resize(HashTableSize);
+    m_codes.resize(HashTableSize);
+}
+
+void GifLzwEncoder::ResetTable()
+{
+    std::fill(m_keys.begin(), m_keys.end(), 0);
+}
+
+void GifLzwEncoder::Encode(uint8_t const* indices, size_t count, uint32_t minCodeSize, std::vector<uint8_t>& output)
+{
+    if (minCodeSize < 2 || minCodeSize > 8)
+    {
+        throw std::invalid_argument("Minimum code size must be between 2 and 8");
+    }
+    output.push_back(static_cast<uint8_t>(minCodeSize));
+    CodeWriter writer(output);
+    uint32_t clearCode = 1u << minCodeSize;
+    uint32_t endCode = clearCode + 1;
+    auto codeSize = minCodeSize + 1;
+    auto nextCode = clearCode + 2;
+    ResetTable();
+    writer.Write(clearCode, codeSize);
+
+    if (count > 0)
+    {
+        uint32_t prefix = indices[0];
+        for (size_t i = 1; i < count; i++)
+        {
+            uint32_t index = indices[i];
+            auto key = ((prefix << 8) | index) + 1;
+            auto slot = HashKey(key);
+            while (m_keys[slot] != 0 && m_keys[slot] != key)
+            {
+                slot = (slot + 1) & (HashTableSize - 1);
+            }
+            if (m_keys[slot] == key)
+            {
+                prefix = m_codes[slot];
+                continue;
+            }
+
+            writer.Write(prefix, codeSize);
+            m_keys[slot] = key;
+            m_codes[slot] = static_cast<uint16_t>(nextCode);
+            nextCode++;
+            // The decoder adds each code one step behind us, so it widens
+            // one code later too
+            if (nextCode == (1u << codeSize) + 1 && codeSize < MaxCodeSize)
+            {
+                codeSize++;
+            }
+            else if (nextCode == MaxCodes)
+            {
+                writer.Write(clearCode, codeSize);
+                ResetTable();
+                codeSize = minCodeSize + 1;
+                nextCode = clearCode + 2;
+            }
+            prefix = index;
+        }
+        writer.Write(prefix, codeSize);
+    }
+    writer.Write(endCode, codeSize);
+    writer.Finish();
+}
+
+GifWriter::GifWriter(uint16_t width, uint16_t height, std::vector<uint32_t> const& globalPalette, std::optional<uint16_t> loopCount)
+{
+    static constexpr uint8_t Signature[] = { 'G', 'I', 'F', '8', '9', 'a' };
+    m_bytes.insert(m_bytes.end(), std::begin(Signature), std::end(Signature));
+    WriteUInt16(m_bytes, width);
+    WriteUInt16(m_bytes, height);
+    m_hasGlobalPalette = !globalPalette.empty();
+    m_globalBits = GifPaletteBits(globalPalette.size());
+    // Color resolution is informational, claim 8 bits
+    uint8_t packed = 0x70;
+    if (m_hasGlobalPalette)
+    {
+        packed |= 0x80 | static_cast<uint8_t>(m_globalBits - 1);
+    }
+    m_bytes.push_back(packed);
+    // Background color and pixel aspect ratio
+    m_bytes.push_back(0);
+    m_bytes.push_back(0);
+    if (m_hasGlobalPalette)
+    {
+        WritePalette(globalPalette);
+    }
+
+    if (loopCount.has_value())
+    {
+        static constexpr uint8_t Netscape[] = { 0x21, 0xFF, 11, 'N', 'E', 'T', 'S', 'C', 'A', 'P', 'E', '2', '.', '0', 3, 1 };
+        m_bytes.insert(m_bytes.end(), std::begin(Netscape), std::end(Netscape));
+        WriteUInt16(m_bytes, loopCount.value());
+        m_bytes.push_back(0);
+    }
+}
+
+void GifWriter::WritePalette(std::vector<uint32_t> const& palette)
+{
+    auto entries = static_cast<size_t>(1) << GifPaletteBits(palette.size());
+    for (size_t i = 0; i < entries; i++)
+    {
+        auto color = i < palette.size() ? palette[i] : 0;
+        m_bytes.push_back(static_cast<uint8_t>((color >> 16) & 0xFF));
+        m_bytes.push_back(static_cast<uint8_t>((color >> 8) & 0xFF));
+        m_bytes.push_back(static_cast<uint8_t>(color & 0xFF));
+    }
+}
+
+void GifWriter::AddFrame(GifWriterFrame const& frame)
+{
+    auto&& rect = frame.Rect;
+    if (frame.Indices.size() != static_cast<size_t>(rect.Width) * rect.Height)
+    {
+        throw std::invalid_argument("Frame indices don't match its rect");
+    }
+    if (frame.Palette.empty() && !m_hasGlobalPalette)
+    {
+        throw std::invalid_argument("Frame needs a palette");
+    }
+
+    // Graphic control extension
+    m_bytes.push_back(0x21);
+    m_bytes.push_back(0xF9);
+    m_bytes.push_back(4);
+    auto hasTransparency = frame.TransparentIndex >= 0;
+    m_bytes.push_back(static_cast<uint8_t>((static_cast<uint8_t>(frame.Disposal) << 2) | (hasTransparency ? 1 : 0)));
+    WriteUInt16(m_bytes, frame.Delay);
+    m_bytes.push_back(hasTransparency ? static_cast<uint8_t>(frame.TransparentIndex) : 0);
+    m_bytes.push_back(0);
+
+    // Image descriptor
+    m_bytes.push_back(0x2C);
+    WriteUInt16(m_bytes, static_cast<uint16_t>(rect.X));
+    WriteUInt16(m_bytes, static_cast<uint16_t>(rect.Y));
+    WriteUInt16(m_bytes, static_cast<uint16_t>(rect.Width));
+    WriteUInt16(m_bytes, static_cast<uint16_t>(rect.Height));
+    auto bits = m_globalBits;
+    if (!frame.Palette.empty())
+    {
+        bits = GifPaletteBits(frame.Palette.size());
+        m_bytes.push_back(static_cast<uint8_t>(0x80 | (bits - 1)));
+        WritePalette(frame.Palette);
+    }
+    else
+    {
+        m_bytes.push_back(0);
+    }
+
+    m_encoder.Encode(frame.Indices.data(), frame.Indices.size(), std::max(bits, 2u), m_bytes);
+}
+
+std::vector<uint8_t> GifWriter::Finish()
+{
+    m_bytes.push_back(0x3B);
+    return std::move(m_bytes);
+}
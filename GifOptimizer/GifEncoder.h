@@ -0,0 +1,64 @@
+#pragma once
+#include <cstddef>
+#include <cstdint>
+#include <optional>
+#include <vector>
+#include "../VisitorGag/GifIndex.h"
+#include "../VisitorGag/FrameDeduplicator.h"
+
+// Turns palette indices into gif-flavoured LZW. Codes are looked up in an
+// open-addressed hash table instead of walking a trie, and the table is
+// cleared once it fills up, which every decoder handles.
+struct GifLzwEncoder
+{
+    GifLzwEncoder();
+
+    // Appends the minimum code size byte, the data sub-blocks and the block
+    // terminator. minCodeSize must fit every index, and be at least 2.
+    void Encode(uint8_t const* indices, size_t count, uint32_t minCodeSize, std::vector<uint8_t>& output);
+
+private:
+    void ResetTable();
+
+private:
+    // (prefix << 8 | index) + 1 for each entry, zero when empty
+    std::vector<uint32_t> m_keys;
+    std::vector<uint16_t> m_codes;
+};
+
+// Colors are BGRA8 packed the same way the decoder writes them
+struct GifWriterFrame
+{
+    FrameRegion Rect;
+    // In the gif's native 10ms units
+    uint16_t Delay = 0;
+    GifDisposal Disposal = GifDisposal::DoNotDispose;
+    // -1 if the frame has no transparent pixels
+    int16_t TransparentIndex = -1;
+    // Empty means use the global palette
+    std::vector<uint32_t> Palette;
+    // Rect.Width * Rect.Height palette indices, row by row
+    std::vector<uint8_t> Indices;
+};
+
+// Writes a GIF89a file. Palettes are padded out to the next power of two.
+struct GifWriter
+{
+    GifWriter(uint16_t width, uint16_t height, std::vector<uint32_t> const& globalPalette, std::optional<uint16_t> loopCount);
+
+    void AddFrame(GifWriterFrame const& frame);
+    // Adds the trailer and hands over the file
+    std::vector<uint8_t> Finish();
+
+private:
+    void WritePalette(std::vector<uint32_t> const& palette);
+
+private:
+    std::vector<uint8_t> m_bytes;
+    GifLzwEncoder m_encoder;
+    bool m_hasGlobalPalette = false;
+    uint32_t m_globalBits = 1;
+};
+
+// Bits needed to index a palette with the given number of entries (1-8)
+uint32_t GifPaletteBits(size_t entries) noexcept;
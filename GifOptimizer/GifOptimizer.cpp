@@ -0,0 +1,368 @@
+#include "GifOptimizer.h"
+#include <algorithm>
+#include <stdexcept>
+#include "GifCompositor.h"
+#include "GifEncoder.h"
+
+namespace
+{
+    using Canvas = std::vector<uint32_t>;
+
+    // A distinct frame, with the delays of any duplicates folded in
+    struct CompositedFrame
+    {
+        Canvas Pixels;
+        // In 10ms units
+        uint32_t Delay = 0;
+        bool Merged = false;
+    };
+
+    struct OptimizedFrame
+    {
+        FrameRegion Rect;
+        uint16_t Delay = 0;
+        GifDisposal Disposal = GifDisposal::DoNotDispose;
+        // Zero where the frame is transparent
+        std::vector<uint32_t> Pixels;
+    };
+
+    // Frames with a delay of zero get shown for 100ms, which is what they
+    // count as once they're merged with something else
+    inline uint32_t EffectiveDelay(uint16_t delay)
+    {
+        return delay == 0 ? 10 : delay;
+    }
+
+    inline bool IsEmpty(FrameRegion const& region)
+    {
+        return region.Width == 0 || region.Height == 0;
+    }
+
+    inline uint64_t Area(FrameRegion const& region)
+    {
+        return static_cast<uint64_t>(region.Width) * region.Height;
+    }
+
+    FrameRegion Union(FrameRegion const& first, FrameRegion const& second)
+    {
+        if (IsEmpty(first))
+        {
+            return second;
+        }
+        if (IsEmpty(second))
+        {
+            return first;
+        }
+        auto left = std::min(first.X, second.X);
+        auto top = std::min(first.Y, second.Y);
+        auto right = std::max(first.X + first.Width, second.X + second.Width);
+        auto bottom = std::max(first.Y + first.Height, second.Y + second.Height);
+        return { left, top, right - left, bottom - top };
+    }
+
+    // Bounds of the pixels for which the predicate holds
+    template <typename Predicate>
+    FrameRegion Bounds(int32_t width, int32_t height, Predicate&& predicate)
+    {
+        auto left = width;
+        auto top = height;
+        auto right = 0;
+        auto bottom = 0;
+        for (int32_t y = 0; y < height; y++)
+        {
+            for (int32_t x = 0; x < width; x++)
+            {
+                if (predicate(static_cast<size_t>(y) * width + x))
+                {
+                    left = std::min(left, x);
+                    right = std::max(right, x + 1);
+                    top = std::min(top, y);
+                    bottom = y + 1;
+                }
+            }
+        }
+        if (right <= left)
+        {
+            return {};
+        }
+        return { left, top, right - left, bottom - top };
+    }
+
+    FrameRegion DiffBounds(Canvas const& first, Canvas const& second, int32_t width, int32_t height)
+    {
+        return Bounds(width, height, [&](size_t i) { return first[i] != second[i]; });
+    }
+
+    void ClearRegion(Canvas& canvas, int32_t width, FrameRegion const& region)
+    {
+        for (int32_t y = region.Y; y < region.Y + region.Height; y++)
+        {
+            std::fill_n(canvas.begin() + static_cast<size_t>(y) * width + region.X, region.Width, 0u);
+        }
+    }
+
+    // Hands out composited frames with duplicates merged away
+    struct DistinctFrameReader
+    {
+        DistinctFrameReader(uint8_t const* data, size_t size, GifIndex const& index) : m_index(index), m_compositor(data, size, index) {}
+
+        bool Read(CompositedFrame& frame)
+        {
+            if (!m_hasLookahead)
+            {
+                if (!m_compositor.Next())
+                {
+                    return false;
+                }
+                m_lookahead = { m_compositor.Canvas(), m_index.Delays[m_compositor.Frame()] };
+            }
+            frame = std::move(m_lookahead);
+            m_hasLookahead = false;
+            while (m_compositor.Next())
+            {
+                auto delay = m_index.Delays[m_compositor.Frame()];
+                if (m_compositor.Canvas() != frame.Pixels)
+                {
+                    m_lookahead = { m_compositor.Canvas(), delay };
+                    m_hasLookahead = true;
+                    break;
+                }
+                if (!frame.Merged)
+                {
+                    frame.Delay = EffectiveDelay(static_cast<uint16_t>(frame.Delay));
+                    frame.Merged = true;
+                }
+                frame.Delay += EffectiveDelay(delay);
+                MergedFrames++;
+            }
+            return true;
+        }
+
+        uint32_t MergedFrames = 0;
+
+    private:
+        GifIndex const& m_index;
+        GifCompositor m_compositor;
+        CompositedFrame m_lookahead;
+        bool m_hasLookahead = false;
+    };
+
+    // Sorted and without duplicates or transparency
+    std::vector<uint32_t> FrameColors(OptimizedFrame const& frame, bool& transparent)
+    {
+        std::vector<uint32_t> colors;
+        colors.reserve(frame.Pixels.size());
+        transparent = false;
+        for (auto pixel : frame.Pixels)
+        {
+            if (pixel == 0)
+            {
+                transparent = true;
+            }
+            else
+            {
+                colors.push_back(pixel);
+            }
+        }
+        std::sort(colors.begin(), colors.end());
+        colors.erase(std::unique(colors.begin(), colors.end()), colors.end());
+        return colors;
+    }
+
+    std::vector<uint8_t> MapToPalette(std::vector<uint32_t> const& pixels, std::vector<uint32_t> const& colors, uint8_t transparentIndex)
+    {
+        std::vector<uint8_t> indices(pixels.size());
+        for (size_t i = 0; i < pixels.size(); i++)
+        {
+            if (pixels[i] == 0)
+            {
+                indices[i] = transparentIndex;
+            }
+            else
+            {
+                auto match = std::lower_bound(colors.begin(), colors.end(), pixels[i]);
+                indices[i] = static_cast<uint8_t>(std::distance(colors.begin(), match));
+            }
+        }
+        return indices;
+    }
+}
+
+GifOptimizerResult OptimizeGif(uint8_t const* data, size_t size)
+{
+    auto index = GifIndex::Build(data, size);
+    int32_t width = index.Width;
+    int32_t height = index.Height;
+    GifOptimizerResult result;
+    auto&& stats = result.Stats;
+    stats.InputFrames = static_cast<uint32_t>(index.FrameCount());
+    for (size_t i = 0; i < index.FrameCount(); i++)
+    {
+        stats.InputFramePixels += static_cast<uint64_t>(index.FrameWidth[i]) * index.FrameHeight[i];
+    }
+
+    // Work out what each frame has to draw given what's already on screen,
+    // looking one frame ahead to pick its disposal.
+    DistinctFrameReader reader(data, size, index);
+    std::vector<OptimizedFrame> frames;
+    Canvas base(static_cast<size_t>(width) * height, 0);
+    CompositedFrame current;
+    CompositedFrame next;
+    auto hasCurrent = reader.Read(current);
+    auto hasNext = hasCurrent && reader.Read(next);
+    while (hasCurrent)
+    {
+        auto drawn = DiffBounds(current.Pixels, base, width, height);
+        auto rect = drawn;
+        auto disposal = GifDisposal::DoNotDispose;
+        if (hasNext)
+        {
+            // Pixels can only go back to transparent by being cleared
+            auto mustClear = Bounds(width, height, [&](size_t i) { return next.Pixels[i] == 0 && current.Pixels[i] != 0; });
+            if (!IsEmpty(mustClear))
+            {
+                disposal = GifDisposal::RestoreToBackground;
+                rect = Union(drawn, mustClear);
+            }
+            else if (!IsEmpty(drawn))
+            {
+                auto cleared = current.Pixels;
+                ClearRegion(cleared, width, drawn);
+                if (Area(DiffBounds(next.Pixels, cleared, width, height)) < Area(DiffBounds(next.Pixels, current.Pixels, width, height)))
+                {
+                    disposal = GifDisposal::RestoreToBackground;
+                }
+            }
+        }
+        // Nothing to draw still takes a (transparent) pixel
+        if (IsEmpty(rect))
+        {
+            rect = { 0, 0, 1, 1 };
+        }
+
+        OptimizedFrame frame;
+        frame.Rect = rect;
+        frame.Delay = static_cast<uint16_t>(std::min<uint32_t>(current.Delay, UINT16_MAX));
+        frame.Disposal = disposal;
+        frame.Pixels.reserve(Area(rect));
+        for (int32_t y = rect.Y; y < rect.Y + rect.Height; y++)
+        {
+            for (int32_t x = rect.X; x < rect.X + rect.Width; x++)
+            {
+                auto i = static_cast<size_t>(y) * width + x;
+                // Whatever matches what's underneath can stay transparent
+                frame.Pixels.push_back(current.Pixels[i] == base[i] ? 0 : current.Pixels[i]);
+            }
+        }
+        stats.OutputFramePixels += Area(rect);
+        if (disposal == GifDisposal::RestoreToBackground)
+        {
+            stats.RestoreToBackgroundFrames++;
+        }
+
+        base = current.Pixels;
+        if (disposal == GifDisposal::RestoreToBackground)
+        {
+            ClearRegion(base, width, rect);
+        }
+        frames.push_back(std::move(frame));
+        current = std::move(next);
+        hasCurrent = hasNext;
+        hasNext = hasCurrent && reader.Read(next);
+    }
+    stats.OutputFrames = static_cast<uint32_t>(frames.size());
+    stats.MergedFrames = reader.MergedFrames;
+
+    // Use one palette for everything if it fits, otherwise one per frame
+    std::vector<std::vector<uint32_t>> frameColors;
+    std::vector<bool> frameTransparency;
+    std::vector<uint32_t> allColors;
+    auto anyTransparency = false;
+    for (auto&& frame : frames)
+    {
+        bool transparent = false;
+        frameColors.push_back(FrameColors(frame, transparent));
+        frameTransparency.push_back(transparent);
+        anyTransparency |= transparent;
+        // No point in keeping track once it can't fit
+        if (allColors.size() <= 256)
+        {
+            allColors.insert(allColors.end(), frameColors.back().begin(), frameColors.back().end());
+            std::sort(allColors.begin(), allColors.end());
+            allColors.erase(std::unique(allColors.begin(), allColors.end()), allColors.end());
+        }
+    }
+    stats.GlobalPalette = allColors.size() + (anyTransparency ? 1 : 0) <= 256;
+
+    std::vector<uint32_t> globalPalette;
+    if (stats.GlobalPalette)
+    {
+        globalPalette = allColors;
+        if (anyTransparency)
+        {
+            globalPalette.push_back(0);
+        }
+        stats.MaxPaletteColors = static_cast<uint32_t>(globalPalette.size());
+    }
+    GifWriter writer(static_cast<uint16_t>(width), static_cast<uint16_t>(height), globalPalette, index.LoopCount);
+    for (size_t i = 0; i < frames.size(); i++)
+    {
+        auto&& frame = frames[i];
+        GifWriterFrame output;
+        output.Rect = frame.Rect;
+        output.Delay = frame.Delay;
+        output.Disposal = frame.Disposal;
+        if (stats.GlobalPalette)
+        {
+            auto transparentIndex = static_cast<uint8_t>(allColors.size());
+            output.TransparentIndex = frameTransparency[i] ? transparentIndex : -1;
+            output.Indices = MapToPalette(frame.Pixels, allColors, transparentIndex);
+        }
+        else
+        {
+            auto&& colors = frameColors[i];
+            if (colors.size() + (frameTransparency[i] ? 1 : 0) > 256)
+            {
+                throw std::runtime_error("A frame needs more than 256 colors");
+            }
+            auto transparentIndex = static_cast<uint8_t>(colors.size());
+            output.TransparentIndex = frameTransparency[i] ? transparentIndex : -1;
+            output.Indices = MapToPalette(frame.Pixels, colors, transparentIndex);
+            output.Palette = colors;
+            if (frameTransparency[i])
+            {
+                output.Palette.push_back(0);
+            }
+            stats.MaxPaletteColors = std::max(stats.MaxPaletteColors, static_cast<uint32_t>(output.Palette.size()));
+        }
+        writer.AddFrame(output);
+    }
+    result.Bytes = writer.Finish();
+    return result;
+}
+
+GifPlaybackCost MeasurePlaybackCost(uint8_t const* data, size_t size)
+{
+    auto index = GifIndex::Build(data, size);
+    GifPlaybackCost cost;
+    cost.ResidentBytes = size + static_cast<uint64_t>(index.Width) * index.Height * 4;
+    for (size_t i = 0; i < index.FrameCount(); i++)
+    {
+        cost.ResidentBytes += static_cast<uint64_t>(index.FrameWidth[i]) * index.FrameHeight[i] * 4;
+    }
+
+    // Small gifs decode too quickly to time once
+    using clock = std::chrono::steady_clock;
+    auto start = clock::now();
+    uint32_t runs = 0;
+    do
+    {
+        GifCompositor compositor(data, size, index);
+        while (compositor.Next())
+        {
+        }
+        runs++;
+    } while (clock::now() - start < std::chrono::milliseconds(200));
+    cost.DecodeTime = std::chrono::duration_cast<std::chrono::microseconds>(clock::now() - start) / runs;
+    return cost;
+}
@@ -0,0 +1,51 @@
+#pragma once
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+struct GifOptimizerStats
+{
+    uint32_t InputFrames = 0;
+    uint32_t OutputFrames = 0;
+    // Frames that looked exactly like the one before them
+    uint32_t MergedFrames = 0;
+    // Frames that clear themselves away before the next one
+    uint32_t RestoreToBackgroundFrames = 0;
+    // Sum of the frame rects, which is what the player uploads and blends
+    uint64_t InputFramePixels = 0;
+    uint64_t OutputFramePixels = 0;
+    bool GlobalPalette = false;
+    uint32_t MaxPaletteColors = 0;
+};
+
+struct GifOptimizerResult
+{
+    std::vector<uint8_t> Bytes;
+    GifOptimizerStats Stats;
+};
+
+// Rewrites a gif so that it's as cheap as possible to play back while
+// showing exactly the same thing. Every frame is composited, frames that
+// don't change anything are merged into the one before them (their delays
+// add up), and each remaining frame only covers the pixels that changed,
+// with unchanged ones left transparent. A frame's disposal is whichever of
+// keeping it or restoring to the background makes the next frame smaller
+// (or whatever is needed to let pixels become transparent again).
+// Palettes only hold colors that are actually used, and a single global
+// palette is used when everything fits in one.
+//
+// Throws std::runtime_error if the input isn't a gif, or if some frame
+// would need more than 256 colors to stay lossless.
+GifOptimizerResult OptimizeGif(uint8_t const* data, size_t size);
+
+struct GifPlaybackCost
+{
+    // To decode and composite every frame once
+    std::chrono::microseconds DecodeTime{};
+    // The encoded gif, the canvas and every frame's pixels, which is what
+    // the player keeps around when nothing is streamed
+    uint64_t ResidentBytes = 0;
+};
+
+GifPlaybackCost MeasurePlaybackCost(uint8_t const* data, size_t size);
@@ -0,0 +1,115 @@
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <iterator>
+#include <stdexcept>
+#include <string>
+#include <vector>
+#include "GifOptimizer.h"
+
+// Has no Windows dependencies so that it can run as part of an asset
+// pipeline on any platform. Decoding is shared with the player.
+
+static bool ReadFile(char const* path, std::vector<uint8_t>& bytes)
+{
+    std::ifstream file(path, std::ios::binary);
+    if (!file)
+    {
+        return false;
+    }
+    bytes.assign(std::istreambuf_iterator<char>(file), std::istreambuf_iterator<char>());
+    return true;
+}
+
+static bool WriteFile(char const* path, std::vector<uint8_t> const& bytes)
+{
+    std::ofstream file(path, std::ios::binary);
+    file.write(reinterpret_cast<char const*>(bytes.data()), static_cast<std::streamsize>(bytes.size()));
+    return static_cast<bool>(file);
+}
+
+static double ToMB(uint64_t bytes)
+{
+    return static_cast<double>(bytes) / (1024.0 * 1024.0);
+}
+
+static double ToMs(std::chrono::microseconds time)
+{
+    return static_cast<double>(time.count()) / 1000.0;
+}
+
+int main(int argc, char* argv[])
+{
+    if (argc != 3 || std::strcmp(argv[1], "-help") == 0 || std::strcmp(argv[1], "/?") == 0)
+    {
+        printf("GifOptimizer <input gif> <output gif>\n");
+        printf("Rewrites a gif so that VisitorGag can play it back as cheaply as possible, without\n");
+        printf("changing what it looks like. If the gif can't be improved it's copied as is.\n");
+        return argc == 3 ? 0 : 1;
+    }
+
+    std::vector<uint8_t> input;
+    if (!ReadFile(argv[1], input))
+    {
+        printf("Failed to read \"%s\"\n", argv[1]);
+        return 1;
+    }
+
+    GifPlaybackCost before;
+    try
+    {
+        before = MeasurePlaybackCost(input.data(), input.size());
+    }
+    catch (std::runtime_error const& error)
+    {
+        printf("Failed to read \"%s\": %s\n", argv[1], error.what());
+        return 1;
+    }
+    GifOptimizerResult result;
+    try
+    {
+        result = OptimizeGif(input.data(), input.size());
+    }
+    catch (std::runtime_error const& error)
+    {
+        // It's still a perfectly good gif, it just gets passed through
+        printf("Can't optimize \"%s\": %s\n", argv[1], error.what());
+    }
+
+    // Only worth it if it's cheaper to play
+    auto after = before;
+    auto improved = false;
+    if (!result.Bytes.empty())
+    {
+        after = MeasurePlaybackCost(result.Bytes.data(), result.Bytes.size());
+        improved = after.ResidentBytes < before.ResidentBytes || after.DecodeTime < before.DecodeTime;
+    }
+    if (!improved)
+    {
+        after = before;
+    }
+    auto&& output = improved ? result.Bytes : input;
+    if (!WriteFile(argv[2], output))
+    {
+        printf("Failed to write \"%s\"\n", argv[2]);
+        return 1;
+    }
+
+    auto&& stats = result.Stats;
+    if (improved)
+    {
+        printf("Frames: %u -> %u (%u duplicate(s) merged, %u clear to the background)\n",
+            stats.InputFrames, stats.OutputFrames, stats.MergedFrames, stats.RestoreToBackgroundFrames);
+        printf("Frame pixels: %llu -> %llu\n",
+            static_cast<unsigned long long>(stats.InputFramePixels), static_cast<unsigned long long>(stats.OutputFramePixels));
+        printf("Palette: %s, up to %u color(s)\n", stats.GlobalPalette ? "global" : "per frame", stats.MaxPaletteColors);
+    }
+    else
+    {
+        printf("No improvement, copied the original\n");
+    }
+    printf("File size: %.2f MB -> %.2f MB\n", ToMB(input.size()), ToMB(output.size()));
+    printf("Decode time: %.2f ms -> %.2f ms\n", ToMs(before.DecodeTime), ToMs(after.DecodeTime));
+    printf("Resident memory: %.2f MB -> %.2f MB\n", ToMB(before.ResidentBytes), ToMB(after.ResidentBytes));
+    return 0;
+}
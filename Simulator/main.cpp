@@ -0,0 +1,81 @@
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include "../VisitorGag/LifecycleSimulation.h"
+
+// The same simulation as VisitorGag's "-simulate", without any Windows
+// dependencies so that it can run anywhere. See the README for how to
+// build it.
+
+static double ToMs(std::chrono::microseconds time)
+{
+    return static_cast<double>(time.count()) / 1000.0;
+}
+
+static double ToMB(uint64_t bytes)
+{
+    return static_cast<double>(bytes) / (1024.0 * 1024.0);
+}
+
+int main(int argc, char* argv[])
+{
+    LifecycleSimulationOptions options;
+    bool valid = argc >= 2 && std::strcmp(argv[1], "-help") != 0 && std::strcmp(argv[1], "/?") != 0;
+    if (valid)
+    {
+        options.Duration = std::chrono::hours(std::strtoul(argv[1], nullptr, 10));
+    }
+    for (int i = 2; valid && i < argc; i++)
+    {
+        auto hasValue = i + 1 < argc;
+        if (std::strcmp(argv[i], "-hibernate") == 0)
+        {
+            options.Hibernate = true;
+        }
+        else if (std::strcmp(argv[i], "-visitors") == 0 && hasValue)
+        {
+            options.Visitors = static_cast<uint32_t>(std::strtoul(argv[++i], nullptr, 10));
+        }
+        else if (std::strcmp(argv[i], "-seed") == 0 && hasValue)
+        {
+            options.Seed = std::strtoull(argv[++i], nullptr, 10);
+        }
+        else if (std::strcmp(argv[i], "-minDelay") == 0 && hasValue)
+        {
+            options.MinDelayMs = static_cast<uint32_t>(std::strtoul(argv[++i], nullptr, 10));
+        }
+        else if (std::strcmp(argv[i], "-maxDelay") == 0 && hasValue)
+        {
+            options.MaxDelayMs = static_cast<uint32_t>(std::strtoul(argv[++i], nullptr, 10));
+        }
+        else
+        {
+            valid = false;
+        }
+    }
+    if (!valid || options.Duration.count() == 0 || options.Visitors == 0 || options.MinDelayMs > options.MaxDelayMs)
+    {
+        printf("Simulator <hours> [-visitors <count>] [-seed <number>] [-hibernate] [-minDelay <ms>] [-maxDelay <ms>]\n");
+        printf("Simulates the visitor's schedule against stubbed capture, animation and hibernation.\n");
+        return argc >= 2 && !valid ? 1 : 0;
+    }
+
+    printf("Simulating %u visitor(s) for %lld hour(s) with seed %llu...\n",
+        options.Visitors, static_cast<long long>(options.Duration.count()), static_cast<unsigned long long>(options.Seed));
+    auto result = RunLifecycleSimulation(options);
+    auto&& totals = result.Totals;
+    printf("Shows: %u, hides: %u, hibernations: %u, wakes: %u\n", totals.Shows, totals.Hides, totals.Hibernations, totals.Wakes);
+    if (result.WakesWhileHibernating > 0 || result.HibernatedWhileVisible > 0)
+    {
+        printf("Wakes while hibernating: %u, hibernated while visible: %u\n", result.WakesWhileHibernating, result.HibernatedWhileVisible);
+    }
+    if (totals.Shows > 0)
+    {
+        printf("Show latency: %.1f ms average, %.1f ms max\n", ToMs(totals.TotalShowLatency) / totals.Shows, ToMs(totals.MaxShowLatency));
+    }
+    printf("Visible for %.1f hour(s) in total, at most %u visitor(s) at once\n",
+        static_cast<double>(totals.VisibleTime.count()) / 3600000000.0, result.PeakVisible);
+    printf("Memory: %.1f MB peak, %.1f MB average\n", ToMB(result.PeakBytes), ToMB(result.AverageBytes));
+    printf("Processed %llu event(s) in %.1f ms\n", static_cast<unsigned long long>(result.Events), ToMs(result.Elapsed));
+    return 0;
+}
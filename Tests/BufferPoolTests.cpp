@@ -0,0 +1,130 @@
+#include "Test.h"
+#include "../VisitorGag/BufferPool.h"
+#include <memory>
+#include <string>
+#include <thread>
+
+TEST(ResourcePoolReusesExactKeys)
+{
+    ResourcePool<std::string, std::unique_ptr<int>> pool;
+    CHECK(!pool.TryAcquire("64x64").has_value());
+    pool.Release("64x64", std::make_unique<int>(1), 100);
+    pool.Release("64x64", std::make_unique<int>(2), 100);
+    pool.Release("32x32", std::make_unique<int>(3), 50);
+    CHECK(pool.Stats().RetainedBytes == 250);
+
+    CHECK(!pool.TryAcquire("64x32").has_value());
+    // Most recently released first, it's the likeliest to still be warm
+    auto reused = pool.TryAcquire("64x64");
+    CHECK(reused.has_value() && **reused == 2);
+    reused = pool.TryAcquire("64x64");
+    CHECK(reused.has_value() && **reused == 1);
+    CHECK(!pool.TryAcquire("64x64").has_value());
+
+    auto&& stats = pool.Stats();
+    CHECK(stats.Acquires == 5 && stats.Reuses == 2);
+    CHECK(stats.Releases == 3 && stats.Evictions == 0);
+    CHECK(stats.RetainedBytes == 50 && stats.PeakRetainedBytes == 250);
+
+    pool.Trim();
+    CHECK(pool.Stats().RetainedBytes == 0);
+    CHECK(!pool.TryAcquire("32x32").has_value());
+}
+
+TEST(ResourcePoolStaysWithinItsLimit)
+{
+    ResourcePool<int, int> pool(300);
+    pool.Release(1, 10, 200);
+    // Would go over, so it's dropped rather than kept
+    pool.Release(1, 11, 200);
+    pool.Release(2, 12, 100);
+    CHECK(pool.Stats().Evictions == 1);
+    CHECK(pool.Stats().RetainedBytes == 300);
+    CHECK(pool.TryAcquire(1) == std::optional<int>(10));
+    CHECK(!pool.TryAcquire(1).has_value());
+    pool.Release(1, 13, 200);
+    CHECK(pool.Stats().Evictions == 1);
+    CHECK(pool.Stats().PeakRetainedBytes == 300);
+}
+
+TEST(BufferPoolReusesSizeClasses)
+{
+    CHECK(BufferPool::SizeClass(1) == BufferPool::MinSizeClass);
+    CHECK(BufferPool::SizeClass(4096) == 4096);
+    CHECK(BufferPool::SizeClass(4097) == 8192);
+    CHECK(BufferPool::SizeClass(1000000) == 1048576);
+
+    BufferPool pool;
+    uint8_t const* first = nullptr;
+    {
+        auto buffer = pool.Acquire(5000);
+        CHECK(buffer.Size() == 5000 && buffer.Capacity() == 8192);
+        first = buffer.Data();
+    }
+    CHECK(pool.Stats().RetainedBytes == 8192);
+
+    // Anything in the same class gets the same memory back
+    auto buffer = pool.Acquire(8000);
+    CHECK(buffer.Data() == first);
+    CHECK(buffer.Size() == 8000);
+    auto other = pool.Acquire(6000);
+    CHECK(other.Data() != first);
+    auto larger = pool.Acquire(9000);
+    CHECK(larger.Capacity() == 16384);
+
+    // Moving hands over ownership without going back to the pool
+    PooledBuffer moved = std::move(buffer);
+    CHECK(buffer.Data() == nullptr && buffer.Empty());
+    CHECK(moved.Data() == first);
+    CHECK(pool.Stats().RetainedBytes == 0);
+    moved.Reset();
+    CHECK(pool.Stats().RetainedBytes == 8192);
+    CHECK(moved.Data() == nullptr);
+
+    CHECK(pool.Acquire(0).Data() == nullptr);
+    auto&& stats = pool.Stats();
+    CHECK(stats.Reuses == 1);
+    pool.Trim();
+    CHECK(pool.Stats().RetainedBytes == 0);
+}
+
+TEST(BufferPoolIsThreadSafe)
+{
+    BufferPool pool(1 << 20);
+    std::vector<std::thread> threads;
+    for (int t = 0; t < 4; t++)
+    {
+        threads.emplace_back([&pool, t]
+        {
+            for (int i = 0; i < 2000; i++)
+            {
+                auto buffer = pool.Acquire(static_cast<size_t>(4096) << ((i + t) % 4));
+                buffer.Data()[0] = static_cast<uint8_t>(i);
+                buffer.Data()[buffer.Size() - 1] = static_cast<uint8_t>(t);
+            }
+        });
+    }
+    for (auto&& thread : threads)
+    {
+        thread.join();
+    }
+    auto stats = pool.Stats();
+    CHECK(stats.Acquires == 8000 && stats.Releases == 8000);
+    CHECK(stats.Reuses > 0);
+    CHECK(stats.RetainedBytes <= 1 << 20);
+}
+
+BENCHMARK(BufferPoolAcquire)
+{
+    BufferPool pool;
+    auto pooled = MeasureMicroseconds(100000, [&] { pool.Acquire(256 * 1024).Data()[0] = 1; });
+    // Volatile so that the allocation can't be optimized out
+    static uint8_t* volatile allocated = nullptr;
+    auto heap = MeasureMicroseconds(100000, [&]
+    {
+        allocated = new uint8_t[256 * 1024];
+        allocated[0] = 1;
+        delete[] allocated;
+    });
+    printf("256 KB buffer: pooled %.3f us, heap %.3f us\n", pooled, heap);
+}
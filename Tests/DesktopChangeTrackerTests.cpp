@@ -0,0 +1,122 @@
+#include "Test.h"
+#include "../VisitorGag/DesktopChangeTracker.h"
+#include <random>
+
+TEST(DesktopChangeTrackerStartsInvalid)
+{
+    DesktopChangeTracker tracker;
+    CHECK(!tracker.IsValid());
+    CHECK(!tracker.IsUnchanged({ 0, 0, 10, 10 }));
+
+    // Changes while invalid are counted but not kept
+    tracker.AddChange({ 0, 0, 5, 5 });
+    CHECK(tracker.TotalChanges() == 1);
+    CHECK(tracker.Changes().empty());
+
+    tracker.Refresh();
+    CHECK(tracker.IsValid());
+    CHECK(tracker.IsUnchanged({ 0, 0, 10, 10 }));
+    tracker.AddChange({ 0, 0, 5, 5 });
+    CHECK(!tracker.IsUnchanged({ 0, 0, 10, 10 }));
+
+    tracker.Invalidate();
+    CHECK(!tracker.IsValid());
+    CHECK(tracker.Changes().empty());
+    CHECK(!tracker.IsUnchanged({ 100, 100, 10, 10 }));
+    CHECK(tracker.TotalChanges() == 2);
+}
+
+TEST(DesktopChangeTrackerMergesContainedChanges)
+{
+    DesktopChangeTracker tracker;
+    tracker.Refresh();
+
+    // Empty rects aren't changes at all
+    tracker.AddChange({ 10, 10, 0, 5 });
+    tracker.AddChange({ 10, 10, 5, -1 });
+    CHECK(tracker.TotalChanges() == 0);
+    CHECK(tracker.Changes().empty());
+
+    // Anything inside a change we have is already covered
+    tracker.AddChange({ 10, 10, 20, 20 });
+    tracker.AddChange({ 15, 15, 5, 5 });
+    tracker.AddChange({ 10, 10, 20, 20 });
+    CHECK(tracker.Changes().size() == 1);
+    CHECK(tracker.TotalChanges() == 3);
+
+    // And a change covering ones we have replaces them
+    tracker.AddChange({ 100, 0, 4, 4 });
+    tracker.AddChange({ 0, 0, 50, 50 });
+    CHECK(tracker.Changes().size() == 2);
+    CHECK(tracker.Changes()[0].X == 100);
+    CHECK(tracker.Changes()[1].Width == 50);
+
+    // Touching edges don't overlap
+    CHECK(tracker.IsUnchanged({ 50, 0, 50, 50 }));
+    CHECK(tracker.IsUnchanged({ 0, 50, 100, 10 }));
+    CHECK(tracker.IsUnchanged({ 104, 0, 10, 10 }));
+    CHECK(!tracker.IsUnchanged({ 49, 49, 2, 2 }));
+    CHECK(!tracker.IsUnchanged({ 99, 3, 2, 2 }));
+}
+
+TEST(DesktopChangeTrackerCollapsesLongLists)
+{
+    DesktopChangeTracker tracker;
+    tracker.Refresh();
+    for (int32_t i = 0; i < static_cast<int32_t>(DesktopChangeTracker::MaxChanges); i++)
+    {
+        tracker.AddChange({ i * 20, 100 + i, 10, 10 });
+    }
+    CHECK(tracker.Changes().size() == DesktopChangeTracker::MaxChanges);
+    // The gaps between changes are still unchanged
+    CHECK(tracker.IsUnchanged({ 10, 100, 10, 10 }));
+
+    // One more and they become their bounding box
+    tracker.AddChange({ 5, 50, 1, 1 });
+    CHECK(tracker.Changes().size() == 1);
+    auto&& box = tracker.Changes().front();
+    CHECK(box.X == 0 && box.Y == 50);
+    CHECK(box.Right() == 31 * 20 + 10 && box.Bottom() == 100 + 31 + 10);
+    CHECK(!tracker.IsUnchanged({ 10, 100, 10, 10 }));
+    CHECK(tracker.IsUnchanged({ 0, 0, 1000, 50 }));
+    CHECK(tracker.TotalChanges() == DesktopChangeTracker::MaxChanges + 1);
+}
+
+TEST(DesktopChangeTrackerNeverMissesAChange)
+{
+    // However the changes get merged, a region touching any of them must
+    // be captured again
+    std::mt19937 random(45);
+    for (int run = 0; run < 200; run++)
+    {
+        DesktopChangeTracker tracker;
+        tracker.Refresh();
+        std::vector<TileRect> added;
+        auto count = random() % 50;
+        for (uint32_t i = 0; i < count; i++)
+        {
+            TileRect rect = { static_cast<int32_t>(random() % 60), static_cast<int32_t>(random() % 60),
+                static_cast<int32_t>(random() % 12), static_cast<int32_t>(random() % 12) };
+            tracker.AddChange(rect);
+            added.push_back(rect);
+        }
+        CHECK(tracker.Changes().size() <= DesktopChangeTracker::MaxChanges);
+        for (int32_t y = 0; y < 72; y += 3)
+        {
+            for (int32_t x = 0; x < 72; x += 3)
+            {
+                TileRect region = { x, y, 3, 3 };
+                bool touched = false;
+                for (auto&& rect : added)
+                {
+                    touched |= rect.Width > 0 && rect.Height > 0 && rect.X < region.Right() && region.X < rect.Right() &&
+                        rect.Y < region.Bottom() && region.Y < rect.Bottom();
+                }
+                if (touched)
+                {
+                    CHECK(!tracker.IsUnchanged(region));
+                }
+            }
+        }
+    }
+}
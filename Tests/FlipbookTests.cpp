@@ -0,0 +1,172 @@
+#include "Test.h"
+#include "../VisitorGag/Flipbook.h"
+#include <random>
+#include <stdexcept>
+
+TEST(FlipbookPlanCountsTheTilesEachFrameDraws)
+{
+    // 4x3 tiles, the last column 4 wide and the last row 6 tall
+    TileGrid grid(100, 70, 32);
+    auto plan = FlipbookPlan::Compute(grid, { { 0, 0, 100, 70 } }, 0);
+    CHECK(!plan.Enabled);
+    CHECK(plan.Bytes == 0 && plan.Images == 0);
+
+    // Every tile, then the four around one small spot
+    std::vector<TileRect> frames = { { 0, 0, 100, 70 }, { 30, 30, 5, 5 } };
+    plan = FlipbookPlan::Compute(grid, frames, 0);
+    CHECK(plan.Enabled);
+    CHECK(plan.Images == 12 + 4);
+    CHECK(plan.Bytes == 100 * 70 * 4 + 4 * 32 * 32 * 4);
+
+    // Clipped edge tiles only count what's on the canvas
+    plan = FlipbookPlan::Compute(grid, { { 90, 60, 50, 50 }, { 0, 0, 0, 0 } }, 0);
+    CHECK(plan.Enabled);
+    CHECK(plan.Images == 4);
+    CHECK(plan.Bytes == (32 * 32 + 4 * 32 + 32 * 6 + 4 * 6) * 4);
+}
+
+TEST(FlipbookPlanStaysWithinTheBudget)
+{
+    TileGrid grid(100, 70, 32);
+    std::vector<TileRect> frames = { { 0, 0, 100, 70 }, { 30, 30, 5, 5 } };
+    uint64_t needed = 100 * 70 * 4 + 4 * 32 * 32 * 4;
+    CHECK(FlipbookPlan::Compute(grid, frames, needed).Enabled);
+    auto plan = FlipbookPlan::Compute(grid, frames, needed - 1);
+    CHECK(!plan.Enabled);
+    CHECK(plan.Bytes > needed - 1);
+
+    // It stops adding up once the budget is gone
+    frames.push_back({ 0, 0, 100, 70 });
+    plan = FlipbookPlan::Compute(grid, frames, 100 * 70 * 4);
+    CHECK(!plan.Enabled);
+    CHECK(plan.Images == 16);
+
+    // Long gifs fall back to compositing without a budget of their own
+    TileGrid large(1024, 1024, 256);
+    std::vector<TileRect> many(65, TileRect{ 0, 0, 1024, 1024 });
+    CHECK(!FlipbookPlan::Compute(large, many, 0).Enabled);
+    many.pop_back();
+    CHECK(FlipbookPlan::Compute(large, many, 0).Enabled);
+    CHECK(FlipbookPlan::Compute(large, many, 0).Bytes == FlipbookPlan::DefaultBudgetBytes);
+}
+
+TEST(FlipbookStoreSharesUnchangedTiles)
+{
+    FlipbookStore store;
+    CHECK(!store.IsComplete());
+    store.Reset(3, { 10, 20, 30, 40 });
+    CHECK(store.PageCount() == 3 && store.TileCount() == 4);
+    CHECK(!store.HasPage(0) && store.CanRecord(0) && !store.CanRecord(1));
+    CHECK_THROWS(store.Record(1, { 0 }), std::runtime_error);
+
+    CHECK(store.Record(0, { 0, 2 }) == 0);
+    CHECK(store.Image(0, 0) == 0 && store.Image(0, 2) == 1);
+    CHECK(store.Image(0, 1) == FlipbookStore::ClearImage && store.Image(0, 3) == FlipbookStore::ClearImage);
+
+    // Page 1 only redraws tile 2, page 2 nothing at all
+    CHECK(store.Record(1, { 2 }) == 2);
+    CHECK(store.Image(1, 0) == 0 && store.Image(1, 2) == 2);
+    CHECK(store.Record(2, {}) == 3);
+    CHECK(store.IsComplete() && store.HasPage(2));
+    CHECK(!store.CanRecord(3));
+    CHECK_THROWS(store.Record(2, { 1 }), std::runtime_error);
+    CHECK(store.ImageCount() == 3);
+    CHECK(store.Bytes() == 10 + 30 + 30);
+
+    std::vector<size_t> tiles;
+    store.Differences(0, 1, tiles);
+    CHECK((tiles == std::vector<size_t>{ 2 }));
+    tiles.clear();
+    store.Differences(1, 2, tiles);
+    CHECK(tiles.empty());
+    store.Differences(2, 0, tiles);
+    CHECK((tiles == std::vector<size_t>{ 2 }));
+
+    store.Reset(2, { 5 });
+    CHECK(store.RecordedPages() == 0 && store.ImageCount() == 0 && store.Bytes() == 0);
+    CHECK(store.Record(0, { 0 }) == 0);
+}
+
+TEST(FlipbookStoreMatchesRedrawingEveryPage)
+{
+    // Each page's tiles, tracked by hand as the frame that last drew them
+    std::mt19937 random(47);
+    for (int run = 0; run < 20; run++)
+    {
+        auto tileCount = 1 + random() % 30;
+        auto pageCount = 1 + random() % 40;
+        FlipbookStore store;
+        store.Reset(pageCount, std::vector<uint64_t>(tileCount, 64));
+        std::vector<std::vector<int64_t>> drawnBy;
+        std::vector<int64_t> current(tileCount, -1);
+        size_t changes = 0;
+        for (size_t page = 0; page < pageCount; page++)
+        {
+            std::vector<size_t> changed;
+            for (size_t tile = 0; tile < tileCount; tile++)
+            {
+                if (random() % 3 == 0)
+                {
+                    changed.push_back(tile);
+                    current[tile] = static_cast<int64_t>(page);
+                }
+            }
+            store.Record(page, changed);
+            drawnBy.push_back(current);
+            changes += changed.size();
+        }
+        CHECK(store.ImageCount() == changes);
+        CHECK(store.Bytes() == changes * 64);
+
+        std::vector<size_t> tiles;
+        for (size_t from = 0; from < pageCount; from++)
+        {
+            for (size_t to = 0; to < pageCount; to++)
+            {
+                tiles.clear();
+                store.Differences(from, to, tiles);
+                std::vector<size_t> expected;
+                for (size_t tile = 0; tile < tileCount; tile++)
+                {
+                    if (drawnBy[from][tile] != drawnBy[to][tile])
+                    {
+                        expected.push_back(tile);
+                    }
+                }
+                CHECK(tiles == expected);
+            }
+        }
+    }
+}
+
+BENCHMARK(FlipbookDifferences)
+{
+    // A 1080p canvas in 256 pixel tiles with a sprite moving around
+    TileGrid grid(1920, 1080, 256);
+    FlipbookStore store;
+    std::vector<uint64_t> tileBytes;
+    for (size_t i = 0; i < grid.TileCount(); i++)
+    {
+        auto bounds = grid.TileBounds(i);
+        tileBytes.push_back(static_cast<uint64_t>(bounds.Width) * bounds.Height * 4);
+    }
+    size_t pages = 120;
+    store.Reset(pages, tileBytes);
+    std::vector<size_t> tiles;
+    for (size_t page = 0; page < pages; page++)
+    {
+        tiles.clear();
+        grid.TilesIntersecting({ static_cast<int32_t>(page * 13), static_cast<int32_t>(page * 7), 400, 300 }, tiles);
+        store.Record(page, tiles);
+    }
+    auto microseconds = MeasureMicroseconds(2000, [&]
+    {
+        for (size_t page = 0; page < pages; page++)
+        {
+            tiles.clear();
+            store.Differences(page, (page + 1) % pages, tiles);
+        }
+    });
+    printf("%zu tiles, %zu pages, %.1f MB: %.2f us per page flip\n", grid.TileCount(), pages,
+        static_cast<double>(store.Bytes()) / (1024.0 * 1024.0), microseconds / pages);
+}
@@ -0,0 +1,189 @@
+#include "Test.h"
+#include "../GifOptimizer/GifCompositor.h"
+#include "../GifOptimizer/GifEncoder.h"
+#include "../VisitorGag/FrameBlendKernels.h"
+#include <cstring>
+#include <random>
+
+namespace
+{
+    char const* const ClassNames[] = { "Empty", "Opaque", "Keyed", "Blended" };
+
+    // A valid premultiplied frame that can only be in the given class or
+    // a simpler one
+    std::vector<uint8_t> MakeFrame(FrameBlendClass blendClass, uint32_t width, uint32_t height, std::mt19937& random)
+    {
+        std::vector<uint8_t> pixels(static_cast<size_t>(width) * height * 4);
+        for (size_t i = 0; i < static_cast<size_t>(width) * height; i++)
+        {
+            uint32_t alpha = 0;
+            switch (blendClass)
+            {
+            case FrameBlendClass::Empty:
+                break;
+            case FrameBlendClass::Opaque:
+                alpha = 255;
+                break;
+            case FrameBlendClass::Keyed:
+                alpha = random() % 3 == 0 ? 0 : 255;
+                break;
+            case FrameBlendClass::Blended:
+                alpha = random() % 2 == 0 ? 255 : random() % 256;
+                break;
+            }
+            pixels[i * 4 + 3] = static_cast<uint8_t>(alpha);
+            for (size_t c = 0; c < 3; c++)
+            {
+                pixels[i * 4 + c] = static_cast<uint8_t>(random() % (alpha + 1));
+            }
+        }
+        return pixels;
+    }
+}
+
+TEST(FrameBlendClassifiesFrames)
+{
+    std::mt19937 random(1);
+    CHECK(ClassifyFrameBlend(MakeFrame(FrameBlendClass::Empty, 9, 4, random).data(), 9, 4, 36) == FrameBlendClass::Empty);
+    CHECK(ClassifyFrameBlend(MakeFrame(FrameBlendClass::Opaque, 9, 4, random).data(), 9, 4, 36) == FrameBlendClass::Opaque);
+
+    std::vector<uint8_t> keyed = { 0, 0, 0, 0, 1, 2, 3, 255 };
+    CHECK(ClassifyFrameBlend(keyed.data(), 2, 1, 8) == FrameBlendClass::Keyed);
+    // Transparent but not zero can't be skipped
+    keyed[0] = 1;
+    CHECK(ClassifyFrameBlend(keyed.data(), 2, 1, 8) == FrameBlendClass::Blended);
+    std::vector<uint8_t> partial = { 0, 0, 0, 254 };
+    CHECK(ClassifyFrameBlend(partial.data(), 1, 1, 4) == FrameBlendClass::Blended);
+
+    // Only the pixels inside the width count, not the padding
+    std::vector<uint8_t> padded = { 1, 2, 3, 255, 9, 9, 9, 9 };
+    CHECK(ClassifyFrameBlend(padded.data(), 1, 1, 8) == FrameBlendClass::Opaque);
+
+    FrameBlendStats stats;
+    stats.Add(FrameBlendClass::Keyed);
+    stats.Add(FrameBlendClass::Keyed);
+    stats.Add(FrameBlendClass::Empty);
+    CHECK(stats.KeyedFrames == 2 && stats.EmptyFrames == 1 && stats.Frames() == 3);
+}
+
+TEST(FrameBlendKernelsMatchTheGenericBlend)
+{
+    // Odd sizes and pitches so that the SSE2 tails get covered
+    std::mt19937 random(2);
+    for (int trial = 0; trial < 2000; trial++)
+    {
+        uint32_t width = 1 + random() % 37;
+        uint32_t height = 1 + random() % 9;
+        auto source = MakeFrame(static_cast<FrameBlendClass>(random() % 4), width + 3, height, random);
+        auto blendClass = ClassifyFrameBlend(source.data(), width, height, (width + 3) * 4);
+        auto destination = MakeFrame(FrameBlendClass::Blended, width + 1, height, random);
+        auto expected = destination;
+        SelectFrameBlendKernel(blendClass)(destination.data(), (width + 1) * 4, source.data(), (width + 3) * 4, width, height);
+        BlendFrameGeneric(expected.data(), (width + 1) * 4, source.data(), (width + 3) * 4, width, height);
+        CHECK(destination == expected);
+    }
+}
+
+TEST(FrameBlendRoundsLikeFloatingPoint)
+{
+    // Every premultiplied source against every destination value, one
+    // pixel at a time and four at a time
+    auto kernel = SelectFrameBlendKernel(FrameBlendClass::Blended);
+    for (uint32_t alpha = 0; alpha < 256; alpha++)
+    {
+        for (uint32_t color = 0; color <= alpha; color++)
+        {
+            for (uint32_t under = 0; under < 256; under++)
+            {
+                uint8_t source[16];
+                uint8_t single[4];
+                uint8_t quad[16];
+                for (size_t i = 0; i < 16; i++)
+                {
+                    source[i] = static_cast<uint8_t>(i % 4 == 3 ? alpha : color);
+                    quad[i] = static_cast<uint8_t>(under);
+                }
+                std::memcpy(single, quad, sizeof(single));
+                kernel(single, 4, source, 4, 1, 1);
+                kernel(quad, 16, source, 16, 4, 1);
+                auto expected = static_cast<int>(color + under * (255.0 - alpha) / 255.0 + 0.5);
+                CHECK(single[0] == expected);
+                CHECK(std::memcmp(single, quad, sizeof(single)) == 0);
+            }
+        }
+    }
+}
+
+BENCHMARK(FrameBlendKernels)
+{
+    std::mt19937 random(3);
+    uint32_t const width = 480;
+    uint32_t const height = 270;
+    for (uint32_t i = 0; i < 4; i++)
+    {
+        auto source = MakeFrame(static_cast<FrameBlendClass>(i), width, height, random);
+        auto destination = MakeFrame(FrameBlendClass::Opaque, width, height, random);
+        auto kernel = SelectFrameBlendKernel(ClassifyFrameBlend(source.data(), width, height, width * 4));
+        auto generic = MeasureMicroseconds(400, [&] { BlendFrameGeneric(destination.data(), width * 4, source.data(), width * 4, width, height); });
+        auto specialized = MeasureMicroseconds(400, [&] { kernel(destination.data(), width * 4, source.data(), width * 4, width, height); });
+        auto classify = MeasureMicroseconds(400, [&] { ClassifyFrameBlend(source.data(), width, height, width * 4); });
+        printf("%-8s generic %7.1f us, specialized %7.1f us (%.1fx), classify %7.1f us\n", ClassNames[i], generic, specialized, generic / specialized, classify);
+    }
+}
+
+namespace
+{
+    // Full-canvas frames of runs of palette colors, every third one with a
+    // transparent color
+    std::vector<uint8_t> MakeCompositorGif(uint16_t width, uint16_t height, uint32_t frameCount, std::mt19937& random)
+    {
+        std::vector<uint32_t> palette = { 0xFF000000, 0xFFFF0000, 0xFF00FF00, 0xFF0000FF, 0xFFFFFFFF, 0xFF808080, 0xFF123456, 0xFFFEDCBA };
+        GifWriter writer(width, height, palette, 0);
+        for (uint32_t i = 0; i < frameCount; i++)
+        {
+            GifWriterFrame frame;
+            frame.Rect = { 0, 0, width, height };
+            frame.Delay = 4;
+            frame.TransparentIndex = static_cast<int16_t>(i % 3 == 0 ? -1 : 0);
+            frame.Indices.resize(static_cast<size_t>(width) * height);
+            for (size_t p = 0; p < frame.Indices.size(); p++)
+            {
+                frame.Indices[p] = p > 0 && random() % 8 != 0 ? frame.Indices[p - 1] : static_cast<uint8_t>(random() % palette.size());
+            }
+            writer.AddFrame(frame);
+        }
+        return writer.Finish();
+    }
+}
+
+TEST(GifCompositorMatchesTheGenericBlend)
+{
+    std::mt19937 random(4);
+    auto bytes = MakeCompositorGif(61, 37, 9, random);
+    auto index = GifIndex::Build(bytes.data(), bytes.size());
+    GifCompositor compositor(bytes.data(), bytes.size(), index);
+    GifFrameDecoder decoder(bytes.data(), bytes.size(), index);
+    std::vector<uint8_t> expected(61 * 37 * 4);
+    std::vector<uint8_t> frame(61 * 37 * 4);
+    while (compositor.Next())
+    {
+        decoder.Decode(compositor.Frame(), frame.data(), 61 * 4);
+        BlendFrameGeneric(expected.data(), 61 * 4, frame.data(), 61 * 4, 61, 37);
+        CHECK(std::memcmp(compositor.Canvas().data(), expected.data(), expected.size()) == 0);
+    }
+}
+
+BENCHMARK(GifCompositorPlayback)
+{
+    std::mt19937 random(5);
+    auto bytes = MakeCompositorGif(480, 270, 30, random);
+    auto index = GifIndex::Build(bytes.data(), bytes.size());
+    auto microseconds = MeasureMicroseconds(10, [&]
+    {
+        GifCompositor compositor(bytes.data(), bytes.size(), index);
+        while (compositor.Next())
+        {
+        }
+    });
+    printf("480x270, a third of frames opaque: %.1f us per frame\n", microseconds / index.FrameCount());
+}
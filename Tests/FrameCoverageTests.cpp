@@ -0,0 +1,266 @@
+#include "Test.h"
+#include "../VisitorGag/FrameCoverage.h"
+#include <algorithm>
+#include <climits>
+#include <random>
+
+namespace
+{
+    struct Canvas
+    {
+        uint32_t Width = 0;
+        uint32_t Height = 0;
+        uint32_t RowPitch = 0;
+        std::vector<uint8_t> Pixels;
+
+        Canvas(uint32_t width, uint32_t height, uint32_t padding = 0)
+            : Width(width), Height(height), RowPitch((width + padding) * 4), Pixels(static_cast<size_t>(height) * (width + padding) * 4, 0)
+        {
+            // Padding is never looked at
+            for (uint32_t y = 0; y < height; y++)
+            {
+                std::fill_n(Pixels.data() + static_cast<size_t>(y) * RowPitch + static_cast<size_t>(width) * 4, padding * 4, uint8_t(0xFF));
+            }
+        }
+
+        bool IsOpaque(int32_t x, int32_t y) const
+        {
+            return Pixels[static_cast<size_t>(y) * RowPitch + static_cast<size_t>(x) * 4 + 3] != 0;
+        }
+
+        void Set(int32_t x, int32_t y, uint8_t alpha = 255)
+        {
+            Pixels[static_cast<size_t>(y) * RowPitch + static_cast<size_t>(x) * 4 + 3] = alpha;
+        }
+
+        void Fill(FrameRegion rect)
+        {
+            for (auto y = rect.Y; y < rect.Y + rect.Height; y++)
+            {
+                for (auto x = rect.X; x < rect.X + rect.Width; x++)
+                {
+                    Set(x, y);
+                }
+            }
+        }
+
+        FrameCoverage Analyze(FrameCoverageOptions const& options = {}) const
+        {
+            return AnalyzeFrameCoverage(Pixels.data(), Width, Height, RowPitch, options);
+        }
+    };
+
+    // Checks the coverage against a straightforward scan of the canvas
+    void CheckCoverage(Canvas const& canvas, FrameCoverage const& coverage)
+    {
+        int32_t left = INT32_MAX;
+        int32_t top = INT32_MAX;
+        int32_t right = 0;
+        int32_t bottom = 0;
+        uint64_t opaque = 0;
+        for (int32_t y = 0; y < static_cast<int32_t>(canvas.Height); y++)
+        {
+            for (int32_t x = 0; x < static_cast<int32_t>(canvas.Width); x++)
+            {
+                if (canvas.IsOpaque(x, y))
+                {
+                    left = std::min(left, x);
+                    top = std::min(top, y);
+                    right = std::max(right, x + 1);
+                    bottom = std::max(bottom, y + 1);
+                    opaque++;
+                }
+            }
+        }
+        CHECK(coverage.OpaquePixels == opaque);
+        if (opaque == 0)
+        {
+            CHECK(coverage.IsEmpty());
+            CHECK(coverage.BlendedPixels() == 0);
+            return;
+        }
+        CHECK((coverage.Bounds == FrameRegion{ left, top, right - left, bottom - top }));
+        if (coverage.Rects.empty())
+        {
+            return;
+        }
+
+        // The rects cover every opaque pixel exactly once and nothing else
+        std::vector<uint8_t> covered(static_cast<size_t>(canvas.Width) * canvas.Height, 0);
+        for (auto&& rect : coverage.Rects)
+        {
+            for (auto y = rect.Y; y < rect.Y + rect.Height; y++)
+            {
+                for (auto x = rect.X; x < rect.X + rect.Width; x++)
+                {
+                    covered[static_cast<size_t>(y) * canvas.Width + x]++;
+                }
+            }
+        }
+        for (int32_t y = 0; y < static_cast<int32_t>(canvas.Height); y++)
+        {
+            for (int32_t x = 0; x < static_cast<int32_t>(canvas.Width); x++)
+            {
+                CHECK(covered[static_cast<size_t>(y) * canvas.Width + x] == (canvas.IsOpaque(x, y) ? 1 : 0));
+            }
+        }
+        CHECK(coverage.BlendedPixels() == opaque);
+    }
+}
+
+TEST(FrameCoverageFindsTightBounds)
+{
+    Canvas empty(37, 21);
+    auto coverage = empty.Analyze();
+    CHECK(coverage.IsEmpty());
+    CheckCoverage(empty, coverage);
+
+    // A single pixel in every possible spot, including odd columns that
+    // the four-wide scan has to finish one at a time
+    Canvas canvas(9, 5, 3);
+    for (int32_t y = 0; y < 5; y++)
+    {
+        for (int32_t x = 0; x < 9; x++)
+        {
+            canvas.Set(x, y);
+            coverage = canvas.Analyze();
+            CHECK((coverage.Bounds == FrameRegion{ x, y, 1, 1 }));
+            CHECK(coverage.OpaquePixels == 1);
+            canvas.Set(x, y, 0);
+        }
+    }
+
+    // Any non-zero alpha counts
+    Canvas faint(64, 64);
+    faint.Set(3, 60, 1);
+    faint.Set(50, 2, 1);
+    coverage = faint.Analyze();
+    CHECK((coverage.Bounds == FrameRegion{ 3, 2, 48, 59 }));
+    CheckCoverage(faint, coverage);
+}
+
+TEST(FrameCoverageMergesSpansIntoRects)
+{
+    // Two bars down a mostly transparent frame
+    Canvas bars(100, 80);
+    bars.Fill({ 10, 5, 4, 70 });
+    bars.Fill({ 60, 5, 7, 70 });
+    auto coverage = bars.Analyze();
+    CHECK(coverage.Rects.size() == 2);
+    CHECK((coverage.Rects[0] == FrameRegion{ 10, 5, 4, 70 }));
+    CHECK((coverage.Rects[1] == FrameRegion{ 60, 5, 7, 70 }));
+    CHECK(coverage.BlendedPixels() == (4 + 7) * 70);
+    CheckCoverage(bars, coverage);
+
+    // An L shape changes its spans partway down
+    Canvas shape(50, 50);
+    shape.Fill({ 0, 0, 5, 40 });
+    shape.Fill({ 0, 40, 45, 5 });
+    coverage = shape.Analyze();
+    CHECK(coverage.Rects.size() == 2);
+    CheckCoverage(shape, coverage);
+
+    // Mostly opaque frames draw their bounds
+    Canvas solid(50, 50);
+    solid.Fill({ 5, 5, 40, 40 });
+    solid.Set(10, 10, 0);
+    coverage = solid.Analyze();
+    CHECK(coverage.Rects.empty());
+    CHECK(coverage.BlendedPixels() == 40 * 40);
+    CheckCoverage(solid, coverage);
+}
+
+TEST(FrameCoverageCapsTheRectCount)
+{
+    // Every row has different spans, one rect per span
+    Canvas stairs(200, 100);
+    for (int32_t y = 0; y < 16; y++)
+    {
+        stairs.Fill({ y * 3, y, 2, 1 });
+        stairs.Fill({ 100 + y * 3, y, 2, 1 });
+    }
+    FrameCoverageOptions options;
+    auto coverage = stairs.Analyze(options);
+    CHECK(coverage.Rects.size() == 32);
+    CheckCoverage(stairs, coverage);
+
+    // One more and it falls back to the bounds
+    stairs.Fill({ 190, 16, 2, 1 });
+    coverage = stairs.Analyze(options);
+    CHECK(coverage.Rects.empty());
+    CHECK(coverage.BlendedPixels() == static_cast<uint64_t>(coverage.Bounds.Width) * coverage.Bounds.Height);
+    CheckCoverage(stairs, coverage);
+
+    options.MaxRects = 64;
+    coverage = stairs.Analyze(options);
+    CHECK(coverage.Rects.size() == 33);
+    options.SpanThreshold = 0.0f;
+    CHECK(stairs.Analyze(options).Rects.empty());
+}
+
+TEST(FrameCoverageMatchesABruteForceScan)
+{
+    std::mt19937 random(8);
+    for (int i = 0; i < 300; i++)
+    {
+        Canvas canvas(1 + random() % 70, 1 + random() % 40, random() % 3);
+        auto shapes = random() % 4;
+        for (uint32_t shape = 0; shape < shapes; shape++)
+        {
+            auto x = static_cast<int32_t>(random() % canvas.Width);
+            auto y = static_cast<int32_t>(random() % canvas.Height);
+            auto width = 1 + static_cast<int32_t>(random() % (canvas.Width - x));
+            auto height = 1 + static_cast<int32_t>(random() % (canvas.Height - y));
+            canvas.Fill({ x, y, width, height });
+        }
+        CheckCoverage(canvas, canvas.Analyze());
+    }
+
+    std::vector<OpaqueSpan> spans;
+    Canvas row(11, 1);
+    row.Fill({ 0, 0, 2, 1 });
+    row.Fill({ 5, 0, 1, 1 });
+    row.Fill({ 8, 0, 3, 1 });
+    FindOpaqueSpans(row.Pixels.data(), 7, 1, 10, spans);
+    CHECK(spans.size() == 3);
+    CHECK(spans[0].Row == 7 && spans[0].Start == 1 && spans[0].Length == 1);
+    CHECK(spans[1].Start == 5 && spans[1].Length == 1);
+    CHECK(spans[2].Start == 8 && spans[2].Length == 2);
+}
+
+BENCHMARK(FrameCoverageAnalyze)
+{
+    // A sprite with a soft outline floating in a larger transparent frame,
+    // the usual shape of a visitor GIF
+    Canvas canvas(480, 270);
+    for (int32_t y = 0; y < 270; y++)
+    {
+        for (int32_t x = 0; x < 480; x++)
+        {
+            auto dx = (x - 300) / 110.0;
+            auto dy = (y - 150) / 90.0;
+            if (dx * dx + dy * dy <= 1.0)
+            {
+                canvas.Set(x, y);
+            }
+        }
+    }
+    auto coverage = canvas.Analyze();
+    auto microseconds = MeasureMicroseconds(2000, [&] { canvas.Analyze(); });
+    printf("480x270 sprite: %u pixels, %llu blended through %zu rects (%llu opaque), %.1f us\n",
+        480u * 270u, static_cast<unsigned long long>(coverage.BlendedPixels()), coverage.Rects.size(),
+        static_cast<unsigned long long>(coverage.OpaquePixels), microseconds);
+
+    // Scattered specks keep the rects under the cap but make every row
+    // scan all the way across
+    Canvas sparse(1920, 1080);
+    for (int32_t y = 100; y < 1000; y++)
+    {
+        sparse.Set(200, y);
+        sparse.Set(1700, y);
+    }
+    coverage = sparse.Analyze();
+    microseconds = MeasureMicroseconds(200, [&] { sparse.Analyze(); });
+    printf("1920x1080 sparse: %u pixels, %llu blended through %zu rects, %.1f us\n",
+        1920u * 1080u, static_cast<unsigned long long>(coverage.BlendedPixels()), coverage.Rects.size(), microseconds);
+}
@@ -0,0 +1,124 @@
+#include "Test.h"
+#include "../VisitorGag/FrameDeduplicator.h"
+#include <algorithm>
+#include <random>
+
+namespace
+{
+    struct Frame
+    {
+        FrameRegion Region;
+        std::vector<uint8_t> Pixels;
+    };
+
+    Frame MakeFrame(FrameRegion region, uint32_t seed)
+    {
+        std::mt19937 random(seed);
+        Frame frame = { region, std::vector<uint8_t>(static_cast<size_t>(region.Width) * region.Height * 4) };
+        for (auto&& byte : frame.Pixels)
+        {
+            byte = static_cast<uint8_t>(random());
+        }
+        return frame;
+    }
+
+    size_t AddFrame(FrameDeduplicator& dedup, std::vector<Frame> const& frames, size_t index, uint32_t& fetches)
+    {
+        auto&& frame = frames[index];
+        return dedup.Add(index, frame.Region, frame.Pixels.data(), static_cast<uint32_t>(frame.Region.Width) * 4, [&](size_t candidate)
+        {
+            fetches++;
+            return frames[candidate].Pixels.data();
+        });
+    }
+}
+
+TEST(FrameDeduplicatorFindsIdenticalFrames)
+{
+    std::vector<Frame> frames =
+    {
+        MakeFrame({ 0, 0, 40, 30 }, 1),
+        MakeFrame({ 0, 0, 40, 30 }, 2),
+        MakeFrame({ 0, 0, 40, 30 }, 1),
+        // Same pixels somewhere else isn't the same frame
+        MakeFrame({ 5, 0, 40, 30 }, 1),
+        MakeFrame({ 0, 0, 40, 30 }, 2),
+        MakeFrame({ 0, 0, 40, 30 }, 2),
+        MakeFrame({ 0, 0, 7, 3 }, 3),
+    };
+    FrameDeduplicator dedup;
+    dedup.Reset(frames.size());
+    CHECK(!dedup.IsKnown(0));
+    CHECK(dedup.CanonicalOf(4) == 4);
+
+    uint32_t fetches = 0;
+    std::vector<size_t> canonical;
+    for (size_t i = 0; i < frames.size(); i++)
+    {
+        canonical.push_back(AddFrame(dedup, frames, i, fetches));
+        CHECK(dedup.IsKnown(i));
+    }
+    CHECK((canonical == std::vector<size_t>{ 0, 1, 0, 3, 1, 1, 6 }));
+    // Only hash matches are confirmed, against the first copy
+    CHECK(fetches == 3);
+    CHECK(dedup.IsDuplicate(2) && dedup.IsDuplicate(5) && !dedup.IsDuplicate(3));
+    CHECK(!dedup.IsHold(4) && dedup.IsHold(5) && !dedup.IsHold(2));
+
+    auto&& stats = dedup.Stats();
+    CHECK(stats.DuplicateFrames == 3);
+    CHECK(stats.BytesSaved == 3 * 40 * 30 * 4);
+
+    dedup.Reset(2);
+    CHECK(!dedup.IsKnown(0) && dedup.Stats().DuplicateFrames == 0);
+    CHECK(AddFrame(dedup, frames, 0, fetches) == 0);
+}
+
+TEST(FrameDeduplicatorConfirmsMatches)
+{
+    auto frame = MakeFrame({ 0, 0, 16, 16 }, 4);
+    FrameDeduplicator dedup;
+    dedup.Reset(3);
+    dedup.Add(0, frame.Region, frame.Pixels.data(), 16 * 4, [](size_t) { return static_cast<uint8_t const*>(nullptr); });
+    // The hash matches but the earlier pixels are gone, so nothing is shared
+    CHECK(dedup.Add(1, frame.Region, frame.Pixels.data(), 16 * 4, [](size_t) { return static_cast<uint8_t const*>(nullptr); }) == 1);
+    // And pixels that differ from what was hashed don't match either
+    auto stale = frame.Pixels;
+    stale[100] ^= 1;
+    CHECK(dedup.Add(2, frame.Region, frame.Pixels.data(), 16 * 4, [&](size_t) { return stale.data(); }) == 2);
+    CHECK(dedup.Stats().DuplicateFrames == 0);
+}
+
+TEST(FrameDeduplicatorHashIgnoresRowPadding)
+{
+    auto frame = MakeFrame({ 3, 4, 13, 9 }, 5);
+    std::vector<uint8_t> padded(static_cast<size_t>(20) * 4 * 9, 0xEE);
+    for (size_t y = 0; y < 9; y++)
+    {
+        std::copy_n(frame.Pixels.data() + y * 13 * 4, 13 * 4, padded.data() + y * 20 * 4);
+    }
+    auto hash = FrameDeduplicator::Hash(frame.Region, frame.Pixels.data(), 13 * 4);
+    CHECK(FrameDeduplicator::Hash(frame.Region, padded.data(), 20 * 4) == hash);
+    CHECK(FrameDeduplicator::Hash({ 3, 5, 13, 9 }, frame.Pixels.data(), 13 * 4) != hash);
+
+    // Every byte counts, including the ones past the last whole 32 bytes
+    for (size_t i = 0; i < frame.Pixels.size(); i += 7)
+    {
+        auto changed = frame.Pixels;
+        changed[i] ^= 0x10;
+        CHECK(FrameDeduplicator::Hash(frame.Region, changed.data(), 13 * 4) != hash);
+    }
+
+    FrameDeduplicator dedup;
+    dedup.Reset(2);
+    uint32_t fetches = 0;
+    std::vector<Frame> frames = { frame };
+    AddFrame(dedup, frames, 0, fetches);
+    CHECK(dedup.Add(1, frame.Region, padded.data(), 20 * 4, [&](size_t candidate) { return frames[candidate].Pixels.data(); }) == 0);
+}
+
+BENCHMARK(FrameDeduplicatorHash)
+{
+    auto frame = MakeFrame({ 0, 0, 480, 270 }, 6);
+    auto microseconds = MeasureMicroseconds(2000, [&] { FrameDeduplicator::Hash(frame.Region, frame.Pixels.data(), 480 * 4); });
+    printf("480x270 frame: %.1f us (%.1f GB/s)\n", microseconds, static_cast<double>(frame.Pixels.size()) / microseconds / 1000.0);
+}
@@ -0,0 +1,78 @@
+#include "Test.h"
+#include "../VisitorGag/FrameResidencyManager.h"
+
+TEST(FrameResidencyStartsEncoded)
+{
+    FrameResidencyManager manager(1000);
+    manager.Reset({ 100, 200, 300 }, 50);
+    auto usage = manager.Usage();
+    CHECK(usage.EncodedFrames == 3);
+    CHECK(usage.CpuFrames == 0 && usage.GpuFrames == 0);
+    CHECK(usage.TotalBytes() == 50);
+    for (size_t i = 0; i < manager.FrameCount(); i++)
+    {
+        CHECK(manager.Residency(i) == FrameResidency::Encoded);
+    }
+}
+
+TEST(FrameResidencyPinsFramesInOrderUntilTheBudgetRunsOut)
+{
+    // Ten 100 byte frames against room for four of them
+    FrameResidencyManager manager(500);
+    manager.Reset(std::vector<uint64_t>(10, 100), 100);
+    std::vector<FrameResidency> placed;
+    for (size_t i = 0; i < manager.FrameCount(); i++)
+    {
+        placed.push_back(manager.Place(i));
+        manager.SetResidency(i, placed.back());
+    }
+    for (size_t i = 0; i < placed.size(); i++)
+    {
+        CHECK(placed[i] == (i < 4 ? FrameResidency::Gpu : FrameResidency::Encoded));
+    }
+    auto usage = manager.Usage();
+    CHECK(usage.GpuFrames == 4 && usage.GpuBytes == 400);
+    CHECK(usage.EncodedFrames == 6);
+    CHECK(usage.TotalBytes() <= usage.BudgetBytes);
+}
+
+TEST(FrameResidencyWithoutBudgetPinsEverything)
+{
+    FrameResidencyManager manager;
+    manager.Reset(std::vector<uint64_t>(100, 1 << 20), 0);
+    for (size_t i = 0; i < manager.FrameCount(); i++)
+    {
+        CHECK(manager.Place(i) == FrameResidency::Gpu);
+        manager.SetResidency(i, FrameResidency::Gpu);
+    }
+    CHECK(manager.Usage().GpuBytes == 100ull << 20);
+}
+
+TEST(FrameResidencyMovesBytesBetweenTiers)
+{
+    FrameResidencyManager manager(1000);
+    manager.Reset({ 100, 200 }, 0);
+    manager.SetResidency(0, FrameResidency::Cpu);
+    manager.SetResidency(1, FrameResidency::Gpu);
+    CHECK(manager.Usage().CpuBytes == 100 && manager.Usage().GpuBytes == 200);
+    manager.SetResidency(0, FrameResidency::Gpu);
+    CHECK(manager.Usage().CpuBytes == 0 && manager.Usage().GpuBytes == 300);
+    CHECK(manager.Usage().CpuFrames == 0 && manager.Usage().GpuFrames == 2);
+    manager.SetResidency(1, FrameResidency::Encoded);
+    CHECK(manager.Usage().GpuBytes == 100 && manager.Usage().EncodedFrames == 1);
+    // Moving within the budget doesn't count the frame twice
+    CHECK(manager.CanPromote(0, FrameResidency::Cpu));
+}
+
+TEST(FrameResidencyOnlyCorrectsEstimatesForEncodedFrames)
+{
+    FrameResidencyManager manager(1000);
+    manager.Reset({ 100, 100 }, 0);
+    manager.SetFrameBytes(0, 950);
+    CHECK(manager.CanPromote(0, FrameResidency::Gpu));
+    manager.SetResidency(0, FrameResidency::Gpu);
+    CHECK(!manager.CanPromote(1, FrameResidency::Gpu));
+    // Too late once it's resident
+    manager.SetFrameBytes(0, 10);
+    CHECK(manager.Usage().GpuBytes == 950);
+}
@@ -0,0 +1,128 @@
+#include "Test.h"
+#include "../VisitorGag/FrameStream.h"
+#include "../VisitorGag/MpscQueue.h"
+#include <thread>
+
+namespace
+{
+    using clock = FrameStream::clock;
+
+    clock::time_point At(int64_t ms)
+    {
+        return clock::time_point{} + std::chrono::milliseconds(ms);
+    }
+}
+
+TEST(FrameStreamNeverWrapsPastMissingFrames)
+{
+    FrameStream stream;
+    stream.Begin(At(0), 3);
+    size_t next = 99;
+    CHECK(!stream.TryGetNext(0, next));
+
+    stream.Publish(At(20));
+    // Only frame 0 is here, showing it again would be a wrap
+    CHECK(!stream.TryGetNext(0, next));
+    stream.Publish(At(30));
+    CHECK(stream.TryGetNext(0, next) && next == 1);
+    CHECK(!stream.TryGetNext(1, next));
+    CHECK(!stream.IsComplete());
+
+    stream.Publish(At(50));
+    CHECK(stream.IsComplete());
+    CHECK(stream.TryGetNext(1, next) && next == 2);
+    CHECK(stream.TryGetNext(2, next) && next == 0);
+
+    // Extra frames are ignored
+    stream.Publish(At(60));
+    CHECK(stream.Available() == 3);
+    CHECK(stream.Stats().TimeToFirstFrame == std::chrono::milliseconds(20));
+    CHECK(stream.Stats().TotalLoadTime == std::chrono::milliseconds(50));
+}
+
+TEST(FrameStreamCountsStalls)
+{
+    FrameStream stream;
+    stream.Begin(At(100), 2);
+    CHECK(!stream.EndStall(At(100)));
+    stream.BeginStall(At(110));
+    // Already stalled, the first start counts
+    stream.BeginStall(At(120));
+    CHECK(stream.IsStalled());
+    CHECK(stream.EndStall(At(150)));
+    CHECK(!stream.IsStalled());
+    stream.BeginStall(At(200));
+    CHECK(stream.EndStall(At(205)));
+    CHECK(stream.Stats().Stalls == 2);
+    CHECK(stream.Stats().StalledTime == std::chrono::milliseconds(45));
+
+    // A new load starts from scratch
+    stream.Begin(At(300), 1);
+    CHECK(stream.Stats().Stalls == 0);
+    CHECK(stream.Available() == 0 && stream.Expected() == 1);
+
+    size_t next = 0;
+    stream.Begin(At(400), 0);
+    CHECK(stream.IsComplete());
+    CHECK(!stream.TryGetNext(0, next));
+}
+
+TEST(FrameStreamPlaysWhileFramesArrive)
+{
+    // A decoder thread hands frames over through a queue the way the
+    // player does, playback only ever moves to frames it has seen
+    constexpr size_t FrameCount = 2000;
+    FrameStream stream;
+    stream.Begin(clock::now(), FrameCount);
+    MpscQueue<size_t> decoded;
+    std::thread decoder([&]
+    {
+        for (size_t i = 0; i < FrameCount; i++)
+        {
+            decoded.Push(i);
+            if (i % 64 == 0)
+            {
+                std::this_thread::yield();
+            }
+        }
+    });
+
+    size_t current = 0;
+    size_t shown = 0;
+    bool started = false;
+    while (shown < FrameCount * 2)
+    {
+        while (auto frame = decoded.TryPop())
+        {
+            CHECK(*frame == stream.Available());
+            stream.Publish(clock::now());
+            stream.EndStall(clock::now());
+        }
+        if (!started)
+        {
+            if (stream.Available() > 0)
+            {
+                started = true;
+                shown++;
+            }
+            continue;
+        }
+        size_t next = 0;
+        if (stream.TryGetNext(current, next))
+        {
+            CHECK(next < stream.Available());
+            CHECK(next == (current + 1) % FrameCount);
+            current = next;
+            shown++;
+        }
+        else
+        {
+            CHECK(!stream.IsComplete());
+            stream.BeginStall(clock::now());
+        }
+    }
+    decoder.join();
+    CHECK(stream.IsComplete());
+    CHECK(!stream.IsStalled());
+    CHECK(stream.Stats().TimeToFirstFrame <= stream.Stats().TotalLoadTime);
+}
@@ -0,0 +1,150 @@
+#include "Test.h"
+#include "../GifOptimizer/GifEncoder.h"
+#include "../VisitorGag/GifFrameDecoder.h"
+#include <cstring>
+#include <random>
+
+namespace
+{
+    std::vector<uint32_t> const Palette = { 0xFF000000, 0xFFFF0000, 0xFF00FF00, 0xFF0000FF, 0xFFFFFFFF, 0xFF808080, 0xFF123456, 0xFFFEDCBA };
+
+    GifWriterFrame MakeFrame(FrameRegion rect, int16_t transparentIndex, std::mt19937& random)
+    {
+        GifWriterFrame frame;
+        frame.Rect = rect;
+        frame.Delay = 4;
+        frame.TransparentIndex = transparentIndex;
+        frame.Indices.resize(static_cast<size_t>(rect.Width) * rect.Height);
+        for (size_t i = 0; i < frame.Indices.size(); i++)
+        {
+            // Runs of the same index, like real gifs have
+            frame.Indices[i] = i > 0 && random() % 4 != 0 ? frame.Indices[i - 1] : static_cast<uint8_t>(random() % Palette.size());
+        }
+        return frame;
+    }
+
+    uint32_t PixelAt(std::vector<uint8_t> const& pixels, size_t index)
+    {
+        uint32_t pixel = 0;
+        std::memcpy(&pixel, pixels.data() + index * 4, sizeof(pixel));
+        return pixel;
+    }
+}
+
+TEST(GifDecoderMatchesTheEncodedIndices)
+{
+    std::mt19937 random(3);
+    std::vector<GifWriterFrame> frames = {
+        MakeFrame({ 0, 0, 37, 23 }, -1, random),
+        MakeFrame({ 5, 3, 20, 11 }, 2, random),
+        MakeFrame({ 36, 22, 1, 1 }, -1, random),
+    };
+    GifWriter writer(37, 23, Palette, 0);
+    for (auto&& frame : frames)
+    {
+        writer.AddFrame(frame);
+    }
+    auto bytes = writer.Finish();
+
+    auto index = GifIndex::Build(bytes.data(), bytes.size());
+    CHECK(index.FrameCount() == frames.size());
+    CHECK(index.Width == 37 && index.Height == 23);
+    CHECK(index.LoopCount == std::optional<uint16_t>(0));
+    CHECK(index.DurationMs() == 120);
+
+    GifFrameDecoder decoder(bytes.data(), bytes.size(), index);
+    for (size_t i = 0; i < frames.size(); i++)
+    {
+        auto&& frame = frames[i];
+        CHECK(index.Left[i] == frame.Rect.X && index.Top[i] == frame.Rect.Y);
+        std::vector<uint8_t> pixels(frame.Indices.size() * 4);
+        decoder.Decode(i, pixels.data(), frame.Rect.Width * 4);
+        for (size_t p = 0; p < frame.Indices.size(); p++)
+        {
+            auto expected = frame.Indices[p] == frame.TransparentIndex ? 0u : Palette[frame.Indices[p]];
+            CHECK(PixelAt(pixels, p) == expected);
+        }
+    }
+}
+
+TEST(GifDecoderOnlyWritesTheClip)
+{
+    std::mt19937 random(4);
+    auto frame = MakeFrame({ 0, 0, 64, 48 }, 0, random);
+    GifWriter writer(64, 48, Palette, std::nullopt);
+    writer.AddFrame(frame);
+    auto bytes = writer.Finish();
+    auto index = GifIndex::Build(bytes.data(), bytes.size());
+    GifFrameDecoder decoder(bytes.data(), bytes.size(), index);
+
+    std::vector<uint8_t> full(64 * 48 * 4);
+    decoder.Decode(0, full.data(), 64 * 4);
+
+    // Into the middle of a bigger buffer, so that overruns show up
+    FrameRegion clip = { 7, 5, 30, 20 };
+    uint32_t const pitch = 40 * 4;
+    std::vector<uint8_t> clipped(pitch * 30, 0xCD);
+    auto origin = clipped.data() + pitch * 2 + 4 * 3;
+    decoder.Decode(0, { origin, pitch, clip });
+    for (int32_t y = 0; y < 30; y++)
+    {
+        for (int32_t x = 0; x < 40; x++)
+        {
+            auto pixel = PixelAt(clipped, static_cast<size_t>(y) * 40 + x);
+            auto inside = x >= 3 && x < 3 + clip.Width && y >= 2 && y < 2 + clip.Height;
+            if (inside)
+            {
+                CHECK(pixel == PixelAt(full, static_cast<size_t>(y - 2 + clip.Y) * 64 + (x - 3 + clip.X)));
+            }
+            else
+            {
+                CHECK(pixel == 0xCDCDCDCD);
+            }
+        }
+    }
+
+    CHECK_THROWS(decoder.Decode(0, { origin, pitch, { 50, 0, 20, 1 } }), std::invalid_argument);
+    CHECK_THROWS(decoder.Decode(0, { origin, pitch, { -1, 0, 2, 1 } }), std::invalid_argument);
+}
+
+TEST(GifDecoderHandlesTruncatedData)
+{
+    std::mt19937 random(5);
+    GifWriter writer(32, 32, Palette, 0);
+    writer.AddFrame(MakeFrame({ 0, 0, 32, 32 }, -1, random));
+    writer.AddFrame(MakeFrame({ 0, 0, 32, 32 }, -1, random));
+    auto bytes = writer.Finish();
+    auto index = GifIndex::Build(bytes.data(), bytes.size());
+
+    // Cut into the last frame's image data, after the index has been built
+    auto cut = static_cast<size_t>(index.DataOffsets.back()) + 20;
+    GifFrameDecoder decoder(bytes.data(), cut, index);
+    std::vector<uint8_t> pixels(32 * 32 * 4, 0xCD);
+    decoder.Decode(1, pixels.data(), 32 * 4);
+    // Whatever didn't make it is transparent rather than left alone
+    CHECK(PixelAt(pixels, pixels.size() / 4 - 1) == 0);
+
+    CHECK(GifIndex::Build(bytes.data(), cut).FrameCount() == 1);
+    uint8_t const junk[] = { 'n', 'o', 't', ' ', 'a', ' ', 'g', 'i', 'f' };
+    CHECK_THROWS(GifIndex::Build(junk, sizeof(junk)), std::runtime_error);
+}
+
+BENCHMARK(GifDecoderThroughput)
+{
+    std::mt19937 random(6);
+    GifWriter writer(480, 270, Palette, 0);
+    for (int i = 0; i < 20; i++)
+    {
+        writer.AddFrame(MakeFrame({ 0, 0, 480, 270 }, 0, random));
+    }
+    auto bytes = writer.Finish();
+    auto index = GifIndex::Build(bytes.data(), bytes.size());
+    GifFrameDecoder decoder(bytes.data(), bytes.size(), index);
+    std::vector<uint8_t> pixels(480 * 270 * 4);
+    size_t frame = 0;
+    auto microseconds = MeasureMicroseconds(200, [&]
+    {
+        decoder.Decode(frame++ % index.FrameCount(), pixels.data(), 480 * 4);
+    });
+    printf("480x270 frame: %.1f us (%.1f Mpixels/s)\n", microseconds, 480.0 * 270.0 / microseconds);
+}
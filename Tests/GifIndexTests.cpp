@@ -0,0 +1,166 @@
+#include "Test.h"
+#include "../GifOptimizer/GifEncoder.h"
+#include <algorithm>
+#include <cstring>
+
+namespace
+{
+    std::vector<uint32_t> const Palette = { 0xFF000000, 0xFFFF0000, 0xFF00FF00, 0xFF0000FF };
+
+    GifWriterFrame MakeFrame(FrameRegion rect, uint16_t delay)
+    {
+        GifWriterFrame frame;
+        frame.Rect = rect;
+        frame.Delay = delay;
+        frame.Indices.resize(static_cast<size_t>(rect.Width) * rect.Height);
+        for (size_t i = 0; i < frame.Indices.size(); i++)
+        {
+            frame.Indices[i] = static_cast<uint8_t>((i / 3) % Palette.size());
+        }
+        return frame;
+    }
+}
+
+TEST(GifIndexReadsEveryFrame)
+{
+    GifWriter writer(64, 48, Palette, 3);
+    writer.AddFrame(MakeFrame({ 0, 0, 64, 48 }, 5));
+    auto second = MakeFrame({ 10, 8, 20, 16 }, 0);
+    second.Disposal = GifDisposal::RestoreToBackground;
+    second.TransparentIndex = 2;
+    writer.AddFrame(second);
+    auto third = MakeFrame({ 30, 20, 34, 28 }, 12);
+    third.Disposal = GifDisposal::RestoreToPrevious;
+    third.Palette = { 0xFF112233, 0xFF445566 };
+    writer.AddFrame(third);
+    auto bytes = writer.Finish();
+
+    auto index = GifIndex::Build(bytes.data(), bytes.size());
+    CHECK(index.Width == 64 && index.Height == 48);
+    CHECK(index.LoopCount == std::optional<uint16_t>(3));
+    CHECK(index.FrameCount() == 3);
+    CHECK(index.Left[1] == 10 && index.Top[1] == 8 && index.FrameWidth[1] == 20 && index.FrameHeight[1] == 16);
+    CHECK(index.Left[2] == 30 && index.Top[2] == 20 && index.FrameWidth[2] == 34 && index.FrameHeight[2] == 28);
+    CHECK(index.Delays[0] == 5 && index.Delays[1] == 0 && index.Delays[2] == 12);
+    CHECK(index.Disposal[0] == GifDisposal::DoNotDispose);
+    CHECK(index.Disposal[1] == GifDisposal::RestoreToBackground);
+    CHECK(index.Disposal[2] == GifDisposal::RestoreToPrevious);
+    CHECK(index.TransparentIndex[0] == -1 && index.TransparentIndex[1] == 2 && index.TransparentIndex[2] == -1);
+    CHECK(!index.Interlaced[0] && !index.Interlaced[1] && !index.Interlaced[2]);
+    for (size_t i = 0; i < index.FrameCount(); i++)
+    {
+        CHECK(bytes[index.DescriptorOffsets[i]] == 0x2C);
+        CHECK(index.DataOffsets[i] > index.DescriptorOffsets[i]);
+    }
+    // The local palette sits between the descriptor and the data
+    CHECK(index.DataOffsets[2] == index.DescriptorOffsets[2] + 10 + 2 * 3);
+}
+
+TEST(GifIndexTimesZeroDelayFrames)
+{
+    GifWriter writer(8, 8, Palette, 0);
+    writer.AddFrame(MakeFrame({ 0, 0, 8, 8 }, 5));
+    writer.AddFrame(MakeFrame({ 0, 0, 8, 8 }, 0));
+    writer.AddFrame(MakeFrame({ 0, 0, 8, 8 }, 2));
+    auto bytes = writer.Finish();
+
+    auto index = GifIndex::Build(bytes.data(), bytes.size());
+    CHECK((index.StartTimesMs == std::vector<uint64_t>{ 0, 50, 150, 170 }));
+    CHECK(index.DurationMs() == 170);
+    CHECK(index.FrameAt(0) == 0);
+    CHECK(index.FrameAt(49) == 0);
+    CHECK(index.FrameAt(50) == 1);
+    CHECK(index.FrameAt(169) == 2);
+    // Clamped to the last frame
+    CHECK(index.FrameAt(170) == 2);
+    CHECK(index.FrameAt(100000) == 2);
+
+    auto fast = GifIndex::Build(bytes.data(), bytes.size(), 20);
+    CHECK(fast.DurationMs() == 90);
+    CHECK(fast.FrameAt(60) == 1);
+}
+
+TEST(GifIndexReadsTheLoopCount)
+{
+    GifWriter once(8, 8, Palette, std::nullopt);
+    once.AddFrame(MakeFrame({ 0, 0, 8, 8 }, 1));
+    auto bytes = once.Finish();
+    CHECK(!GifIndex::Build(bytes.data(), bytes.size()).LoopCount.has_value());
+
+    GifWriter forever(8, 8, Palette, 0);
+    forever.AddFrame(MakeFrame({ 0, 0, 8, 8 }, 1));
+    bytes = forever.Finish();
+    CHECK(GifIndex::Build(bytes.data(), bytes.size()).LoopCount == std::optional<uint16_t>(0));
+
+    // Some encoders write the same block under another name
+    GifWriter animexts(8, 8, Palette, 7);
+    animexts.AddFrame(MakeFrame({ 0, 0, 8, 8 }, 1));
+    bytes = animexts.Finish();
+    auto name = std::search(bytes.begin(), bytes.end(), "NETSCAPE2.0", "NETSCAPE2.0" + 11);
+    CHECK(name != bytes.end());
+    std::memcpy(&*name, "ANIMEXTS1.0", 11);
+    CHECK(GifIndex::Build(bytes.data(), bytes.size()).LoopCount == std::optional<uint16_t>(7));
+
+    // Any other application extension is skipped
+    std::memcpy(&*name, "XMP DataXMP", 11);
+    auto index = GifIndex::Build(bytes.data(), bytes.size());
+    CHECK(!index.LoopCount.has_value());
+    CHECK(index.FrameCount() == 1);
+}
+
+TEST(GifIndexStopsAtTheLastCompleteFrame)
+{
+    GifWriter writer(16, 16, Palette, 0);
+    for (uint16_t i = 0; i < 4; i++)
+    {
+        writer.AddFrame(MakeFrame({ 0, 0, 16, 16 }, i));
+    }
+    auto bytes = writer.Finish();
+    auto full = GifIndex::Build(bytes.data(), bytes.size());
+    CHECK(full.FrameCount() == 4);
+
+    // Each frame's data ends where the next frame's 8-byte graphic control
+    // extension starts, or at the trailer
+    std::vector<size_t> ends;
+    for (size_t i = 1; i < full.FrameCount(); i++)
+    {
+        ends.push_back(full.DescriptorOffsets[i] - 8);
+    }
+    ends.push_back(bytes.size() - 1);
+
+    // Every possible cut either throws for want of a frame or indexes the
+    // frames whose data fits
+    size_t previous = 0;
+    for (size_t size = 0; size <= bytes.size(); size++)
+    {
+        auto expected = static_cast<size_t>(std::upper_bound(ends.begin(), ends.end(), size) - ends.begin());
+        if (expected == 0)
+        {
+            CHECK_THROWS(GifIndex::Build(bytes.data(), size), std::runtime_error);
+            continue;
+        }
+        auto index = GifIndex::Build(bytes.data(), size);
+        CHECK(index.FrameCount() == expected);
+        CHECK(index.FrameCount() >= previous);
+        CHECK(index.StartTimesMs.size() == index.FrameCount() + 1);
+        previous = index.FrameCount();
+    }
+    CHECK(previous == 4);
+
+    // Garbage after a frame ends the file there
+    auto garbage = bytes;
+    garbage[full.DescriptorOffsets[2] - 8] = 0x42;
+    CHECK(GifIndex::Build(garbage.data(), garbage.size()).FrameCount() == 2);
+}
+
+BENCHMARK(GifIndexBuild)
+{
+    GifWriter writer(480, 270, Palette, 0);
+    for (uint16_t i = 0; i < 500; i++)
+    {
+        writer.AddFrame(MakeFrame({ 0, 0, 480, 270 }, 4));
+    }
+    auto bytes = writer.Finish();
+    auto microseconds = MeasureMicroseconds(100, [&] { GifIndex::Build(bytes.data(), bytes.size()); });
+    printf("500 frames, %.1f MB: %.1f us (%.0f MB/s)\n", static_cast<double>(bytes.size()) / (1024.0 * 1024.0), microseconds, static_cast<double>(bytes.size()) / microseconds);
+}
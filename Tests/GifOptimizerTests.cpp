@@ -0,0 +1,206 @@
+#include "Test.h"
+#include "../GifOptimizer/GifCompositor.h"
+#include "../GifOptimizer/GifEncoder.h"
+#include "../GifOptimizer/GifOptimizer.h"
+#include <algorithm>
+#include <random>
+
+namespace
+{
+    using Canvas = std::vector<uint32_t>;
+
+    struct Animation
+    {
+        uint16_t Width = 0;
+        uint16_t Height = 0;
+        std::vector<Canvas> Frames;
+        // In 10ms units
+        std::vector<uint16_t> Delays;
+        std::optional<uint16_t> LoopCount;
+    };
+
+    // Every frame covers the whole canvas with its own palette and clears
+    // itself away, so what's on screen is exactly the frame
+    std::vector<uint8_t> Encode(Animation const& animation)
+    {
+        GifWriter writer(animation.Width, animation.Height, {}, animation.LoopCount);
+        for (size_t i = 0; i < animation.Frames.size(); i++)
+        {
+            auto&& pixels = animation.Frames[i];
+            GifWriterFrame frame;
+            frame.Rect = { 0, 0, animation.Width, animation.Height };
+            frame.Delay = animation.Delays[i];
+            frame.Disposal = GifDisposal::RestoreToBackground;
+            frame.Palette = pixels;
+            std::sort(frame.Palette.begin(), frame.Palette.end());
+            frame.Palette.erase(std::unique(frame.Palette.begin(), frame.Palette.end()), frame.Palette.end());
+            if (frame.Palette.front() == 0)
+            {
+                frame.TransparentIndex = 0;
+            }
+            for (auto pixel : pixels)
+            {
+                auto match = std::lower_bound(frame.Palette.begin(), frame.Palette.end(), pixel);
+                frame.Indices.push_back(static_cast<uint8_t>(std::distance(frame.Palette.begin(), match)));
+            }
+            writer.AddFrame(frame);
+        }
+        return writer.Finish();
+    }
+
+    // What's on screen for each 10ms of one loop
+    std::vector<Canvas> Timeline(std::vector<uint8_t> const& bytes)
+    {
+        auto index = GifIndex::Build(bytes.data(), bytes.size());
+        GifCompositor compositor(bytes.data(), bytes.size(), index);
+        std::vector<Canvas> timeline;
+        while (compositor.Next())
+        {
+            timeline.insert(timeline.end(), index.Delays[compositor.Frame()], compositor.Canvas());
+        }
+        return timeline;
+    }
+
+    void Fill(Canvas& canvas, uint16_t width, FrameRegion rect, uint32_t color)
+    {
+        for (auto y = rect.Y; y < rect.Y + rect.Height; y++)
+        {
+            std::fill_n(canvas.begin() + static_cast<size_t>(y) * width + rect.X, rect.Width, color);
+        }
+    }
+
+    // A two-tone sprite walking across a transparent canvas, pausing for a
+    // few frames and disappearing for one
+    Animation MakeWalk(uint16_t width, uint16_t height, uint32_t frameCount, int32_t size)
+    {
+        Animation walk;
+        walk.Width = width;
+        walk.Height = height;
+        walk.LoopCount = 3;
+        for (uint32_t i = 0; i < frameCount; i++)
+        {
+            Canvas canvas(static_cast<size_t>(width) * height, 0);
+            auto step = static_cast<int32_t>(std::min(i, 3u) + (i > 5 ? i - 5 : 0));
+            auto x = step * (width - size) / static_cast<int32_t>(frameCount);
+            if (i != frameCount - 2)
+            {
+                Fill(canvas, width, { x, height / 4, size, size }, 0xFF20A040);
+                Fill(canvas, width, { x + size / 4, height / 4 + size / 4, size / 2, size / 2 }, 0xFFF0E010);
+            }
+            walk.Frames.push_back(std::move(canvas));
+            walk.Delays.push_back(static_cast<uint16_t>(3 + i % 4));
+        }
+        return walk;
+    }
+}
+
+TEST(GifOptimizerPlaysTheSame)
+{
+    // Frames 3, 4 and 5 are the same
+    auto walk = MakeWalk(64, 48, 12, 12);
+    auto input = Encode(walk);
+    auto result = OptimizeGif(input.data(), input.size());
+    CHECK(Timeline(result.Bytes) == Timeline(input));
+
+    auto&& stats = result.Stats;
+    CHECK(stats.InputFrames == 12);
+    CHECK(stats.MergedFrames == 2);
+    CHECK(stats.OutputFrames == 10);
+    CHECK(stats.InputFramePixels == 12 * 64 * 48);
+    CHECK(stats.OutputFramePixels < stats.InputFramePixels / 4);
+    // Moving pixels have to become transparent again
+    CHECK(stats.RestoreToBackgroundFrames > 0);
+    CHECK(stats.GlobalPalette && stats.MaxPaletteColors == 3);
+    CHECK(result.Bytes.size() < input.size());
+
+    auto index = GifIndex::Build(result.Bytes.data(), result.Bytes.size());
+    CHECK(index.FrameCount() == 10);
+    CHECK(index.LoopCount == std::optional<uint16_t>(3));
+    CHECK(index.Delays[3] == 6 + 3 + 4);
+
+    // Nothing left to take out the second time around
+    auto again = OptimizeGif(result.Bytes.data(), result.Bytes.size());
+    CHECK(again.Stats.MergedFrames == 0);
+    CHECK(again.Stats.OutputFramePixels == stats.OutputFramePixels);
+    CHECK(Timeline(again.Bytes) == Timeline(input));
+}
+
+TEST(GifOptimizerCropsToChanges)
+{
+    // An opaque background with one pixel blinking
+    Animation blink;
+    blink.Width = 40;
+    blink.Height = 30;
+    for (uint32_t i = 0; i < 6; i++)
+    {
+        Canvas canvas(40 * 30, 0xFF3060C0);
+        canvas[17 * 40 + 23] = i % 2 == 0 ? 0xFF3060C0 : 0xFFFFFFFF;
+        blink.Frames.push_back(std::move(canvas));
+        blink.Delays.push_back(5);
+    }
+    auto input = Encode(blink);
+    auto result = OptimizeGif(input.data(), input.size());
+    CHECK(Timeline(result.Bytes) == Timeline(input));
+    CHECK(result.Stats.OutputFrames == 6);
+    CHECK(result.Stats.RestoreToBackgroundFrames == 0);
+    CHECK(result.Stats.OutputFramePixels == 40 * 30 + 5);
+    CHECK(!GifIndex::Build(result.Bytes.data(), result.Bytes.size()).LoopCount.has_value());
+}
+
+TEST(GifOptimizerMergesZeroDelays)
+{
+    Animation held;
+    held.Width = 8;
+    held.Height = 8;
+    held.Frames = { Canvas(64, 0xFF000080), Canvas(64, 0xFF000080), Canvas(64, 0xFF800000) };
+    held.Delays = { 0, 5, 7 };
+    auto input = Encode(held);
+    auto result = OptimizeGif(input.data(), input.size());
+    auto index = GifIndex::Build(result.Bytes.data(), result.Bytes.size());
+    CHECK(index.FrameCount() == 2);
+    // A zero delay counts as 100ms once it's merged with something
+    CHECK(index.Delays[0] == 15 && index.Delays[1] == 7);
+
+    // And stays zero when it isn't
+    held.Delays = { 0, 5, 0 };
+    input = Encode(held);
+    result = OptimizeGif(input.data(), input.size());
+    index = GifIndex::Build(result.Bytes.data(), result.Bytes.size());
+    CHECK(index.Delays[0] == 15 && index.Delays[1] == 0);
+}
+
+TEST(GifOptimizerFallsBackToFramePalettes)
+{
+    // 200 colors a frame, none shared, so no single palette fits
+    Animation colorful;
+    colorful.Width = 20;
+    colorful.Height = 10;
+    for (uint32_t i = 0; i < 3; i++)
+    {
+        Canvas canvas;
+        for (uint32_t p = 0; p < 200; p++)
+        {
+            canvas.push_back(0xFF000000 | (i << 16) | p);
+        }
+        colorful.Frames.push_back(std::move(canvas));
+        colorful.Delays.push_back(2);
+    }
+    auto input = Encode(colorful);
+    auto result = OptimizeGif(input.data(), input.size());
+    CHECK(Timeline(result.Bytes) == Timeline(input));
+    CHECK(!result.Stats.GlobalPalette);
+    CHECK(result.Stats.MaxPaletteColors == 200);
+
+    std::vector<uint8_t> garbage = { 'G', 'I', 'F', '0', '0' };
+    CHECK_THROWS(OptimizeGif(garbage.data(), garbage.size()), std::runtime_error);
+}
+
+BENCHMARK(GifOptimizerThroughput)
+{
+    auto walk = MakeWalk(480, 270, 30, 90);
+    auto input = Encode(walk);
+    GifOptimizerResult result;
+    auto microseconds = MeasureMicroseconds(3, [&] { result = OptimizeGif(input.data(), input.size()); });
+    printf("480x270, 30 frames: %.1f ms, %zu -> %zu bytes, %llu -> %llu frame pixels\n", microseconds / 1000.0, input.size(), result.Bytes.size(),
+        static_cast<unsigned long long>(result.Stats.InputFramePixels), static_cast<unsigned long long>(result.Stats.OutputFramePixels));
+}
@@ -0,0 +1,55 @@
+#include "Test.h"
+#include "../VisitorGag/HibernationStateMachine.h"
+
+namespace
+{
+    using clock = HibernationStateMachine::clock;
+
+    clock::time_point At(int64_t ms)
+    {
+        return clock::time_point{} + std::chrono::milliseconds(ms);
+    }
+}
+
+TEST(HibernationRoundTrip)
+{
+    HibernationStateMachine machine;
+    CHECK(machine.State() == HibernationState::Awake);
+    CHECK(!machine.TryBeginWake(At(0)));
+    CHECK(machine.TryBeginHibernate(At(0)));
+    CHECK(!machine.TryBeginHibernate(At(1)));
+    CHECK(machine.CompleteHibernate(At(20), 4));
+    CHECK(machine.State() == HibernationState::Hibernated);
+    CHECK(machine.TryBeginWake(At(100)));
+    machine.CompleteWake(At(140), 64);
+    CHECK(machine.State() == HibernationState::Awake);
+
+    auto&& stats = machine.Stats();
+    CHECK(stats.Hibernations == 1);
+    CHECK(stats.LastHibernateDuration == std::chrono::milliseconds(20));
+    CHECK(stats.LastWakeDuration == std::chrono::milliseconds(40));
+    CHECK(stats.IdleBytes == 4 && stats.AwakeBytes == 64);
+    CHECK(machine.WakeLeadTime() == std::chrono::milliseconds(80));
+}
+
+TEST(HibernationKeepsAWakeThatArrivesWhileHibernating)
+{
+    HibernationStateMachine machine;
+    CHECK(machine.TryBeginHibernate(At(0)));
+    CHECK(!machine.TryBeginWake(At(5)));
+    CHECK(machine.WakePending());
+    // Hibernating is abandoned and we go straight to waking
+    CHECK(!machine.CompleteHibernate(At(20), 4));
+    CHECK(machine.State() == HibernationState::Waking);
+    CHECK(!machine.WakePending());
+    CHECK(machine.Stats().Hibernations == 0);
+    machine.CompleteWake(At(60), 64);
+    CHECK(machine.State() == HibernationState::Awake);
+    CHECK(machine.Stats().LastWakeDuration == std::chrono::milliseconds(40));
+}
+
+TEST(HibernationLeadTimeDefaultsBeforeTheFirstWake)
+{
+    HibernationStateMachine machine;
+    CHECK(machine.WakeLeadTime() == std::chrono::milliseconds(500));
+}
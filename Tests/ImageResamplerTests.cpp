@@ -0,0 +1,174 @@
+#include "Test.h"
+#include "../VisitorGag/ImageResampler.h"
+#include <limits>
+#include <random>
+
+namespace
+{
+    ResampleFilter const Filters[] = { ResampleFilter::Box, ResampleFilter::Bilinear, ResampleFilter::Lanczos };
+
+    std::vector<uint8_t> MakeCanvas(uint32_t width, uint32_t height, std::mt19937& random)
+    {
+        std::vector<uint8_t> pixels(static_cast<size_t>(width) * height * 4);
+        for (size_t i = 0; i < static_cast<size_t>(width) * height; i++)
+        {
+            uint32_t alpha = random() % 2 == 0 ? 255 : random() % 256;
+            pixels[i * 4 + 3] = static_cast<uint8_t>(alpha);
+            for (size_t c = 0; c < 3; c++)
+            {
+                pixels[i * 4 + c] = static_cast<uint8_t>(random() % (alpha + 1));
+            }
+        }
+        return pixels;
+    }
+}
+
+TEST(ImageScaleFitsWithinTheMaximum)
+{
+    uint32_t width = 0;
+    uint32_t height = 0;
+    ImageScale scale;
+    scale.Apply(400, 300, width, height);
+    CHECK(width == 400 && height == 300);
+
+    scale.Scale = 2.0f;
+    scale.MaxWidth = 500;
+    scale.Apply(400, 300, width, height);
+    CHECK(width == 500 && height == 375);
+
+    scale = {};
+    scale.MaxWidth = 100;
+    scale.MaxHeight = 100;
+    scale.Apply(400, 1000, width, height);
+    CHECK(width == 40 && height == 100);
+
+    scale = {};
+    scale.Scale = 0.001f;
+    scale.Apply(400, 300, width, height);
+    CHECK(width == 1 && height == 1);
+}
+
+TEST(ImageScaleStaysWithinTextureLimits)
+{
+    uint32_t width = 0;
+    uint32_t height = 0;
+    ImageScale scale;
+    scale.Scale = 1e30f;
+    scale.Apply(400, 300, width, height);
+    CHECK(width == ImageScale::MaxSize && height == 12288);
+
+    scale.Scale = 100.0f;
+    scale.MaxWidth = 1000000;
+    scale.MaxHeight = 1000000;
+    scale.Apply(10, 1000, width, height);
+    CHECK(width == 164 && height == ImageScale::MaxSize);
+
+    for (auto bad : { std::numeric_limits<float>::infinity(), std::numeric_limits<float>::quiet_NaN(), -2.0f, 0.0f })
+    {
+        scale = {};
+        scale.Scale = bad;
+        scale.Apply(400, 300, width, height);
+        CHECK(width == 400 && height == 300);
+    }
+}
+
+TEST(ResamplerOutputIsPremultiplied)
+{
+    std::mt19937 random(1);
+    auto canvas = MakeCanvas(80, 60, random);
+    for (auto filter : Filters)
+    {
+        for (auto [scaledWidth, scaledHeight] : { std::pair{ 40u, 30u }, std::pair{ 203u, 97u }, std::pair{ 3u, 2u } })
+        {
+            FrameResampler resampler(80, 60, scaledWidth, scaledHeight, filter);
+            TileRect frame = { 0, 0, 80, 60 };
+            auto rect = resampler.ScaledRect(frame);
+            CHECK(rect.X == 0 && rect.Y == 0 && rect.Width == static_cast<int32_t>(scaledWidth) && rect.Height == static_cast<int32_t>(scaledHeight));
+            std::vector<uint8_t> scaled(static_cast<size_t>(rect.Width) * rect.Height * 4);
+            resampler.Resample(frame, canvas.data(), 80 * 4, scaled.data(), rect.Width * 4);
+            for (size_t i = 0; i < scaled.size(); i += 4)
+            {
+                CHECK(scaled[i] <= scaled[i + 3] && scaled[i + 1] <= scaled[i + 3] && scaled[i + 2] <= scaled[i + 3]);
+            }
+        }
+    }
+}
+
+TEST(ResamplerKeepsFlatColors)
+{
+    // Renormalized at the canvas edges, so a solid canvas stays solid
+    std::vector<uint8_t> canvas(50 * 40 * 4);
+    for (size_t i = 0; i < canvas.size(); i += 4)
+    {
+        canvas[i] = 10;
+        canvas[i + 1] = 100;
+        canvas[i + 2] = 200;
+        canvas[i + 3] = 255;
+    }
+    for (auto filter : Filters)
+    {
+        FrameResampler resampler(50, 40, 77, 23, filter);
+        std::vector<uint8_t> scaled(77 * 23 * 4);
+        resampler.Resample({ 0, 0, 50, 40 }, canvas.data(), 50 * 4, scaled.data(), 77 * 4);
+        for (size_t i = 0; i < scaled.size(); i += 4)
+        {
+            CHECK(scaled[i] == 10 && scaled[i + 1] == 100 && scaled[i + 2] == 200 && scaled[i + 3] == 255);
+        }
+    }
+}
+
+TEST(ResamplerClipsMatchTheWholeFrame)
+{
+    std::mt19937 random(2);
+    auto canvas = MakeCanvas(200, 150, random);
+    for (auto filter : Filters)
+    {
+        FrameResampler resampler(200, 150, 333, 117, filter);
+        // A frame in the middle of the canvas bleeds past its own edges
+        TileRect frame = { 13, 27, 101, 61 };
+        auto rect = resampler.ScaledRect(frame);
+        CHECK(rect.Width > 0 && rect.Height > 0);
+        auto source = canvas.data() + (static_cast<size_t>(frame.Y) * 200 + frame.X) * 4;
+        std::vector<uint8_t> full(static_cast<size_t>(rect.Width) * rect.Height * 4);
+        resampler.Resample(frame, source, 200 * 4, full.data(), rect.Width * 4);
+
+        TileRect clip = { 3, 2, rect.Width - 7, rect.Height - 5 };
+        std::vector<uint8_t> clipped(static_cast<size_t>(clip.Width) * clip.Height * 4);
+        resampler.Resample(frame, source, 200 * 4, clip, clipped.data(), clip.Width * 4);
+        bool matches = true;
+        for (int32_t y = 0; y < clip.Height; y++)
+        {
+            for (int32_t x = 0; x < clip.Width * 4; x++)
+            {
+                matches = matches && clipped[static_cast<size_t>(y) * clip.Width * 4 + x] == full[static_cast<size_t>(y + clip.Y) * rect.Width * 4 + clip.X * 4 + x];
+            }
+        }
+        CHECK(matches);
+    }
+}
+
+TEST(ResamplerRejectsEmptyCanvases)
+{
+    CHECK_THROWS(FrameResampler(0, 10, 10, 10, ResampleFilter::Box), std::invalid_argument);
+    CHECK_THROWS(FrameResampler(10, 10, 10, 0, ResampleFilter::Box), std::invalid_argument);
+}
+
+BENCHMARK(ResamplerThroughput)
+{
+    std::mt19937 random(3);
+    auto canvas = MakeCanvas(800, 600, random);
+    char const* const names[] = { "box", "bilinear", "lanczos" };
+    for (auto filter : Filters)
+    {
+        for (auto [scaledWidth, scaledHeight] : { std::pair{ 400u, 300u }, std::pair{ 1200u, 900u } })
+        {
+            FrameResampler resampler(800, 600, scaledWidth, scaledHeight, filter);
+            std::vector<uint8_t> scaled(static_cast<size_t>(scaledWidth) * scaledHeight * 4);
+            auto microseconds = MeasureMicroseconds(20, [&]
+            {
+                resampler.Resample({ 0, 0, 800, 600 }, canvas.data(), 800 * 4, scaled.data(), scaledWidth * 4);
+            });
+            printf("%-8s 800x600 -> %4ux%-4u %8.1f us\n", names[static_cast<size_t>(filter)], scaledWidth, scaledHeight, microseconds);
+        }
+    }
+}
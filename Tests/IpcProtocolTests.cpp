@@ -0,0 +1,265 @@
+#include "Test.h"
+#include "../VisitorGag/IpcProtocol.h"
+#include <algorithm>
+#include <condition_variable>
+#include <mutex>
+#include <thread>
+
+namespace
+{
+    // One direction of an in-process byte stream
+    struct LoopbackStream
+    {
+        size_t Read(char* data, size_t size)
+        {
+            std::unique_lock lock(m_mutex);
+            m_ready.wait(lock, [&] { return !m_bytes.empty() || m_closed; });
+            auto count = std::min(size, m_bytes.size());
+            std::copy_n(m_bytes.begin(), count, data);
+            m_bytes.erase(0, count);
+            return count;
+        }
+
+        bool Write(char const* data, size_t size)
+        {
+            {
+                std::lock_guard lock(m_mutex);
+                if (m_closed)
+                {
+                    return false;
+                }
+                m_bytes.append(data, size);
+            }
+            m_ready.notify_all();
+            return true;
+        }
+
+        void Close()
+        {
+            {
+                std::lock_guard lock(m_mutex);
+                m_closed = true;
+            }
+            m_ready.notify_all();
+        }
+
+    private:
+        std::mutex m_mutex;
+        std::condition_variable m_ready;
+        std::string m_bytes;
+        bool m_closed = false;
+    };
+
+    // Runs ServeIpcClient on its own thread, the way CommandPipeServer does
+    // for each pipe client
+    struct LoopbackServer
+    {
+        explicit LoopbackServer(IpcBatchHandler const& handler)
+        {
+            m_thread = std::thread([this, handler]
+            {
+                ServeIpcClient(
+                    [this](char* data, size_t size) { return m_toServer.Read(data, size); },
+                    [this](char const* data, size_t size) { return m_toClient.Write(data, size); },
+                    handler);
+                m_toClient.Close();
+            });
+        }
+
+        ~LoopbackServer()
+        {
+            m_toServer.Close();
+            m_thread.join();
+        }
+
+        // Sends the request in one write and reads until the expected number
+        // of response lines arrived or the server hung up
+        std::string Send(std::string const& request, size_t expectedLines)
+        {
+            m_toServer.Write(request.data(), request.size());
+            return Receive(expectedLines);
+        }
+
+        std::string Receive(size_t expectedLines)
+        {
+            std::string responses;
+            char buffer[256] = {};
+            while (static_cast<size_t>(std::count(responses.begin(), responses.end(), '\n')) < expectedLines)
+            {
+                auto bytesRead = m_toClient.Read(buffer, sizeof(buffer));
+                if (bytesRead == 0)
+                {
+                    break;
+                }
+                responses.append(buffer, bytesRead);
+            }
+            return responses;
+        }
+
+        void Disconnect() { m_toServer.Close(); }
+
+    private:
+        LoopbackStream m_toServer;
+        LoopbackStream m_toClient;
+        std::thread m_thread;
+    };
+
+    std::optional<std::vector<std::string>> Echo(std::vector<IpcCommand> const& commands)
+    {
+        char const* const names[] = { "show", "load", "schedule", "stats" };
+        std::vector<std::string> responses;
+        for (auto&& command : commands)
+        {
+            responses.push_back(FormatIpcResponse(true, names[static_cast<size_t>(command.Type)]));
+        }
+        return responses;
+    }
+
+    std::string ParseError(std::string_view line)
+    {
+        std::string error;
+        CHECK(!ParseIpcCommand(line, error).has_value());
+        return error;
+    }
+}
+
+TEST(IpcParsesCommands)
+{
+    std::string error;
+    auto show = ParseIpcCommand("  show ", error);
+    CHECK(show.has_value() && show->Type == IpcCommandType::Show);
+    auto stats = ParseIpcCommand("stats", error);
+    CHECK(stats.has_value() && stats->Type == IpcCommandType::Stats);
+
+    auto load = ParseIpcCommand("load  C:\\Some Folder\\cat.gif ", error);
+    CHECK(load.has_value() && load->Type == IpcCommandType::Load);
+    CHECK(load->Path == "C:\\Some Folder\\cat.gif");
+
+    auto schedule = ParseIpcCommand("schedule 5000 30000", error);
+    CHECK(schedule.has_value() && schedule->Type == IpcCommandType::Schedule);
+    CHECK(schedule->MinDelayMs == 5000 && schedule->MaxDelayMs == 30000);
+    CHECK(ParseIpcCommand("schedule 0 0", error).has_value());
+}
+
+TEST(IpcRejectsBadCommands)
+{
+    CHECK(ParseError("") == "empty command");
+    CHECK(ParseError("   ") == "empty command");
+    CHECK(ParseError("dance") == "unknown command");
+    CHECK(ParseError("SHOW") == "unknown command");
+    CHECK(ParseError("show now") == "unexpected arguments");
+    CHECK(ParseError("load") == "missing path");
+    CHECK(ParseError("load   ") == "missing path");
+    CHECK(ParseError("schedule 10 5") == "min delay is greater than max delay");
+    CHECK(!ParseError("schedule 10").empty());
+    CHECK(!ParseError("schedule 10 20 30").empty());
+    CHECK(!ParseError("schedule -1 20").empty());
+    CHECK(!ParseError("schedule 10 99999999999").empty());
+}
+
+TEST(IpcResponsesAreOneLine)
+{
+    CHECK(FormatIpcResponse(true) == "ok\n");
+    CHECK(FormatIpcResponse(false, "no such file") == "error no such file\n");
+    CHECK(FormatIpcResponse(true, "a\r\nb") == "ok a  b\n");
+}
+
+TEST(IpcLineBufferSplitsLines)
+{
+    IpcLineBuffer buffer;
+    std::string line;
+    CHECK(buffer.Append("sh", 2));
+    CHECK(!buffer.TryPopLine(line));
+    CHECK(buffer.Append("ow\r\nstats\nlo", 12));
+    CHECK(buffer.TryPopLine(line) && line == "show");
+    CHECK(buffer.TryPopLine(line) && line == "stats");
+    CHECK(!buffer.TryPopLine(line));
+    CHECK(buffer.Append("ad x\n", 5));
+    CHECK(buffer.TryPopLine(line) && line == "load x");
+    CHECK(buffer.Append("\n", 1));
+    CHECK(buffer.TryPopLine(line) && line.empty());
+}
+
+TEST(IpcLineBufferLimitsLineLength)
+{
+    IpcLineBuffer buffer;
+    std::string chunk(IpcLineBuffer::MaxLineLength, 'x');
+    CHECK(buffer.Append(chunk.data(), chunk.size()));
+    CHECK(!buffer.Append("x", 1));
+
+    // A long run of short lines is fine
+    buffer.Clear();
+    std::string lines;
+    for (int i = 0; i < 1000; i++)
+    {
+        lines += "show\n";
+    }
+    CHECK(buffer.Append(lines.data(), lines.size()));
+    std::string line;
+    int count = 0;
+    while (buffer.TryPopLine(line))
+    {
+        count++;
+    }
+    CHECK(count == 1000);
+}
+
+TEST(IpcServerAnswersBatchesInOrder)
+{
+    std::vector<size_t> batches;
+    LoopbackServer server([&](std::vector<IpcCommand> const& commands)
+    {
+        batches.push_back(commands.size());
+        return Echo(commands);
+    });
+    CHECK(server.Send("show\n", 1) == "ok show\n");
+    // Parse errors are answered in place without reaching the handler
+    CHECK(server.Send("show\r\ndance\nload a b.gif\n", 3) == "ok show\nerror unknown command\nok load\n");
+    CHECK(server.Send("nope\n", 1) == "error unknown command\n");
+    // Lines can arrive in pieces
+    CHECK(server.Send("sta", 0).empty());
+    CHECK(server.Send("ts\nschedule 1 2\n", 2) == "ok stats\nok schedule\n");
+    CHECK((batches == std::vector<size_t>{ 1, 2, 2 }));
+}
+
+TEST(IpcServerAnswersMissingResponsesAsFailed)
+{
+    LoopbackServer server([](std::vector<IpcCommand> const& commands)
+    {
+        // Only answers the first command
+        return std::optional(std::vector<std::string>{ FormatIpcResponse(true, std::to_string(commands.size())) });
+    });
+    CHECK(server.Send("show\nshow\nx\nstats\n", 4) == "ok 3\nerror command failed\nerror unknown command\nerror command failed\n");
+}
+
+TEST(IpcServerDropsClients)
+{
+    {
+        // The handler can refuse, e.g. while shutting down
+        LoopbackServer server([](std::vector<IpcCommand> const&) { return std::optional<std::vector<std::string>>(); });
+        CHECK(server.Send("show\n", 1).empty());
+    }
+    {
+        LoopbackServer server(Echo);
+        std::string line(IpcLineBuffer::MaxLineLength + 1, 'x');
+        CHECK(server.Send(line, 2) == "error line too long\n");
+    }
+    {
+        // The client hanging up ends the loop
+        LoopbackServer server(Echo);
+        CHECK(server.Send("show\n", 1) == "ok show\n");
+        server.Disconnect();
+        CHECK(server.Receive(1).empty());
+    }
+}
+
+BENCHMARK(IpcTriggerLatency)
+{
+    // A show request's round trip through the protocol and a server thread,
+    // without the pipe and dispatcher hops the real server adds
+    LoopbackServer server(Echo);
+    auto microseconds = MeasureMicroseconds(20000, [&] { server.Send("show\n", 1); });
+    printf("show round trip: %.2f us\n", microseconds);
+    auto batched = MeasureMicroseconds(2000, [&] { server.Send("show\nstats\nschedule 10 20\nshow\nstats\nschedule 10 20\nshow\nstats\n", 8); });
+    printf("8 command batch: %.2f us (%.2f us per command)\n", batched, batched / 8.0);
+}
@@ -0,0 +1,59 @@
+#include "Test.h"
+#include "../VisitorGag/LifecycleSimulation.h"
+
+TEST(LifecycleSimulationIsRepeatable)
+{
+    LifecycleSimulationOptions options;
+    options.Visitors = 20;
+    options.Duration = std::chrono::hours(2);
+    options.Seed = 7;
+    options.Hibernate = true;
+    auto first = RunLifecycleSimulation(options);
+    auto second = RunLifecycleSimulation(options);
+    CHECK(first.Events > 0 && first.Events == second.Events);
+    CHECK(first.Totals.Shows > 0 && first.Totals.Shows == second.Totals.Shows);
+    CHECK(first.Totals.Hibernations == second.Totals.Hibernations);
+    CHECK(first.PeakBytes == second.PeakBytes && first.AverageBytes == second.AverageBytes);
+}
+
+TEST(LifecycleSimulationNeverHibernatesWhileVisible)
+{
+    // Reveals come due constantly, so plenty of them land while a visitor
+    // is still going to sleep
+    LifecycleSimulationOptions options;
+    options.Visitors = 50;
+    options.Duration = std::chrono::hours(4);
+    options.Hibernate = true;
+    options.MinDelayMs = 0;
+    options.MaxDelayMs = 100;
+    options.MinClickDelay = std::chrono::milliseconds(0);
+    options.MaxClickDelay = std::chrono::milliseconds(50);
+    auto result = RunLifecycleSimulation(options);
+    CHECK(result.Totals.Hibernations > 0);
+    CHECK(result.WakesWhileHibernating > 0);
+    CHECK(result.HibernatedWhileVisible == 0);
+}
+
+TEST(LifecycleSimulationHibernatingSavesMemory)
+{
+    LifecycleSimulationOptions options;
+    options.Visitors = 20;
+    options.Duration = std::chrono::hours(4);
+    auto awake = RunLifecycleSimulation(options);
+    options.Hibernate = true;
+    auto hibernating = RunLifecycleSimulation(options);
+    CHECK(awake.Totals.Hibernations == 0);
+    CHECK(hibernating.AverageBytes < awake.AverageBytes);
+    CHECK(hibernating.PeakBytes <= awake.PeakBytes);
+}
+
+BENCHMARK(LifecycleSimulationDay)
+{
+    LifecycleSimulationOptions options;
+    options.Visitors = 100;
+    options.Hibernate = true;
+    auto result = RunLifecycleSimulation(options);
+    printf("%u visitors for a day: %llu events in %.1f ms, %llu shows, max show latency %.1f ms\n",
+        options.Visitors, static_cast<unsigned long long>(result.Events), result.Elapsed.count() / 1000.0,
+        static_cast<unsigned long long>(result.Totals.Shows), result.Totals.MaxShowLatency.count() / 1000.0);
+}
@@ -0,0 +1,101 @@
+#include "Test.h"
+#include "../VisitorGag/MemoryAccounting.h"
+#include <algorithm>
+#include <cstdint>
+#include <cstdio>
+#include <new>
+#include <thread>
+#include <vector>
+
+TEST(MemoryHooksRejectSizesThatWrapAround)
+{
+    // Volatile so that the compiler doesn't see the size coming
+    volatile size_t size = SIZE_MAX - 4;
+    CHECK_THROWS(operator delete(operator new(size)), std::bad_alloc);
+    CHECK(operator new(size, std::nothrow) == nullptr);
+}
+
+TEST(MemoryCountersSurviveThreadExit)
+{
+    // Textures so that nothing but this test touches the counters
+    auto before = ReadMemoryReport().Tags[static_cast<size_t>(MemoryTag::Capture)].Textures;
+    // Fewer operations and bytes than either flush threshold
+    std::thread([]
+    {
+        RecordAllocation(MemoryTag::Capture, MemoryKind::Texture, 4096);
+        RecordAllocation(MemoryTag::Capture, MemoryKind::Texture, 1024);
+        RecordFree(MemoryTag::Capture, MemoryKind::Texture, 1024);
+    }).join();
+    auto after = ReadMemoryReport().Tags[static_cast<size_t>(MemoryTag::Capture)].Textures;
+    CHECK(after.Allocations == before.Allocations + 2);
+    CHECK(after.Frees == before.Frees + 1);
+    CHECK(after.LiveBytes == before.LiveBytes + 4096);
+    CHECK(after.PeakBytes >= before.LiveBytes + 4096);
+
+    std::thread([]
+    {
+        RecordFree(MemoryTag::Capture, MemoryKind::Texture, 4096);
+    }).join();
+    CHECK(ReadMemoryReport().Tags[static_cast<size_t>(MemoryTag::Capture)].Textures.LiveBytes == before.LiveBytes);
+}
+
+TEST(MemoryTagScopeChargesHeapAllocations)
+{
+    auto before = ReadMemoryReport().Tags[static_cast<size_t>(MemoryTag::Decoder)].Heap;
+    std::vector<uint8_t>* buffer = nullptr;
+    {
+        MemoryTagScope scope(MemoryTag::Decoder);
+        CHECK(CurrentMemoryTag() == MemoryTag::Decoder);
+        buffer = new std::vector<uint8_t>(100000);
+    }
+    CHECK(CurrentMemoryTag() == MemoryTag::App);
+    auto allocated = ReadMemoryReport().Tags[static_cast<size_t>(MemoryTag::Decoder)].Heap;
+    CHECK(allocated.Allocations == before.Allocations + 2);
+    CHECK(allocated.LiveBytes == before.LiveBytes + 100000 + sizeof(std::vector<uint8_t>));
+    CHECK(allocated.PeakBytes >= allocated.LiveBytes);
+
+    // Charged back to the decoder even though the app tag frees it
+    delete buffer;
+    auto freed = ReadMemoryReport().Tags[static_cast<size_t>(MemoryTag::Decoder)].Heap;
+    CHECK(freed.Frees == before.Frees + 2);
+    CHECK(freed.LiveBytes == before.LiveBytes);
+    CHECK(freed.PeakBytes == allocated.PeakBytes);
+}
+
+TEST(MemoryPeaksFollowTheLargestLiveTotal)
+{
+    auto before = ReadMemoryReport().Tags[static_cast<size_t>(MemoryTag::Player)].Textures;
+    // Large enough that each one is folded in right away
+    RecordAllocation(MemoryTag::Player, MemoryKind::Texture, 1 << 20);
+    RecordAllocation(MemoryTag::Player, MemoryKind::Texture, 1 << 20);
+    RecordFree(MemoryTag::Player, MemoryKind::Texture, 1 << 20);
+    RecordAllocation(MemoryTag::Player, MemoryKind::Texture, 1 << 19);
+    auto after = ReadMemoryReport().Tags[static_cast<size_t>(MemoryTag::Player)].Textures;
+    CHECK(after.LiveBytes == before.LiveBytes + (1 << 20) + (1 << 19));
+    CHECK(after.PeakBytes == std::max<uint64_t>(before.PeakBytes, before.LiveBytes + (2 << 20)));
+    RecordFree(MemoryTag::Player, MemoryKind::Texture, 1 << 20);
+    RecordFree(MemoryTag::Player, MemoryKind::Texture, 1 << 19);
+}
+
+TEST(MemoryReportFormatting)
+{
+    MemoryReport report = {};
+    report.Tags[static_cast<size_t>(MemoryTag::Decoder)].Heap = { 3 << 20, 4 << 20, 12, 2 };
+    report.Tags[static_cast<size_t>(MemoryTag::Player)].Textures = { 1 << 20, 2 << 20, 5, 0 };
+    auto text = FormatMemoryReport(report);
+    CHECK(text.find("app heap 0.0 MB") == 0);
+    CHECK(text.find("decoder heap 3.0 MB (peak 4.0 MB, 12 allocs)") != std::string::npos);
+    CHECK(text.find("player heap 0.0 MB (peak 0.0 MB, 0 allocs) textures 1.0 MB (peak 2.0 MB, 5 allocs)") != std::string::npos);
+    // Only tags that ever had a texture mention them
+    CHECK(text.find("textures") == text.rfind("textures"));
+}
+
+BENCHMARK(MemoryAccountingRecord)
+{
+    auto elapsed = MeasureMicroseconds(10000000, []
+    {
+        RecordAllocation(MemoryTag::App, MemoryKind::Texture, 64);
+        RecordFree(MemoryTag::App, MemoryKind::Texture, 64);
+    });
+    printf("MemoryAccountingRecord: %.2f ns per allocation and free\n", elapsed * 1000.0);
+}
@@ -0,0 +1,64 @@
+#include "Test.h"
+#include "../VisitorGag/MpscQueue.h"
+#include <memory>
+#include <thread>
+
+TEST(MpscQueueIsFifo)
+{
+    MpscQueue<std::unique_ptr<int>> queue;
+    CHECK(!queue.TryPop().has_value());
+    for (int i = 0; i < 10; i++)
+    {
+        queue.Push(std::make_unique<int>(i));
+    }
+    for (int i = 0; i < 10; i++)
+    {
+        auto value = queue.TryPop();
+        CHECK(value.has_value() && **value == i);
+    }
+    CHECK(!queue.TryPop().has_value());
+    // Whatever's left is freed with the queue
+    queue.Push(std::make_unique<int>(10));
+}
+
+TEST(MpscQueueKeepsEachProducersOrder)
+{
+    constexpr uint32_t Producers = 4;
+    constexpr uint32_t Items = 100000;
+    MpscQueue<uint64_t> queue;
+    std::vector<std::thread> threads;
+    for (uint64_t producer = 0; producer < Producers; producer++)
+    {
+        threads.emplace_back([&queue, producer]
+        {
+            for (uint64_t i = 0; i < Items; i++)
+            {
+                queue.Push((producer << 32) | i);
+            }
+        });
+    }
+
+    std::vector<uint64_t> next(Producers, 0);
+    uint64_t received = 0;
+    bool ordered = true;
+    while (received < Producers * Items)
+    {
+        if (auto value = queue.TryPop())
+        {
+            auto producer = value.value() >> 32;
+            ordered = ordered && (value.value() & 0xFFFFFFFF) == next[producer];
+            next[producer]++;
+            received++;
+        }
+        else
+        {
+            std::this_thread::yield();
+        }
+    }
+    for (auto&& thread : threads)
+    {
+        thread.join();
+    }
+    CHECK(ordered);
+    CHECK(!queue.TryPop().has_value());
+}
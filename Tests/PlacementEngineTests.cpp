@@ -0,0 +1,131 @@
+#include "Test.h"
+#include "../VisitorGag/PlacementEngine.h"
+#include <algorithm>
+#include <random>
+#include <set>
+#include <utility>
+
+namespace
+{
+    std::vector<uint8_t> MakeNoise(uint32_t height, uint32_t rowPitch, std::mt19937& random)
+    {
+        std::vector<uint8_t> pixels(static_cast<size_t>(rowPitch) * height);
+        for (auto&& byte : pixels)
+        {
+            byte = static_cast<uint8_t>(random());
+        }
+        return pixels;
+    }
+
+    void FillRect(std::vector<uint8_t>& pixels, uint32_t rowPitch, uint32_t x, uint32_t y, uint32_t width, uint32_t height, uint8_t gray)
+    {
+        for (uint32_t row = y; row < y + height; row++)
+        {
+            for (uint32_t column = x; column < x + width; column++)
+            {
+                auto pixel = pixels.data() + static_cast<size_t>(row) * rowPitch + static_cast<size_t>(column) * 4;
+                pixel[0] = gray;
+                pixel[1] = gray;
+                pixel[2] = gray;
+                pixel[3] = 255;
+            }
+        }
+    }
+}
+
+TEST(PlacementFindsTheOnlyQuietRegion)
+{
+    std::mt19937 random(1);
+    // Including cells that don't split into whole groups of pixels
+    for (uint32_t cellSize : { 4u, 8u, 12u, 13u })
+    {
+        auto pixels = MakeNoise(256, 256 * 4, random);
+        FillRect(pixels, 256 * 4, cellSize * 13, cellSize * 8, cellSize * 6, cellSize * 5, 40);
+        PlacementEngine engine(cellSize);
+        engine.Analyze(pixels.data(), 256, 256, 256 * 4);
+        for (int i = 0; i < 10; i++)
+        {
+            auto position = engine.FindQuietRegion(cellSize * 6, cellSize * 5, random);
+            CHECK(position.has_value());
+            CHECK(position->X == static_cast<int32_t>(cellSize * 13) && position->Y == static_cast<int32_t>(cellSize * 8));
+        }
+    }
+}
+
+TEST(PlacementBreaksTiesRandomlyWithinBounds)
+{
+    // Neither the image nor the region is a whole number of cells
+    std::vector<uint8_t> pixels(static_cast<size_t>(100) * 70 * 4, 128);
+    PlacementEngine engine;
+    engine.Analyze(pixels.data(), 100, 70, 100 * 4);
+    std::mt19937 random(2);
+    std::set<std::pair<int32_t, int32_t>> positions;
+    for (int i = 0; i < 200; i++)
+    {
+        auto position = engine.FindQuietRegion(37, 21, random);
+        CHECK(position.has_value());
+        CHECK(position->X >= 0 && position->X <= 100 - 37);
+        CHECK(position->Y >= 0 && position->Y <= 70 - 21);
+        CHECK(position->X % 8 == 0 || position->X == 100 - 37);
+        positions.insert({ position->X, position->Y });
+    }
+    CHECK(positions.size() > 10);
+}
+
+TEST(PlacementRejectsRegionsThatDontFit)
+{
+    std::vector<uint8_t> pixels(static_cast<size_t>(64) * 48 * 4, 0);
+    PlacementEngine engine;
+    engine.Analyze(pixels.data(), 64, 48, 64 * 4);
+    std::mt19937 random(3);
+    CHECK(!engine.FindQuietRegion(65, 10, random).has_value());
+    CHECK(!engine.FindQuietRegion(10, 49, random).has_value());
+    CHECK(!engine.FindQuietRegion(0, 10, random).has_value());
+    CHECK(engine.FindQuietRegion(64, 48, random).has_value());
+
+    // Smaller than a single cell
+    PlacementEngine coarse(16);
+    coarse.Analyze(pixels.data(), 12, 12, 64 * 4);
+    auto position = coarse.FindQuietRegion(5, 5, random);
+    CHECK(position.has_value() && position->X == 0 && position->Y == 0);
+}
+
+TEST(PlacementIgnoresRowPadding)
+{
+    std::mt19937 random(4);
+    auto tight = MakeNoise(120, 200 * 4, random);
+    FillRect(tight, 200 * 4, 24, 40, 48, 32, 200);
+    // Same pixels with noise past the end of every row
+    auto padded = MakeNoise(120, 256 * 4, random);
+    for (uint32_t row = 0; row < 120; row++)
+    {
+        std::copy_n(tight.data() + static_cast<size_t>(row) * 200 * 4, 200 * 4, padded.data() + static_cast<size_t>(row) * 256 * 4);
+    }
+    PlacementEngine tightEngine;
+    PlacementEngine paddedEngine;
+    tightEngine.Analyze(tight.data(), 200, 120, 200 * 4);
+    paddedEngine.Analyze(padded.data(), 200, 120, 256 * 4);
+    std::mt19937 tightRandom(5);
+    std::mt19937 paddedRandom(5);
+    for (int i = 0; i < 20; i++)
+    {
+        auto expected = tightEngine.FindQuietRegion(48, 32, tightRandom);
+        auto actual = paddedEngine.FindQuietRegion(48, 32, paddedRandom);
+        CHECK(expected.has_value() && actual.has_value());
+        CHECK(expected->X == 24 && expected->Y == 40);
+        CHECK(actual->X == expected->X && actual->Y == expected->Y);
+    }
+}
+
+BENCHMARK(PlacementAnalyze)
+{
+    std::mt19937 random(6);
+    for (auto [width, height] : { std::pair{ 1920u, 1080u }, std::pair{ 3840u, 2160u } })
+    {
+        auto pixels = MakeNoise(height, width * 4, random);
+        PlacementEngine engine;
+        auto analyze = MeasureMicroseconds(20, [&] { engine.Analyze(pixels.data(), width, height, width * 4); });
+        auto find = MeasureMicroseconds(20, [&] { engine.FindQuietRegion(400, 300, random); });
+        printf("%4ux%-4u analyze %8.1f us (%.2f ns per pixel), find %7.1f us\n", width, height, analyze, analyze * 1000.0 / (static_cast<double>(width) * height), find);
+    }
+}
@@ -0,0 +1,172 @@
+#include "Test.h"
+#include "../VisitorGag/PlaybackClock.h"
+#include <algorithm>
+#include <map>
+#include <random>
+
+namespace
+{
+    using clock = PlaybackClock::clock;
+
+    clock::time_point At(int64_t ms)
+    {
+        return clock::time_point{} + std::chrono::milliseconds(ms);
+    }
+}
+
+TEST(PlaybackClockBatchesDeadlinesWithinTheWindow)
+{
+    PlaybackClock playbackClock(std::chrono::milliseconds(4), At(0));
+    auto first = playbackClock.Register();
+    auto second = playbackClock.Register();
+    auto third = playbackClock.Register();
+    playbackClock.Schedule(first, At(10));
+    playbackClock.Schedule(second, At(13));
+    playbackClock.Schedule(third, At(20));
+    CHECK(playbackClock.NextWake() == At(10));
+
+    std::vector<PlaybackClock::ClientId> due;
+    playbackClock.CollectDue(At(10), due);
+    CHECK((due == std::vector<PlaybackClock::ClientId>{ first, second }));
+    CHECK(!playbackClock.IsScheduled(first) && playbackClock.IsScheduled(third));
+    CHECK(playbackClock.NextWake() == At(20));
+
+    // Rescheduling replaces the pending deadline
+    playbackClock.Schedule(third, At(30));
+    CHECK(playbackClock.PendingCount() == 1);
+    playbackClock.Cancel(third);
+    CHECK(!playbackClock.NextWake().has_value());
+
+    auto stats = playbackClock.Stats(At(1000));
+    CHECK(stats.Clients == 3 && stats.Wakeups == 1 && stats.Ticks == 2 && stats.MaxFanOut == 2);
+}
+
+TEST(PlaybackClockReusesIds)
+{
+    PlaybackClock playbackClock(std::chrono::milliseconds(4), At(0));
+    auto first = playbackClock.Register();
+    playbackClock.Schedule(first, At(10));
+    playbackClock.Unregister(first);
+    CHECK(!playbackClock.IsScheduled(first));
+    CHECK(playbackClock.PendingCount() == 0);
+    CHECK_THROWS(playbackClock.Unregister(first), std::invalid_argument);
+    CHECK_THROWS(playbackClock.Schedule(first, At(10)), std::invalid_argument);
+    CHECK(playbackClock.Register() == first);
+}
+
+TEST(PlaybackClockMatchesAReference)
+{
+    // Random operations checked against a plain map of deadlines
+    std::mt19937 random(1);
+    PlaybackClock playbackClock(std::chrono::milliseconds(4), At(0));
+    std::map<PlaybackClock::ClientId, clock::time_point> reference;
+    std::vector<PlaybackClock::ClientId> clients;
+    for (int i = 0; i < 20000; i++)
+    {
+        auto operation = random() % 10;
+        if (operation == 0 || clients.empty())
+        {
+            clients.push_back(playbackClock.Register());
+        }
+        else if (operation == 1)
+        {
+            auto index = random() % clients.size();
+            playbackClock.Unregister(clients[index]);
+            reference.erase(clients[index]);
+            clients.erase(clients.begin() + index);
+        }
+        else if (operation < 6)
+        {
+            auto client = clients[random() % clients.size()];
+            auto deadline = At(0) + std::chrono::microseconds(random() % 1000000);
+            playbackClock.Schedule(client, deadline);
+            reference[client] = deadline;
+        }
+        else if (operation == 6)
+        {
+            auto client = clients[random() % clients.size()];
+            playbackClock.Cancel(client);
+            reference.erase(client);
+        }
+        else
+        {
+            auto now = At(0) + std::chrono::microseconds(random() % 1000000);
+            std::vector<PlaybackClock::ClientId> due;
+            playbackClock.CollectDue(now, due);
+            for (size_t j = 1; j < due.size(); j++)
+            {
+                CHECK(reference[due[j - 1]] <= reference[due[j]]);
+            }
+            std::vector<PlaybackClock::ClientId> expected;
+            for (auto it = reference.begin(); it != reference.end();)
+            {
+                if (it->second <= now + std::chrono::milliseconds(4))
+                {
+                    expected.push_back(it->first);
+                    it = reference.erase(it);
+                }
+                else
+                {
+                    ++it;
+                }
+            }
+            std::sort(due.begin(), due.end());
+            CHECK(due == expected);
+        }
+        CHECK(playbackClock.PendingCount() == reference.size());
+        if (!reference.empty())
+        {
+            auto earliest = std::min_element(reference.begin(), reference.end(), [](auto&& a, auto&& b) { return a.second < b.second; });
+            CHECK(playbackClock.NextWake() == earliest->second);
+        }
+    }
+}
+
+BENCHMARK(PlaybackClockWakeups)
+{
+    // Ten seconds of players at common gif frame delays, with and without
+    // batching
+    uint32_t const delays[] = { 20, 30, 40, 50, 70, 100 };
+    for (uint32_t players : { 10u, 1000u, 20000u })
+    {
+        for (uint32_t windowMs : { 0u, 4u })
+        {
+            std::mt19937 random(2);
+            PlaybackClock playbackClock(std::chrono::milliseconds(windowMs), At(0));
+            std::vector<uint32_t> delay(players);
+            std::vector<clock::time_point> deadlines(players);
+            for (uint32_t i = 0; i < players; i++)
+            {
+                auto client = playbackClock.Register();
+                delay[client] = delays[random() % 6];
+                deadlines[client] = At(0) + std::chrono::microseconds(random() % 100000);
+                playbackClock.Schedule(client, deadlines[client]);
+            }
+
+            auto end = At(10000);
+            std::vector<PlaybackClock::ClientId> due;
+            uint64_t ticks = 0;
+            auto start = std::chrono::steady_clock::now();
+            while (auto wake = playbackClock.NextWake())
+            {
+                if (wake.value() > end)
+                {
+                    break;
+                }
+                due.clear();
+                playbackClock.CollectDue(wake.value(), due);
+                // Like the player, early wakeups time the next frame from the deadline
+                for (auto client : due)
+                {
+                    deadlines[client] = std::max(wake.value(), deadlines[client]) + std::chrono::milliseconds(delay[client]);
+                    playbackClock.Schedule(client, deadlines[client]);
+                }
+                ticks += due.size();
+            }
+            auto elapsed = std::chrono::duration<double, std::micro>(std::chrono::steady_clock::now() - start).count();
+            auto stats = playbackClock.Stats(end);
+            printf("%6u players, %u ms window: %8.1f wakeups/s, fan-out %7.1f (max %zu), %.3f us per tick\n",
+                players, windowMs, stats.WakeupsPerSecond(), stats.AverageFanOut(), stats.MaxFanOut, elapsed / static_cast<double>(ticks));
+        }
+    }
+}
@@ -0,0 +1,175 @@
+#include "Test.h"
+#include "../VisitorGag/CheckpointPlan.h"
+#include "../VisitorGag/FrameDeduplicator.h"
+#include "../VisitorGag/FrameStream.h"
+#include "../VisitorGag/PlaybackCursor.h"
+
+namespace
+{
+    // The frames shown from First until the cursor wraps, and the frame it
+    // wraps to
+    std::vector<size_t> Cycle(PlaybackCursor& cursor, size_t& wrappedTo)
+    {
+        std::vector<size_t> frames = { cursor.First() };
+        bool wrapped = false;
+        while (true)
+        {
+            auto next = cursor.Next(frames.back(), wrapped);
+            if (wrapped)
+            {
+                wrappedTo = next;
+                return frames;
+            }
+            frames.push_back(next);
+        }
+    }
+}
+
+TEST(PlaybackCursorWalksEachMode)
+{
+    PlaybackCursor cursor;
+    size_t wrappedTo = 99;
+    cursor.Reset(PlaybackMode::Forward, 4);
+    CHECK((Cycle(cursor, wrappedTo) == std::vector<size_t>{ 0, 1, 2, 3 }));
+    CHECK(wrappedTo == 0);
+
+    cursor.Reset(PlaybackMode::Reverse, 4);
+    CHECK((Cycle(cursor, wrappedTo) == std::vector<size_t>{ 3, 2, 1, 0 }));
+    CHECK(wrappedTo == 3);
+
+    // Neither end is shown twice in a row
+    cursor.Reset(PlaybackMode::PingPong, 4);
+    CHECK((Cycle(cursor, wrappedTo) == std::vector<size_t>{ 0, 1, 2, 3, 2, 1 }));
+    CHECK(wrappedTo == 0);
+    // And the next cycle goes the same way
+    CHECK((Cycle(cursor, wrappedTo) == std::vector<size_t>{ 0, 1, 2, 3, 2, 1 }));
+
+    cursor.Reset(PlaybackMode::PingPong, 2);
+    CHECK((Cycle(cursor, wrappedTo) == std::vector<size_t>{ 0, 1 }));
+    CHECK(wrappedTo == 0);
+}
+
+TEST(PlaybackCursorHandlesSingleFrames)
+{
+    PlaybackCursor cursor;
+    bool wrapped = false;
+    for (auto mode : { PlaybackMode::Forward, PlaybackMode::Reverse, PlaybackMode::PingPong })
+    {
+        cursor.Reset(mode, 1);
+        CHECK(cursor.First() == 0);
+        CHECK(cursor.Next(0, wrapped) == 0 && wrapped);
+        cursor.Reset(mode, 0);
+        CHECK(cursor.First() == 0);
+        CHECK(cursor.Next(0, wrapped) == 0 && wrapped);
+    }
+
+    // Resetting mid-way through ping-pong starts forwards again
+    cursor.Reset(PlaybackMode::PingPong, 3);
+    CHECK(cursor.Next(2, wrapped) == 1 && !wrapped);
+    cursor.Reset(PlaybackMode::PingPong, 3);
+    CHECK(cursor.Next(1, wrapped) == 2 && !wrapped);
+    CHECK(cursor.Mode() == PlaybackMode::PingPong);
+}
+
+TEST(ForwardPlaybackMergesHoldsWithinACycle)
+{
+    // One pixel per frame, runs of the same color are holds
+    std::vector<uint32_t> const pixels = { 1, 1, 2, 2, 2, 3, 1, 1 };
+    std::vector<uint32_t> const delays = { 10, 20, 30, 40, 50, 60, 70, 80 };
+    FrameDeduplicator dedup;
+    dedup.Reset(pixels.size());
+    FrameStream stream;
+    stream.Begin(FrameStream::clock::time_point{}, pixels.size());
+    for (size_t i = 0; i < pixels.size(); i++)
+    {
+        dedup.Add(i, { 0, 0, 1, 1 }, reinterpret_cast<uint8_t const*>(&pixels[i]), 4, [&](size_t candidate)
+        {
+            return reinterpret_cast<uint8_t const*>(&pixels[candidate]);
+        });
+        stream.Publish(FrameStream::clock::time_point{});
+    }
+    CHECK(!dedup.IsHold(0));
+    CHECK(dedup.IsHold(1) && dedup.IsHold(3) && dedup.IsHold(4) && dedup.IsHold(7));
+    CHECK(!dedup.IsHold(6));
+
+    // The same walk AdvanceFrame does: show the next frame, then fold the
+    // holds after it into its delay without crossing into the next cycle
+    PlaybackCursor cursor;
+    cursor.Reset(PlaybackMode::Forward, pixels.size());
+    // Where the cursor ends up after each step, the last frame of each run
+    std::vector<size_t> shown;
+    std::vector<uint32_t> shownFor;
+    size_t current = cursor.First();
+    for (int step = 0; step < 8; step++)
+    {
+        auto delay = delays[current];
+        size_t hold = 0;
+        while (stream.TryGetNext(current, hold) && hold != 0 && dedup.IsHold(hold))
+        {
+            delay += delays[hold];
+            current = hold;
+        }
+        shown.push_back(current);
+        shownFor.push_back(delay);
+        bool wrapped = false;
+        current = cursor.Next(current, wrapped);
+    }
+    // Frame 0 matches frame 7 but still starts each cycle
+    CHECK((shown == std::vector<size_t>{ 1, 4, 5, 7, 1, 4, 5, 7 }));
+    CHECK((shownFor == std::vector<uint32_t>{ 30, 120, 60, 150, 30, 120, 60, 150 }));
+}
+
+TEST(CheckpointPlanUsesThePreferredSpacing)
+{
+    auto plan = CheckpointPlan::Compute(100, 1000, 0);
+    CHECK(plan.Spacing == 8 && plan.Count == 12);
+    CHECK(!plan.IsCheckpoint(0));
+    CHECK(!plan.IsCheckpoint(7));
+    CHECK(plan.IsCheckpoint(8) && plan.Slot(8) == 0);
+    CHECK(plan.IsCheckpoint(96) && plan.Slot(96) == 11);
+    CHECK(!plan.IsCheckpoint(104));
+    CHECK(plan.FrameForSlot(11) == 96);
+    CHECK(plan.SlotAtOrBefore(7) == plan.Count);
+    CHECK(plan.SlotAtOrBefore(8) == 0);
+    CHECK(plan.SlotAtOrBefore(15) == 0);
+    CHECK(plan.SlotAtOrBefore(99) == 11);
+    CHECK(plan.MaxReplay(100) == 8);
+
+    plan = CheckpointPlan::Compute(100, 1000, 0, 0);
+    CHECK(plan.Spacing == 1 && plan.Count == 99);
+}
+
+TEST(CheckpointPlanFitsTheBudget)
+{
+    for (size_t frameCount = 0; frameCount < 150; frameCount++)
+    {
+        for (uint64_t budget : { 1, 9, 10, 45, 100, 333, 5000 })
+        {
+            auto plan = CheckpointPlan::Compute(frameCount, 10, budget);
+            CHECK(plan.Count * 10 <= budget);
+            if (plan.Spacing == 0)
+            {
+                CHECK(plan.Count == 0);
+                CHECK(plan.MaxReplay(frameCount) == frameCount);
+                continue;
+            }
+            // Every frame is at most Spacing - 1 frames past a checkpoint
+            // or the start
+            for (size_t frame = 0; frame < frameCount; frame++)
+            {
+                auto slot = plan.SlotAtOrBefore(frame);
+                auto from = slot == plan.Count ? 0 : plan.FrameForSlot(slot);
+                CHECK(from <= frame);
+                CHECK(frame - from < plan.MaxReplay(frameCount));
+                CHECK(plan.IsCheckpoint(frame) == (slot != plan.Count && from == frame));
+            }
+        }
+    }
+
+    // Not even one snapshot fits, or there's nothing to seek to
+    CHECK(CheckpointPlan::Compute(100, 10, 9).Spacing == 0);
+    CHECK(CheckpointPlan::Compute(1, 10, 0).Spacing == 0);
+    CHECK(CheckpointPlan::Compute(100, 0, 0).Spacing == 0);
+    auto plan = CheckpointPlan::Compute(100, 10, 45);
+    CHECK(plan.Spacing == 25 && plan.Count == 3);
+}
@@ -0,0 +1,73 @@
+#include "Test.h"
+#include "../VisitorGag/PlaybackSuspension.h"
+
+namespace
+{
+    using clock = PlaybackSuspension::clock;
+
+    clock::time_point At(int64_t ms)
+    {
+        return clock::time_point{} + std::chrono::milliseconds(ms);
+    }
+}
+
+TEST(SuspensionAdvancesFramesWithinTheTolerance)
+{
+    PlaybackSuspension suspension(std::chrono::milliseconds(100), std::chrono::milliseconds(8));
+    suspension.ArmFrame(At(50));
+    CHECK(suspension.NextWake() == At(50));
+    CHECK(!suspension.Poll(At(30)).AdvanceFrame);
+
+    auto early = suspension.Poll(At(45));
+    CHECK(early.AdvanceFrame);
+    CHECK(early.Early == std::chrono::milliseconds(5));
+    CHECK(early.Lag.count() == 0);
+    CHECK(!suspension.NextWake().has_value());
+
+    suspension.ArmFrame(At(100));
+    auto late = suspension.Poll(At(130));
+    CHECK(late.AdvanceFrame);
+    CHECK(late.Lag == std::chrono::milliseconds(30));
+}
+
+TEST(SuspensionDebouncesSignals)
+{
+    PlaybackSuspension suspension(std::chrono::milliseconds(100), std::chrono::milliseconds(8));
+    suspension.ArmFrame(At(10));
+    suspension.Signal(SuspendReason::Occluded, true, At(0));
+    CHECK(suspension.NextWake() == At(10));
+    // Flipping back before it settles costs nothing
+    suspension.Signal(SuspendReason::Occluded, false, At(50));
+    CHECK(suspension.Stats().DebouncedSignals == 1);
+    CHECK(!suspension.IsSuspended());
+
+    // A burst of signals settles together
+    suspension.Signal(SuspendReason::SessionLocked, true, At(60));
+    suspension.Signal(SuspendReason::DisplayOff, true, At(70));
+    CHECK(suspension.NextWake() == At(10));
+    CHECK(suspension.Poll(At(10)).AdvanceFrame);
+    CHECK(suspension.NextWake() == At(170));
+
+    suspension.ArmFrame(At(200));
+    CHECK(!suspension.Poll(At(160)).Suspend);
+    auto actions = suspension.Poll(At(170));
+    CHECK(actions.Suspend);
+    CHECK(!actions.AdvanceFrame);
+    CHECK(suspension.IsSuspended());
+    // Frames don't wake us while suspended
+    CHECK(!suspension.NextWake().has_value());
+
+    // Still suspended as long as any reason is active
+    suspension.Signal(SuspendReason::SessionLocked, false, At(1000));
+    CHECK(!suspension.NextWake().has_value());
+    suspension.Signal(SuspendReason::DisplayOff, false, At(1000));
+    CHECK(suspension.NextWake() == At(1100));
+    auto resumed = suspension.Poll(At(1100));
+    CHECK(resumed.Resume);
+    // Handled along with the resume, since it's long overdue
+    CHECK(resumed.AdvanceFrame);
+    CHECK(resumed.Lag == std::chrono::milliseconds(900));
+    CHECK(suspension.Stats().Suspensions == 1);
+    CHECK(suspension.Stats().SuspendedTime == std::chrono::milliseconds(930));
+    CHECK(suspension.Stats().CoalescedWakes == 1);
+}
@@ -0,0 +1,287 @@
+#include "Test.h"
+#include "../VisitorGag/SharedFrameLayout.h"
+#include <set>
+
+#ifndef _WIN32
+#include <cerrno>
+#include <signal.h>
+#include <sys/mman.h>
+#include <sys/wait.h>
+#include <unistd.h>
+#endif
+
+namespace
+{
+    struct Segment
+    {
+        std::vector<uint8_t> Content;
+        SharedFrameLayout Layout;
+        uint64_t Hash = 0;
+
+        Segment(size_t contentSize)
+        {
+            for (size_t i = 0; i < contentSize; i++)
+            {
+                Content.push_back(static_cast<uint8_t>(i * 7 + 3));
+            }
+            Layout = ComputeSharedFrameLayout({ { 0, 0, 10, 10 }, { 3, 4, 5, 6 }, { 0, 0, 0, 0 } }, Content.size());
+            Hash = HashSharedFrameContent(Content.data(), Content.size());
+        }
+
+        void Initialize(void* memory, uint32_t writer) const
+        {
+            InitializeSharedFrames(memory, Layout, 10, 10, Content.data(), Content.size(), Hash, writer);
+        }
+
+        SharedFrameHeader* Validate(void* memory, size_t mappedBytes) const
+        {
+            return const_cast<SharedFrameHeader*>(ValidateSharedFrames(memory, mappedBytes, Content.data(), Content.size(), Hash));
+        }
+
+        // Frame pixels a given writer fills in
+        static uint8_t Pixel(uint32_t writer, size_t frame, size_t byte)
+        {
+            return static_cast<uint8_t>(writer * 31 + frame * 17 + byte);
+        }
+
+        void WriteFrames(void* memory, uint32_t writer) const
+        {
+            auto entries = SharedFrameEntries(memory);
+            for (size_t i = 0; i < Layout.Entries.size(); i++)
+            {
+                auto bytes = static_cast<uint8_t*>(memory) + entries[i].Offset;
+                for (size_t b = 0; b < static_cast<size_t>(entries[i].RowPitch) * entries[i].Rect.Height; b++)
+                {
+                    bytes[b] = Pixel(writer, i, b);
+                }
+            }
+        }
+
+        bool HasFrames(void const* memory, uint32_t writer) const
+        {
+            auto entries = SharedFrameEntries(memory);
+            for (size_t i = 0; i < Layout.Entries.size(); i++)
+            {
+                auto bytes = static_cast<uint8_t const*>(memory) + entries[i].Offset;
+                for (size_t b = 0; b < static_cast<size_t>(entries[i].RowPitch) * entries[i].Rect.Height; b++)
+                {
+                    if (bytes[b] != Pixel(writer, i, b))
+                    {
+                        return false;
+                    }
+                }
+            }
+            return true;
+        }
+    };
+
+    // Process ids in these tests are made up, a set says which are running
+    SharedFrameProcessCheck AliveIn(std::set<uint32_t> const& alive)
+    {
+        return [&alive](uint32_t processId) { return alive.count(processId) != 0; };
+    }
+}
+
+TEST(SharedFrameLayoutPlacesContentBeforeFrames)
+{
+    Segment segment(1000);
+    auto&& layout = segment.Layout;
+    CHECK(layout.ContentOffset == sizeof(SharedFrameHeader) + 3 * sizeof(SharedFrameEntry));
+    CHECK(layout.Entries[0].Offset >= layout.ContentOffset + 1000);
+    for (auto&& entry : layout.Entries)
+    {
+        CHECK(entry.Offset % 64 == 0);
+        CHECK(entry.RowPitch == static_cast<uint32_t>(entry.Rect.Width) * 4);
+    }
+    CHECK(layout.Entries[1].Offset >= layout.Entries[0].Offset + 10 * 10 * 4);
+    CHECK(layout.TotalBytes >= layout.Entries[1].Offset + 5 * 6 * 4);
+    CHECK(layout.TotalBytes % 64 == 0);
+}
+
+TEST(SharedFramesConfirmTheContent)
+{
+    Segment segment(333);
+    std::vector<uint8_t> memory(segment.Layout.TotalBytes);
+    segment.Initialize(memory.data(), 5);
+    auto header = segment.Validate(memory.data(), memory.size());
+    CHECK(header != nullptr);
+    CHECK(header->State.load() == static_cast<uint32_t>(SharedFrameState::Writing));
+    CHECK(header->Writer.load() == 5);
+    CHECK(CountSharedFrameUsers(*header) == 0);
+
+    // A different gif that hashes the same is turned away
+    auto collision = segment.Content;
+    collision[200] ^= 1;
+    CHECK(ValidateSharedFrames(memory.data(), memory.size(), collision.data(), collision.size(), segment.Hash) == nullptr);
+    CHECK(ValidateSharedFrames(memory.data(), memory.size(), segment.Content.data(), segment.Content.size(), segment.Hash + 1) == nullptr);
+    CHECK(ValidateSharedFrames(memory.data(), memory.size(), segment.Content.data(), segment.Content.size() - 1, segment.Hash) == nullptr);
+
+    // Too little mapped, or a table pointing outside the segment
+    CHECK(segment.Validate(memory.data(), memory.size() - 1) == nullptr);
+    CHECK(segment.Validate(memory.data(), sizeof(SharedFrameHeader) - 1) == nullptr);
+    auto entries = const_cast<SharedFrameEntry*>(SharedFrameEntries(memory.data()));
+    entries[0].Offset = segment.Layout.ContentOffset;
+    CHECK(segment.Validate(memory.data(), memory.size()) == nullptr);
+
+    // Not there until the magic is
+    std::vector<uint8_t> blank(memory.size());
+    CHECK(segment.Validate(blank.data(), blank.size()) == nullptr);
+    CHECK(ValidateSharedFrames(nullptr, 0, segment.Content.data(), segment.Content.size(), segment.Hash) == nullptr);
+}
+
+TEST(SharedFrameUsersAreReclaimedFromDeadProcesses)
+{
+    Segment segment(10);
+    std::vector<uint8_t> memory(segment.Layout.TotalBytes);
+    segment.Initialize(memory.data(), 1);
+    auto&& header = *segment.Validate(memory.data(), memory.size());
+
+    std::set<uint32_t> alive = { 1, 2, 3 };
+    CHECK(AttachSharedFrameUser(header, 1, AliveIn(alive)));
+    CHECK(AttachSharedFrameUser(header, 2, AliveIn(alive)));
+    CHECK(AttachSharedFrameUser(header, 2, AliveIn(alive)));
+    CHECK(CountSharedFrameUsers(header) == 3);
+    DetachSharedFrameUser(header, 2);
+    CHECK(CountSharedFrameUsers(header) == 2);
+    DetachSharedFrameUser(header, 7);
+    CHECK(CountSharedFrameUsers(header) == 2);
+
+    // 2 dies without detaching, which only shows once somebody opens it
+    alive.erase(2);
+    CHECK(CountSharedFrameUsers(header) == 2);
+    CHECK(AttachSharedFrameUser(header, 3, AliveIn(alive)));
+    CHECK(CountSharedFrameUsers(header) == 2);
+
+    // Full of live processes
+    for (uint32_t id = 100; id < 100 + MaxSharedFrameUsers - 2; id++)
+    {
+        alive.insert(id);
+        CHECK(AttachSharedFrameUser(header, id, AliveIn(alive)));
+    }
+    CHECK(CountSharedFrameUsers(header) == MaxSharedFrameUsers);
+    alive.insert(4);
+    CHECK(!AttachSharedFrameUser(header, 4, AliveIn(alive)));
+    alive.erase(150);
+    CHECK(AttachSharedFrameUser(header, 4, AliveIn(alive)));
+    CHECK(CountSharedFrameUsers(header) == MaxSharedFrameUsers);
+}
+
+TEST(SharedFramesAreReclaimedFromDeadWriters)
+{
+    Segment segment(10);
+    std::vector<uint8_t> memory(segment.Layout.TotalBytes);
+    segment.Initialize(memory.data(), 1);
+    auto&& header = *segment.Validate(memory.data(), memory.size());
+
+    std::set<uint32_t> alive = { 1, 2, 3 };
+    CHECK(!ReclaimSharedFrames(header, 2, AliveIn(alive)));
+    CHECK(!ReclaimSharedFrames(header, 1, AliveIn(alive)));
+    alive.erase(1);
+    CHECK(ReclaimSharedFrames(header, 2, AliveIn(alive)));
+    CHECK(header.Writer.load() == 2);
+    // Only one process takes over
+    CHECK(!ReclaimSharedFrames(header, 3, AliveIn(alive)));
+
+    // Finished or given up segments stay as they are
+    alive.erase(2);
+    header.State.store(static_cast<uint32_t>(SharedFrameState::Abandoned));
+    CHECK(!ReclaimSharedFrames(header, 3, AliveIn(alive)));
+    header.State.store(static_cast<uint32_t>(SharedFrameState::Ready));
+    CHECK(!ReclaimSharedFrames(header, 3, AliveIn(alive)));
+}
+
+#ifndef _WIN32
+namespace
+{
+    // Runs body in a child process and returns its exit code. The child
+    // never returns to the test runner.
+    template <typename Body>
+    int RunChild(Body&& body)
+    {
+        auto child = fork();
+        if (child == 0)
+        {
+            int code = 1;
+            try
+            {
+                code = body() ? 0 : 2;
+            }
+            catch (...)
+            {
+            }
+            _exit(code);
+        }
+        int status = 0;
+        if (child < 0 || waitpid(child, &status, 0) != child || !WIFEXITED(status))
+        {
+            return -1;
+        }
+        return WEXITSTATUS(status);
+    }
+
+    bool IsProcessAlive(uint32_t processId)
+    {
+        return kill(static_cast<pid_t>(processId), 0) == 0 || errno == EPERM;
+    }
+}
+
+TEST(SharedFramesSurviveProcessesDying)
+{
+    Segment segment(4096);
+    auto size = static_cast<size_t>(segment.Layout.TotalBytes);
+    auto memory = mmap(nullptr, size, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_ANONYMOUS, -1, 0);
+    CHECK(memory != MAP_FAILED);
+    auto self = static_cast<uint32_t>(getpid());
+
+    // The first process starts writing and dies before publishing
+    CHECK(RunChild([&]
+    {
+        auto writer = static_cast<uint32_t>(getpid());
+        segment.Initialize(memory, writer);
+        auto header = segment.Validate(memory, size);
+        if (header == nullptr || !AttachSharedFrameUser(*header, writer, IsProcessAlive))
+        {
+            return false;
+        }
+        segment.WriteFrames(memory, writer);
+        return true;
+    }) == 0);
+    auto header = segment.Validate(memory, size);
+    CHECK(header != nullptr);
+    auto firstWriter = header->Writer.load();
+    CHECK(firstWriter != 0 && firstWriter != self);
+    CHECK(CountSharedFrameUsers(*header) == 1);
+
+    // The next one in frees its slot and finishes the job
+    CHECK(AttachSharedFrameUser(*header, self, IsProcessAlive));
+    CHECK(CountSharedFrameUsers(*header) == 1);
+    CHECK(ReclaimSharedFrames(*header, self, IsProcessAlive));
+    segment.WriteFrames(memory, self);
+    header->State.store(static_cast<uint32_t>(SharedFrameState::Ready), std::memory_order_release);
+
+    // Later processes see the finished frames and count themselves in
+    // alongside us
+    for (int reader = 0; reader < 3; reader++)
+    {
+        CHECK(RunChild([&]
+        {
+            auto readerId = static_cast<uint32_t>(getpid());
+            auto mapped = segment.Validate(memory, size);
+            if (mapped == nullptr || mapped->State.load(std::memory_order_acquire) != static_cast<uint32_t>(SharedFrameState::Ready))
+            {
+                return false;
+            }
+            if (ReclaimSharedFrames(*mapped, readerId, IsProcessAlive) || !AttachSharedFrameUser(*mapped, readerId, IsProcessAlive))
+            {
+                return false;
+            }
+            // The previous reader died without detaching
+            return CountSharedFrameUsers(*mapped) == 2 && segment.HasFrames(memory, self);
+        }) == 0);
+    }
+
+    DetachSharedFrameUser(*header, self);
+    CHECK(CountSharedFrameUsers(*header) == 1);
+    munmap(memory, size);
+}
+#endif
@@ -0,0 +1,32 @@
+#include "Test.h"
+#include "../VisitorGag/SnapshotCell.h"
+#include <thread>
+
+TEST(SnapshotCellNeverTears)
+{
+    struct Pair
+    {
+        uint64_t First = 0;
+        uint64_t Second = 0;
+    };
+    SnapshotCell<Pair> cell;
+    CHECK(cell.Read().First == 0);
+
+    std::thread writer([&cell]
+    {
+        for (uint64_t i = 1; i <= 100000; i++)
+        {
+            cell.Publish({ i, i * 2 });
+        }
+    });
+    bool consistent = true;
+    uint64_t last = 0;
+    while (last < 100000)
+    {
+        auto value = cell.Read();
+        consistent = consistent && value.Second == value.First * 2 && value.First >= last;
+        last = value.First;
+    }
+    writer.join();
+    CHECK(consistent);
+}
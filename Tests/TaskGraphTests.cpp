@@ -0,0 +1,190 @@
+#include "Test.h"
+#include "../VisitorGag/TaskGraph.h"
+#include <atomic>
+#include <stdexcept>
+#include <thread>
+
+namespace
+{
+    // When each task started and finished, as positions in one sequence
+    struct Trace
+    {
+        std::atomic<uint32_t> Next = 0;
+        std::vector<uint32_t> Started;
+        std::vector<uint32_t> Finished;
+        std::vector<std::thread::id> Threads;
+
+        explicit Trace(size_t taskCount) : Started(taskCount), Finished(taskCount), Threads(taskCount) {}
+
+        std::function<void()> Task(size_t id)
+        {
+            return [this, id]()
+            {
+                Started[id] = Next++;
+                Threads[id] = std::this_thread::get_id();
+                std::this_thread::yield();
+                Finished[id] = Next++;
+            };
+        }
+    };
+}
+
+TEST(TaskGraphRejectsForwardDependencies)
+{
+    TaskGraph graph;
+    auto first = graph.Add("first", {}, [] {});
+    CHECK_THROWS(graph.Add("self", { 1 }, [] {}), std::runtime_error);
+    CHECK_THROWS(graph.Add("later", { first, 5 }, [] {}), std::runtime_error);
+    CHECK(graph.TaskCount() == 1);
+    CHECK(graph.Add("second", { first }, [] {}) == 1);
+
+    TaskGraph empty;
+    auto stats = empty.Run(4);
+    CHECK(stats.Tasks.empty() && stats.Work.count() == 0);
+}
+
+TEST(TaskGraphRunsInOrderWithoutWorkers)
+{
+    TaskGraph graph;
+    Trace trace(5);
+    graph.Add("a", {}, trace.Task(0));
+    graph.Add("b", {}, trace.Task(1), TaskAffinity::Caller);
+    graph.Add("c", { 0 }, trace.Task(2));
+    graph.Add("d", {}, trace.Task(3));
+    graph.Add("e", { 1, 2 }, trace.Task(4), TaskAffinity::Caller);
+    auto stats = graph.Run(0);
+    for (size_t i = 0; i < 5; i++)
+    {
+        CHECK(trace.Started[i] == i * 2);
+        CHECK(trace.Threads[i] == std::this_thread::get_id());
+        CHECK(stats.Tasks[i].Ran);
+    }
+    CHECK(stats.Tasks[4].Name == "e");
+}
+
+TEST(TaskGraphWaitsForDependencies)
+{
+    // Two layers of fan out and back in, plus a chain along the side
+    for (int run = 0; run < 50; run++)
+    {
+        TaskGraph graph;
+        Trace trace(14);
+        std::vector<std::vector<TaskGraph::TaskId>> dependencies;
+        auto add = [&](std::vector<TaskGraph::TaskId> const& on, TaskAffinity affinity = TaskAffinity::Any)
+        {
+            auto id = graph.Add("task", on, trace.Task(graph.TaskCount()), affinity);
+            dependencies.push_back(on);
+            return id;
+        };
+        auto root = add({});
+        std::vector<TaskGraph::TaskId> fan;
+        for (int i = 0; i < 5; i++)
+        {
+            fan.push_back(add({ root }, i == 2 ? TaskAffinity::Caller : TaskAffinity::Any));
+        }
+        auto join = add(fan);
+        fan.clear();
+        for (int i = 0; i < 4; i++)
+        {
+            fan.push_back(add({ join }));
+        }
+        add(fan, TaskAffinity::Caller);
+        auto side = add({});
+        add({ side, root });
+
+        auto stats = graph.Run(4);
+        for (size_t i = 0; i < graph.TaskCount(); i++)
+        {
+            CHECK(stats.Tasks[i].Ran);
+            for (auto dependency : dependencies[i])
+            {
+                CHECK(trace.Finished[dependency] < trace.Started[i]);
+            }
+        }
+        CHECK(trace.Threads[3] == std::this_thread::get_id());
+        CHECK(trace.Threads[11] == std::this_thread::get_id());
+        CHECK(trace.Threads[0] != std::this_thread::get_id());
+        CHECK(stats.CriticalPath <= stats.Work);
+    }
+}
+
+TEST(TaskGraphSkipsWhatDependsOnFailures)
+{
+    for (uint32_t workers : { 0u, 1u, 3u })
+    {
+        TaskGraph graph;
+        std::atomic<uint32_t> ran = 0;
+        auto counted = [&] { ran++; };
+        auto fails = graph.Add("fails", {}, [] { throw std::invalid_argument("first"); });
+        auto alsoFails = graph.Add("also fails", {}, [] { throw std::logic_error("second"); }, TaskAffinity::Caller);
+        auto independent = graph.Add("independent", {}, counted);
+        auto direct = graph.Add("direct", { fails, independent }, counted);
+        graph.Add("transitive", { direct }, counted, TaskAffinity::Caller);
+        graph.Add("after", { independent }, counted);
+        graph.Add("late", { alsoFails }, counted);
+
+        // Whichever failed first is rethrown, after everything else ran
+        bool threw = false;
+        try
+        {
+            graph.Run(workers);
+        }
+        catch (std::logic_error const&)
+        {
+            threw = true;
+        }
+        CHECK(threw);
+        CHECK(ran == 2);
+    }
+
+    // The exception comes out as it was thrown
+    TaskGraph graph;
+    auto fails = graph.Add("fails", {}, [] { throw std::runtime_error("failed"); });
+    graph.Add("skipped", { fails }, [] {});
+    graph.Add("runs", {}, [] {});
+    try
+    {
+        graph.Run(2);
+        CHECK(false);
+    }
+    catch (std::runtime_error const& error)
+    {
+        CHECK(std::string(error.what()) == "failed");
+    }
+}
+
+TEST(TaskGraphMeasuresTheCriticalPath)
+{
+    // Three 20ms tasks side by side, then one more after all of them
+    TaskGraph graph;
+    auto sleep = [] { std::this_thread::sleep_for(std::chrono::milliseconds(20)); };
+    std::vector<TaskGraph::TaskId> layer;
+    for (int i = 0; i < 3; i++)
+    {
+        layer.push_back(graph.Add("layer", {}, sleep));
+    }
+    graph.Add("last", layer, sleep);
+    auto stats = graph.Run(3);
+    CHECK(stats.Work >= std::chrono::milliseconds(80));
+    CHECK(stats.CriticalPath >= std::chrono::milliseconds(40));
+    CHECK(stats.CriticalPath < stats.Work);
+    CHECK(stats.Elapsed >= stats.CriticalPath);
+    CHECK(stats.Tasks[3].Start >= stats.Tasks[0].Start + stats.Tasks[0].Duration);
+}
+
+BENCHMARK(TaskGraphOverhead)
+{
+    auto microseconds = MeasureMicroseconds(100, []
+    {
+        TaskGraph graph;
+        auto root = graph.Add("root", {}, [] {});
+        std::vector<TaskGraph::TaskId> fan;
+        for (int i = 0; i < 62; i++)
+        {
+            fan.push_back(graph.Add("fan", { root }, [] {}));
+        }
+        graph.Add("join", fan, [] {});
+        graph.Run(4);
+    });
+    printf("64 empty tasks on 4 workers: %.1f us per task\n", microseconds / 64);
+}
@@ -0,0 +1,85 @@
+#pragma once
+#include <chrono>
+#include <cstdio>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+// Just enough of a test framework to check the portable parts of the
+// player on any platform. Tests and benchmarks register themselves at
+// static initialization, main runs whichever were asked for.
+
+struct TestFailure : std::runtime_error
+{
+    using std::runtime_error::runtime_error;
+};
+
+struct TestCase
+{
+    char const* Name = nullptr;
+    void (*Run)() = nullptr;
+};
+
+std::vector<TestCase>& Tests();
+std::vector<TestCase>& Benchmarks();
+
+struct TestRegistration
+{
+    TestRegistration(std::vector<TestCase>& registry, char const* name, void (*run)())
+    {
+        registry.push_back({ name, run });
+    }
+};
+
+[[noreturn]] void FailTest(char const* file, int line, std::string const& message);
+
+#define TEST(name) \
+    static void name(); \
+    static TestRegistration name##Registration(Tests(), #name, name); \
+    static void name()
+
+#define BENCHMARK(name) \
+    static void name(); \
+    static TestRegistration name##Registration(Benchmarks(), #name, name); \
+    static void name()
+
+#define CHECK(condition) \
+    do \
+    { \
+        if (!(condition)) \
+        { \
+            FailTest(__FILE__, __LINE__, #condition); \
+        } \
+    } while (false)
+
+#define CHECK_THROWS(expression, exception) \
+    do \
+    { \
+        bool threw = false; \
+        try \
+        { \
+            expression; \
+        } \
+        catch (exception const&) \
+        { \
+            threw = true; \
+        } \
+        if (!threw) \
+        { \
+            FailTest(__FILE__, __LINE__, #expression " didn't throw " #exception); \
+        } \
+    } while (false)
+
+// Average time per call, after one call to warm up
+template <typename Function>
+double MeasureMicroseconds(uint32_t iterations, Function&& function)
+{
+    function();
+    auto start = std::chrono::steady_clock::now();
+    for (uint32_t i = 0; i < iterations; i++)
+    {
+        function();
+    }
+    auto elapsed = std::chrono::duration<double, std::micro>(std::chrono::steady_clock::now() - start);
+    return elapsed.count() / iterations;
+}
@@ -0,0 +1,100 @@
+#include "Test.h"
+#include "../VisitorGag/TileGrid.h"
+#include <random>
+#include <stdexcept>
+
+TEST(TileGridClipsEdgeTiles)
+{
+    TileGrid grid(300, 130, 128);
+    CHECK(grid.Columns() == 3 && grid.Rows() == 2 && grid.TileCount() == 6);
+    auto first = grid.TileBounds(0);
+    CHECK(first.X == 0 && first.Y == 0 && first.Width == 128 && first.Height == 128);
+    auto right = grid.TileBounds(2);
+    CHECK(right.X == 256 && right.Y == 0 && right.Width == 44 && right.Height == 128);
+    auto corner = grid.TileBounds(5);
+    CHECK(corner.X == 256 && corner.Y == 128 && corner.Width == 44 && corner.Height == 2);
+
+    // The tiles cover the canvas exactly once
+    uint64_t area = 0;
+    for (size_t i = 0; i < grid.TileCount(); i++)
+    {
+        auto bounds = grid.TileBounds(i);
+        area += static_cast<uint64_t>(bounds.Width) * bounds.Height;
+    }
+    CHECK(area == 300 * 130);
+
+    TileGrid exact(256, 256, 128);
+    CHECK(exact.TileCount() == 4 && exact.TileBounds(3).Width == 128);
+    CHECK_THROWS(TileGrid(10, 10, 0), std::invalid_argument);
+}
+
+TEST(TileGridFindsIntersectingTiles)
+{
+    TileGrid grid(300, 130, 64);
+    std::vector<size_t> tiles;
+    grid.TilesIntersecting({ 60, 10, 10, 10 }, tiles);
+    CHECK((tiles == std::vector<size_t>{ 0, 1 }));
+
+    // Touching a tile's edge isn't overlapping it
+    tiles.clear();
+    grid.TilesIntersecting({ 0, 0, 64, 64 }, tiles);
+    CHECK((tiles == std::vector<size_t>{ 0 }));
+
+    // Rects hanging off the canvas are clipped first
+    tiles.clear();
+    grid.TilesIntersecting({ -50, 120, 100, 100 }, tiles);
+    CHECK((tiles == std::vector<size_t>{ 5, 10 }));
+    tiles.clear();
+    grid.TilesIntersecting({ 290, -5, 1000, 1000 }, tiles);
+    CHECK((tiles == std::vector<size_t>{ 4, 9, 14 }));
+
+    // Entirely outside or empty
+    tiles.clear();
+    grid.TilesIntersecting({ 300, 0, 10, 10 }, tiles);
+    grid.TilesIntersecting({ -10, -10, 10, 10 }, tiles);
+    grid.TilesIntersecting({ 5, 5, 0, 10 }, tiles);
+    CHECK(tiles.empty());
+}
+
+TEST(TileGridMatchesABruteForceScan)
+{
+    std::mt19937 random(7);
+    TileGrid grid(517, 389, 96);
+    for (int i = 0; i < 2000; i++)
+    {
+        TileRect rect =
+        {
+            static_cast<int32_t>(random() % 700) - 100,
+            static_cast<int32_t>(random() % 600) - 100,
+            static_cast<int32_t>(random() % 300),
+            static_cast<int32_t>(random() % 300),
+        };
+        std::vector<size_t> tiles;
+        grid.TilesIntersecting(rect, tiles);
+        std::vector<size_t> expected;
+        for (size_t tile = 0; tile < grid.TileCount(); tile++)
+        {
+            if (TileGrid::Intersect(rect, grid.TileBounds(tile)).has_value())
+            {
+                expected.push_back(tile);
+            }
+        }
+        CHECK(tiles == expected);
+    }
+
+    std::vector<bool> marked;
+    auto count = grid.MarkTilesIntersecting({ { 0, 0, 10, 10 }, { 5, 5, 10, 10 }, { 400, 300, 200, 200 }, { 1000, 0, 5, 5 } }, marked);
+    CHECK(count == 5);
+    CHECK(marked.size() == grid.TileCount());
+    CHECK(marked[0] && marked[grid.TileCount() - 1]);
+    CHECK(marked[4 * grid.Columns() + 4] && marked[3 * grid.Columns() + 5]);
+}
+
+TEST(TileRectIntersection)
+{
+    auto overlap = TileGrid::Intersect({ 0, 0, 10, 10 }, { 5, -5, 10, 10 });
+    CHECK(overlap.has_value());
+    CHECK(overlap->X == 5 && overlap->Y == 0 && overlap->Width == 5 && overlap->Height == 5);
+    CHECK(!TileGrid::Intersect({ 0, 0, 10, 10 }, { 10, 0, 10, 10 }).has_value());
+    CHECK(!TileGrid::Intersect({ 0, 0, 10, 10 }, { 3, 3, 0, 0 }).has_value());
+}
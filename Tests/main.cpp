@@ -0,0 +1,70 @@
+#include <cstring>
+#include "Test.h"
+
+// Has no Windows dependencies, see the README for how to build it.
+
+std::vector<TestCase>& Tests()
+{
+    static std::vector<TestCase> tests;
+    return tests;
+}
+
+std::vector<TestCase>& Benchmarks()
+{
+    static std::vector<TestCase> benchmarks;
+    return benchmarks;
+}
+
+void FailTest(char const* file, int line, std::string const& message)
+{
+    throw TestFailure(std::string(file) + "(" + std::to_string(line) + "): " + message);
+}
+
+int main(int argc, char* argv[])
+{
+    bool benchmark = false;
+    char const* filter = nullptr;
+    for (int i = 1; i < argc; i++)
+    {
+        if (std::strcmp(argv[i], "-bench") == 0)
+        {
+            benchmark = true;
+        }
+        else if (std::strcmp(argv[i], "-help") == 0 || std::strcmp(argv[i], "/?") == 0)
+        {
+            printf("Tests [-bench] [filter]\n");
+            printf("Runs the tests (or with \"-bench\" the benchmarks) whose names contain the filter.\n");
+            return 0;
+        }
+        else
+        {
+            filter = argv[i];
+        }
+    }
+
+    uint32_t run = 0;
+    uint32_t failed = 0;
+    for (auto&& test : benchmark ? Benchmarks() : Tests())
+    {
+        if (filter != nullptr && std::strstr(test.Name, filter) == nullptr)
+        {
+            continue;
+        }
+        run++;
+        if (benchmark)
+        {
+            printf("%s\n", test.Name);
+        }
+        try
+        {
+            test.Run();
+        }
+        catch (std::exception const& error)
+        {
+            failed++;
+            printf("FAILED %s: %s\n", test.Name, error.what());
+        }
+    }
+    printf("%u of %u passed\n", run - failed, run);
+    return failed == 0 ? 0 : 1;
+}
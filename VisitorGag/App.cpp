@@ -2,6 +2,7 @@
 #include "App.h"
 #include "DDACaptureSource.h"
 #include "WGCCaptureSource.h"
+#include "TiledSurface.h"
 
 namespace winrt
 {
@@ -26,6 +27,8 @@ namespace util
     using namespace robmikh::common::uwp;
 }
 
+static constexpr uint32_t ShadeTileSize = 1024;
+
 winrt::IAsyncOperation<winrt::StorageFile> OpenGifFileAsync(HWND modalTo)
 {
     auto picker = winrt::FileOpenPicker();
@@ -39,45 +42,186 @@ winrt::IAsyncOperation<winrt::StorageFile> OpenGifFileAsync(HWND modalTo)
     co_return file;
 }
 
-App::App(bool dxDebug, std::optional<std::filesystem::path> path, CaptureMode captureMode, bool demoMode, bool loop)
+std::shared_ptr<ICaptureSourceFactory> CreateCaptureSourceFactory(CaptureMode captureMode)
 {
+    switch (captureMode)
+    {
+    case CaptureMode::WGC:
+        return std::make_shared<WGCCaptureSourceFactory>();
+    case CaptureMode::DDA:
+        return std::make_shared<DDACaptureSourceFactory>();
+    default:
+        // Starting with Windows 10 build 20348, we can use Windows.Graphics.Capture instead and disable the border.
+        if (winrt::ApiInformation::IsPropertyPresent(winrt::name_of<winrt::GraphicsCaptureSession>(), L"IsBorderRequired"))
+        {
+            return std::make_shared<WGCCaptureSourceFactory>();
+        }
+        else
+        {
+            return std::make_shared<DDACaptureSourceFactory>();
+        }
+    }
+}
+
+App::App(AppOptions const& options)
+{
+    m_startTime = std::chrono::steady_clock::now();
     m_dispatcherQueue = winrt::DispatcherQueue::GetForCurrentThread();
-    m_gifPath = path;
-    m_demoMode = demoMode;
+    m_gifPath = options.FilePath;
+    m_demoMode = options.DemoMode;
+    m_smartPlacement = options.SmartPlacement;
+    m_resident = options.Resident;
+    m_scale = options.Scale;
+    m_scaleWithDpi = options.ScaleWithDpi;
+    if (m_scaleWithDpi)
+    {
+        // Until we know which monitor the first visitor lands on
+        m_dpi = GetDpiForSystem();
+    }
+    m_lifecycle = std::make_unique<VisitorLifecycle>(*this, options.Resident, options.Hibernate, m_randomDevice());
+    m_bufferPool = CompositionGifPlayer::CreateBufferPool();
+
+    // Reading the gif, creating the devices and getting capture ready don't
+    // depend on each other, so they run side by side. Anything that touches
+    // the compositor stays on this thread. For comparison, SerialStartup
+    // makes each task wait for the one before it like startup used to.
+    TaskGraph startup;
+    std::optional<TaskGraph::TaskId> previous;
+    auto add = [&](std::string name, std::vector<TaskGraph::TaskId> dependencies, std::function<void()> work, TaskAffinity affinity = TaskAffinity::Any)
+    {
+        if (options.SerialStartup && previous.has_value())
+        {
+            dependencies.push_back(previous.value());
+        }
+        previous = startup.Add(std::move(name), dependencies, std::move(work), affinity);
+        return previous.value();
+    };
+    auto window = add("window", {}, [&]()
+        {
+            // Create our window and visual tree
+            m_window = std::make_unique<MainWindow>(L"VisitorGag", 800, 600);
+            m_compositor = winrt::Compositor();
+            m_target = m_window->CreateWindowTarget(m_compositor);
+            m_root = m_compositor.CreateSpriteVisual();
+            m_root.RelativeSizeAdjustment({ 1.0f, 1.0f });
+            m_target.Root(m_root);
+            CreateShadeVisuals();
+        }, TaskAffinity::Caller);
+    auto devices = add("devices", {}, [&]()
+        {
+            // Init D3D and D2D
+            uint32_t flags = D3D11_CREATE_DEVICE_BGRA_SUPPORT;
+            if (options.DxDebug)
+            {
+                flags |= D3D11_CREATE_DEVICE_DEBUG;
+            }
+            m_d3dDevice = util::CreateD3DDevice(flags);
+            m_d3dDevice->GetImmediateContext(m_d3dContext.put());
+            // The render thread and this one share the immediate context
+            m_d3dDevice.as<ID3D11Multithread>()->SetMultithreadProtected(true);
+            auto debugLevel = D2D1_DEBUG_LEVEL_NONE;
+            if (options.DxDebug)
+            {
+                debugLevel = D2D1_DEBUG_LEVEL_INFORMATION;
+            }
+            m_d2dFactory = util::CreateD2DFactory(debugLevel);
+            m_d2dDevice = util::CreateD2DDevice(m_d2dFactory, m_d3dDevice);
+        });
+    add("player", { window, devices }, [&]()
+        {
+            m_compGraphics = util::CreateCompositionGraphicsDevice(m_compositor, m_d3dDevice.get());
+            // Prep the shade surface
+            m_shadeSurface = m_compGraphics.CreateVirtualDrawingSurface({ 1, 1 }, winrt::DirectXPixelFormat::B8G8R8A8UIntNormalized, winrt::DirectXAlphaMode::Premultiplied);
+            m_leftShadeBrush.Surface(m_shadeSurface);
+            m_rightShadeBrush.Surface(m_shadeSurface);
+            MemoryTagScope memoryTag(MemoryTag::Player);
+            CreateGifPlayer(options);
+        }, TaskAffinity::Caller);
+    add("capture", { devices }, [&]()
+        {
+            MemoryTagScope memoryTag(MemoryTag::Capture);
+            m_captureSourceFactory = CreateCaptureSourceFactory(options.CaptureMode);
+            // Warm up the source the first visit will use
+            m_captureSource = m_captureSourceFactory->CreateCaptureSource(m_d3dDevice);
+        });
+    if (m_gifPath.has_value())
+    {
+        add("gif", {}, [&]()
+            {
+                // Blocks on the async calls, so nothing here switches threads
+                MemoryTagScope memoryTag(MemoryTag::Decoder);
+                m_startupGifStart = std::chrono::steady_clock::now();
+                auto file = util::GetStorageFileFromPathAsync(m_gifPath.value().wstring()).get();
+                auto stream = file.OpenReadAsync().get();
+                m_startupImage = GifImage::PrepareAsync(stream, *m_bufferPool, options.Progressive, options.ShareFrames, ScaleForDpi(m_dpi)).get();
+            });
+    }
+    TaskGraphStats stats;
+    {
+        // Worker threads join the process-wide MTA for the duration
+        CO_MTA_USAGE_COOKIE mtaUsage = nullptr;
+        winrt::check_hresult(CoIncrementMTAUsage(&mtaUsage));
+        auto releaseMta = wil::scope_exit([mtaUsage]()
+            {
+                CoDecrementMTAUsage(mtaUsage);
+            });
+        auto workers = options.SerialStartup ? 1 : std::max(std::thread::hardware_concurrency(), 1u);
+        stats = startup.Run(workers);
+    }
 
-    // Create our window and visual tree
-    m_window = std::make_unique<MainWindow>(L"VisitorGag", 800, 600);
-    m_compositor = winrt::Compositor();
-    m_target = m_window->CreateWindowTarget(m_compositor);
-    m_root = m_compositor.CreateSpriteVisual();
-    m_root.RelativeSizeAdjustment({ 1.0f, 1.0f });
-    m_target.Root(m_root);
+    auto toMs = [](std::chrono::microseconds time) { return static_cast<double>(time.count()) / 1000.0; };
+    wprintf(L"Startup took %.1f ms (%.1f ms of work, %.1f ms critical path):",
+        toMs(stats.Elapsed), toMs(stats.Work), toMs(stats.CriticalPath));
+    for (auto&& task : stats.Tasks)
+    {
+        wprintf(L" %S %.1f ms", task.Name.c_str(), toMs(task.Duration));
+    }
+    wprintf(L"\n");
 
-    // Init D3D and D2D
-    uint32_t flags = D3D11_CREATE_DEVICE_BGRA_SUPPORT;
-    if (dxDebug)
+    // Setup callback
+    m_window->OnLButtonUp(std::bind(&App::OnLButtonUp, this));
+    m_lifecycleTimer = m_dispatcherQueue.CreateTimer();
+    m_lifecycleTimer.IsRepeating(false);
+    m_lifecycleTimer.Tick([this](auto&&, auto&&)
+        {
+            m_lifecycle->OnTimer(std::chrono::steady_clock::now());
+            UpdateLifecycleTimer();
+        });
+
+    if (options.MemoryLogSeconds != 0)
     {
-        flags |= D3D11_CREATE_DEVICE_DEBUG;
+        m_memoryLogTimer = m_dispatcherQueue.CreateTimer();
+        m_memoryLogTimer.Interval(std::chrono::seconds(options.MemoryLogSeconds));
+        m_memoryLogTimer.IsRepeating(true);
+        m_memoryLogTimer.Tick([](auto&&, auto&&)
+            {
+                wprintf(L"Memory: %S\n", FormatMemoryReport(ReadMemoryReport()).c_str());
+            });
+        m_memoryLogTimer.Start();
     }
-    m_d3dDevice = util::CreateD3DDevice(flags);
-    m_d3dDevice->GetImmediateContext(m_d3dContext.put());
-    auto debugLevel = D2D1_DEBUG_LEVEL_NONE;
-    if (dxDebug)
+
+    // In resident mode we stick around and wait to be told what to do
+    if (m_resident)
     {
-        debugLevel = D2D1_DEBUG_LEVEL_INFORMATION;
+        m_commandServer = std::make_unique<CommandPipeServer>(ResidentPipeName, std::bind(&App::HandleCommands, this, std::placeholders::_1));
     }
-    m_d2dFactory = util::CreateD2DFactory(debugLevel);
-    m_d2dDevice = util::CreateD2DDevice(m_d2dFactory, m_d3dDevice);
-    m_compGraphics = util::CreateCompositionGraphicsDevice(m_compositor, m_d3dDevice.get());
+}
 
-    // Create the gif player
-    m_gifPlayer = std::make_unique<CompositionGifPlayer>(m_compositor, m_compGraphics, m_d2dDevice, m_d3dDevice, loop);
-    auto gifVisual = m_gifPlayer->Root();
-    gifVisual.AnchorPoint({ 0.5f, 0.5f });
-    gifVisual.RelativeOffsetAdjustment({ 0.5f, 0.5f, 0.0f });
-    m_root.Children().InsertAtTop(gifVisual);
+App::~App()
+{
+    // Nothing may be running on the render thread once the player goes away
+    wil::unique_event shutdown(wil::EventOptions::None);
+    auto shutdownAsync = m_renderQueueController.ShutdownQueueAsync();
+    shutdownAsync.Completed([&shutdown](auto&&, auto&&)
+        {
+            shutdown.SetEvent();
+        });
+    shutdown.wait();
+    m_gifPlayer.reset();
+}
 
-    // Create the shade visuals
+void App::CreateShadeVisuals()
+{
     m_leftShadeVisual = m_compositor.CreateSpriteVisual();
     m_leftShadeVisual.BorderMode(winrt::CompositionBorderMode::Hard);
     m_leftShadeVisual.RelativeSizeAdjustment({ 0.5f, 1.0f });
@@ -97,46 +241,104 @@ App::App(bool dxDebug, std::optional<std::filesystem::path> path, CaptureMode ca
     m_rightShadeVisual.Brush(m_rightShadeBrush);
     m_root.Children().InsertAtTop(m_leftShadeVisual);
     m_root.Children().InsertAtTop(m_rightShadeVisual);
+}
 
-    // Prep the shade surface
-    m_shadeSurface = m_compGraphics.CreateDrawingSurface2({ 1, 1 }, winrt::DirectXPixelFormat::B8G8R8A8UIntNormalized, winrt::DirectXAlphaMode::Premultiplied);
-    m_leftShadeBrush.Surface(m_shadeSurface);
-    m_rightShadeBrush.Surface(m_shadeSurface);
-
-    // Pick a capture method
-    switch (captureMode)
-    {
-    case CaptureMode::WGC:
-        m_captureSourceFactory = std::make_shared<WGCCaptureSourceFactory>();
-        break;
-    case CaptureMode::DDA:
-        m_captureSourceFactory = std::make_shared<DDACaptureSourceFactory>();
-        break;
-    default:
-        // Starting with Windows 10 build 20348, we can use Windows.Graphics.Capture instead and disable the border.
-        if (winrt::ApiInformation::IsPropertyPresent(winrt::name_of<winrt::GraphicsCaptureSession>(), L"IsBorderRequired"))
+void App::CreateGifPlayer(AppOptions const& options)
+{
+    m_renderQueueController = winrt::DispatcherQueueController::CreateOnDedicatedThread();
+    // Any other players on the render thread would share it
+    m_playbackClock = std::make_shared<SharedPlaybackClock>(m_renderQueueController.DispatcherQueue());
+    PlayerOptions playerOptions;
+    playerOptions.Loop = !options.NoLoop;
+    playerOptions.Progressive = options.Progressive;
+    playerOptions.MaxMemoryBytes = static_cast<uint64_t>(options.MaxMemoryMB) * 1024 * 1024;
+    playerOptions.ShareFrames = options.ShareFrames;
+    playerOptions.Flipbook = options.Flipbook;
+    playerOptions.Scale = ScaleForDpi(m_dpi);
+    m_gifPlayer = std::make_unique<CompositionGifPlayer>(m_compositor, m_compGraphics, m_d2dDevice, m_d3dDevice, playerOptions, m_renderQueueController.DispatcherQueue(), m_bufferPool, m_playbackClock);
+    m_gifPlayer->SetPlaybackMode(options.PlaybackMode);
+    m_gifPlayer->SetSpeed(options.Speed);
+    m_window->OnSuspendSignal([this](SuspendReason reason, bool active)
         {
-            m_captureSourceFactory = std::make_shared<WGCCaptureSourceFactory>();
-        }
-        else
+            m_gifPlayer->Signal(reason, active);
+        });
+    m_gifPlayer->OnLoadCompleted([this](FrameStreamStats const& stats)
         {
-            m_captureSourceFactory = std::make_shared<DDACaptureSourceFactory>();
-        }
-        break;
+            wprintf(L"Gif loaded: first frame after %.1f ms, all frames after %.1f ms",
+                static_cast<double>(stats.TimeToFirstFrame.count()) / 1000.0,
+                static_cast<double>(stats.TotalLoadTime.count()) / 1000.0);
+            if (stats.Stalls > 0)
+            {
+                wprintf(L", playback waited on the decoder %u time(s) for %.1f ms",
+                    stats.Stalls,
+                    static_cast<double>(stats.StalledTime.count()) / 1000.0);
+            }
+            wprintf(L"\n");
+
+            auto&& dedup = m_gifPlayer->DedupStats();
+            if (dedup.DuplicateFrames > 0)
+            {
+                wprintf(L"Found %u duplicate frame(s), saving %.1f MB (took %.2f ms)\n",
+                    dedup.DuplicateFrames,
+                    static_cast<double>(dedup.BytesSaved) / (1024.0 * 1024.0),
+                    static_cast<double>(dedup.Elapsed.count()) / 1000.0);
+            }
+            auto&& coverage = m_gifPlayer->CoverageStats();
+            if (coverage.FramePixels > 0 && coverage.BlendedPixels < coverage.FramePixels)
+            {
+                wprintf(L"Trimmed transparent pixels, blending %.1f%% of the frame area\n",
+                    100.0 * static_cast<double>(coverage.BlendedPixels) / static_cast<double>(coverage.FramePixels));
+            }
+            auto&& blend = m_gifPlayer->BlendStats();
+            if (blend.BlendedFrames < blend.Frames())
+            {
+                wprintf(L"Frames by blending needed: %u opaque, %u keyed, %u blended, %u empty\n",
+                    blend.OpaqueFrames, blend.KeyedFrames, blend.BlendedFrames, blend.EmptyFrames);
+            }
+        });
+    auto gifVisual = m_gifPlayer->Root();
+    gifVisual.AnchorPoint({ 0.5f, 0.5f });
+    gifVisual.RelativeOffsetAdjustment({ 0.5f, 0.5f, 0.0f });
+    // Under the shades
+    m_root.Children().InsertAtBottom(gifVisual);
+}
+
+ImageScale App::ScaleForDpi(uint32_t dpi) const
+{
+    auto scale = m_scale;
+    if (m_scaleWithDpi)
+    {
+        // Gifs (and the maximum size) are taken to be in 96 DPI pixels
+        auto factor = static_cast<float>(dpi) / static_cast<float>(USER_DEFAULT_SCREEN_DPI);
+        scale.Scale *= factor;
+        scale.MaxWidth = static_cast<uint32_t>(std::lround(scale.MaxWidth * factor));
+        scale.MaxHeight = static_cast<uint32_t>(std::lround(scale.MaxHeight * factor));
     }
-    
-    // Setup callback
-    m_window->OnLButtonUp(std::bind(&App::OnLButtonUp, this));
+    return scale;
 }
 
 winrt::IAsyncOperation<bool> App::TryLoadGifFromPickerAsync()
 {
+    if (m_startupImage != nullptr)
+    {
+        // Already read and decoded during startup
+        co_await m_dispatcherQueue;
+        co_await m_gifPlayer->LoadGifAsync(std::move(m_startupImage), m_startupGifStart);
+        OnGifLoaded();
+        co_return true;
+    }
+
     // Load a gif file
     winrt::StorageFile file{ nullptr };
     if (m_gifPath.has_value())
     {
         file = co_await util::GetStorageFileFromPathAsync(m_gifPath.value().wstring());
     }
+    else if (m_resident)
+    {
+        // A gif can be loaded later with the "load" command
+        co_return true;
+    }
     else
     {
         file = co_await OpenGifFileAsync(m_window->m_window);
@@ -158,10 +360,51 @@ winrt::IAsyncAction App::LoadGifAsync(winrt::IRandomAccessStream stream)
 {
     co_await m_dispatcherQueue;
     co_await m_gifPlayer->LoadGifAsync(stream);
+    OnGifLoaded();
+}
+
+void App::OnGifLoaded()
+{
+    auto usage = m_gifPlayer->MemoryUsage();
+    auto toMB = [](uint64_t bytes) { return static_cast<double>(bytes) / (1024.0 * 1024.0); };
+    wprintf(L"Frame memory: %u frame(s) on the GPU (%.1f MB), %u streamed from the encoded gif, %.1f MB total",
+        usage.GpuFrames, toMB(usage.GpuBytes), usage.EncodedFrames, toMB(usage.TotalBytes()));
+    if (usage.BudgetBytes != 0)
+    {
+        wprintf(L" of a %.1f MB budget", toMB(usage.BudgetBytes));
+    }
+    wprintf(L"\n");
+    auto pools = m_gifPlayer->PoolStats();
+    wprintf(L"Pools: reused %llu of %llu buffer(s) and %llu of %llu texture(s), %.1f MB pooled\n",
+        pools.Buffers.Reuses, pools.Buffers.Acquires, pools.Textures.Reuses, pools.Textures.Acquires,
+        toMB(pools.Buffers.RetainedBytes + pools.Textures.RetainedBytes));
+    auto shared = m_gifPlayer->SharedFramesStats();
+    if (shared.Attached)
+    {
+        wprintf(L"Shared frames: %.1f MB, %s, %u process(es) attached\n",
+            toMB(shared.Bytes),
+            shared.Ready ? (shared.Publisher ? L"published by us" : L"decoded by another process") : L"not published yet",
+            shared.Users);
+    }
+    auto flipbook = m_gifPlayer->FlipbookStats();
+    if (flipbook.Pages > 0)
+    {
+        wprintf(L"Flipbook: pre-rendering %zu page(s) during the first loop, up to %.1f MB\n", flipbook.Pages, toMB(flipbook.PlannedBytes));
+    }
+    else if (flipbook.PlannedBytes > 0)
+    {
+        wprintf(L"Flipbook: would need more than %.1f MB, compositing every frame instead\n", toMB(flipbook.PlannedBytes));
+    }
+    m_lifecycle->OnGifLoaded(std::chrono::steady_clock::now());
+    UpdateLifecycleTimer();
+}
+
+void App::ShowVisitor()
+{
     CaptureAndAnimate();
 }
 
-void App::OnLButtonUp()
+void App::HideVisitor()
 {
     auto batch = m_compositor.CreateScopedBatch(winrt::CompositionBatchTypes::Animation);
     PlayHideAnimation(std::chrono::milliseconds(800));
@@ -169,11 +412,44 @@ void App::OnLButtonUp()
         {
             m_window->Hide();
             m_gifPlayer->Stop();
-            Rerun();
+            m_lifecycle->OnHidden(std::chrono::steady_clock::now());
+            UpdateLifecycleTimer();
         });
     batch.End();
 }
 
+void App::HibernateVisitor()
+{
+    Hibernate();
+}
+
+void App::WakeVisitor()
+{
+    Wake();
+}
+
+std::chrono::microseconds App::WakeLeadTime()
+{
+    return m_hibernation.WakeLeadTime();
+}
+
+void App::OnLButtonUp()
+{
+    m_lifecycle->OnClicked(std::chrono::steady_clock::now());
+    UpdateLifecycleTimer();
+}
+
+void App::UpdateLifecycleTimer()
+{
+    m_lifecycleTimer.Stop();
+    if (auto deadline = m_lifecycle->NextDeadline())
+    {
+        auto delay = std::max(deadline.value() - std::chrono::steady_clock::now(), std::chrono::steady_clock::duration::zero());
+        m_lifecycleTimer.Interval(std::chrono::duration_cast<winrt::TimeSpan>(delay));
+        m_lifecycleTimer.Start();
+    }
+}
+
 void App::PlayShowAnimation(winrt::Windows::Foundation::TimeSpan const& duration)
 {
     auto leftAnimation = m_compositor.CreateScalarKeyFrameAnimation();
@@ -214,95 +490,283 @@ void App::PlayHideAnimation(winrt::Windows::Foundation::TimeSpan const& duration
     m_rightShadeVisual.StartAnimation(L"RelativeOffsetAdjustment.X", rightAnimation);
 }
 
-void App::CaptureAndAnimate()
+winrt::fire_and_forget App::CaptureAndAnimate()
 {
     auto gifSize = m_gifPlayer->Size();
 
-    // Generate random window position
-    auto captureSource = m_captureSourceFactory->CreateCaptureSource(m_d3dDevice);
-    auto desktopCoordinates = captureSource->DesktopCoordinates();
-
+    // Everything the capture source allocates is charged to capture. The
+    // scope has to end before we co_await.
+    winrt::com_ptr<ID3D11Texture2D> captureTexture;
+    RECT desktopCoordinates = {};
+    // Relative to the capture, which starts at the desktop's top-left
+    // corner. That isn't (0, 0) when a monitor sits left of or above the
+    // primary one.
     int32_t x = 0;
     int32_t y = 0;
-    if (!m_demoMode)
     {
-        auto minX = desktopCoordinates.left;
-        auto minY = desktopCoordinates.top;
-        auto maxX = (desktopCoordinates.right - desktopCoordinates.left) - gifSize.Width;
-        auto maxY = (desktopCoordinates.bottom - desktopCoordinates.top) - gifSize.Height;
+        MemoryTagScope memoryTag(MemoryTag::Capture);
+        // Kept between visits so that sources that track desktop changes can
+        // reuse the last capture
+        if (m_captureSource == nullptr)
+        {
+            m_captureSource = m_captureSourceFactory->CreateCaptureSource(m_d3dDevice);
+        }
+        desktopCoordinates = m_captureSource->DesktopCoordinates();
+        auto desktopWidth = static_cast<int32_t>(desktopCoordinates.right - desktopCoordinates.left);
+        auto desktopHeight = static_cast<int32_t>(desktopCoordinates.bottom - desktopCoordinates.top);
 
-        std::uniform_int_distribution<int> distX(minX, maxX);
-        std::uniform_int_distribution<int> distY(minY, maxY);
-        x = distX(m_randomDevice);
-        y = distY(m_randomDevice);
+        // Pick a window position. Smart placement has to look at the whole
+        // desktop, otherwise only the pixels under the visitor matter.
+        std::optional<PlacementPoint> position;
+        if (m_demoMode)
+        {
+            auto margin = 75;
+            position = PlacementPoint{ desktopWidth - gifSize.Width - margin, margin };
+        }
+        else if (m_smartPlacement)
+        {
+            captureTexture = m_captureSource->Capture();
+            position = FindQuietRegion(captureTexture, gifSize);
+        }
+        if (!position.has_value())
+        {
+            std::uniform_int_distribution<int> distX(0, desktopWidth - gifSize.Width);
+            std::uniform_int_distribution<int> distY(0, desktopHeight - gifSize.Height);
+            position = PlacementPoint{ distX(m_randomDevice), distY(m_randomDevice) };
+        }
+        x = position->X;
+        y = position->Y;
     }
-    else
+
+    // Draw the gif for the monitor it's about to show up on
+    if (m_scaleWithDpi)
     {
-        auto margin = 75;
-        x = desktopCoordinates.right - gifSize.Width - margin;
-        y = margin;
+        auto monitor = MonitorFromPoint({ desktopCoordinates.left + x + gifSize.Width / 2, desktopCoordinates.top + y + gifSize.Height / 2 }, MONITOR_DEFAULTTONEAREST);
+        uint32_t dpiX = 0;
+        uint32_t dpiY = 0;
+        winrt::check_hresult(GetDpiForMonitor(monitor, MDT_EFFECTIVE_DPI, &dpiX, &dpiY));
+        if (dpiX != m_dpi)
+        {
+            m_dpi = dpiX;
+            co_await m_gifPlayer->SetScaleAsync(ScaleForDpi(m_dpi));
+            gifSize = m_gifPlayer->Size();
+            // Keep it on the desktop at its new size
+            x = std::max(std::min(x, static_cast<int32_t>(desktopCoordinates.right - desktopCoordinates.left) - gifSize.Width), 0);
+            y = std::max(std::min(y, static_cast<int32_t>(desktopCoordinates.bottom - desktopCoordinates.top) - gifSize.Height), 0);
+        }
     }
 
-    // Capture screen with DDA
-    winrt::com_ptr<ID3D11Texture2D> windowAreaTexture;
     {
-        auto captureTexture = captureSource->Capture();
-
-        // Cut out window area from screenshot
-        D3D11_TEXTURE2D_DESC desc = {};
-        desc.Width = static_cast<uint32_t>(gifSize.Width);
-        desc.Height = static_cast<uint32_t>(gifSize.Height);
-        desc.MipLevels = 1;
-        desc.ArraySize = 1;
-        desc.Format = DXGI_FORMAT_B8G8R8A8_UNORM;
-        desc.BindFlags = D3D11_BIND_SHADER_RESOURCE;
-        desc.SampleDesc.Count = 1;
-        winrt::check_hresult(m_d3dDevice->CreateTexture2D(&desc, nullptr, windowAreaTexture.put()));
-        D3D11_BOX region = {};
-        region.left = x;
-        region.right = x + gifSize.Width;
-        region.top = y;
-        region.bottom = y + gifSize.Height;
-        region.back = 1;
-        m_d3dContext->CopySubresourceRegion(windowAreaTexture.get(), 0, 0, 0, 0, captureTexture.get(), 0, &region);
+        MemoryTagScope memoryTag(MemoryTag::Capture);
+        if (captureTexture == nullptr)
+        {
+            auto reuses = m_captureSource->ReuseStats().Reuses;
+            captureTexture = m_captureSource->CaptureRegion({ x, y, x + gifSize.Width, y + gifSize.Height });
+            auto stats = m_captureSource->ReuseStats();
+            if (stats.Reuses != reuses)
+            {
+                wprintf(L"Nothing changed under the visitor, reusing the last capture (%u of %u captures)\n", stats.Reuses, stats.Captures);
+            }
+        }
     }
 
-    // Apply the window area texture
+    // Copy the window area from the screenshot into the shade, one tile at
+    // a time so that large gifs don't need a single huge texture.
     m_shadeSurface.Resize(gifSize);
     {
-        POINT point = {};
-        auto dxgiSurface = util::SurfaceBeginDraw(m_shadeSurface, &point);
-        auto shadeSurface = m_shadeSurface;
-        auto endDraw = wil::scope_exit([shadeSurface]()
-            {
-                util::SurfaceEndDraw(shadeSurface);
-            });
-        auto destination = dxgiSurface.as<ID3D11Texture2D>();
-
-        D3D11_BOX region = {};
-        region.left = 0;
-        region.right = gifSize.Width;
-        region.top = 0;
-        region.bottom = gifSize.Height;
-        region.back = 1;
-        m_d3dContext->CopySubresourceRegion(destination.get(), 0, point.x, point.y, 0, windowAreaTexture.get(), 0, &region);
+        TileGrid shadeTiles(static_cast<uint32_t>(gifSize.Width), static_cast<uint32_t>(gifSize.Height), ShadeTileSize);
+        for (size_t i = 0; i < shadeTiles.TileCount(); i++)
+        {
+            auto bounds = shadeTiles.TileBounds(i);
+            CopyToSurfaceRegion(m_d3dContext, m_shadeSurface, bounds, captureTexture, x + bounds.X, y + bounds.Y);
+        }
     }
     m_leftShadeBrush.Offset({ 0.0f, 0.0f });
     m_rightShadeBrush.Offset({ static_cast<float>(gifSize.Width) / -2.0f, 0.0f });
     m_leftShadeVisual.RelativeOffsetAdjustment({ 0.0f, 0.0f, 0.0f });
     m_rightShadeVisual.RelativeOffsetAdjustment({ 0.5f, 0.0f, 0.0f });
 
-    // Show window
+    // Show window once the first frame is up
     m_gifPlayer->Play();
-    m_window->Show(x, y, gifSize);
+    co_await m_gifPlayer->SyncAsync();
+    m_window->Show(desktopCoordinates.left + x, desktopCoordinates.top + y, gifSize);
+    if (m_startTime.has_value())
+    {
+        wprintf(L"First visitor after %.1f ms\n",
+            static_cast<double>(std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now() - m_startTime.value()).count()) / 1000.0);
+        m_startTime = std::nullopt;
+    }
+    auto batch = m_compositor.CreateScopedBatch(winrt::CompositionBatchTypes::Animation);
     PlayShowAnimation(std::chrono::milliseconds(800));
+    batch.Completed([&](auto&&, auto&&)
+        {
+            m_lifecycle->OnShown(std::chrono::steady_clock::now());
+            UpdateLifecycleTimer();
+        });
+    batch.End();
 }
 
-winrt::fire_and_forget App::Rerun()
+winrt::fire_and_forget App::Hibernate()
 {
-    std::uniform_int_distribution<int> dist(5000, 30000);
-    auto delayInMilliseconds = dist(m_randomDevice);
-    co_await std::chrono::milliseconds(delayInMilliseconds);
-    co_await m_dispatcherQueue;
-    CaptureAndAnimate();
+    if (!m_hibernation.TryBeginHibernate(std::chrono::steady_clock::now()))
+    {
+        co_return;
+    }
+
+    m_gifPlayer->Hibernate();
+    // The duplication and the last capture hold on to a whole desktop. The
+    // source itself stays, a show waking us up may be using it.
+    if (m_captureSource != nullptr)
+    {
+        m_captureSource->Trim();
+    }
+    co_await m_gifPlayer->SyncAsync();
+    // A show can come in while the player lets go of its frames, and may
+    // already be drawing the shades. Leave everything else alone then.
+    if (!m_hibernation.WakePending())
+    {
+        m_shadeSurface.Resize({ 1, 1 });
+        // Along with whatever it captured last
+        m_captureSource = nullptr;
+        // Give the driver a chance to release the memory we just let go of
+        m_d3dContext->ClearState();
+        m_d3dContext->Flush();
+        m_d3dDevice.as<IDXGIDevice3>()->Trim();
+    }
+
+    if (!m_hibernation.CompleteHibernate(std::chrono::steady_clock::now(), m_gifPlayer->MemoryUsage().TotalBytes()))
+    {
+        co_await CompleteWakeAsync();
+        co_return;
+    }
+    auto&& stats = m_hibernation.Stats();
+    wprintf(L"Hibernated in %.2f ms, idle footprint %.1f MB\n",
+        static_cast<double>(stats.LastHibernateDuration.count()) / 1000.0,
+        static_cast<double>(stats.IdleBytes) / (1024.0 * 1024.0));
+}
+
+winrt::fire_and_forget App::Wake()
+{
+    // If we're still hibernating this is picked up once that's done
+    if (!m_hibernation.TryBeginWake(std::chrono::steady_clock::now()))
+    {
+        co_return;
+    }
+    co_await CompleteWakeAsync();
+}
+
+winrt::IAsyncAction App::CompleteWakeAsync()
+{
+    m_gifPlayer->Wake();
+    co_await m_gifPlayer->SyncAsync();
+
+    m_hibernation.CompleteWake(std::chrono::steady_clock::now(), m_gifPlayer->MemoryUsage().TotalBytes());
+    auto&& stats = m_hibernation.Stats();
+    wprintf(L"Woke up in %.2f ms, footprint %.1f MB\n",
+        static_cast<double>(stats.LastWakeDuration.count()) / 1000.0,
+        static_cast<double>(stats.AwakeBytes) / (1024.0 * 1024.0));
+}
+
+std::optional<PlacementPoint> App::FindQuietRegion(winrt::com_ptr<ID3D11Texture2D> const& captureTexture, winrt::SizeInt32 const& gifSize)
+{
+    auto stagingTexture = util::CopyD3DTexture(m_d3dDevice, captureTexture, true);
+    D3D11_TEXTURE2D_DESC desc = {};
+    stagingTexture->GetDesc(&desc);
+
+    D3D11_MAPPED_SUBRESOURCE mapped = {};
+    winrt::check_hresult(m_d3dContext->Map(stagingTexture.get(), 0, D3D11_MAP_READ, 0, &mapped));
+    auto unmap = wil::scope_exit([&]()
+        {
+            m_d3dContext->Unmap(stagingTexture.get(), 0);
+        });
+
+    m_placementEngine.Analyze(reinterpret_cast<uint8_t const*>(mapped.pData), desc.Width, desc.Height, mapped.RowPitch);
+    return m_placementEngine.FindQuietRegion(static_cast<uint32_t>(gifSize.Width), static_cast<uint32_t>(gifSize.Height), m_randomDevice);
+}
+
+std::vector<std::string> App::HandleCommands(std::vector<IpcCommand> const& commands)
+{
+    std::vector<std::string> responses;
+    responses.reserve(commands.size());
+    for (auto&& command : commands)
+    {
+        try
+        {
+            responses.push_back(HandleCommand(command));
+        }
+        catch (winrt::hresult_error const& error)
+        {
+            responses.push_back(FormatIpcResponse(false, winrt::to_string(error.message())));
+        }
+    }
+    return responses;
+}
+
+std::string App::HandleCommand(IpcCommand const& command)
+{
+    switch (command.Type)
+    {
+    case IpcCommandType::Show:
+    {
+        auto result = m_lifecycle->RequestShow(std::chrono::steady_clock::now());
+        UpdateLifecycleTimer();
+        switch (result)
+        {
+        case ShowResult::NotLoaded:
+            return FormatIpcResponse(false, "no gif loaded");
+        case ShowResult::AlreadyVisible:
+            return FormatIpcResponse(true, "already visible");
+        }
+        return FormatIpcResponse(true);
+    }
+    case IpcCommandType::Load:
+        if (m_lifecycle->IsVisible())
+        {
+            return FormatIpcResponse(false, "can't load while the visitor is visible");
+        }
+        // Answer right away, the load finishes in the background
+        LoadGifFromPathAsync(std::filesystem::u8path(command.Path));
+        return FormatIpcResponse(true, "loading");
+    case IpcCommandType::Schedule:
+        m_lifecycle->SetSchedule(command.MinDelayMs, command.MaxDelayMs);
+        return FormatIpcResponse(true);
+    case IpcCommandType::Stats:
+    {
+        auto usage = m_gifPlayer->MemoryUsage();
+        auto state = m_hibernation.State();
+        auto&& suspension = m_gifPlayer->SuspendStats();
+        auto clock = m_playbackClock->Stats();
+        char stats[384] = {};
+        snprintf(stats, sizeof(stats), "loaded=%d visible=%d hibernated=%d gpuFrames=%u streamedFrames=%u memoryMB=%.1f suspensions=%u suspendedSec=%.1f coalescedWakes=%u clockWakeupsPerSec=%.1f clockFanOut=%.2f clockMaxFanOut=%zu",
+            m_lifecycle->IsLoaded() ? 1 : 0,
+            m_lifecycle->IsVisible() ? 1 : 0,
+            state == HibernationState::Hibernated ? 1 : 0,
+            usage.GpuFrames,
+            usage.EncodedFrames,
+            static_cast<double>(usage.TotalBytes()) / (1024.0 * 1024.0),
+            suspension.Suspensions,
+            static_cast<double>(suspension.SuspendedTime.count()) / 1000000.0,
+            suspension.CoalescedWakes,
+            clock.WakeupsPerSecond(),
+            clock.AverageFanOut(),
+            clock.MaxFanOut);
+        return FormatIpcResponse(true, stats);
+    }
+    }
+    return FormatIpcResponse(false, "unknown command");
+}
+
+winrt::fire_and_forget App::LoadGifFromPathAsync(std::filesystem::path path)
+{
+    try
+    {
+        auto file = co_await util::GetStorageFileFromPathAsync(path.wstring());
+        auto stream = co_await file.OpenReadAsync();
+        co_await LoadGifAsync(stream);
+        wprintf(L"Loaded \"%s\"\n", path.wstring().c_str());
+    }
+    catch (winrt::hresult_error const& error)
+    {
+        wprintf(L"Failed to load \"%s\": %s\n", path.wstring().c_str(), error.message().c_str());
+    }
 }
@@ -2,6 +2,12 @@
 #include "MainWindow.h"
 #include "CompositionGifPlayer.h"
 #include "ICaptureSource.h"
+#include "PlacementEngine.h"
+#include "HibernationStateMachine.h"
+#include "VisitorLifecycle.h"
+#include "CommandPipe.h"
+#include "TaskGraph.h"
+#include "MemoryAccounting.h"
 
 enum class CaptureMode
 {
@@ -10,20 +16,64 @@ enum class CaptureMode
 	DDA
 };
 
-struct App
+// Everything the command line can ask for
+struct AppOptions
 {
-	App(bool dxDebug, std::optional<std::filesystem::path> path, CaptureMode captureMode, bool demoMode, bool noLoop);
+	bool DxDebug = false;
+	std::optional<std::filesystem::path> FilePath = std::nullopt;
+	CaptureMode CaptureMode = CaptureMode::Default;
+	bool DemoMode = false;
+	bool NoLoop = false;
+	bool SmartPlacement = false;
+	uint32_t MaxMemoryMB = 0;
+	bool Hibernate = false;
+	bool Progressive = false;
+	PlaybackMode PlaybackMode = PlaybackMode::Forward;
+	float Speed = 1.0f;
+	bool Resident = false;
+	bool ShareFrames = false;
+	bool SerialStartup = false;
+	uint32_t MemoryLogSeconds = 0;
+	bool Flipbook = false;
+	ImageScale Scale = {};
+	bool ScaleWithDpi = false;
+};
+
+struct App : IVisitorHost
+{
+	explicit App(AppOptions const& options);
+	~App();
 
 	winrt::Windows::Foundation::IAsyncOperation<bool> TryLoadGifFromPickerAsync();
 	winrt::Windows::Foundation::IAsyncAction LoadGifAsync(winrt::Windows::Storage::Streams::IRandomAccessStream stream);
 
 private:
+	void ShowVisitor() override;
+	void HideVisitor() override;
+	void HibernateVisitor() override;
+	void WakeVisitor() override;
+	std::chrono::microseconds WakeLeadTime() override;
+
+	void CreateShadeVisuals();
+	void CreateGifPlayer(AppOptions const& options);
+	// The requested scale, adjusted for the given DPI if we scale with it
+	ImageScale ScaleForDpi(uint32_t dpi) const;
+	void OnGifLoaded();
 	void OnLButtonUp();
+	// Arms the timer for whatever the lifecycle wants to do next
+	void UpdateLifecycleTimer();
 
 	void PlayShowAnimation(winrt::Windows::Foundation::TimeSpan const& duration);
 	void PlayHideAnimation(winrt::Windows::Foundation::TimeSpan const& duration);
-	void CaptureAndAnimate();
-	winrt::fire_and_forget Rerun();
+	winrt::fire_and_forget CaptureAndAnimate();
+	std::optional<PlacementPoint> FindQuietRegion(winrt::com_ptr<ID3D11Texture2D> const& captureTexture, winrt::Windows::Graphics::SizeInt32 const& gifSize);
+	winrt::fire_and_forget Hibernate();
+	winrt::fire_and_forget Wake();
+	// Once the state machine says we're waking
+	winrt::Windows::Foundation::IAsyncAction CompleteWakeAsync();
+	std::vector<std::string> HandleCommands(std::vector<IpcCommand> const& commands);
+	std::string HandleCommand(IpcCommand const& command);
+	winrt::fire_and_forget LoadGifFromPathAsync(std::filesystem::path path);
 
 private:
 	std::unique_ptr<MainWindow> m_window;
@@ -44,10 +94,35 @@ private:
 	winrt::Windows::UI::Composition::CompositionDrawingSurface m_shadeSurface{ nullptr };
 
 	winrt::Windows::System::DispatcherQueue m_dispatcherQueue{ nullptr };
+	// The gif player draws on its own thread so that capture and window
+	// messages don't hold up frames (and the other way around)
+	winrt::Windows::System::DispatcherQueueController m_renderQueueController{ nullptr };
 	std::random_device m_randomDevice;
+	std::shared_ptr<BufferPool> m_bufferPool;
+	std::shared_ptr<SharedPlaybackClock> m_playbackClock;
 	std::unique_ptr<CompositionGifPlayer> m_gifPlayer;
 	std::shared_ptr<ICaptureSourceFactory> m_captureSourceFactory;
+	// Created during startup and kept until we hibernate
+	std::unique_ptr<ICaptureSource> m_captureSource;
+	PlacementEngine m_placementEngine;
+	HibernationStateMachine m_hibernation;
+	std::unique_ptr<VisitorLifecycle> m_lifecycle;
+	winrt::Windows::System::DispatcherQueueTimer m_lifecycleTimer{ nullptr };
+	winrt::Windows::System::DispatcherQueueTimer m_memoryLogTimer{ nullptr };
+	std::unique_ptr<CommandPipeServer> m_commandServer;
+
+	// Read and decoded during startup, handed to the player once it exists
+	std::unique_ptr<GifImage> m_startupImage;
+	std::chrono::steady_clock::time_point m_startupGifStart = {};
+	// Cleared once the first visitor shows up
+	std::optional<std::chrono::steady_clock::time_point> m_startTime = std::nullopt;
 
 	std::optional<std::filesystem::path> m_gifPath = std::nullopt;
 	bool m_demoMode = false;
+	bool m_smartPlacement = false;
+	bool m_resident = false;
+	ImageScale m_scale;
+	bool m_scaleWithDpi = false;
+	// What the gif is currently scaled for
+	uint32_t m_dpi = USER_DEFAULT_SCREEN_DPI;
 };
@@ -0,0 +1,85 @@
+#include "BufferPool.h"
+
+PooledBuffer::PooledBuffer(PooledBuffer&& other) noexcept
+{
+    *this = std::move(other);
+}
+
+PooledBuffer& PooledBuffer::operator=(PooledBuffer&& other) noexcept
+{
+    if (this != &other)
+    {
+        Reset();
+        m_pool = std::exchange(other.m_pool, nullptr);
+        m_data = std::move(other.m_data);
+        m_size = std::exchange(other.m_size, 0);
+        m_capacity = std::exchange(other.m_capacity, 0);
+    }
+    return *this;
+}
+
+void PooledBuffer::Reset()
+{
+    if (m_data != nullptr && m_pool != nullptr)
+    {
+        m_pool->Release(std::move(m_data), m_capacity);
+    }
+    m_data = nullptr;
+    m_pool = nullptr;
+    m_size = 0;
+    m_capacity = 0;
+}
+
+PooledBuffer BufferPool::Acquire(size_t size)
+{
+    PooledBuffer buffer;
+    if (size == 0)
+    {
+        return buffer;
+    }
+    auto capacity = SizeClass(size);
+    {
+        std::scoped_lock lock(m_lock);
+        if (auto data = m_pool.TryAcquire(capacity))
+        {
+            buffer.m_data = std::move(data.value());
+        }
+    }
+    if (buffer.m_data == nullptr)
+    {
+        // Left uninitialized, callers always overwrite what they use
+        buffer.m_data = std::unique_ptr<uint8_t[]>(new uint8_t[capacity]);
+    }
+    buffer.m_pool = this;
+    buffer.m_size = size;
+    buffer.m_capacity = capacity;
+    return buffer;
+}
+
+void BufferPool::Trim()
+{
+    std::scoped_lock lock(m_lock);
+    m_pool.Trim();
+}
+
+ResourcePoolStats BufferPool::Stats()
+{
+    std::scoped_lock lock(m_lock);
+    return m_pool.Stats();
+}
+
+size_t BufferPool::SizeClass(size_t size) noexcept
+{
+    size_t sizeClass = MinSizeClass;
+    while (sizeClass < size)
+    {
+        sizeClass <<= 1;
+    }
+    return sizeClass;
+}
+
+void BufferPool::Release(std::unique_ptr<uint8_t[]>&& data, size_t capacity)
+{
+    std::scoped_lock lock(m_lock);
+    m_pool.Release(capacity, std::move(data), capacity);
+}
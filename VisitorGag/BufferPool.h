@@ -0,0 +1,61 @@
+#pragma once
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include "ResourcePool.h"
+
+struct BufferPool;
+
+// A byte buffer borrowed from a BufferPool. It goes back to the pool when
+// destroyed, so the pool must outlive it. The contents are uninitialized.
+struct PooledBuffer
+{
+    PooledBuffer() {}
+    PooledBuffer(PooledBuffer&& other) noexcept;
+    PooledBuffer& operator=(PooledBuffer&& other) noexcept;
+    PooledBuffer(PooledBuffer const&) = delete;
+    PooledBuffer& operator=(PooledBuffer const&) = delete;
+    ~PooledBuffer() { Reset(); }
+
+    uint8_t* Data() noexcept { return m_data.get(); }
+    uint8_t const* Data() const noexcept { return m_data.get(); }
+    size_t Size() const noexcept { return m_size; }
+    size_t Capacity() const noexcept { return m_capacity; }
+    bool Empty() const noexcept { return m_size == 0; }
+    // Returns the memory to the pool
+    void Reset();
+
+private:
+    friend struct BufferPool;
+    BufferPool* m_pool = nullptr;
+    std::unique_ptr<uint8_t[]> m_data;
+    size_t m_size = 0;
+    size_t m_capacity = 0;
+};
+
+// Hands out byte buffers rounded up to power-of-two size classes so that
+// buffers of similar sizes (decode scratch, encoded files, frame pixels)
+// can be reused across loads instead of going back to the heap every time.
+// Safe to use from multiple threads.
+struct BufferPool
+{
+    static constexpr size_t MinSizeClass = 4096;
+
+    // A limit of zero means unlimited
+    BufferPool(uint64_t maxRetainedBytes = 0) : m_pool(maxRetainedBytes) {}
+
+    PooledBuffer Acquire(size_t size);
+    void Trim();
+    ResourcePoolStats Stats();
+
+    static size_t SizeClass(size_t size) noexcept;
+
+private:
+    friend struct PooledBuffer;
+    void Release(std::unique_ptr<uint8_t[]>&& data, size_t capacity);
+
+private:
+    std::mutex m_lock;
+    ResourcePool<size_t, std::unique_ptr<uint8_t[]>> m_pool;
+};
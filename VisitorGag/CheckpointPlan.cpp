@@ -0,0 +1,35 @@
+#include "CheckpointPlan.h"
+#include <algorithm>
+
+CheckpointPlan CheckpointPlan::Compute(size_t frameCount, uint64_t checkpointBytes, uint64_t budgetBytes, size_t preferredSpacing)
+{
+    CheckpointPlan plan;
+    if (frameCount <= 1 || checkpointBytes == 0)
+    {
+        return plan;
+    }
+
+    auto spacing = std::max<size_t>(preferredSpacing, 1);
+    if (budgetBytes != 0)
+    {
+        auto maxCheckpoints = static_cast<size_t>(budgetBytes / checkpointBytes);
+        if (maxCheckpoints == 0)
+        {
+            return plan;
+        }
+        // Frames 1 through frameCount - 1 can have checkpoints
+        spacing = std::max<size_t>((frameCount - 1 + maxCheckpoints - 1) / maxCheckpoints, 1);
+    }
+    plan.Spacing = spacing;
+    plan.Count = (frameCount - 1) / spacing;
+    return plan;
+}
+
+size_t CheckpointPlan::SlotAtOrBefore(size_t frame) const noexcept
+{
+    if (Spacing == 0 || Count == 0 || frame < Spacing)
+    {
+        return Count;
+    }
+    return std::min(frame / Spacing, Count) - 1;
+}
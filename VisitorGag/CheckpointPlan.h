@@ -0,0 +1,27 @@
+#pragma once
+#include <cstddef>
+#include <cstdint>
+
+// Where to keep snapshots of the composited canvas so that any frame can
+// be reached by restoring one snapshot and drawing at most Spacing - 1
+// frames on top. Frame 0 never needs a snapshot since it starts from a
+// cleared canvas.
+struct CheckpointPlan
+{
+    // A budget of zero means unlimited, in which case preferredSpacing is
+    // used. Otherwise checkpoints are spread out as far as needed to fit.
+    static CheckpointPlan Compute(size_t frameCount, uint64_t checkpointBytes, uint64_t budgetBytes, size_t preferredSpacing = 8);
+
+    // Zero if there are no checkpoints at all
+    size_t Spacing = 0;
+    size_t Count = 0;
+
+    bool IsCheckpoint(size_t frame) const noexcept { return Spacing != 0 && frame != 0 && frame % Spacing == 0 && Slot(frame) < Count; }
+    size_t Slot(size_t frame) const noexcept { return frame / Spacing - 1; }
+    size_t FrameForSlot(size_t slot) const noexcept { return (slot + 1) * Spacing; }
+    // The slot of the last checkpoint at or before the frame, or Count if
+    // the frame has to be composed from scratch
+    size_t SlotAtOrBefore(size_t frame) const noexcept;
+    // The most frames a single seek has to draw
+    size_t MaxReplay(size_t frameCount) const noexcept { return Spacing == 0 ? frameCount : Spacing; }
+};
@@ -0,0 +1,190 @@
+#include "pch.h"
+#include "CommandPipe.h"
+
+namespace winrt
+{
+    using namespace Windows::System;
+}
+
+CommandPipeServer::CommandPipeServer(std::wstring const& pipeName, CommandBatchHandler const& handler)
+{
+    m_dispatcherQueue = winrt::DispatcherQueue::GetForCurrentThread();
+    if (m_dispatcherQueue == nullptr)
+    {
+        throw winrt::hresult_error(E_FAIL, L"Must be created on a thread with a Windows.System.DispatcherQueue");
+    }
+    m_pipeName = pipeName;
+    m_handler = handler;
+
+    // Only one resident instance at a time, and nothing from other machines
+    m_pipe.reset(CreateNamedPipeW(
+        m_pipeName.c_str(),
+        PIPE_ACCESS_DUPLEX | FILE_FLAG_OVERLAPPED | FILE_FLAG_FIRST_PIPE_INSTANCE,
+        PIPE_TYPE_BYTE | PIPE_READMODE_BYTE | PIPE_WAIT | PIPE_REJECT_REMOTE_CLIENTS,
+        1,
+        IpcLineBuffer::MaxLineLength,
+        IpcLineBuffer::MaxLineLength,
+        0,
+        nullptr));
+    if (!m_pipe)
+    {
+        winrt::throw_last_error();
+    }
+    m_stopEvent.create(wil::EventOptions::ManualReset);
+    m_thread = std::thread([this]() { Run(); });
+}
+
+CommandPipeServer::~CommandPipeServer()
+{
+    m_stopEvent.SetEvent();
+    m_thread.join();
+}
+
+void CommandPipeServer::Run()
+{
+    wil::unique_event ioEvent(wil::EventOptions::ManualReset);
+    OVERLAPPED overlapped = {};
+    overlapped.hEvent = ioEvent.get();
+    while (!m_stopEvent.is_signaled())
+    {
+        ioEvent.ResetEvent();
+        if (!ConnectNamedPipe(m_pipe.get(), &overlapped))
+        {
+            auto error = GetLastError();
+            DWORD bytesTransferred = 0;
+            if (error == ERROR_IO_PENDING)
+            {
+                if (!WaitForIo(overlapped, bytesTransferred))
+                {
+                    continue;
+                }
+            }
+            else if (error != ERROR_PIPE_CONNECTED)
+            {
+                DisconnectNamedPipe(m_pipe.get());
+                continue;
+            }
+        }
+
+        ServeClient(overlapped);
+        FlushFileBuffers(m_pipe.get());
+        DisconnectNamedPipe(m_pipe.get());
+    }
+}
+
+void CommandPipeServer::ServeClient(OVERLAPPED& overlapped)
+{
+    auto read = [&](char* data, size_t size) -> size_t
+    {
+        DWORD bytesRead = 0;
+        ResetEvent(overlapped.hEvent);
+        if (m_stopEvent.is_signaled() ||
+            (!ReadFile(m_pipe.get(), data, static_cast<DWORD>(size), nullptr, &overlapped) && GetLastError() != ERROR_IO_PENDING) ||
+            !WaitForIo(overlapped, bytesRead))
+        {
+            return 0;
+        }
+        return bytesRead;
+    };
+    auto write = [&](char const* data, size_t size)
+    {
+        DWORD bytesWritten = 0;
+        ResetEvent(overlapped.hEvent);
+        if (!WriteFile(m_pipe.get(), data, static_cast<DWORD>(size), nullptr, &overlapped) && GetLastError() != ERROR_IO_PENDING)
+        {
+            return false;
+        }
+        return WaitForIo(overlapped, bytesWritten);
+    };
+    ServeIpcClient(read, write, [this](auto&& commands) { return DispatchCommands(commands); });
+}
+
+bool CommandPipeServer::WaitForIo(OVERLAPPED& overlapped, DWORD& bytesTransferred)
+{
+    HANDLE handles[] = { m_stopEvent.get(), overlapped.hEvent };
+    auto result = WaitForMultipleObjects(ARRAYSIZE(handles), handles, FALSE, INFINITE);
+    if (result != WAIT_OBJECT_0 + 1)
+    {
+        // We're shutting down, make sure the kernel is done with our buffers
+        CancelIoEx(m_pipe.get(), &overlapped);
+        GetOverlappedResult(m_pipe.get(), &overlapped, &bytesTransferred, TRUE);
+        return false;
+    }
+    return GetOverlappedResult(m_pipe.get(), &overlapped, &bytesTransferred, FALSE) != FALSE;
+}
+
+std::optional<std::vector<std::string>> CommandPipeServer::DispatchCommands(std::vector<IpcCommand> const& commands)
+{
+    // The whole batch goes to the owning thread in one hop
+    auto promise = std::make_shared<std::promise<std::vector<std::string>>>();
+    auto future = promise->get_future();
+    auto handler = m_handler;
+    auto enqueued = m_dispatcherQueue.TryEnqueue([promise, handler, commands]()
+        {
+            try
+            {
+                promise->set_value(handler(commands));
+            }
+            catch (...)
+            {
+                promise->set_exception(std::current_exception());
+            }
+        });
+    if (!enqueued)
+    {
+        return std::nullopt;
+    }
+    // Don't block shutdown on a handler that will never run
+    while (future.wait_for(std::chrono::milliseconds(50)) != std::future_status::ready)
+    {
+        if (m_stopEvent.is_signaled())
+        {
+            return std::nullopt;
+        }
+    }
+    try
+    {
+        return future.get();
+    }
+    catch (...)
+    {
+        // Every command in the batch is answered as failed
+        return std::vector<std::string>();
+    }
+}
+
+std::string SendPipeCommands(std::wstring const& pipeName, std::string const& commands)
+{
+    if (!WaitNamedPipeW(pipeName.c_str(), 2000))
+    {
+        throw winrt::hresult_error(HRESULT_FROM_WIN32(GetLastError()), L"No resident instance is running");
+    }
+    wil::unique_hfile pipe(CreateFileW(pipeName.c_str(), GENERIC_READ | GENERIC_WRITE, 0, nullptr, OPEN_EXISTING, 0, nullptr));
+    if (!pipe)
+    {
+        winrt::throw_last_error();
+    }
+
+    auto request = commands;
+    if (request.empty() || request.back() != '\n')
+    {
+        request += '\n';
+    }
+    DWORD bytesWritten = 0;
+    winrt::check_bool(WriteFile(pipe.get(), request.data(), static_cast<DWORD>(request.size()), &bytesWritten, nullptr));
+
+    // One response line per request line
+    auto expectedLines = std::count(request.begin(), request.end(), '\n');
+    std::string responses;
+    char buffer[IpcLineBuffer::MaxLineLength] = {};
+    while (std::count(responses.begin(), responses.end(), '\n') < expectedLines)
+    {
+        DWORD bytesRead = 0;
+        if (!ReadFile(pipe.get(), buffer, sizeof(buffer), &bytesRead, nullptr) || bytesRead == 0)
+        {
+            break;
+        }
+        responses.append(buffer, bytesRead);
+    }
+    return responses;
+}
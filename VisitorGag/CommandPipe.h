@@ -0,0 +1,35 @@
+#pragma once
+#include "IpcProtocol.h"
+
+static constexpr wchar_t ResidentPipeName[] = L"\\\\.\\pipe\\VisitorGag";
+
+// Handles a batch of commands on the owning thread and returns one response
+// line (see FormatIpcResponse) per command, in order.
+using CommandBatchHandler = std::function<std::vector<std::string>(std::vector<IpcCommand> const&)>;
+
+// Serves the resident mode protocol over a local named pipe. Clients are
+// handled one at a time on a worker thread by ServeIpcClient, which hands
+// each batch of commands to the owning thread's DispatcherQueue.
+struct CommandPipeServer
+{
+    CommandPipeServer(std::wstring const& pipeName, CommandBatchHandler const& handler);
+    ~CommandPipeServer();
+
+private:
+    void Run();
+    void ServeClient(OVERLAPPED& overlapped);
+    bool WaitForIo(OVERLAPPED& overlapped, DWORD& bytesTransferred);
+    std::optional<std::vector<std::string>> DispatchCommands(std::vector<IpcCommand> const& commands);
+
+private:
+    std::wstring m_pipeName;
+    CommandBatchHandler m_handler;
+    winrt::Windows::System::DispatcherQueue m_dispatcherQueue{ nullptr };
+    wil::unique_handle m_pipe;
+    wil::unique_event m_stopEvent;
+    std::thread m_thread;
+};
+
+// Sends newline-separated commands to a resident instance and returns its
+// responses. Throws if no resident instance is listening.
+std::string SendPipeCommands(std::wstring const& pipeName, std::string const& commands);
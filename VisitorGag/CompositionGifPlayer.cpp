@@ -1,5 +1,7 @@
 #include "pch.h"
 #include "CompositionGifPlayer.h"
+#include "TiledSurface.h"
+#include "TextureAccounting.h"
 
 namespace winrt
 {
@@ -22,6 +24,14 @@ namespace util
     using namespace robmikh::common::uwp;
 }
 
+// Small enough to stay well under the texture size limit of any device we
+// run on, big enough that typical gifs fit in a single tile.
+static constexpr uint32_t CanvasTileSize = 1024;
+static constexpr D2D1_COLOR_F CanvasClearColor = { 0.0f, 0.0f, 0.0f, 1.0f };
+// How much each pool may hold on to between loads
+static constexpr uint64_t BufferPoolRetainedBytes = 64ull * 1024 * 1024;
+static constexpr uint64_t TexturePoolRetainedBytes = 64ull * 1024 * 1024;
+
 winrt::com_ptr<ID2D1Bitmap1> CreateBitmapFromTexture(
     winrt::com_ptr<ID3D11Texture2D> const& texture,
     winrt::com_ptr<ID2D1DeviceContext> const& d2dContext)
@@ -32,67 +42,202 @@ winrt::com_ptr<ID2D1Bitmap1> CreateBitmapFromTexture(
     return bitmap;
 }
 
-std::future<std::unique_ptr<GifImage>> GifImage::LoadAsync(winrt::IRandomAccessStream const& gifStream)
+std::future<std::unique_ptr<GifImage>> GifImage::LoadAsync(winrt::IRandomAccessStream const& gifStream, BufferPool& bufferPool, ImageScale const& scale)
+{
+    auto gifImage = co_await OpenAsync(gifStream, bufferPool, scale);
+    for (uint32_t i = 0; i < gifImage->FrameCount(); i++)
+    {
+        gifImage->AppendFrame(DecodeSoftwareFrame(gifImage->Decoder(), bufferPool, i, gifImage->Resampler()));
+    }
+    co_return gifImage;
+}
+
+std::future<std::unique_ptr<GifImage>> GifImage::OpenAsync(winrt::IRandomAccessStream const& gifStream, BufferPool& bufferPool, ImageScale const& scale)
+{
+    auto size = static_cast<uint32_t>(gifStream.Size());
+    auto buffer = winrt::Buffer(size);
+    co_await gifStream.ReadAsync(buffer, size, winrt::InputStreamOptions::None);
+    // Nothing below suspends, so the scope stays on one thread
+    MemoryTagScope memoryTag(MemoryTag::Decoder);
+
+    // Keep a copy of the encoded gif around so that frames can be
+    // re-materialized after their decoded pixels have been thrown away.
+    auto source = std::make_shared<GifSource>();
+    source->Encoded = bufferPool.Acquire(buffer.Length());
+    std::copy_n(buffer.data(), buffer.Length(), source->Encoded.Data());
+    try
+    {
+        source->Index = GifIndex::Build(source->Encoded.Data(), source->Encoded.Size());
+    }
+    catch (std::runtime_error const&)
+    {
+        throw winrt::hresult_error(WINCODEC_ERR_BADIMAGE, L"Not a valid gif");
+    }
+    co_return Open(std::move(source), scale);
+}
+
+std::unique_ptr<GifImage> GifImage::Open(std::shared_ptr<GifSource const> source, ImageScale const& scale)
 {
+    MemoryTagScope memoryTag(MemoryTag::Decoder);
     auto gifImage = std::make_unique<GifImage>();
+    auto&& index = source->Index;
+    gifImage->m_frameCount = static_cast<uint32_t>(index.FrameCount());
+    // Reserve up front so that references to frames stay valid while more
+    // are appended.
+    gifImage->m_frames.reserve(gifImage->m_frameCount);
+    gifImage->m_decoder = std::make_unique<GifFrameDecoder>(source->Encoded.Data(), source->Encoded.Size(), index);
+    gifImage->m_scale = scale;
+    // An empty canvas has nothing to scale
+    if (index.Width != 0 && index.Height != 0)
+    {
+        uint32_t scaledWidth = 0;
+        uint32_t scaledHeight = 0;
+        scale.Apply(index.Width, index.Height, scaledWidth, scaledHeight);
+        gifImage->m_resampler = FrameResampler(index.Width, index.Height, scaledWidth, scaledHeight, scale.Filter);
+    }
+    gifImage->m_source = std::move(source);
+    return gifImage;
+}
+
+std::future<std::unique_ptr<GifImage>> GifImage::PrepareAsync(winrt::IRandomAccessStream const& gifStream, BufferPool& bufferPool, bool progressive, bool shareFrames, ImageScale const& scale)
+{
+    auto image = co_await OpenAsync(gifStream, bufferPool, scale);
+    image->DecodeInitialFrames(bufferPool, progressive, shareFrames);
+    co_return image;
+}
+
+void GifImage::DecodeInitialFrames(BufferPool& bufferPool, bool progressive, bool shareFrames)
+{
+    if (shareFrames && m_resampler.IsIdentity())
+    {
+        AttachSharedFrames(SharedFrameStore::Open(EncodedBytes(), Index(), FrameCount()));
+        if (HasSharedFrames())
+        {
+            // Another process already decoded this gif
+            AppendSharedFrames();
+            return;
+        }
+    }
+    // In progressive mode only wait for the first frame, the rest are
+    // decoded in the background while we play.
+    auto frameCount = progressive ? std::min(m_frameCount, 1u) : m_frameCount;
+    for (auto i = static_cast<uint32_t>(m_frames.size()); i < frameCount; i++)
+    {
+        AppendFrame(DecodeSoftwareFrame(*m_decoder, bufferPool, i, m_resampler));
+    }
+}
 
-    auto decoder = co_await winrt::BitmapDecoder::CreateAsync(gifStream);
-    gifImage->m_width = decoder.PixelWidth();
-    gifImage->m_height = decoder.PixelHeight();
-    auto numFrames = decoder.FrameCount();
-    if (numFrames == 0)
+SoftwareGifFrame GifImage::DecodeSoftwareFrame(GifFrameDecoder& decoder, BufferPool& bufferPool, uint32_t index, FrameResampler const& resampler)
+{
+    MemoryTagScope memoryTag(MemoryTag::Decoder);
+    auto&& gifIndex = decoder.Index();
+    SoftwareGifFrame frame;
+    // Originally stored in 10ms units
+    frame.Delay = std::chrono::milliseconds(gifIndex.Delays[index] * 10);
+    TileRect rect = { gifIndex.Left[index], gifIndex.Top[index], gifIndex.FrameWidth[index], gifIndex.FrameHeight[index] };
+    if (resampler.IsIdentity())
     {
-        throw winrt::hresult_error(E_FAIL, L"Gifs with zero frames are not supported");
+        frame.Rect = { rect.X, rect.Y, rect.Width, rect.Height };
+        frame.RowPitch = static_cast<uint32_t>(frame.Rect.Width) * 4;
+        frame.Pixels = bufferPool.Acquire(static_cast<size_t>(frame.RowPitch) * frame.Rect.Height);
+        decoder.Decode(index, frame.Pixels.Data(), frame.RowPitch);
+        return frame;
     }
-    gifImage->m_frames.reserve(numFrames);
 
-    for (uint32_t i = 0; i < numFrames; i++)
+    // Only the scaled copy is kept
+    auto unscaledPitch = static_cast<uint32_t>(rect.Width) * 4;
+    auto unscaled = bufferPool.Acquire(static_cast<size_t>(unscaledPitch) * rect.Height);
+    decoder.Decode(index, unscaled.Data(), unscaledPitch);
+    auto scaledRect = resampler.ScaledRect(rect);
+    frame.Rect = { scaledRect.X, scaledRect.Y, scaledRect.Width, scaledRect.Height };
+    frame.RowPitch = static_cast<uint32_t>(frame.Rect.Width) * 4;
+    frame.Pixels = bufferPool.Acquire(static_cast<size_t>(frame.RowPitch) * frame.Rect.Height);
+    resampler.Resample(rect, unscaled.Data(), unscaledPitch, frame.Pixels.Data(), frame.RowPitch);
+    return frame;
+}
+
+TileRect GifImage::FrameRect(size_t index) const
+{
+    auto&& gifIndex = m_source->Index;
+    return m_resampler.ScaledRect({ gifIndex.Left[index], gifIndex.Top[index], gifIndex.FrameWidth[index], gifIndex.FrameHeight[index] });
+}
+
+void GifImage::AppendFrame(SoftwareGifFrame&& frame)
+{
+    if (m_frames.size() >= m_frameCount)
     {
-        auto decodedFrame = co_await decoder.GetFrameAsync(i);
+        throw winrt::hresult_error(E_FAIL, L"Too many frames appended to gif");
+    }
+    m_frames.push_back(std::move(frame));
 
-        // Get the bitmap
-        auto bitmap = co_await decodedFrame.GetSoftwareBitmapAsync();
-        auto pixelFormat = bitmap.BitmapPixelFormat();
-        auto alphaMode = bitmap.BitmapAlphaMode();
-        if (pixelFormat != winrt::BitmapPixelFormat::Bgra8 ||
-            alphaMode != winrt::BitmapAlphaMode::Premultiplied)
+    auto&& appended = m_frames.back();
+    if (m_sharedFrames != nullptr && m_sharedFrames->IsPublisher() && !appended.Pixels.Empty())
+    {
+        FrameRegion rect = { appended.Rect.X, appended.Rect.Y, appended.Rect.Width, appended.Rect.Height };
+        auto written = m_sharedFrames->WriteFrame(m_frames.size() - 1, rect, appended.Pixels.Data(), appended.RowPitch);
+        if (written && IsComplete())
         {
-            auto convertedBitmap = winrt::SoftwareBitmap::Convert(
-                bitmap,
-                winrt::BitmapPixelFormat::Bgra8,
-                winrt::BitmapAlphaMode::Premultiplied);
-            bitmap = convertedBitmap;
+            m_sharedFrames->Publish();
         }
+    }
+}
 
-        // Get the properties
-        auto properties = co_await decodedFrame.BitmapProperties().GetPropertiesAsync(
-            {
-                L"/grctlext/Delay",
-                L"/imgdesc/Left",
-                L"/imgdesc/Top",
-                L"/imgdesc/Width",
-                L"/imgdesc/Height",
-            });
-        auto gifRawDelay = winrt::unbox_value<uint16_t>(properties.Lookup(L"/grctlext/Delay").Value());
-        auto left = winrt::unbox_value<uint16_t>(properties.Lookup(L"/imgdesc/Left").Value());
-        auto top = winrt::unbox_value<uint16_t>(properties.Lookup(L"/imgdesc/Top").Value());
-        auto frameWidth = winrt::unbox_value<uint16_t>(properties.Lookup(L"/imgdesc/Width").Value());
-        auto frameHeight = winrt::unbox_value<uint16_t>(properties.Lookup(L"/imgdesc/Height").Value());
+uint8_t const* GifImage::SharedFrameBytes(size_t index, uint32_t& rowPitch) const noexcept
+{
+    if (m_sharedFrames == nullptr)
+    {
+        return nullptr;
+    }
+    return m_sharedFrames->FrameBytes(index, rowPitch);
+}
 
+void GifImage::AppendSharedFrames()
+{
+    auto&& index = m_source->Index;
+    for (auto i = m_frames.size(); i < m_frameCount; i++)
+    {
+        SoftwareGifFrame frame;
         // Originally stored in 10ms units
-        auto delay = std::chrono::milliseconds(gifRawDelay * 10);
-        auto rect = winrt::RectInt32
-        {
-            static_cast<int32_t>(left),
-            static_cast<int32_t>(top),
-            static_cast<int32_t>(frameWidth),
-            static_cast<int32_t>(frameHeight),
-        };
+        frame.Delay = std::chrono::milliseconds(index.Delays[i] * 10);
+        frame.Rect = { index.Left[i], index.Top[i], index.FrameWidth[i], index.FrameHeight[i] };
+        m_frames.push_back(std::move(frame));
+    }
+}
 
-        gifImage->m_frames.push_back({ bitmap, delay, rect });
+void GifImage::DecodeFrame(size_t index, FrameDestination const& destination)
+{
+    uint32_t sharedPitch = 0;
+    if (auto shared = SharedFrameBytes(index, sharedPitch))
+    {
+        auto&& clip = destination.Clip;
+        auto rowBytes = static_cast<size_t>(clip.Width) * 4;
+        auto source = shared + static_cast<size_t>(clip.Y) * sharedPitch + static_cast<size_t>(clip.X) * 4;
+        for (int32_t y = 0; y < clip.Height; y++)
+        {
+            std::copy_n(source + static_cast<size_t>(y) * sharedPitch, rowBytes, destination.Bytes + static_cast<size_t>(y) * destination.RowPitch);
+        }
+        return;
+    }
+    if (!m_resampler.IsIdentity())
+    {
+        // Scaled pixels depend on their neighbours, so decode the whole
+        // frame and scale just the part that's wanted
+        auto&& gifIndex = m_source->Index;
+        TileRect rect = { gifIndex.Left[index], gifIndex.Top[index], gifIndex.FrameWidth[index], gifIndex.FrameHeight[index] };
+        auto unscaledPitch = static_cast<uint32_t>(rect.Width) * 4;
+        m_unscaledScratch.resize(static_cast<size_t>(unscaledPitch) * rect.Height);
+        m_decoder->Decode(index, m_unscaledScratch.data(), unscaledPitch);
+        auto&& clip = destination.Clip;
+        m_resampler.Resample(rect, m_unscaledScratch.data(), unscaledPitch, { clip.X, clip.Y, clip.Width, clip.Height }, destination.Bytes, destination.RowPitch);
+        return;
     }
+    m_decoder->Decode(index, destination);
+}
 
-    co_return gifImage;
+void GifImage::DecodeFrame(size_t index, uint8_t* destination, uint32_t rowPitch)
+{
+    auto&& rect = m_frames[index].Rect;
+    DecodeFrame(index, { destination, rowPitch, { 0, 0, rect.Width, rect.Height } });
 }
 
 CompositionGifPlayer::CompositionGifPlayer(
@@ -100,231 +245,1420 @@ CompositionGifPlayer::CompositionGifPlayer(
     winrt::CompositionGraphicsDevice const& compGraphics, 
     winrt::com_ptr<ID2D1Device> const& d2dDevice, 
     winrt::com_ptr<ID3D11Device> const& d3dDevice,
-    bool loop)
+    PlayerOptions const& options,
+    winrt::DispatcherQueue const& renderQueue,
+    std::shared_ptr<BufferPool> const& bufferPool,
+    std::shared_ptr<SharedPlaybackClock> const& playbackClock) : m_bufferPool(bufferPool != nullptr ? bufferPool : CreateBufferPool()), m_texturePool(TexturePoolRetainedBytes), m_residency(options.MaxMemoryBytes)
 {
+    m_compositionQueue = winrt::DispatcherQueue::GetForCurrentThread();
+    if (m_compositionQueue == nullptr)
+    {
+        throw winrt::hresult_error(E_FAIL, L"Must be created on a thread with a Windows.System.DispatcherQueue");
+    }
+    m_dispatcherQueue = renderQueue != nullptr ? renderQueue : m_compositionQueue;
+    if (renderQueue != nullptr)
+    {
+        // The render thread only ever works for us
+        renderQueue.TryEnqueue([]()
+            {
+                SetThreadMemoryTag(MemoryTag::Player);
+            });
+    }
+
     m_compGraphics = compGraphics;
     m_d2dDevice = d2dDevice;
     m_d3dDevice = d3dDevice;
     m_d3dDevice->GetImmediateContext(m_d3dContext.put());
+    m_d3dMultithread = m_d3dDevice.as<ID3D11Multithread>();
     winrt::check_hresult(d2dDevice->CreateDeviceContext(D2D1_DEVICE_CONTEXT_OPTIONS_NONE, m_d2dContext.put()));
 
     m_visual = compositor.CreateSpriteVisual();
     m_brush = compositor.CreateSurfaceBrush();
     m_visual.Brush(m_brush);
 
-    m_surface = m_compGraphics.CreateDrawingSurface2({ 1, 1 }, winrt::DirectXPixelFormat::B8G8R8A8UIntNormalized, winrt::DirectXAlphaMode::Premultiplied);
+    // Virtual so that very large gifs don't need one huge allocation
+    m_surface = m_compGraphics.CreateVirtualDrawingSurface({ 1, 1 }, winrt::DirectXPixelFormat::B8G8R8A8UIntNormalized, winrt::DirectXAlphaMode::Premultiplied);
     m_brush.Surface(m_surface);
-    m_loop = loop;
+    m_loop = options.Loop;
+    m_progressive = options.Progressive;
+    m_shareFrames = options.ShareFrames;
+    m_flipbookMode = options.Flipbook;
+    m_scale.Publish(options.Scale);
+
+    m_playbackClock = playbackClock != nullptr ? playbackClock : std::make_shared<SharedPlaybackClock>(m_dispatcherQueue);
+    if (m_playbackClock->DispatcherQueue() != m_dispatcherQueue)
+    {
+        throw winrt::hresult_invalid_argument(L"The playback clock must run on the player's render queue");
+    }
+    // We won't be ticked until we schedule something
+    m_clockClient = m_playbackClock->Register([this]()
+        {
+            OnTick();
+        });
 }
 
-void CompositionGifPlayer::Play()
+CompositionGifPlayer::~CompositionGifPlayer()
 {
-    auto lock = m_lock.lock();
+    m_playbackClock->Unregister(m_clockClient);
+}
 
-    if (!m_frames.empty())
-    {
-        {
-            auto d3dMultithread = m_d3dDevice.as<ID3D11Multithread>();
-            auto d3dLock = util::D3D11DeviceLock(d3dMultithread.get());
-            winrt::TimeSpan delay = {};
-            {
-                m_d2dContext->BeginDraw();
-                auto endDraw = wil::scope_exit([&]()
-                    {
-                        winrt::check_hresult(m_d2dContext->EndDraw());
-                    });
-
-                m_d2dContext->Clear(D2D1_COLOR_F{ 0.0f, 0.0f, 0.0f, 1.0f });
-                WINRT_ASSERT(!m_frames.empty());
-                delay = DrawFrameToRenderTarget(0, m_d2dContext);
-            }
-            if (delay.count() == 0)
-            {
-                delay = std::chrono::milliseconds(100);
-            }
+std::shared_ptr<BufferPool> CompositionGifPlayer::CreateBufferPool()
+{
+    return std::make_shared<BufferPool>(BufferPoolRetainedBytes);
+}
 
-            UpdateSurface();
-            m_timer.Interval(delay);
-            m_currentIndex = 0;
-        }
-        m_timer.Start();
-    }
+void CompositionGifPlayer::Play()
+{
+    Post({ GifPlayerCommandType::Play });
 }
 
 void CompositionGifPlayer::Stop()
 {
-    auto lock = m_lock.lock();
-    if (m_timer != nullptr)
+    Post({ GifPlayerCommandType::Stop });
+}
+
+void CompositionGifPlayer::Seek(winrt::TimeSpan const& position)
+{
+    GifPlayerCommand command = { GifPlayerCommandType::Seek };
+    command.Position = position;
+    Post(std::move(command));
+}
+
+void CompositionGifPlayer::SetSpeed(float speed)
+{
+    if (!std::isfinite(speed) || !(speed > 0.0f))
     {
-        m_timer.Stop();
+        throw winrt::hresult_invalid_argument(L"Playback speed must be a positive number");
     }
+    GifPlayerCommand command = { GifPlayerCommandType::SetSpeed };
+    command.Speed = speed;
+    Post(std::move(command));
 }
 
 winrt::IAsyncAction CompositionGifPlayer::LoadGifAsync(winrt::IRandomAccessStream const& gifStream)
 {
-    auto currentQueue = winrt::DispatcherQueue::GetForCurrentThread();
-    if (currentQueue == nullptr)
+    auto start = std::chrono::steady_clock::now();
+    auto generation = ++m_loadGeneration;
+    auto stream = gifStream;
+    winrt::apartment_context caller;
+
+    // Keep decoding off both the caller's thread and the render thread
+    co_await winrt::resume_background();
+    auto image = co_await GifImage::PrepareAsync(stream, *m_bufferPool, m_progressive, m_shareFrames, m_scale.Read());
+    co_await ApplyGifAsync(std::move(image), generation, start);
+    co_await caller;
+}
+
+winrt::IAsyncAction CompositionGifPlayer::SetScaleAsync(ImageScale scale)
+{
+    auto start = std::chrono::steady_clock::now();
+    winrt::apartment_context caller;
+    m_scale.Publish(scale);
+
+    // Only the owning thread may look at the current gif
+    co_await m_dispatcherQueue;
+    if (m_image == nullptr || m_image->Scale() == scale)
     {
-        throw winrt::hresult_error(E_FAIL, L"Must be called from a thread with a Windows.System.DispatcherQueue");
+        co_await caller;
+        co_return;
     }
+    auto source = m_image->Source();
+    auto generation = ++m_loadGeneration;
+
+    // Decode again from the encoded gif we already have, frames are only
+    // kept at the size they're drawn at
+    co_await winrt::resume_background();
+    auto image = GifImage::Open(std::move(source), scale);
+    image->DecodeInitialFrames(*m_bufferPool, m_progressive, m_shareFrames);
+    co_await ApplyGifAsync(std::move(image), generation, start);
+    co_await caller;
+}
 
-    auto image = co_await GifImage::LoadAsync(gifStream);
-    co_await currentQueue;
+winrt::IAsyncAction CompositionGifPlayer::LoadGifAsync(std::unique_ptr<GifImage> image, std::chrono::steady_clock::time_point start)
+{
+    auto generation = ++m_loadGeneration;
+    winrt::apartment_context caller;
+    co_await ApplyGifAsync(std::move(image), generation, start);
+    co_await caller;
+}
+
+winrt::IAsyncAction CompositionGifPlayer::ApplyGifAsync(std::unique_ptr<GifImage> image, uint32_t generation, std::chrono::steady_clock::time_point start)
+{
+    auto source = image->Source();
+    auto resampler = image->Resampler();
+    auto frameCount = image->FrameCount();
+    auto decodedFrames = static_cast<uint32_t>(image->Frames().size());
 
+    GifPlayerCommand command = { GifPlayerCommandType::Load };
+    command.Image = std::move(image);
+    command.Generation = generation;
+    command.Start = start;
+    Post(std::move(command));
+
+    // Commands are processed in order on the owning thread, so once we get
+    // there the new gif has been applied.
+    co_await m_dispatcherQueue;
+
+    if (decodedFrames < frameCount)
     {
-        auto lock = m_lock.lock();
+        DecodeRemainingFrames(source, resampler, generation, decodedFrames, frameCount);
+    }
+}
 
-        auto d3dMultithread = m_d3dDevice.as<ID3D11Multithread>();
+winrt::IAsyncAction CompositionGifPlayer::SyncAsync()
+{
+    winrt::apartment_context caller;
+    co_await m_dispatcherQueue;
+    co_await caller;
+}
 
-        if (m_timer != nullptr)
+winrt::fire_and_forget CompositionGifPlayer::DecodeRemainingFrames(std::shared_ptr<GifSource const> source, FrameResampler resampler, uint32_t generation, uint32_t firstFrame, uint32_t frameCount)
+{
+    co_await winrt::resume_background();
+    // The owning thread may be decoding from the same gif, so use our own
+    GifFrameDecoder decoder(source->Encoded.Data(), source->Encoded.Size(), source->Index);
+    for (auto i = firstFrame; i < frameCount; i++)
+    {
+        // Give up if another gif has been loaded since
+        if (m_loadGeneration.load() != generation)
         {
-            m_timer.Stop();
-            m_timer = nullptr;
+            co_return;
         }
-        m_timer = currentQueue.CreateTimer();
-        m_timer.IsRepeating(false);
-        m_tick = m_timer.Tick(winrt::auto_revoke, { this, &CompositionGifPlayer::OnTick });
+        GifPlayerCommand command = { GifPlayerCommandType::AppendFrame };
+        command.Frame = GifImage::DecodeSoftwareFrame(decoder, *m_bufferPool, i, resampler);
+        command.Generation = generation;
+        Post(std::move(command));
+    }
+}
+
+void CompositionGifPlayer::OnLoadCompleted(std::function<void(FrameStreamStats const&)> const& callback)
+{
+    m_loadCompleted = callback;
+}
 
-        m_image = std::move(image);
+void CompositionGifPlayer::SetPlaybackMode(PlaybackMode mode)
+{
+    GifPlayerCommand command = { GifPlayerCommandType::SetPlaybackMode };
+    command.Mode = mode;
+    Post(std::move(command));
+}
 
-        if (m_d2dRenderTarget != nullptr)
-        {
-            m_d2dContext->SetTarget(nullptr);
-            m_d2dRenderTarget = nullptr;
-            m_renderTargetTexture = nullptr;
-        }
-        D3D11_TEXTURE2D_DESC desc = {};
-        desc.Width = m_image->Width();
-        desc.Height = m_image->Height();
-        desc.MipLevels = 1;
-        desc.ArraySize = 1;
-        desc.Format = DXGI_FORMAT_B8G8R8A8_UNORM;
-        desc.BindFlags = D3D11_BIND_RENDER_TARGET | D3D11_BIND_SHADER_RESOURCE;
-        desc.SampleDesc.Count = 1;
-        winrt::check_hresult(m_d3dDevice->CreateTexture2D(&desc, nullptr, m_renderTargetTexture.put()));
-        m_d2dRenderTarget = CreateBitmapFromTexture(m_renderTargetTexture, m_d2dContext);
-        m_d2dContext->SetTarget(m_d2dRenderTarget.get());
-
-        auto frames = m_image->Frames();
-        m_frames.clear();
-        m_frames.reserve(frames.size());
-        for (auto&& frame : frames)
-        {
-            auto frameWidth = static_cast<uint32_t>(frame.Rect.Width);
-            auto frameHeight = static_cast<uint32_t>(frame.Rect.Height);
-
-            auto bitmapBuffer = frame.Bitmap.LockBuffer(winrt::Windows::Graphics::Imaging::BitmapBufferAccessMode::Read);
-            auto reference = bitmapBuffer.CreateReference();
-            auto byteAccess = reference.as<::Windows::Foundation::IMemoryBufferByteAccess>();
-            uint8_t* bytes = nullptr;
-            uint32_t size = 0;
-            winrt::check_hresult(byteAccess->GetBuffer(&bytes, &size));
-
-            auto texture = robmikh::common::uwp::CreateTextureFromRawBytes(
-                m_d3dDevice,
-                bytes,
-                frameWidth,
-                frameHeight,
-                DXGI_FORMAT_B8G8R8A8_UNORM);
-            m_frames.push_back(CreateBitmapFromTexture(texture, m_d2dContext));
-        }
-
-        m_visual.Size({ static_cast<float>(m_image->Width()), static_cast<float>(m_image->Height()) });
-        m_surface.Resize({ static_cast<int32_t>(m_image->Width()), static_cast<int32_t>(m_image->Height()) });
-        {
-            auto d3dLock = util::D3D11DeviceLock(d3dMultithread.get());
-            winrt::TimeSpan delay = {};
-            {
-                m_d2dContext->BeginDraw();
-                auto endDraw = wil::scope_exit([&]()
-                    {
-                        winrt::check_hresult(m_d2dContext->EndDraw());
-                    });
-
-                m_d2dContext->Clear(D2D1_COLOR_F{ 0.0f, 0.0f, 0.0f, 1.0f });
-                WINRT_ASSERT(!m_frames.empty());
-                delay = DrawFrameToRenderTarget(0, m_d2dContext);
-            }
-            if (delay.count() == 0)
+void CompositionGifPlayer::Hibernate()
+{
+    Post({ GifPlayerCommandType::Hibernate });
+}
+
+void CompositionGifPlayer::Wake()
+{
+    Post({ GifPlayerCommandType::Wake });
+}
+
+void CompositionGifPlayer::Signal(SuspendReason reason, bool active)
+{
+    GifPlayerCommand command = { GifPlayerCommandType::Signal };
+    command.Reason = reason;
+    command.Active = active;
+    Post(std::move(command));
+}
+
+void CompositionGifPlayer::Post(GifPlayerCommand&& command)
+{
+    m_commands.Push(std::move(command));
+    if (m_dispatcherQueue.HasThreadAccess())
+    {
+        // Apply it right away so that callers on the owning thread (e.g.
+        // App::CaptureAndAnimate) see the first frame before they show it.
+        DrainCommands();
+    }
+    else if (!m_drainScheduled.exchange(true))
+    {
+        m_dispatcherQueue.TryEnqueue([this]()
             {
-                delay = std::chrono::milliseconds(100);
-            }
+                DrainCommands();
+            });
+    }
+}
 
-            UpdateSurface();
-            m_timer.Interval(delay);
-            m_currentIndex = 0;
+void CompositionGifPlayer::DrainCommands()
+{
+    // Reset the flag before draining, anything pushed after this point
+    // will either be seen by the loop below or schedule another drain.
+    m_drainScheduled.store(false);
+    // The compositor's thread shares the immediate context with us
+    auto d3dLock = util::D3D11DeviceLock(m_d3dMultithread.get());
+    while (auto command = m_commands.TryPop())
+    {
+        switch (command->Type)
+        {
+        case GifPlayerCommandType::Play:
+            OnPlay();
+            break;
+        case GifPlayerCommandType::Stop:
+            OnStop();
+            break;
+        case GifPlayerCommandType::Load:
+            OnLoad(std::move(command->Image), command->Generation, command->Start);
+            break;
+        case GifPlayerCommandType::AppendFrame:
+            OnAppendFrame(std::move(command->Frame), command->Generation);
+            break;
+        case GifPlayerCommandType::Seek:
+            OnSeek(command->Position);
+            break;
+        case GifPlayerCommandType::SetSpeed:
+            m_speed = command->Speed;
+            break;
+        case GifPlayerCommandType::SetPlaybackMode:
+            m_playbackMode = command->Mode;
+            m_cursor.Reset(m_playbackMode, m_frames.size());
+            break;
+        case GifPlayerCommandType::Hibernate:
+            OnHibernate();
+            break;
+        case GifPlayerCommandType::Wake:
+            OnWake();
+            break;
+        case GifPlayerCommandType::Signal:
+            OnSignal(command->Reason, command->Active);
+            break;
         }
     }
+    PublishSnapshot();
+}
 
-    co_return;
+void CompositionGifPlayer::PublishSnapshot()
+{
+    GifPlayerSnapshot snapshot;
+    if (m_image != nullptr)
+    {
+        snapshot.Size = { static_cast<int32_t>(m_image->Width()), static_cast<int32_t>(m_image->Height()) };
+    }
+    snapshot.MemoryUsage = m_residency.Usage();
+    snapshot.Pools = { m_bufferPool->Stats(), m_texturePool.Stats() };
+    snapshot.Dedup = m_dedup.Stats();
+    snapshot.Coverage = m_coverageStats;
+    snapshot.Blend = m_blendStats;
+    snapshot.Suspension = m_suspension.Stats();
+    if (m_image != nullptr)
+    {
+        snapshot.SharedFrames = m_image->SharedFramesStats();
+    }
+    snapshot.Flipbook = { m_flipbookPlan.Enabled, m_flipbook.PageCount(), m_flipbook.RecordedPages(), m_flipbook.Bytes(), m_flipbookPlan.Bytes };
+    m_snapshot.Publish(snapshot);
 }
 
-winrt::TimeSpan CompositionGifPlayer::DrawFrameToRenderTarget(size_t index, winrt::com_ptr<ID2D1DeviceContext> const& d2dContext)
+void CompositionGifPlayer::OnPlay()
 {
-    auto frames = m_image->Frames();
-    auto& frame = frames[index];
-    auto& frameTexture = m_frames[index];
+    OnWake();
+    if (!m_frames.empty())
+    {
+        ResetLoopCount();
+        m_cursor.Reset(m_playbackMode, m_frames.size());
+        // Other modes need every frame, start at the beginning until then
+        auto first = m_frameStream.IsComplete() ? m_cursor.First() : 0;
+        auto delay = ComposeTo(first);
+        ArmFrameTimer(delay);
+        m_playing = true;
+    }
+}
 
-    d2dContext->DrawImage(frameTexture.get(), { static_cast<float>(frame.Rect.X), static_cast<float>(frame.Rect.Y) });
-    return frame.Delay;
+void CompositionGifPlayer::OnStop()
+{
+    DisarmFrameTimer();
+    m_playing = false;
+    m_frameStream.EndStall(std::chrono::steady_clock::now());
+}
+
+void CompositionGifPlayer::OnLoad(std::unique_ptr<GifImage>&& image, uint32_t generation, std::chrono::steady_clock::time_point start)
+{
+    DisarmFrameTimer();
+    m_playing = false;
+    m_hibernated = false;
+
+    // The old frames have to go while we still know which ones are shared
+    RecycleFrameResources();
+    m_image = std::move(image);
+    m_generation = generation;
+    m_dedup.Reset(m_image->FrameCount());
+    m_coverage.clear();
+    m_coverage.resize(m_image->FrameCount());
+    m_coverageStats = {};
+    m_blendClasses.assign(m_image->FrameCount(), FrameBlendClass::Blended);
+    m_blendStats = {};
+    CreateFrameResources();
+
+    winrt::float2 visualSize = { static_cast<float>(m_image->Width()), static_cast<float>(m_image->Height()) };
+    if (m_compositionQueue.HasThreadAccess())
+    {
+        m_visual.Size(visualSize);
+    }
+    else
+    {
+        m_compositionQueue.TryEnqueue([visual = m_visual, visualSize]()
+            {
+                visual.Size(visualSize);
+            });
+    }
+    ResizeSurface();
+    WINRT_ASSERT(!m_image->Frames().empty());
+    ComposeTo(0);
+
+    auto now = std::chrono::steady_clock::now();
+    m_frameStream.Begin(start, m_image->FrameCount());
+    for (size_t i = 0; i < m_image->Frames().size(); i++)
+    {
+        m_frameStream.Publish(now);
+    }
+    if (m_frameStream.IsComplete() && m_loadCompleted != nullptr)
+    {
+        PublishSnapshot();
+        m_loadCompleted(m_frameStream.Stats());
+    }
 }
 
-void CompositionGifPlayer::OnTick(winrt::DispatcherQueueTimer const&, winrt::IInspectable const&)
+void CompositionGifPlayer::OnAppendFrame(SoftwareGifFrame&& frame, uint32_t generation)
 {
-    auto lock = m_lock.lock();
-    m_currentIndex = (m_currentIndex + 1) % m_frames.size();
-    if (m_currentIndex == 0 && !m_loop)
+    // Stragglers from a gif that has since been replaced
+    if (generation != m_generation || m_image == nullptr)
     {
-        m_timer.Stop();
         return;
     }
 
-    auto d3dMultithread = m_d3dDevice.as<ID3D11Multithread>();
+    m_image->AppendFrame(std::move(frame));
+    auto index = m_image->Frames().size() - 1;
+    auto&& rect = m_image->Frames()[index].Rect;
+    m_residency.SetFrameBytes(index, static_cast<uint64_t>(rect.Width) * rect.Height * 4);
+    if (m_hibernated)
+    {
+        // It'll get placed when we wake up
+        m_image->DiscardPixels(index);
+    }
+    else
+    {
+        PlaceFrame(index);
+    }
 
-    winrt::TimeSpan delay = {};
+    auto now = std::chrono::steady_clock::now();
+    m_frameStream.Publish(now);
+    if (m_frameStream.IsComplete() && m_loadCompleted != nullptr)
     {
-        m_d2dContext->BeginDraw();
-        auto endDraw = wil::scope_exit([&]()
-            {
-                winrt::check_hresult(m_d2dContext->EndDraw());
-            });
+        PublishSnapshot();
+        m_loadCompleted(m_frameStream.Stats());
+    }
+    // If playback was waiting on this frame, show it now
+    if (m_frameStream.EndStall(now) && m_playing)
+    {
+        AdvanceFrame();
+    }
+}
+
+void CompositionGifPlayer::OnHibernate()
+{
+    if (m_hibernated || m_image == nullptr)
+    {
+        return;
+    }
+    DisarmFrameTimer();
+    m_playing = false;
+    m_frameStream.EndStall(std::chrono::steady_clock::now());
+
+    // Everything can be rebuilt from the encoded gif. We're trying to give
+    // memory back, so don't keep any of it pooled either.
+    RecycleFrameResources();
+    for (size_t i = 0; i < m_frames.size(); i++)
+    {
+        m_residency.SetResidency(i, FrameResidency::Encoded);
+    }
+    m_checkpointPlan = {};
+    m_dirtyTiles.clear();
+    m_texturePool.Trim();
+    m_bufferPool->Trim();
+    ResizeDrawingSurface(m_surface, { 1, 1 });
+    m_d2dDevice->ClearResources();
+    m_residency.SetFixedBytes(m_image->EncodedBytes().Size());
+    m_hibernated = true;
+}
+
+void CompositionGifPlayer::OnWake()
+{
+    if (!m_hibernated)
+    {
+        return;
+    }
+    CreateFrameResources();
+    ResizeSurface();
+    m_hibernated = false;
+}
+
+void CompositionGifPlayer::CreateFrameResources()
+{
+    // Hand whatever the last gif used back to the pools so that the new one
+    // can pick up anything with a matching size. Canvas tiles are allocated
+    // as frames draw into them.
+    RecycleFrameResources();
+    m_tileGrid = TileGrid(m_image->Width(), m_image->Height(), CanvasTileSize);
+    m_tiles.resize(m_tileGrid.TileCount());
+    m_dirtyTiles.assign(m_tileGrid.TileCount(), false);
 
-        if (m_currentIndex == 0)
+    // Decide where each frame should live before uploading anything. The
+    // index has the size of every frame, even ones that haven't been decoded
+    // yet. If it disagrees with the decoder, assume the whole canvas.
+    auto&& frames = m_image->Frames();
+    auto&& index = m_image->Index();
+    auto frameCount = static_cast<size_t>(m_image->FrameCount());
+    auto canvasBytes = static_cast<uint64_t>(m_image->Width()) * m_image->Height() * 4;
+    std::vector<uint64_t> frameBytes;
+    std::vector<TileRect> frameRects;
+    frameBytes.reserve(frameCount);
+    frameRects.reserve(frameCount);
+    uint64_t totalFrameBytes = 0;
+    for (size_t i = 0; i < frameCount; i++)
+    {
+        TileRect rect = { 0, 0, static_cast<int32_t>(m_image->Width()), static_cast<int32_t>(m_image->Height()) };
+        if (i < frames.size())
+        {
+            rect = { frames[i].Rect.X, frames[i].Rect.Y, frames[i].Rect.Width, frames[i].Rect.Height };
+        }
+        else if (i < index.FrameCount())
         {
-            m_d2dContext->Clear(D2D1_COLOR_F{ 0.0f, 0.0f, 0.0f, 1.0f });
+            rect = m_image->FrameRect(i);
         }
-        if (!m_frames.empty())
+        if (m_coverage[i].has_value())
         {
-            delay = DrawFrameToRenderTarget(m_currentIndex, m_d2dContext);
+            rect = FrameContentRect(i);
         }
+        auto bytes = static_cast<uint64_t>(rect.Width) * rect.Height * 4;
+        frameRects.push_back(rect);
+        frameBytes.push_back(bytes);
+        totalFrameBytes += bytes;
     }
-    if (delay.count() == 0)
+    // Only tiles that some frame draws into will ever be allocated
+    std::vector<bool> contentTiles;
+    m_tileGrid.MarkTilesIntersecting(frameRects, contentTiles);
+    uint64_t contentBytes = 0;
+    for (size_t i = 0; i < contentTiles.size(); i++)
     {
-        delay = std::chrono::milliseconds(100);
+        if (contentTiles[i])
+        {
+            auto bounds = m_tileGrid.TileBounds(i);
+            contentBytes += static_cast<uint64_t>(bounds.Width) * bounds.Height * 4;
+        }
     }
+    auto tileBytes = static_cast<uint64_t>(CanvasTileSize) * CanvasTileSize * 4;
 
-    UpdateSurface();
-    m_timer.Interval(delay);
-    m_timer.Start();
+    // The canvas tiles and the composition surface, plus the streaming
+    // texture if not everything is going to fit.
+    auto fixedBytes = canvasBytes + contentBytes + m_image->EncodedBytes().Size();
+    auto budgetBytes = m_residency.BudgetBytes();
+    // Frames that other processes decoded for us are always streamed, so we
+    // don't each keep a copy of them.
+    auto needsStreaming = (budgetBytes != 0 && fixedBytes + totalFrameBytes > budgetBytes) || m_image->HasSharedFrames();
+    if (needsStreaming)
+    {
+        fixedBytes += tileBytes;
+    }
+    m_residency.Reset(frameBytes, fixedBytes);
+
+    m_frames.resize(frameCount);
+    for (size_t i = 0; i < frames.size(); i++)
+    {
+        PlaceFrame(i);
+    }
+
+    if (needsStreaming)
+    {
+        m_streamingTexture = AcquireTexture(std::min(CanvasTileSize, m_image->Width()), std::min(CanvasTileSize, m_image->Height()), D3D11_BIND_SHADER_RESOURCE);
+        m_streamingBitmap = CreateBitmapFromTexture(m_streamingTexture, m_d2dContext);
+    }
+
+    // A flipbook gets whatever budget is left and is recorded as playback
+    // passes each frame for the first time. Its pages make checkpoints
+    // pointless. Long gifs that don't fit fall back to checkpoints.
+    auto totalBytes = m_residency.Usage().TotalBytes();
+    m_flipbookPlan = {};
+    if (m_flipbookMode && (budgetBytes == 0 || budgetBytes > totalBytes + tileBytes))
+    {
+        m_flipbookPlan = FlipbookPlan::Compute(m_tileGrid, frameRects, budgetBytes == 0 ? 0 : budgetBytes - totalBytes - tileBytes);
+    }
+    if (m_flipbookPlan.Enabled)
+    {
+        std::vector<uint64_t> pageTileBytes;
+        pageTileBytes.reserve(m_tileGrid.TileCount());
+        for (size_t i = 0; i < m_tileGrid.TileCount(); i++)
+        {
+            auto bounds = m_tileGrid.TileBounds(i);
+            pageTileBytes.push_back(static_cast<uint64_t>(bounds.Width) * bounds.Height * 4);
+        }
+        m_flipbook.Reset(frameCount, std::move(pageTileBytes));
+        m_flipbookClearTexture = CreateClearTexture();
+        m_residency.SetFixedBytes(m_residency.Usage().FixedBytes + tileBytes);
+        m_checkpointPlan = {};
+    }
+    // Snapshots of the composited canvas get whatever budget is left. They
+    // are captured lazily as seeking or non-forward playback passes them.
+    else if (budgetBytes == 0)
+    {
+        m_checkpointPlan = CheckpointPlan::Compute(frameCount, contentBytes, 0);
+    }
+    else if (budgetBytes > totalBytes)
+    {
+        m_checkpointPlan = CheckpointPlan::Compute(frameCount, contentBytes, budgetBytes - totalBytes);
+    }
+    else
+    {
+        m_checkpointPlan = {};
+    }
+    m_checkpoints.resize(m_checkpointPlan.Count);
 }
 
-void CompositionGifPlayer::UpdateSurface()
+void CompositionGifPlayer::ResizeSurface()
 {
-    POINT point = {};
-    auto dxgiSurface = util::SurfaceBeginDraw(m_surface, &point);
-    auto surface = m_surface;
-    auto endDraw = wil::scope_exit([surface]()
+    ResizeDrawingSurface(m_surface, { static_cast<int32_t>(m_image->Width()), static_cast<int32_t>(m_image->Height()) });
+
+    // Tiles that haven't been allocated yet are the clear color, which the
+    // surface needs to show too. Borrow a single tile to fill them in.
+    auto clearTexture = CreateClearTexture();
+
+    auto d3dLock = util::D3D11DeviceLock(m_d3dMultithread.get());
+    for (size_t i = 0; i < m_tiles.size(); i++)
+    {
+        auto bounds = m_tileGrid.TileBounds(i);
+        if (m_tiles[i].Texture == nullptr)
         {
-            util::SurfaceEndDraw(surface);
-        });
-    auto destination = dxgiSurface.as<ID3D11Texture2D>();
+            CopyToSurfaceRegion(m_d3dContext, m_surface, bounds, clearTexture, 0, 0);
+        }
+        else
+        {
+            CopyToSurfaceRegion(m_d3dContext, m_surface, bounds, m_tiles[i].Texture, 0, 0);
+        }
+        m_dirtyTiles[i] = false;
+    }
+    RecycleTexture(std::move(clearTexture));
+}
 
-    winrt::SizeInt32 gifSize = { static_cast<int32_t>(m_image->Width()), static_cast<int32_t>(m_image->Height()) };
-    D3D11_BOX region = {};
-    region.left = 0;
-    region.right = gifSize.Width;
-    region.top = 0;
-    region.bottom = gifSize.Height;
-    region.back = 1;
-    m_d3dContext->CopySubresourceRegion(destination.get(), 0, point.x, point.y, 0, m_renderTargetTexture.get(), 0, &region);
+CanvasTile CompositionGifPlayer::CreateCanvasTile(size_t tile)
+{
+    auto bounds = m_tileGrid.TileBounds(tile);
+    CanvasTile result;
+    result.Texture = AcquireTexture(static_cast<uint32_t>(bounds.Width), static_cast<uint32_t>(bounds.Height), D3D11_BIND_RENDER_TARGET | D3D11_BIND_SHADER_RESOURCE);
+    result.Target = CreateBitmapFromTexture(result.Texture, m_d2dContext);
+    return result;
+}
+
+winrt::com_ptr<ID3D11Texture2D> CompositionGifPlayer::CreateClearTexture()
+{
+    auto clearTile = CreateCanvasTile(0);
+    {
+        m_d2dContext->SetTarget(clearTile.Target.get());
+        m_d2dContext->BeginDraw();
+        auto endDraw = wil::scope_exit([&]()
+            {
+                winrt::check_hresult(m_d2dContext->EndDraw());
+            });
+        m_d2dContext->Clear(CanvasClearColor);
+    }
+    m_d2dContext->SetTarget(nullptr);
+    return std::move(clearTile.Texture);
+}
+
+void CompositionGifPlayer::AnalyzeFrame(size_t index)
+{
+    auto&& frame = m_image->Frames()[index];
+    auto frameWidth = static_cast<uint32_t>(frame.Rect.Width);
+    auto frameHeight = static_cast<uint32_t>(frame.Rect.Height);
+    auto&& coverage = m_coverage[index].emplace(AnalyzeFrameCoverage(frame.Pixels.Data(), frameWidth, frameHeight, frame.RowPitch));
+
+    m_coverageStats.FramePixels += static_cast<uint64_t>(frameWidth) * frameHeight;
+    m_coverageStats.BlendedPixels += coverage.BlendedPixels();
+    // Classify what's inside the tight bounds, since that's all we draw
+    auto&& bounds = coverage.Bounds;
+    auto blendClass = FrameBlendClass::Empty;
+    if (!coverage.IsEmpty())
+    {
+        auto boundsBytes = frame.Pixels.Data() + static_cast<size_t>(bounds.Y) * frame.RowPitch + static_cast<size_t>(bounds.X) * 4;
+        blendClass = ClassifyFrameBlend(boundsBytes, static_cast<uint32_t>(bounds.Width), static_cast<uint32_t>(bounds.Height), frame.RowPitch);
+    }
+    m_blendClasses[index] = blendClass;
+    m_blendStats.Add(blendClass);
+    // Only the tight bounds get uploaded
+    m_residency.SetFrameBytes(index, static_cast<uint64_t>(coverage.Bounds.Width) * coverage.Bounds.Height * 4);
+}
+
+TileRect CompositionGifPlayer::FrameContentRect(size_t index) const
+{
+    auto&& frame = m_image->Frames()[index];
+    auto&& coverage = m_coverage[index];
+    if (!coverage.has_value())
+    {
+        return { frame.Rect.X, frame.Rect.Y, frame.Rect.Width, frame.Rect.Height };
+    }
+    auto&& bounds = coverage->Bounds;
+    return { frame.Rect.X + bounds.X, frame.Rect.Y + bounds.Y, bounds.Width, bounds.Height };
+}
+
+void CompositionGifPlayer::DeduplicateFrame(size_t index)
+{
+    auto&& frames = m_image->Frames();
+    auto&& frame = frames[index];
+    auto rowPitch = frame.RowPitch;
+    FrameRegion region = { frame.Rect.X, frame.Rect.Y, frame.Rect.Width, frame.Rect.Height };
+
+    PooledBuffer candidateScratch;
+    m_dedup.Add(index, region, frame.Pixels.Data(), rowPitch, [&](size_t candidate) -> uint8_t const*
+        {
+            auto&& candidateFrame = frames[candidate];
+            if (!candidateFrame.Pixels.Empty())
+            {
+                return candidateFrame.Pixels.Data();
+            }
+            // Its decoded copy is gone, get it back from the encoded gif
+            candidateScratch = m_bufferPool->Acquire(static_cast<size_t>(rowPitch) * candidateFrame.Rect.Height);
+            m_image->DecodeFrame(candidate, candidateScratch.Data(), rowPitch);
+            return candidateScratch.Data();
+        });
+}
+
+winrt::com_ptr<ID3D11Texture2D> CompositionGifPlayer::AcquireTexture(uint32_t width, uint32_t height, uint32_t bindFlags)
+{
+    if (auto texture = m_texturePool.TryAcquire({ width, height, bindFlags }))
+    {
+        return texture.value();
+    }
+    D3D11_TEXTURE2D_DESC desc = {};
+    desc.Width = width;
+    desc.Height = height;
+    desc.MipLevels = 1;
+    desc.ArraySize = 1;
+    desc.Format = DXGI_FORMAT_B8G8R8A8_UNORM;
+    desc.BindFlags = bindFlags;
+    desc.SampleDesc.Count = 1;
+    winrt::com_ptr<ID3D11Texture2D> texture;
+    winrt::check_hresult(m_d3dDevice->CreateTexture2D(&desc, nullptr, texture.put()));
+    TrackTexture(texture.get(), MemoryTag::Player);
+    return texture;
+}
+
+winrt::com_ptr<ID3D11Texture2D> CompositionGifPlayer::UploadTextureRegion(uint8_t const* bytes, uint32_t rowPitch, uint32_t width, uint32_t height)
+{
+    auto texture = AcquireTexture(width, height, D3D11_BIND_SHADER_RESOURCE);
+    D3D11_BOX region = {};
+    region.right = width;
+    region.bottom = height;
+    region.back = 1;
+    m_d3dContext->UpdateSubresource(texture.get(), 0, &region, bytes, rowPitch, 0);
+    return texture;
+}
+
+void CompositionGifPlayer::RecycleTexture(winrt::com_ptr<ID3D11Texture2D>&& texture)
+{
+    if (texture == nullptr)
+    {
+        return;
+    }
+    D3D11_TEXTURE2D_DESC desc = {};
+    texture->GetDesc(&desc);
+    auto bytes = static_cast<uint64_t>(desc.Width) * desc.Height * 4;
+    m_texturePool.Release({ desc.Width, desc.Height, desc.BindFlags }, std::move(texture), bytes);
+}
+
+void CompositionGifPlayer::RecycleFrameResources()
+{
+    // D2D may still be pointing at one of the tiles
+    m_d2dContext->SetTarget(nullptr);
+    for (auto&& tile : m_tiles)
+    {
+        tile.Target = nullptr;
+        RecycleTexture(std::move(tile.Texture));
+    }
+    m_tiles.clear();
+    // Back to front so that duplicates let go of their shared textures
+    // before the frame that owns them is recycled
+    for (auto i = m_frames.size(); i > 0; i--)
+    {
+        auto&& frameTiles = m_frames[i - 1];
+        if (frameTiles.empty())
+        {
+            continue;
+        }
+        auto canonical = m_dedup.CanonicalOf(i - 1);
+        auto shared = canonical != i - 1 && !m_frames[canonical].empty() &&
+            frameTiles.front().Texture == m_frames[canonical].front().Texture;
+        if (!shared)
+        {
+            for (auto&& frameTile : frameTiles)
+            {
+                frameTile.Bitmap = nullptr;
+                RecycleTexture(std::move(frameTile.Texture));
+            }
+        }
+        frameTiles.clear();
+    }
+    for (auto&& checkpoint : m_checkpoints)
+    {
+        for (auto&& texture : checkpoint)
+        {
+            RecycleTexture(std::move(texture));
+        }
+    }
+    m_checkpoints.clear();
+    for (auto&& image : m_flipbookImages)
+    {
+        RecycleTexture(std::move(image));
+    }
+    m_flipbookImages.clear();
+    m_flipbook.Reset(0, {});
+    RecycleTexture(std::move(m_flipbookClearTexture));
+    m_streamingBitmap = nullptr;
+    RecycleTexture(std::move(m_streamingTexture));
+}
+
+bool CompositionGifPlayer::EnsureTile(size_t tile)
+{
+    if (m_tiles[tile].Texture != nullptr)
+    {
+        return false;
+    }
+    m_tiles[tile] = CreateCanvasTile(tile);
+    return true;
+}
+
+void CompositionGifPlayer::ClearTile(size_t tile)
+{
+    // Must be called between BeginDraw and EndDraw
+    m_d2dContext->SetTarget(m_tiles[tile].Target.get());
+    m_d2dContext->Clear(CanvasClearColor);
+    m_dirtyTiles[tile] = true;
+}
+
+void CompositionGifPlayer::RestoreCanvas(std::vector<winrt::com_ptr<ID3D11Texture2D>> const* checkpoint)
+{
+    // Copy back the tiles that had content, and clear the ones that didn't.
+    // Starting from scratch is the same as restoring an all-clear checkpoint.
+    for (size_t i = 0; i < m_tiles.size(); i++)
+    {
+        if (checkpoint != nullptr && (*checkpoint)[i] != nullptr)
+        {
+            EnsureTile(i);
+            m_d3dContext->CopyResource(m_tiles[i].Texture.get(), (*checkpoint)[i].get());
+            m_dirtyTiles[i] = true;
+        }
+    }
+
+    m_tileScratch.clear();
+    for (size_t i = 0; i < m_tiles.size(); i++)
+    {
+        auto hasContent = checkpoint != nullptr && (*checkpoint)[i] != nullptr;
+        if (!hasContent && m_tiles[i].Texture != nullptr)
+        {
+            m_tileScratch.push_back(i);
+        }
+    }
+    if (m_tileScratch.empty())
+    {
+        return;
+    }
+
+    m_d2dContext->BeginDraw();
+    auto endDraw = wil::scope_exit([&]()
+        {
+            winrt::check_hresult(m_d2dContext->EndDraw());
+        });
+    for (auto tile : m_tileScratch)
+    {
+        ClearTile(tile);
+    }
+}
+
+void CompositionGifPlayer::PlaceFrame(size_t index)
+{
+    // Check new frames against everything we've seen so far. This only
+    // happens once per frame, while its decoded copy is still around.
+    if (!m_coverage[index].has_value() && !m_image->Frames()[index].Pixels.Empty())
+    {
+        AnalyzeFrame(index);
+    }
+    if (!m_dedup.IsKnown(index) && !m_image->Frames()[index].Pixels.Empty())
+    {
+        DeduplicateFrame(index);
+    }
+    if (m_image->HasSharedFrames() && m_image->Frames()[index].Pixels.Empty())
+    {
+        m_image->DiscardPixels(index);
+        m_residency.SetResidency(index, FrameResidency::Encoded);
+        return;
+    }
+    auto canonical = m_dedup.CanonicalOf(index);
+    if (canonical != index && !m_frames[canonical].empty())
+    {
+        m_residency.SetFrameBytes(index, 0);
+        m_frames[index] = m_frames[canonical];
+        m_image->DiscardPixels(index);
+        m_residency.SetResidency(index, FrameResidency::Gpu);
+        return;
+    }
+
+    auto residency = m_residency.Place(index);
+    if (residency == FrameResidency::Gpu)
+    {
+        m_frames[index] = UploadFrame(index);
+    }
+    // Once uploaded (or streamed) we no longer need the decoded copy
+    m_image->DiscardPixels(index);
+    m_residency.SetResidency(index, residency);
+}
+
+std::vector<FrameTile> CompositionGifPlayer::UploadFrame(size_t index)
+{
+    auto&& frame = m_image->Frames()[index];
+    auto contentRect = FrameContentRect(index);
+    if (contentRect.Width == 0 || contentRect.Height == 0)
+    {
+        return {};
+    }
+
+    // Both point at the top-left of the content rect
+    uint8_t const* bytes = nullptr;
+    uint32_t rowPitch = 0;
+    PooledBuffer scratch;
+    if (!frame.Pixels.Empty())
+    {
+        rowPitch = frame.RowPitch;
+        bytes = frame.Pixels.Data() + static_cast<size_t>(contentRect.Y - frame.Rect.Y) * rowPitch + static_cast<size_t>(contentRect.X - frame.Rect.X) * 4;
+    }
+    else
+    {
+        // The decoded copy is gone (e.g. we're waking up), go back to the
+        // encoded gif. Only the visible part needs to be written out.
+        rowPitch = static_cast<uint32_t>(contentRect.Width) * 4;
+        scratch = m_bufferPool->Acquire(static_cast<size_t>(rowPitch) * contentRect.Height);
+        m_image->DecodeFrame(index, { scratch.Data(), rowPitch, { contentRect.X - frame.Rect.X, contentRect.Y - frame.Rect.Y, contentRect.Width, contentRect.Height } });
+        bytes = scratch.Data();
+    }
+
+    // Split the visible part of the frame along tile boundaries so that
+    // each piece can be drawn into a single canvas tile.
+    m_tileScratch.clear();
+    m_tileGrid.TilesIntersecting(contentRect, m_tileScratch);
+    std::vector<FrameTile> result;
+    result.reserve(m_tileScratch.size());
+    for (auto tile : m_tileScratch)
+    {
+        auto piece = TileGrid::Intersect(contentRect, m_tileGrid.TileBounds(tile)).value();
+        auto pieceBytes = bytes + static_cast<size_t>(piece.Y - contentRect.Y) * rowPitch + static_cast<size_t>(piece.X - contentRect.X) * 4;
+        auto texture = UploadTextureRegion(pieceBytes, rowPitch, static_cast<uint32_t>(piece.Width), static_cast<uint32_t>(piece.Height));
+        auto bitmap = CreateBitmapFromTexture(texture, m_d2dContext);
+        result.push_back({ tile, piece, std::move(texture), std::move(bitmap) });
+    }
+    return result;
+}
+
+void CompositionGifPlayer::OnSeek(winrt::TimeSpan position)
+{
+    if (m_frames.empty() || m_hibernated)
+    {
+        return;
+    }
+
+    // The index knows the whole timeline even if not everything has been
+    // decoded yet, in which case we clamp to the last decoded frame.
+    auto&& index = m_image->Index();
+    auto positionMs = static_cast<uint64_t>(std::max(std::chrono::duration_cast<std::chrono::milliseconds>(position).count(), 0ll));
+    // Wrap around if playback would have looped by then
+    if (m_loopsRemaining != 0)
+    {
+        positionMs %= index.DurationMs();
+    }
+    auto frameIndex = std::min(index.FrameAt(positionMs), m_image->Frames().size() - 1);
+    auto frameEndMs = index.StartTimesMs[frameIndex + 1];
+    winrt::TimeSpan remaining = std::chrono::milliseconds(frameEndMs > positionMs ? frameEndMs - positionMs : 0);
+
+    // Frames are composited incrementally, so we have to replay everything
+    // up to the target.
+    ComposeTo(frameIndex);
+    m_frameStream.EndStall(std::chrono::steady_clock::now());
+    if (m_playing)
+    {
+        ArmFrameTimer(remaining);
+    }
+}
+
+winrt::TimeSpan CompositionGifPlayer::ComposeTo(size_t index)
+{
+    auto d3dLock = util::D3D11DeviceLock(m_d3dMultithread.get());
+
+    if (m_flipbook.IsComplete())
+    {
+        ShowPage(index);
+        m_currentIndex = index;
+        return m_image->Frames()[index].Delay;
+    }
+
+    // Start from the closest snapshot at or before the target, if we have
+    // one. Otherwise we start from a cleared canvas.
+    size_t nextFrame = 0;
+    auto slot = m_checkpointPlan.SlotAtOrBefore(index);
+    while (slot < m_checkpointPlan.Count && m_checkpoints[slot].empty())
+    {
+        slot = slot == 0 ? m_checkpointPlan.Count : slot - 1;
+    }
+    if (slot < m_checkpointPlan.Count)
+    {
+        nextFrame = m_checkpointPlan.FrameForSlot(slot) + 1;
+    }
+
+    // A frame after that which replaces the whole canvas is closer still,
+    // and copying it over every tile means nothing has to be restored.
+    auto replacement = index + 1;
+    for (auto i = index + 1; i > nextFrame; i--)
+    {
+        if (ReplacesCanvas(i - 1))
+        {
+            replacement = i - 1;
+            break;
+        }
+    }
+    if (replacement <= index)
+    {
+        nextFrame = replacement;
+    }
+    else if (slot < m_checkpointPlan.Count)
+    {
+        RestoreCanvas(&m_checkpoints[slot]);
+    }
+    else
+    {
+        RestoreCanvas(nullptr);
+    }
+
+    winrt::TimeSpan delay = m_image->Frames()[index].Delay;
+    while (nextFrame <= index)
+    {
+        // Draw up to the target, stopping early to snapshot any checkpoint
+        // or page we don't have yet.
+        auto lastFrame = nextFrame;
+        {
+            m_d2dContext->BeginDraw();
+            auto endDraw = wil::scope_exit([&]()
+                {
+                    winrt::check_hresult(m_d2dContext->EndDraw());
+                });
+
+            do
+            {
+                // Like forward playback, don't draw a frame over itself.
+                // Scaled frames have soft edges that would build up.
+                lastFrame = nextFrame++;
+                delay = m_dedup.IsHold(lastFrame) ? m_image->Frames()[lastFrame].Delay : DrawFrameToRenderTarget(lastFrame, m_d2dContext);
+            } while (nextFrame <= index && !NeedsCheckpoint(lastFrame) && !NeedsPage(lastFrame));
+        }
+        if (NeedsCheckpoint(lastFrame))
+        {
+            CaptureCheckpoint(lastFrame);
+        }
+        if (NeedsPage(lastFrame))
+        {
+            RecordPage(lastFrame);
+        }
+    }
+
+    UpdateSurface();
+    m_currentIndex = index;
+    return delay;
+}
+
+bool CompositionGifPlayer::ReplacesCanvas(size_t index) const
+{
+    // Holds aren't drawn at all
+    if (m_blendClasses[index] != FrameBlendClass::Opaque || m_dedup.IsHold(index))
+    {
+        return false;
+    }
+    auto contentRect = FrameContentRect(index);
+    return contentRect.X == 0 && contentRect.Y == 0 &&
+        static_cast<uint32_t>(contentRect.Width) == m_image->Width() && static_cast<uint32_t>(contentRect.Height) == m_image->Height();
+}
+
+bool CompositionGifPlayer::NeedsCheckpoint(size_t index) const
+{
+    return m_checkpointPlan.IsCheckpoint(index) && m_checkpoints[m_checkpointPlan.Slot(index)].empty();
+}
+
+void CompositionGifPlayer::CaptureCheckpoint(size_t index)
+{
+    auto& checkpoint = m_checkpoints[m_checkpointPlan.Slot(index)];
+    checkpoint.resize(m_tiles.size());
+    uint64_t checkpointBytes = 0;
+    for (size_t i = 0; i < m_tiles.size(); i++)
+    {
+        // Tiles that were never drawn to are still clear
+        auto&& tile = m_tiles[i];
+        if (tile.Texture == nullptr)
+        {
+            continue;
+        }
+        D3D11_TEXTURE2D_DESC desc = {};
+        tile.Texture->GetDesc(&desc);
+        checkpoint[i] = AcquireTexture(desc.Width, desc.Height, 0);
+        m_d3dContext->CopyResource(checkpoint[i].get(), tile.Texture.get());
+        checkpointBytes += static_cast<uint64_t>(desc.Width) * desc.Height * 4;
+    }
+    m_residency.SetFixedBytes(m_residency.Usage().FixedBytes + checkpointBytes);
+}
+
+void CompositionGifPlayer::RecordPage(size_t index)
+{
+    // Only the tiles the frame drew into can differ from the last page.
+    // Drawing a frame identical to the one before it changes nothing.
+    m_tileScratch.clear();
+    if (!m_dedup.IsHold(index))
+    {
+        m_tileGrid.TilesIntersecting(FrameContentRect(index), m_tileScratch);
+    }
+    m_flipbook.Record(index, m_tileScratch);
+    uint64_t pageBytes = 0;
+    for (auto tile : m_tileScratch)
+    {
+        auto bounds = m_tileGrid.TileBounds(tile);
+        auto image = AcquireTexture(static_cast<uint32_t>(bounds.Width), static_cast<uint32_t>(bounds.Height), 0);
+        m_d3dContext->CopyResource(image.get(), m_tiles[tile].Texture.get());
+        m_flipbookImages.push_back(std::move(image));
+        pageBytes += static_cast<uint64_t>(bounds.Width) * bounds.Height * 4;
+    }
+    WINRT_ASSERT(m_flipbookImages.size() == m_flipbook.ImageCount());
+    m_residency.SetFixedBytes(m_residency.Usage().FixedBytes + pageBytes);
+}
+
+void CompositionGifPlayer::ShowPage(size_t index)
+{
+    // The surface is showing the page for m_currentIndex
+    m_tileScratch.clear();
+    m_flipbook.Differences(m_currentIndex, index, m_tileScratch);
+    for (auto tile : m_tileScratch)
+    {
+        auto image = m_flipbook.Image(index, tile);
+        auto&& source = image == FlipbookStore::ClearImage ? m_flipbookClearTexture : m_flipbookImages[image];
+        CopyToSurfaceRegion(m_d3dContext, m_surface, m_tileGrid.TileBounds(tile), source, 0, 0);
+    }
+}
+
+void CompositionGifPlayer::ResetLoopCount()
+{
+    // A missing loop count means the gif plays once, zero means forever
+    auto loopCount = m_image->Index().LoopCount;
+    if (!m_loop || !loopCount.has_value())
+    {
+        m_loopsRemaining = 0;
+    }
+    else if (loopCount.value() == 0)
+    {
+        m_loopsRemaining = std::nullopt;
+    }
+    else
+    {
+        m_loopsRemaining = loopCount.value();
+    }
+}
+
+winrt::TimeSpan CompositionGifPlayer::FrameDelay(winrt::TimeSpan const& delay)
+{
+    if (delay.count() == 0)
+    {
+        return std::chrono::milliseconds(100);
+    }
+    return delay;
+}
+
+winrt::TimeSpan CompositionGifPlayer::ScaledInterval(winrt::TimeSpan const& delay) const
+{
+    // However fast we play, a frame never takes no time at all, or the
+    // clock would spin. Very slow speeds mustn't overflow either.
+    using Interval = std::chrono::duration<double, winrt::TimeSpan::period>;
+    auto interval = std::clamp(Interval(FrameDelay(delay)) / m_speed, Interval(std::chrono::milliseconds(1)), Interval(std::chrono::hours(24)));
+    return std::chrono::duration_cast<winrt::TimeSpan>(interval);
+}
+
+winrt::TimeSpan CompositionGifPlayer::DrawFrameToRenderTarget(size_t index, winrt::com_ptr<ID2D1DeviceContext> const& d2dContext)
+{
+    auto&& frame = m_image->Frames()[index];
+    auto&& frameTiles = m_frames[index];
+
+    if (!frameTiles.empty())
+    {
+        for (auto&& frameTile : frameTiles)
+        {
+            DrawFramePiece(index, frameTile.Tile, frameTile.Rect, frameTile.Bitmap.get(), d2dContext);
+        }
+        return frame.Delay;
+    }
+
+    // The frame didn't fit in our budget, decode it again and draw it
+    // through the streaming texture one tile at a time.
+    auto contentRect = FrameContentRect(index);
+    m_tileScratch.clear();
+    m_tileGrid.TilesIntersecting(contentRect, m_tileScratch);
+    if (m_tileScratch.empty())
+    {
+        return frame.Delay;
+    }
+    // Shared frames can be uploaded straight out of the mapping. Either
+    // way bytes points at the top-left of the content rect.
+    uint32_t rowPitch = 0;
+    PooledBuffer scratch;
+    auto bytes = m_image->SharedFrameBytes(index, rowPitch);
+    if (bytes != nullptr)
+    {
+        bytes += static_cast<size_t>(contentRect.Y - frame.Rect.Y) * rowPitch + static_cast<size_t>(contentRect.X - frame.Rect.X) * 4;
+    }
+    else
+    {
+        rowPitch = static_cast<uint32_t>(contentRect.Width) * 4;
+        scratch = m_bufferPool->Acquire(static_cast<size_t>(rowPitch) * contentRect.Height);
+        m_image->DecodeFrame(index, { scratch.Data(), rowPitch, { contentRect.X - frame.Rect.X, contentRect.Y - frame.Rect.Y, contentRect.Width, contentRect.Height } });
+        bytes = scratch.Data();
+    }
+
+    for (auto tile : m_tileScratch)
+    {
+        auto piece = TileGrid::Intersect(contentRect, m_tileGrid.TileBounds(tile)).value();
+        auto pieceBytes = bytes + static_cast<size_t>(piece.Y - contentRect.Y) * rowPitch + static_cast<size_t>(piece.X - contentRect.X) * 4;
+
+        // A previous draw may still be reading from the streaming texture
+        winrt::check_hresult(d2dContext->Flush());
+        D3D11_BOX region = {};
+        region.right = static_cast<uint32_t>(piece.Width);
+        region.bottom = static_cast<uint32_t>(piece.Height);
+        region.back = 1;
+        m_d3dContext->UpdateSubresource(m_streamingTexture.get(), 0, &region, pieceBytes, rowPitch, 0);
+        DrawFramePiece(index, tile, piece, m_streamingBitmap.get(), d2dContext);
+    }
+    return frame.Delay;
+}
+
+void CompositionGifPlayer::DrawFramePiece(size_t index, size_t tile, TileRect const& pieceRect, ID2D1Bitmap* bitmap, winrt::com_ptr<ID2D1DeviceContext> const& d2dContext)
+{
+    if (EnsureTile(tile))
+    {
+        ClearTile(tile);
+    }
+    auto bounds = m_tileGrid.TileBounds(tile);
+    d2dContext->SetTarget(m_tiles[tile].Target.get());
+    m_dirtyTiles[tile] = true;
+
+    // Frames without partly transparent pixels are copied rather than
+    // blended. Keyed frames can only be copied span by span, where the
+    // coverage rects leave out every transparent pixel.
+    auto&& coverage = m_coverage[index];
+    auto blendClass = m_blendClasses[index];
+    auto hasRects = coverage.has_value() && !coverage->Rects.empty();
+    auto copy = blendClass == FrameBlendClass::Opaque || (blendClass == FrameBlendClass::Keyed && hasRects);
+    auto compositeMode = copy ? D2D1_COMPOSITE_MODE_SOURCE_COPY : D2D1_COMPOSITE_MODE_SOURCE_OVER;
+
+    auto drawRect = [&](TileRect const& rect)
+    {
+        D2D1_POINT_2F offset = { static_cast<float>(rect.X - bounds.X), static_cast<float>(rect.Y - bounds.Y) };
+        D2D1_RECT_F sourceRect =
+        {
+            static_cast<float>(rect.X - pieceRect.X),
+            static_cast<float>(rect.Y - pieceRect.Y),
+            static_cast<float>(rect.Right() - pieceRect.X),
+            static_cast<float>(rect.Bottom() - pieceRect.Y),
+        };
+        d2dContext->DrawImage(bitmap, offset, sourceRect, D2D1_INTERPOLATION_MODE_LINEAR, compositeMode);
+    };
+
+    // Mostly transparent frames only draw their opaque spans
+    if (!hasRects)
+    {
+        drawRect(pieceRect);
+        return;
+    }
+    auto&& frame = m_image->Frames()[index];
+    for (auto&& rect : coverage->Rects)
+    {
+        TileRect canvasRect = { frame.Rect.X + rect.X, frame.Rect.Y + rect.Y, rect.Width, rect.Height };
+        if (auto clipped = TileGrid::Intersect(canvasRect, pieceRect))
+        {
+            drawRect(clipped.value());
+        }
+    }
+}
+
+void CompositionGifPlayer::OnSignal(SuspendReason reason, bool active)
+{
+    m_suspension.Signal(reason, active, std::chrono::steady_clock::now());
+    ScheduleWake();
+}
+
+void CompositionGifPlayer::OnTick()
+{
+    auto d3dLock = util::D3D11DeviceLock(m_d3dMultithread.get());
+    auto now = std::chrono::steady_clock::now();
+    auto actions = m_suspension.Poll(now);
+    // The clock ticks everything due around the same time together, so we
+    // may be a little early. Time the next frame from the deadline.
+    m_tickTime = now + actions.Early;
+    auto endTick = wil::scope_exit([&]()
+        {
+            m_tickTime.reset();
+        });
+    if (actions.AdvanceFrame && m_playing)
+    {
+        if (actions.Resume)
+        {
+            CatchUp(actions.Lag);
+        }
+        else
+        {
+            AdvanceFrame();
+        }
+    }
+    if (actions.Suspend || actions.Resume)
+    {
+        PublishSnapshot();
+    }
+    ScheduleWake();
+}
+
+void CompositionGifPlayer::ArmFrameTimer(winrt::TimeSpan const& delay)
+{
+    m_suspension.ArmFrame(m_tickTime.value_or(std::chrono::steady_clock::now()) + ScaledInterval(delay));
+    ScheduleWake();
+}
+
+void CompositionGifPlayer::DisarmFrameTimer()
+{
+    m_suspension.DisarmFrame();
+    ScheduleWake();
+}
+
+void CompositionGifPlayer::ScheduleWake()
+{
+    if (auto wake = m_suspension.NextWake())
+    {
+        m_playbackClock->Schedule(m_clockClient, wake.value());
+    }
+    else
+    {
+        m_playbackClock->Cancel(m_clockClient);
+    }
+}
+
+void CompositionGifPlayer::CatchUp(std::chrono::microseconds lag)
+{
+    // Only forward playback has a timeline to keep up with
+    auto&& index = m_image->Index();
+    auto nextIndex = m_currentIndex + 1;
+    if (m_cursor.Mode() != PlaybackMode::Forward || nextIndex >= index.FrameCount())
+    {
+        AdvanceFrame();
+        return;
+    }
+    // Still within the next frame, so nothing gets skipped
+    auto lagMs = static_cast<uint64_t>(std::chrono::duration_cast<std::chrono::milliseconds>(lag).count() * m_speed);
+    auto positionMs = index.StartTimesMs[nextIndex] + lagMs;
+    if (positionMs < index.StartTimesMs[nextIndex + 1])
+    {
+        AdvanceFrame();
+        return;
+    }
+    OnSeek(std::chrono::milliseconds(positionMs));
+}
+
+void CompositionGifPlayer::AdvanceFrame()
+{
+    // This is only ever called on the owning thread, so no locks or
+    // interface queries are needed here.
+    size_t nextIndex = 0;
+    bool wrapped = false;
+    if (m_cursor.Mode() == PlaybackMode::Forward || !m_frameStream.IsComplete())
+    {
+        // Until everything is decoded we can only go forward
+        if (!m_frameStream.TryGetNext(m_currentIndex, nextIndex))
+        {
+            // We've caught up with the decoder, OnAppendFrame will pick
+            // things back up once the next frame arrives.
+            m_frameStream.BeginStall(std::chrono::steady_clock::now());
+            return;
+        }
+        wrapped = nextIndex == 0;
+    }
+    else
+    {
+        nextIndex = m_cursor.Next(m_currentIndex, wrapped);
+    }
+
+    if (wrapped && m_loopsRemaining.has_value())
+    {
+        if (m_loopsRemaining.value() == 0)
+        {
+            m_playing = false;
+            return;
+        }
+        m_loopsRemaining = m_loopsRemaining.value() - 1;
+    }
+
+    winrt::TimeSpan delay = {};
+    if (nextIndex == m_currentIndex + 1 && !m_flipbook.IsComplete())
+    {
+        // The common case, draw on top of what's already there
+        {
+            m_d2dContext->BeginDraw();
+            auto endDraw = wil::scope_exit([&]()
+                {
+                    winrt::check_hresult(m_d2dContext->EndDraw());
+                });
+
+            delay = DrawFrameToRenderTarget(nextIndex, m_d2dContext);
+        }
+        // Forward playback only seeks to catch up, and that captures the
+        // checkpoints it passes. Capturing them here would keep snapshots
+        // of a gif that's never seeked.
+        if (m_cursor.Mode() != PlaybackMode::Forward && NeedsCheckpoint(nextIndex))
+        {
+            CaptureCheckpoint(nextIndex);
+        }
+        if (NeedsPage(nextIndex))
+        {
+            RecordPage(nextIndex);
+        }
+        UpdateSurface();
+        m_currentIndex = nextIndex;
+    }
+    else
+    {
+        // Wrapping around, going backwards or flipping to a page
+        delay = ComposeTo(nextIndex);
+    }
+
+    // Identical frames in a row don't need to be drawn again, the one we
+    // just drew is simply shown for longer
+    if (m_cursor.Mode() == PlaybackMode::Forward)
+    {
+        delay = FrameDelay(delay);
+        size_t holdIndex = 0;
+        while (m_frameStream.TryGetNext(m_currentIndex, holdIndex) && holdIndex != 0 && m_dedup.IsHold(holdIndex))
+        {
+            if (NeedsPage(holdIndex))
+            {
+                RecordPage(holdIndex);
+            }
+            delay += FrameDelay(m_image->Frames()[holdIndex].Delay);
+            m_currentIndex = holdIndex;
+        }
+    }
+
+    ArmFrameTimer(delay);
+}
+
+void CompositionGifPlayer::UpdateSurface()
+{
+    // Only push the tiles that changed
+    for (size_t i = 0; i < m_tiles.size(); i++)
+    {
+        if (m_dirtyTiles[i])
+        {
+            CopyToSurfaceRegion(m_d3dContext, m_surface, m_tileGrid.TileBounds(i), m_tiles[i].Texture, 0, 0);
+            m_dirtyTiles[i] = false;
+        }
+    }
 }
@@ -1,28 +1,242 @@
 #pragma once
+#include "FrameResidencyManager.h"
+#include "MpscQueue.h"
+#include "SnapshotCell.h"
+#include "FrameStream.h"
+#include "GifIndex.h"
+#include "GifFrameDecoder.h"
+#include "CheckpointPlan.h"
+#include "PlaybackCursor.h"
+#include "TileGrid.h"
+#include "BufferPool.h"
+#include "ResourcePool.h"
+#include "FrameDeduplicator.h"
+#include "FrameCoverage.h"
+#include "FrameBlend.h"
+#include "PlaybackSuspension.h"
+#include "SharedFrameStore.h"
+#include "Flipbook.h"
+#include "ImageResampler.h"
+#include "SharedPlaybackClock.h"
 
+// Frames are stored at the size they're drawn at, which is only the gif's
+// own size if it isn't scaled
 struct SoftwareGifFrame
 {
-    winrt::Windows::Graphics::Imaging::SoftwareBitmap Bitmap{ nullptr };
+    // Premultiplied BGRA8, empty once uploaded or if the pixels come from
+    // the shared frames
+    PooledBuffer Pixels;
+    uint32_t RowPitch = 0;
     winrt::Windows::Foundation::TimeSpan Delay{};
     winrt::Windows::Graphics::RectInt32 Rect{};
 };
 
+// The encoded gif and its index. Shared so that frames can keep being
+// decoded in the background after the image has been handed off.
+struct GifSource
+{
+    PooledBuffer Encoded;
+    GifIndex Index;
+};
+
 struct GifImage
 {
-    static std::future<std::unique_ptr<GifImage>> LoadAsync(winrt::Windows::Storage::Streams::IRandomAccessStream const& gifStream);
+    // Decodes every frame before returning
+    static std::future<std::unique_ptr<GifImage>> LoadAsync(winrt::Windows::Storage::Streams::IRandomAccessStream const& gifStream, BufferPool& bufferPool, ImageScale const& scale);
+    // Only reads the header, frames are added with AppendFrame as they're
+    // decoded with DecodeSoftwareFrame. The encoded gif is kept in a buffer
+    // from the pool, which must outlive the image.
+    static std::future<std::unique_ptr<GifImage>> OpenAsync(winrt::Windows::Storage::Streams::IRandomAccessStream const& gifStream, BufferPool& bufferPool, ImageScale const& scale);
+    // Like OpenAsync but reuses an encoded gif that's already been read,
+    // e.g. to draw it at another size
+    static std::unique_ptr<GifImage> Open(std::shared_ptr<GifSource const> source, ImageScale const& scale);
+    // Decodes as much as the player needs before it can start playing: only
+    // the first frame in progressive mode, nothing if another process has
+    // already shared its frames, otherwise everything
+    static std::future<std::unique_ptr<GifImage>> PrepareAsync(winrt::Windows::Storage::Streams::IRandomAccessStream const& gifStream, BufferPool& bufferPool, bool progressive, bool shareFrames, ImageScale const& scale);
+    // Decodes straight into a buffer from the pool, scaling if the
+    // resampler isn't the identity
+    static SoftwareGifFrame DecodeSoftwareFrame(GifFrameDecoder& decoder, BufferPool& bufferPool, uint32_t index, FrameResampler const& resampler);
 
     GifImage() {}
 
-    uint32_t Width() const noexcept { return m_width; }
-    uint32_t Height() const noexcept { return m_height; }
+    // The size frames are drawn at
+    uint32_t Width() const noexcept { return m_resampler.ScaledWidth(); }
+    uint32_t Height() const noexcept { return m_resampler.ScaledHeight(); }
+    ImageScale const& Scale() const noexcept { return m_scale; }
+    FrameResampler const& Resampler() const noexcept { return m_resampler; }
+    // Where a frame lands on the (scaled) canvas, worked out from the index
+    // so it's known before the frame is decoded
+    TileRect FrameRect(size_t index) const;
+    uint32_t FrameCount() const noexcept { return m_frameCount; }
+    bool IsComplete() const noexcept { return m_frames.size() == m_frameCount; }
+    std::shared_ptr<GifSource const> Source() const noexcept { return m_source; }
+    // Only for use by whoever owns the image
+    GifFrameDecoder& Decoder() noexcept { return *m_decoder; }
+    // Built from the encoded bytes, covers every frame even before it's decoded
+    GifIndex const& Index() const noexcept { return m_source->Index; }
+    // The frames decoded so far
     std::vector<SoftwareGifFrame> const& Frames() const noexcept { return m_frames; }
+    PooledBuffer const& EncodedBytes() const noexcept { return m_source->Encoded; }
+
+    // The part of PrepareAsync that runs once the gif is open
+    void DecodeInitialFrames(BufferPool& bufferPool, bool progressive, bool shareFrames);
+    void AppendFrame(SoftwareGifFrame&& frame);
+    // Drops the decoded pixels for a frame, DecodeFrame can bring them back
+    void DiscardPixels(size_t index) { m_frames[index].Pixels.Reset(); }
+    // Synchronously decodes (part of) a frame from the encoded gif as
+    // premultiplied BGRA8 into the caller's memory, or copies it out of the
+    // shared frames if they're ready
+    void DecodeFrame(size_t index, FrameDestination const& destination);
+    void DecodeFrame(size_t index, uint8_t* destination, uint32_t rowPitch);
+
+    // If we're the publisher, frames are copied into the store as they're
+    // appended and it's published once the last one is in. Shared frames
+    // are always the gif's own size, so scaled images can't use them.
+    void AttachSharedFrames(std::shared_ptr<SharedFrameStore> const& sharedFrames) { m_sharedFrames = sharedFrames; }
+    bool HasSharedFrames() const noexcept { return m_sharedFrames != nullptr && m_sharedFrames->IsReady(); }
+    SharedFrameStats SharedFramesStats() const noexcept { return m_sharedFrames != nullptr ? m_sharedFrames->Stats() : SharedFrameStats{}; }
+    // Null unless the shared frames are ready
+    uint8_t const* SharedFrameBytes(size_t index, uint32_t& rowPitch) const noexcept;
+    // Fills in every frame from the index without decoding anything, the
+    // pixels come from the shared frames when drawn
+    void AppendSharedFrames();
 
 private:
-    uint32_t m_width = 0;
-    uint32_t m_height = 0;
+    uint32_t m_frameCount = 0;
     std::vector<SoftwareGifFrame> m_frames;
+    std::shared_ptr<GifSource const> m_source;
+    // Borrows from m_source
+    std::unique_ptr<GifFrameDecoder> m_decoder;
+    std::shared_ptr<SharedFrameStore> m_sharedFrames;
+    ImageScale m_scale;
+    FrameResampler m_resampler;
+    // Whole frames at the gif's own size, for DecodeFrame to scale from
+    std::vector<uint8_t> m_unscaledScratch;
+};
+
+// One tile of the composited canvas. Tiles are only allocated once a frame
+// draws into them, until then they're the clear color.
+struct CanvasTile
+{
+    winrt::com_ptr<ID3D11Texture2D> Texture;
+    winrt::com_ptr<ID2D1Bitmap1> Target;
+};
+
+// The part of a frame that falls within a single canvas tile
+struct FrameTile
+{
+    size_t Tile = 0;
+    // In canvas coordinates
+    TileRect Rect;
+    winrt::com_ptr<ID3D11Texture2D> Texture;
+    winrt::com_ptr<ID2D1Bitmap> Bitmap;
+};
+
+// Textures are pooled by exact size and usage
+struct TextureKey
+{
+    uint32_t Width = 0;
+    uint32_t Height = 0;
+    uint32_t BindFlags = 0;
+
+    bool operator==(TextureKey const& other) const noexcept { return Width == other.Width && Height == other.Height && BindFlags == other.BindFlags; }
+};
+
+struct TextureKeyHash
+{
+    size_t operator()(TextureKey const& key) const noexcept
+    {
+        return std::hash<uint64_t>()((static_cast<uint64_t>(key.Width) << 32) ^ (static_cast<uint64_t>(key.Height) << 8) ^ key.BindFlags);
+    }
 };
 
+struct GifPlayerPoolStats
+{
+    ResourcePoolStats Buffers;
+    ResourcePoolStats Textures;
+};
+
+// What the player looks like from the outside, published by the owning
+// thread whenever it changes
+struct GifPlayerSnapshot
+{
+    winrt::Windows::Graphics::SizeInt32 Size{};
+    FrameMemoryUsage MemoryUsage;
+    GifPlayerPoolStats Pools;
+    FrameDedupStats Dedup;
+    FrameCoverageStats Coverage;
+    FrameBlendStats Blend;
+    SuspensionStats Suspension;
+    SharedFrameStats SharedFrames;
+    FlipbookPageStats Flipbook;
+};
+
+enum class GifPlayerCommandType
+{
+    Play,
+    Stop,
+    Load,
+    Seek,
+    SetSpeed,
+    SetPlaybackMode,
+    Hibernate,
+    Wake,
+    AppendFrame,
+    Signal,
+};
+
+struct GifPlayerCommand
+{
+    GifPlayerCommandType Type = GifPlayerCommandType::Play;
+    std::unique_ptr<GifImage> Image;
+    winrt::Windows::Foundation::TimeSpan Position{};
+    float Speed = 1.0f;
+    PlaybackMode Mode = PlaybackMode::Forward;
+    SoftwareGifFrame Frame;
+    uint32_t Generation = 0;
+    std::chrono::steady_clock::time_point Start = {};
+    SuspendReason Reason = SuspendReason::Occluded;
+    bool Active = false;
+};
+
+struct PlayerOptions
+{
+    bool Loop = true;
+    // Start playing once the first frame is decoded
+    bool Progressive = false;
+    // Zero means everything stays resident
+    uint64_t MaxMemoryBytes = 0;
+    bool ShareFrames = false;
+    bool Flipbook = false;
+    ImageScale Scale = {};
+};
+
+// Threading contract:
+//   The player is created on the compositor's thread, which must have a
+//   DispatcherQueue. It is owned by the render queue it was given (or the
+//   creating thread if there isn't one). All playback state (the image,
+//   frames, D2D context and timer) is only touched on the owning thread.
+//   The only things that go back to the compositor's thread are changes to
+//   the root visual; drawing to the surface happens on the owning thread.
+//   Players on the same queue can share a playback clock so that they're
+//   woken up together. One is created if none is given.
+//
+//   Play, Stop, Seek, SetSpeed, SetPlaybackMode, Hibernate, Wake, Signal,
+//   SyncAsync, LoadGifAsync and SetScaleAsync may be called from any
+//   thread. They push a command onto a lock-free queue that the owning
+//   thread drains in order. Calls made on the owning thread are applied
+//   before they return. LoadGifAsync and SetScaleAsync decode on the thread
+//   pool and complete back on the calling thread's context once the gif is
+//   applied. In progressive mode they complete as soon as the first frame
+//   is up, and the remaining frames are decoded on the thread pool and
+//   handed to the owning thread one at a time.
+//
+//   Root, Size and the stats accessors may be called from any thread. The
+//   stats come from a snapshot the owning thread publishes after applying
+//   commands, so they can lag behind calls that haven't been applied yet.
+//   Await SyncAsync first to be sure they haven't. The load completed
+//   callback runs on the owning thread.
 struct CompositionGifPlayer
 {
     CompositionGifPlayer(
@@ -30,37 +244,195 @@ struct CompositionGifPlayer
         winrt::Windows::UI::Composition::CompositionGraphicsDevice const& compGraphics,
         winrt::com_ptr<ID2D1Device> const& d2dDevice,
         winrt::com_ptr<ID3D11Device> const& d3dDevice,
-        bool loop);
+        PlayerOptions const& options,
+        winrt::Windows::System::DispatcherQueue const& renderQueue = nullptr,
+        std::shared_ptr<BufferPool> const& bufferPool = nullptr,
+        std::shared_ptr<SharedPlaybackClock> const& playbackClock = nullptr);
+    ~CompositionGifPlayer();
+
+    // A pool sized the way the player would size its own, for callers that
+    // want to prepare a gif before the player exists
+    static std::shared_ptr<BufferPool> CreateBufferPool();
 
     winrt::Windows::UI::Composition::Visual Root() const noexcept { return m_visual; }
-    winrt::Windows::Graphics::SizeInt32 Size() const noexcept { return { static_cast<int32_t>(m_image->Width()), static_cast<int32_t>(m_image->Height()) }; }
+    winrt::Windows::Graphics::SizeInt32 Size() const { return m_snapshot.Read().Size; }
+    FrameMemoryUsage MemoryUsage() const { return m_snapshot.Read().MemoryUsage; }
+    GifPlayerPoolStats PoolStats() const { return m_snapshot.Read().Pools; }
+    FrameDedupStats DedupStats() const { return m_snapshot.Read().Dedup; }
+    FrameCoverageStats CoverageStats() const { return m_snapshot.Read().Coverage; }
+    FrameBlendStats BlendStats() const { return m_snapshot.Read().Blend; }
+    SuspensionStats SuspendStats() const { return m_snapshot.Read().Suspension; }
+    SharedFrameStats SharedFramesStats() const { return m_snapshot.Read().SharedFrames; }
+    FlipbookPageStats FlipbookStats() const { return m_snapshot.Read().Flipbook; }
+    // Covers every player sharing the clock
+    PlaybackClockStats ClockStats() const { return m_playbackClock->Stats(); }
 
     void Play();
     void Stop();
+    void Seek(winrt::Windows::Foundation::TimeSpan const& position);
+    void SetSpeed(float speed);
+    // Reverse and ping-pong playback kick in once every frame is decoded
+    void SetPlaybackMode(PlaybackMode mode);
+    // Releases everything but the encoded gif. Playing again wakes the
+    // player up if Wake wasn't called first.
+    void Hibernate();
+    void Wake();
+    // Playback pauses while any reason is active and picks up where the
+    // timeline would be once they've all cleared
+    void Signal(SuspendReason reason, bool active);
+    // Completes on the calling thread's context once everything posted
+    // before it has been applied
+    winrt::Windows::Foundation::IAsyncAction SyncAsync();
     winrt::Windows::Foundation::IAsyncAction LoadGifAsync(winrt::Windows::Storage::Streams::IRandomAccessStream const& gifStream);
+    // Plays a gif that was already prepared with GifImage::PrepareAsync,
+    // using the same buffer pool as the player. Load times are measured
+    // from start.
+    winrt::Windows::Foundation::IAsyncAction LoadGifAsync(std::unique_ptr<GifImage> image, std::chrono::steady_clock::time_point start);
+    // Decodes the current gif again at another size and swaps it in once
+    // it's ready to play. Gifs loaded later use the new scale too.
+    winrt::Windows::Foundation::IAsyncAction SetScaleAsync(ImageScale scale);
+    // Called on the owning thread once every frame of a gif is available
+    void OnLoadCompleted(std::function<void(FrameStreamStats const&)> const& callback);
 
 private:
+    winrt::Windows::Foundation::IAsyncAction ApplyGifAsync(std::unique_ptr<GifImage> image, uint32_t generation, std::chrono::steady_clock::time_point start);
+    winrt::fire_and_forget DecodeRemainingFrames(std::shared_ptr<GifSource const> source, FrameResampler resampler, uint32_t generation, uint32_t firstFrame, uint32_t frameCount);
+    void Post(GifPlayerCommand&& command);
+    void DrainCommands();
+    void PublishSnapshot();
+    void OnPlay();
+    void OnStop();
+    void OnLoad(std::unique_ptr<GifImage>&& image, uint32_t generation, std::chrono::steady_clock::time_point start);
+    void OnAppendFrame(SoftwareGifFrame&& frame, uint32_t generation);
+    void OnSeek(winrt::Windows::Foundation::TimeSpan position);
+    void OnHibernate();
+    void OnWake();
+    void OnSignal(SuspendReason reason, bool active);
+
+    void CreateFrameResources();
+    void ResizeSurface();
+    void PlaceFrame(size_t index);
+    void DeduplicateFrame(size_t index);
+    void AnalyzeFrame(size_t index);
+    // The part of the frame with visible pixels, in canvas coordinates
+    TileRect FrameContentRect(size_t index) const;
+    std::vector<FrameTile> UploadFrame(size_t index);
+    CanvasTile CreateCanvasTile(size_t tile);
+    // A full-size tile filled with the clear color
+    winrt::com_ptr<ID3D11Texture2D> CreateClearTexture();
+    // Textures come from (and go back to) m_texturePool
+    winrt::com_ptr<ID3D11Texture2D> AcquireTexture(uint32_t width, uint32_t height, uint32_t bindFlags);
+    winrt::com_ptr<ID3D11Texture2D> UploadTextureRegion(uint8_t const* bytes, uint32_t rowPitch, uint32_t width, uint32_t height);
+    void RecycleTexture(winrt::com_ptr<ID3D11Texture2D>&& texture);
+    void RecycleFrameResources();
+    // Returns true if the tile had to be allocated
+    bool EnsureTile(size_t tile);
+    void ClearTile(size_t tile);
+    void RestoreCanvas(std::vector<winrt::com_ptr<ID3D11Texture2D>> const* checkpoint);
+
+    // Restores the nearest checkpoint and draws the frames after it, or
+    // starts from the last frame that replaces the whole canvas if that's
+    // closer
+    winrt::Windows::Foundation::TimeSpan ComposeTo(size_t index);
+    // An opaque frame covering the whole canvas hides everything before it
+    bool ReplacesCanvas(size_t index) const;
+    bool NeedsCheckpoint(size_t index) const;
+    void CaptureCheckpoint(size_t index);
+    bool NeedsPage(size_t index) const noexcept { return m_flipbook.CanRecord(index); }
+    // Must be called right after the frame was drawn on top of the one
+    // before it (or a clear canvas for frame 0)
+    void RecordPage(size_t index);
+    // Copies the tiles that differ from the page that's currently shown
+    void ShowPage(size_t index);
+    void ResetLoopCount();
+    static winrt::Windows::Foundation::TimeSpan FrameDelay(winrt::Windows::Foundation::TimeSpan const& delay);
+    winrt::Windows::Foundation::TimeSpan ScaledInterval(winrt::Windows::Foundation::TimeSpan const& delay) const;
     winrt::Windows::Foundation::TimeSpan DrawFrameToRenderTarget(size_t index, winrt::com_ptr<ID2D1DeviceContext> const& d2dContext);
+    // Draws the part of a frame that falls within one canvas tile. The
+    // bitmap's top-left corner lands on the top-left of pieceRect.
+    void DrawFramePiece(size_t index, size_t tile, TileRect const& pieceRect, ID2D1Bitmap* bitmap, winrt::com_ptr<ID2D1DeviceContext> const& d2dContext);
 
-    void OnTick(winrt::Windows::System::DispatcherQueueTimer const& timer, winrt::Windows::Foundation::IInspectable const& args);
+    void OnTick();
+    // All wakeups go through m_suspension, which decides when the playback
+    // clock ticks us
+    void ArmFrameTimer(winrt::Windows::Foundation::TimeSpan const& delay);
+    void DisarmFrameTimer();
+    void ScheduleWake();
+    // Skips ahead to where playback would be if we hadn't been suspended
+    void CatchUp(std::chrono::microseconds lag);
+    void AdvanceFrame();
     void UpdateSurface();
 
 private:
-    wil::critical_section m_lock = {};
+    winrt::Windows::System::DispatcherQueue m_dispatcherQueue{ nullptr };
+    winrt::Windows::System::DispatcherQueue m_compositionQueue{ nullptr };
+    MpscQueue<GifPlayerCommand> m_commands;
+    SnapshotCell<GifPlayerSnapshot> m_snapshot;
+    // What gifs are decoded at from here on
+    SnapshotCell<ImageScale> m_scale;
+    std::atomic<bool> m_drainScheduled = false;
+    std::atomic<uint32_t> m_loadGeneration = 0;
+    uint32_t m_generation = 0;
+    // Declared before anything that borrows from them
+    std::shared_ptr<BufferPool> m_bufferPool;
+    ResourcePool<TextureKey, winrt::com_ptr<ID3D11Texture2D>, TextureKeyHash> m_texturePool;
+    FrameStream m_frameStream;
+    std::function<void(FrameStreamStats const&)> m_loadCompleted;
     winrt::com_ptr<ID2D1Device> m_d2dDevice;
     winrt::com_ptr<ID2D1DeviceContext> m_d2dContext;
-    winrt::com_ptr<ID2D1Bitmap1> m_d2dRenderTarget;
-    winrt::com_ptr<ID3D11Texture2D> m_renderTargetTexture;
+    TileGrid m_tileGrid;
+    std::vector<CanvasTile> m_tiles;
+    // Tiles that have changed since the surface was last updated
+    std::vector<bool> m_dirtyTiles;
+    std::vector<size_t> m_tileScratch;
     winrt::com_ptr<ID3D11Device> m_d3dDevice;
     winrt::com_ptr<ID3D11DeviceContext> m_d3dContext;
+    winrt::com_ptr<ID3D11Multithread> m_d3dMultithread;
     winrt::Windows::UI::Composition::CompositionGraphicsDevice m_compGraphics{ nullptr };
     std::unique_ptr<GifImage> m_image;
-    std::vector<winrt::com_ptr<ID2D1Bitmap>> m_frames;
+    // Frames that aren't resident on the GPU have no tiles and get streamed
+    // through m_streamingTexture one tile at a time when drawn.
+    std::vector<std::vector<FrameTile>> m_frames;
+    FrameResidencyManager m_residency;
+    // Duplicate frames share the canonical frame's entry in m_frames
+    FrameDeduplicator m_dedup;
+    // Filled in the first time each frame is placed
+    std::vector<std::optional<FrameCoverage>> m_coverage;
+    FrameCoverageStats m_coverageStats;
+    // Decides how each frame is drawn. Blended until the frame is analyzed.
+    std::vector<FrameBlendClass> m_blendClasses;
+    FrameBlendStats m_blendStats;
+    winrt::com_ptr<ID3D11Texture2D> m_streamingTexture;
+    winrt::com_ptr<ID2D1Bitmap1> m_streamingBitmap;
+    CheckpointPlan m_checkpointPlan;
+    // One texture per canvas tile (null if the tile was clear), empty if
+    // the checkpoint hasn't been captured yet
+    std::vector<std::vector<winrt::com_ptr<ID3D11Texture2D>>> m_checkpoints;
+    // Once every page is recorded, playback only swaps pages in and the
+    // canvas is left alone
+    FlipbookPlan m_flipbookPlan;
+    FlipbookStore m_flipbook;
+    std::vector<winrt::com_ptr<ID3D11Texture2D>> m_flipbookImages;
+    winrt::com_ptr<ID3D11Texture2D> m_flipbookClearTexture;
     winrt::Windows::UI::Composition::SpriteVisual m_visual{ nullptr };
     winrt::Windows::UI::Composition::CompositionSurfaceBrush m_brush{ nullptr };
     winrt::Windows::UI::Composition::CompositionDrawingSurface m_surface{ nullptr };
-    winrt::Windows::System::DispatcherQueueTimer m_timer{ nullptr };
-    winrt::Windows::System::DispatcherQueueTimer::Tick_revoker m_tick;
+    // Shared with other players on the same queue, or our own
+    std::shared_ptr<SharedPlaybackClock> m_playbackClock;
+    SharedPlaybackClock::ClientId m_clockClient = 0;
+    // Set while a tick runs, the next frame is timed from here
+    std::optional<std::chrono::steady_clock::time_point> m_tickTime;
+    PlaybackSuspension m_suspension;
     size_t m_currentIndex = 0;
+    float m_speed = 1.0f;
+    PlaybackMode m_playbackMode = PlaybackMode::Forward;
+    PlaybackCursor m_cursor;
+    bool m_playing = false;
+    bool m_hibernated = false;
     bool m_loop = false;
+    // Loops left before playback stops, no value means forever
+    std::optional<uint32_t> m_loopsRemaining = 0;
+    bool m_progressive = false;
+    bool m_shareFrames = false;
+    bool m_flipbookMode = false;
 };
\ No newline at end of file
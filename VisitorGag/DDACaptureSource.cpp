@@ -1,11 +1,16 @@
 #include "pch.h"
 #include "DDACaptureSource.h"
+#include "TextureAccounting.h"
 
 namespace util
 {
     using namespace robmikh::common::uwp;
 }
 
+// How long a new duplication gets to hand over a frame. The desktop only
+// produces one when something on it changes, so we can't wait forever.
+static constexpr UINT FrameTimeoutMs = 500;
+
 std::unique_ptr<ICaptureSource> DDACaptureSourceFactory::CreateCaptureSource(winrt::com_ptr<ID3D11Device> const& d3dDevice)
 {
 	auto source = std::make_unique<DDACaptureSource>(d3dDevice);
@@ -15,6 +20,7 @@ std::unique_ptr<ICaptureSource> DDACaptureSourceFactory::CreateCaptureSource(win
 DDACaptureSource::DDACaptureSource(winrt::com_ptr<ID3D11Device> const& d3dDevice)
 {
 	m_d3dDevice = d3dDevice;
+    m_d3dDevice->GetImmediateContext(m_d3dContext.put());
     m_dxgiDevice = m_d3dDevice.as<IDXGIDevice>();
     winrt::com_ptr<IDXGIAdapter> dxgiAdapter;
     winrt::check_hresult(m_dxgiDevice->GetAdapter(dxgiAdapter.put()));
@@ -26,22 +32,139 @@ DDACaptureSource::DDACaptureSource(winrt::com_ptr<ID3D11Device> const& d3dDevice
 
 winrt::com_ptr<ID3D11Texture2D> DDACaptureSource::Capture()
 {
-    winrt::com_ptr<ID3D11Texture2D> captureTexture;
-    {
-        auto output6 = m_dxgiOutput.as<IDXGIOutput6>();
-        winrt::com_ptr<IDXGIOutputDuplication> duplication;
-        winrt::check_hresult(output6->DuplicateOutput(m_d3dDevice.get(), duplication.put()));
-        winrt::com_ptr<IDXGIResource> ddaResource;
-        DXGI_OUTDUPL_FRAME_INFO frameInfo = {};
-        winrt::check_hresult(duplication->AcquireNextFrame(INFINITE, &frameInfo, ddaResource.put()));
-        // Windows 10 build 19044 seems to have an issue where subsequent calls to DDA
-        // can get an empty frame. As a workaround, always get the second frame.
-        ddaResource = nullptr;
-        winrt::check_hresult(duplication->ReleaseFrame());
-        winrt::check_hresult(duplication->AcquireNextFrame(INFINITE, &frameInfo, ddaResource.put()));
-        auto ddaTexture = ddaResource.as<ID3D11Texture2D>();
-        captureTexture = util::CopyD3DTexture(m_d3dDevice, ddaTexture, false);
-        winrt::check_hresult(duplication->ReleaseFrame());
-    }
-    return captureTexture;
+    auto width = m_desktopCoordinates.right - m_desktopCoordinates.left;
+    auto height = m_desktopCoordinates.bottom - m_desktopCoordinates.top;
+    return CaptureRegion({ 0, 0, width, height });
+}
+
+winrt::com_ptr<ID3D11Texture2D> DDACaptureSource::CaptureRegion(RECT const& region)
+{
+    TileRect target = { region.left, region.top, region.right - region.left, region.bottom - region.top };
+    m_stats.Captures++;
+
+    winrt::com_ptr<IDXGIResource> ddaResource;
+    DXGI_OUTDUPL_FRAME_INFO frameInfo = {};
+    auto hr = DXGI_ERROR_ACCESS_LOST;
+    if (m_duplication != nullptr)
+    {
+        // The duplication has been collecting changes since the last call
+        hr = m_duplication->AcquireNextFrame(0, &frameInfo, ddaResource.put());
+        if (hr == DXGI_ERROR_WAIT_TIMEOUT)
+        {
+            if (m_changes.IsUnchanged(target))
+            {
+                m_stats.Reuses++;
+                return m_lastCapture;
+            }
+            // The region changed before a capture that didn't need it, and
+            // DDA won't hand those pixels out again
+            hr = DXGI_ERROR_ACCESS_LOST;
+        }
+    }
+    if (hr == DXGI_ERROR_ACCESS_LOST)
+    {
+        // Also covers mode changes and the like taking the duplication away
+        ddaResource = StartDuplication(frameInfo);
+        if (ddaResource == nullptr)
+        {
+            m_changes.Refresh();
+            return m_lastCapture;
+        }
+    }
+    else
+    {
+        winrt::check_hresult(hr);
+        // A zero present time means only the pointer changed
+        if (frameInfo.LastPresentTime.QuadPart != 0)
+        {
+            AddFrameChanges(frameInfo.TotalMetadataBufferSize);
+        }
+    }
+    auto releaseFrame = wil::scope_exit([&]()
+        {
+            m_duplication->ReleaseFrame();
+        });
+
+    if (m_changes.IsUnchanged(target))
+    {
+        m_stats.Reuses++;
+        return m_lastCapture;
+    }
+    // The desktop image is always complete, not just the dirty parts
+    m_d3dContext->CopyResource(m_lastCapture.get(), ddaResource.as<ID3D11Texture2D>().get());
+    m_changes.Refresh();
+    return m_lastCapture;
+}
+
+void DDACaptureSource::Trim()
+{
+    m_duplication = nullptr;
+    m_lastCapture = nullptr;
+    m_changes.Invalidate();
+}
+
+winrt::com_ptr<IDXGIResource> DDACaptureSource::StartDuplication(DXGI_OUTDUPL_FRAME_INFO& frameInfo)
+{
+    Trim();
+    // The desktop may have changed size if we lost the old duplication
+    DXGI_OUTPUT_DESC outputDesc = {};
+    winrt::check_hresult(m_dxgiOutput->GetDesc(&outputDesc));
+    m_desktopCoordinates = outputDesc.DesktopCoordinates;
+
+    auto output6 = m_dxgiOutput.as<IDXGIOutput6>();
+    winrt::check_hresult(output6->DuplicateOutput(m_d3dDevice.get(), m_duplication.put()));
+    winrt::com_ptr<IDXGIResource> ddaResource;
+    auto hr = m_duplication->AcquireNextFrame(FrameTimeoutMs, &frameInfo, ddaResource.put());
+    if (hr == DXGI_ERROR_WAIT_TIMEOUT)
+    {
+        m_duplication = nullptr;
+        throw winrt::hresult_error(hr, L"The desktop duplication never produced a frame");
+    }
+    winrt::check_hresult(hr);
+    // Windows 10 build 19044 seems to have an issue where subsequent calls to DDA
+    // can get an empty frame. As a workaround, always get the second frame. It
+    // only shows up once something on the desktop changes though, so keep the
+    // first one in case it never does.
+    m_lastCapture = util::CopyD3DTexture(m_d3dDevice, ddaResource.as<ID3D11Texture2D>(), false);
+    TrackTexture(m_lastCapture.get(), MemoryTag::Capture);
+    ddaResource = nullptr;
+    winrt::check_hresult(m_duplication->ReleaseFrame());
+    hr = m_duplication->AcquireNextFrame(FrameTimeoutMs, &frameInfo, ddaResource.put());
+    if (hr == DXGI_ERROR_WAIT_TIMEOUT)
+    {
+        return nullptr;
+    }
+    winrt::check_hresult(hr);
+    return ddaResource;
+}
+
+void DDACaptureSource::AddFrameChanges(uint32_t metadataSize)
+{
+    m_metadata.resize(metadataSize);
+    UINT moveBytes = 0;
+    UINT dirtyBytes = 0;
+    if (metadataSize == 0 ||
+        FAILED(m_duplication->GetFrameMoveRects(metadataSize, reinterpret_cast<DXGI_OUTDUPL_MOVE_RECT*>(m_metadata.data()), &moveBytes)) ||
+        FAILED(m_duplication->GetFrameDirtyRects(metadataSize - moveBytes, reinterpret_cast<RECT*>(m_metadata.data() + moveBytes), &dirtyBytes)))
+    {
+        // Something changed but we can't tell what
+        m_changes.Invalidate();
+        return;
+    }
+
+    auto addChange = [&](RECT const& rect)
+    {
+        m_changes.AddChange({ rect.left, rect.top, rect.right - rect.left, rect.bottom - rect.top });
+    };
+    // Only the destination of a move changes
+    auto moves = reinterpret_cast<DXGI_OUTDUPL_MOVE_RECT const*>(m_metadata.data());
+    for (size_t i = 0; i < moveBytes / sizeof(DXGI_OUTDUPL_MOVE_RECT); i++)
+    {
+        addChange(moves[i].DestinationRect);
+    }
+    auto dirtyRects = reinterpret_cast<RECT const*>(m_metadata.data() + moveBytes);
+    for (size_t i = 0; i < dirtyBytes / sizeof(RECT); i++)
+    {
+        addChange(dirtyRects[i]);
+    }
 }
@@ -1,6 +1,9 @@
 #pragma once
 #include "ICaptureSource.h"
+#include "DesktopChangeTracker.h"
 
+// Keeps its duplication open between captures so that the dirty and move
+// rects DDA reports tell us whether the last capture is still good.
 struct DDACaptureSource : public ICaptureSource
 {
 	DDACaptureSource(winrt::com_ptr<ID3D11Device> const& d3dDevice);
@@ -8,12 +11,27 @@ struct DDACaptureSource : public ICaptureSource
 
 	RECT DesktopCoordinates() override { return m_desktopCoordinates; };
 	winrt::com_ptr<ID3D11Texture2D> Capture() override;
+	winrt::com_ptr<ID3D11Texture2D> CaptureRegion(RECT const& region) override;
+	CaptureReuseStats ReuseStats() override { return m_stats; }
+	void Trim() override;
 	
+private:
+	// Returns the first good frame, which the caller has to release, or
+	// nullptr if m_lastCapture already holds the desktop
+	winrt::com_ptr<IDXGIResource> StartDuplication(DXGI_OUTDUPL_FRAME_INFO& frameInfo);
+	void AddFrameChanges(uint32_t metadataSize);
+
 private:
 	winrt::com_ptr<ID3D11Device> m_d3dDevice;
+	winrt::com_ptr<ID3D11DeviceContext> m_d3dContext;
 	winrt::com_ptr<IDXGIDevice> m_dxgiDevice;
 	winrt::com_ptr<IDXGIOutput> m_dxgiOutput;
 	RECT m_desktopCoordinates = {};
+	winrt::com_ptr<IDXGIOutputDuplication> m_duplication;
+	winrt::com_ptr<ID3D11Texture2D> m_lastCapture;
+	DesktopChangeTracker m_changes;
+	std::vector<uint8_t> m_metadata;
+	CaptureReuseStats m_stats = {};
 };
 
 struct DDACaptureSourceFactory : public ICaptureSourceFactory
@@ -0,0 +1,79 @@
+#include "DesktopChangeTracker.h"
+#include <algorithm>
+
+static bool Intersects(TileRect const& first, TileRect const& second) noexcept
+{
+    return first.X < second.Right() && second.X < first.Right() &&
+        first.Y < second.Bottom() && second.Y < first.Bottom();
+}
+
+static bool Contains(TileRect const& outer, TileRect const& inner) noexcept
+{
+    return outer.X <= inner.X && outer.Y <= inner.Y &&
+        inner.Right() <= outer.Right() && inner.Bottom() <= outer.Bottom();
+}
+
+void DesktopChangeTracker::Invalidate() noexcept
+{
+    m_valid = false;
+    m_changes.clear();
+}
+
+void DesktopChangeTracker::Refresh() noexcept
+{
+    m_valid = true;
+    m_changes.clear();
+}
+
+void DesktopChangeTracker::AddChange(TileRect const& rect)
+{
+    if (rect.Width <= 0 || rect.Height <= 0)
+    {
+        return;
+    }
+    m_totalChanges++;
+    if (!m_valid)
+    {
+        // Everything is stale already
+        return;
+    }
+    for (auto&& change : m_changes)
+    {
+        if (Contains(change, rect))
+        {
+            return;
+        }
+    }
+    m_changes.erase(std::remove_if(m_changes.begin(), m_changes.end(), [&rect](auto&& change) { return Contains(rect, change); }), m_changes.end());
+    m_changes.push_back(rect);
+    if (m_changes.size() > MaxChanges)
+    {
+        Collapse();
+    }
+}
+
+bool DesktopChangeTracker::IsUnchanged(TileRect const& region) const noexcept
+{
+    if (!m_valid)
+    {
+        return false;
+    }
+    return std::none_of(m_changes.begin(), m_changes.end(), [&region](auto&& change) { return Intersects(change, region); });
+}
+
+void DesktopChangeTracker::Collapse()
+{
+    auto left = m_changes.front().X;
+    auto top = m_changes.front().Y;
+    auto right = m_changes.front().Right();
+    auto bottom = m_changes.front().Bottom();
+    for (auto&& change : m_changes)
+    {
+        left = std::min(left, change.X);
+        top = std::min(top, change.Y);
+        right = std::max(right, change.Right());
+        bottom = std::max(bottom, change.Bottom());
+    }
+    m_changes.clear();
+    m_changes.push_back({ left, top, right - left, bottom - top });
+}
@@ -0,0 +1,40 @@
+#pragma once
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+#include "TileGrid.h"
+
+// Remembers which parts of the desktop have changed since the last time we
+// captured it, so that a capture whose region hasn't been touched can reuse
+// the pixels we're already holding on to. Changes are fed in from whatever
+// the capture API reports (e.g. DDA dirty and move rects) and are kept as
+// a short list of rects. Once the list gets too long it collapses into its
+// bounding box, which can only make us capture more often, never less.
+//
+// No Windows dependencies so that it can be built and tested on its own.
+struct DesktopChangeTracker
+{
+    static constexpr size_t MaxChanges = 32;
+
+    // Nothing is known about the desktop until the next Refresh
+    void Invalidate() noexcept;
+    // The pixels we hold match the desktop again
+    void Refresh() noexcept;
+    void AddChange(TileRect const& rect);
+
+    // True if the held pixels can be used for the region. Otherwise the
+    // caller is expected to capture again and then call Refresh.
+    bool IsUnchanged(TileRect const& region) const noexcept;
+    bool IsValid() const noexcept { return m_valid; }
+    std::vector<TileRect> const& Changes() const noexcept { return m_changes; }
+    // Changed rects reported since the tracker was created
+    uint64_t TotalChanges() const noexcept { return m_totalChanges; }
+
+private:
+    void Collapse();
+
+private:
+    bool m_valid = false;
+    std::vector<TileRect> m_changes;
+    uint64_t m_totalChanges = 0;
+};
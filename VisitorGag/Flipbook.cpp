@@ -0,0 +1,81 @@
+#include "Flipbook.h"
+#include <algorithm>
+#include <stdexcept>
+
+FlipbookPlan FlipbookPlan::Compute(TileGrid const& grid, std::vector<TileRect> const& frameRects, uint64_t budgetBytes)
+{
+    FlipbookPlan plan;
+    // A single frame never needs to be swapped out
+    if (frameRects.size() <= 1)
+    {
+        return plan;
+    }
+    if (budgetBytes == 0)
+    {
+        budgetBytes = DefaultBudgetBytes;
+    }
+
+    std::vector<size_t> tiles;
+    for (auto&& rect : frameRects)
+    {
+        tiles.clear();
+        grid.TilesIntersecting(rect, tiles);
+        for (auto tile : tiles)
+        {
+            auto bounds = grid.TileBounds(tile);
+            plan.Bytes += static_cast<uint64_t>(bounds.Width) * bounds.Height * 4;
+        }
+        plan.Images += tiles.size();
+        if (plan.Bytes > budgetBytes)
+        {
+            // No point in adding up the rest
+            return plan;
+        }
+    }
+    plan.Enabled = true;
+    return plan;
+}
+
+void FlipbookStore::Reset(size_t pageCount, std::vector<uint64_t> tileBytes)
+{
+    m_pageCount = pageCount;
+    m_recordedPages = 0;
+    m_tileBytes = std::move(tileBytes);
+    m_images.assign(m_pageCount * m_tileBytes.size(), ClearImage);
+    m_imageCount = 0;
+    m_bytes = 0;
+}
+
+uint32_t FlipbookStore::Record(size_t page, std::vector<size_t> const& changedTiles)
+{
+    if (!CanRecord(page))
+    {
+        throw std::runtime_error("Flipbook pages must be recorded in order!");
+    }
+    auto tileCount = m_tileBytes.size();
+    auto images = m_images.begin() + page * tileCount;
+    if (page > 0)
+    {
+        std::copy(images - tileCount, images, images);
+    }
+    auto firstImage = static_cast<uint32_t>(m_imageCount);
+    for (auto tile : changedTiles)
+    {
+        images[tile] = static_cast<uint32_t>(m_imageCount++);
+        m_bytes += m_tileBytes[tile];
+    }
+    m_recordedPages++;
+    return firstImage;
+}
+
+void FlipbookStore::Differences(size_t from, size_t to, std::vector<size_t>& tiles) const
+{
+    auto tileCount = m_tileBytes.size();
+    for (size_t i = 0; i < tileCount; i++)
+    {
+        if (Image(from, i) != Image(to, i))
+        {
+            tiles.push_back(i);
+        }
+    }
+}
@@ -0,0 +1,78 @@
+#pragma once
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+#include "TileGrid.h"
+
+struct FlipbookPageStats
+{
+    bool Enabled = false;
+    size_t Pages = 0;
+    size_t RecordedPages = 0;
+    uint64_t Bytes = 0;
+    // What the plan set aside, Bytes ends up lower if frames share tiles
+    uint64_t PlannedBytes = 0;
+};
+
+// Whether every composited frame can be kept around as a pre-rendered page
+// so that playback only has to swap them in. A page only needs its own
+// copy of the tiles its frame draws into, the rest are shared with the
+// page before it.
+struct FlipbookPlan
+{
+    // Used when the player doesn't have a budget of its own, so that long
+    // gifs still fall back to compositing every frame
+    static constexpr uint64_t DefaultBudgetBytes = 256ull * 1024 * 1024;
+
+    // frameRects are the parts of the canvas each frame draws into. A
+    // budget of zero means DefaultBudgetBytes.
+    static FlipbookPlan Compute(TileGrid const& grid, std::vector<TileRect> const& frameRects, uint64_t budgetBytes);
+
+    bool Enabled = false;
+    // Assumes no two frames in a row are identical, so it's an upper bound
+    uint64_t Bytes = 0;
+    size_t Images = 0;
+};
+
+// Keeps track of which tile images make up each page. Images are numbered
+// in the order they're recorded, so callers can keep the images themselves
+// in a vector and append one for each changed tile. Pages have to be
+// recorded in order since each one builds on the page before it.
+//
+// No Windows dependencies so that it can be built and benchmarked on its own.
+struct FlipbookStore
+{
+    // The tile is still the clear color
+    static constexpr uint32_t ClearImage = UINT32_MAX;
+
+    void Reset(size_t pageCount, std::vector<uint64_t> tileBytes);
+
+    size_t PageCount() const noexcept { return m_pageCount; }
+    size_t TileCount() const noexcept { return m_tileBytes.size(); }
+    size_t RecordedPages() const noexcept { return m_recordedPages; }
+    bool HasPage(size_t page) const noexcept { return page < m_recordedPages; }
+    bool IsComplete() const noexcept { return m_pageCount != 0 && m_recordedPages == m_pageCount; }
+    // Only the page right after the last recorded one can be recorded
+    bool CanRecord(size_t page) const noexcept { return page == m_recordedPages && page < m_pageCount; }
+
+    // The page matches the one before it (or a clear canvas for page 0)
+    // except for changedTiles, which each get a new image. Returns the id
+    // of the first new image.
+    uint32_t Record(size_t page, std::vector<size_t> const& changedTiles);
+    uint32_t Image(size_t page, size_t tile) const noexcept { return m_images[page * m_tileBytes.size() + tile]; }
+    // The tiles that have to be copied to go from showing one page to
+    // showing the other
+    void Differences(size_t from, size_t to, std::vector<size_t>& tiles) const;
+
+    size_t ImageCount() const noexcept { return m_imageCount; }
+    uint64_t Bytes() const noexcept { return m_bytes; }
+
+private:
+    size_t m_pageCount = 0;
+    size_t m_recordedPages = 0;
+    std::vector<uint64_t> m_tileBytes;
+    // PageCount * TileCount image ids, row-major by page
+    std::vector<uint32_t> m_images;
+    size_t m_imageCount = 0;
+    uint64_t m_bytes = 0;
+};
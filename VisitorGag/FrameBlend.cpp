@@ -0,0 +1,61 @@
+#include "FrameBlend.h"
+#include <cstring>
+
+namespace
+{
+    uint32_t LoadPixel(uint8_t const* bytes)
+    {
+        uint32_t pixel = 0;
+        std::memcpy(&pixel, bytes, sizeof(pixel));
+        return pixel;
+    }
+}
+
+void FrameBlendStats::Add(FrameBlendClass blendClass) noexcept
+{
+    switch (blendClass)
+    {
+    case FrameBlendClass::Empty:
+        EmptyFrames++;
+        break;
+    case FrameBlendClass::Opaque:
+        OpaqueFrames++;
+        break;
+    case FrameBlendClass::Keyed:
+        KeyedFrames++;
+        break;
+    case FrameBlendClass::Blended:
+        BlendedFrames++;
+        break;
+    }
+}
+
+FrameBlendClass ClassifyFrameBlend(uint8_t const* pixels, uint32_t width, uint32_t height, uint32_t rowPitch)
+{
+    // Accumulate over a row without branching, then decide
+    uint32_t allAlpha = 0xFF;
+    uint32_t anyAlpha = 0;
+    for (uint32_t y = 0; y < height; y++)
+    {
+        auto row = pixels + static_cast<size_t>(y) * rowPitch;
+        uint32_t partial = 0;
+        for (uint32_t x = 0; x < width; x++)
+        {
+            auto pixel = LoadPixel(row + static_cast<size_t>(x) * 4);
+            auto alpha = pixel >> 24;
+            allAlpha &= alpha;
+            anyAlpha |= alpha;
+            // Anything but 0 and 255, or a transparent pixel with color
+            partial |= ((alpha + 1) & 0xFE) | (pixel & (0u - static_cast<uint32_t>(alpha == 0)));
+        }
+        if (partial != 0)
+        {
+            return FrameBlendClass::Blended;
+        }
+    }
+    if (anyAlpha == 0)
+    {
+        return FrameBlendClass::Empty;
+    }
+    return allAlpha == 0xFF ? FrameBlendClass::Opaque : FrameBlendClass::Keyed;
+}
@@ -0,0 +1,34 @@
+#pragma once
+#include <cstddef>
+#include <cstdint>
+
+// How a frame has to be drawn onto the canvas, worked out once when it's
+// loaded. Gifs only have opaque pixels and a transparent color, so most
+// frames never need real blending. Only scaled frames with soft edges do.
+enum class FrameBlendClass : uint8_t
+{
+    // Fully transparent, drawing it changes nothing
+    Empty,
+    // Every pixel is opaque, drawing it is a copy
+    Opaque,
+    // Every pixel is either opaque or fully transparent (a gif's transparent
+    // color), drawing it is a copy of the opaque ones
+    Keyed,
+    // Some pixels are partly transparent
+    Blended,
+};
+
+struct FrameBlendStats
+{
+    uint32_t EmptyFrames = 0;
+    uint32_t OpaqueFrames = 0;
+    uint32_t KeyedFrames = 0;
+    uint32_t BlendedFrames = 0;
+
+    void Add(FrameBlendClass blendClass) noexcept;
+    uint32_t Frames() const noexcept { return EmptyFrames + OpaqueFrames + KeyedFrames + BlendedFrames; }
+};
+
+// Expects premultiplied BGRA8. Transparent pixels that still have some
+// color in them can't be skipped, so they make the frame Blended.
+FrameBlendClass ClassifyFrameBlend(uint8_t const* pixels, uint32_t width, uint32_t height, uint32_t rowPitch);
@@ -0,0 +1,159 @@
+#include "FrameBlendKernels.h"
+#include <cstring>
+
+#if defined(_M_X64) || defined(_M_IX86) || defined(__SSE2__)
+#include <emmintrin.h>
+#define BLEND_SSE2 1
+#endif
+
+namespace
+{
+    uint32_t LoadPixel(uint8_t const* bytes)
+    {
+        uint32_t pixel = 0;
+        std::memcpy(&pixel, bytes, sizeof(pixel));
+        return pixel;
+    }
+
+    void StorePixel(uint8_t* bytes, uint32_t pixel)
+    {
+        std::memcpy(bytes, &pixel, sizeof(pixel));
+    }
+
+    // Premultiplied source-over for one pixel. Each channel of the
+    // destination is scaled by 255 - alpha and rounded, two channels at a
+    // time. A valid premultiplied source can't carry into the next channel.
+    uint32_t BlendPixel(uint32_t source, uint32_t destination)
+    {
+        auto inverse = 255 - (source >> 24);
+        auto redBlue = (destination & 0x00FF00FF) * inverse + 0x00800080;
+        auto alphaGreen = ((destination >> 8) & 0x00FF00FF) * inverse + 0x00800080;
+        redBlue = ((redBlue + ((redBlue >> 8) & 0x00FF00FF)) >> 8) & 0x00FF00FF;
+        alphaGreen = (alphaGreen + ((alphaGreen >> 8) & 0x00FF00FF)) & 0xFF00FF00;
+        return source + (redBlue | alphaGreen);
+    }
+
+    // Transparent keyed pixels are all zero
+    uint32_t KeyPixel(uint32_t source, uint32_t destination)
+    {
+        return source | (destination & (0u - static_cast<uint32_t>(source == 0)));
+    }
+
+    void KeyRow(uint8_t* destination, uint8_t const* source, uint32_t width)
+    {
+        uint32_t x = 0;
+#if BLEND_SSE2
+        auto zero = _mm_setzero_si128();
+        for (; x + 4 <= width; x += 4)
+        {
+            auto sourcePixels = _mm_loadu_si128(reinterpret_cast<__m128i const*>(source + static_cast<size_t>(x) * 4));
+            auto destinationPixels = _mm_loadu_si128(reinterpret_cast<__m128i const*>(destination + static_cast<size_t>(x) * 4));
+            auto transparent = _mm_cmpeq_epi32(sourcePixels, zero);
+            auto result = _mm_or_si128(sourcePixels, _mm_and_si128(transparent, destinationPixels));
+            _mm_storeu_si128(reinterpret_cast<__m128i*>(destination + static_cast<size_t>(x) * 4), result);
+        }
+#endif
+        for (; x < width; x++)
+        {
+            auto offset = static_cast<size_t>(x) * 4;
+            StorePixel(destination + offset, KeyPixel(LoadPixel(source + offset), LoadPixel(destination + offset)));
+        }
+    }
+
+#if BLEND_SSE2
+    // Two pixels widened to 16 bits a channel
+    __m128i BlendHalf(__m128i source, __m128i destination)
+    {
+        auto alpha = _mm_shufflehi_epi16(_mm_shufflelo_epi16(source, _MM_SHUFFLE(3, 3, 3, 3)), _MM_SHUFFLE(3, 3, 3, 3));
+        auto inverse = _mm_sub_epi16(_mm_set1_epi16(255), alpha);
+        auto scaled = _mm_add_epi16(_mm_mullo_epi16(destination, inverse), _mm_set1_epi16(128));
+        return _mm_srli_epi16(_mm_add_epi16(scaled, _mm_srli_epi16(scaled, 8)), 8);
+    }
+#endif
+
+    void BlendRow(uint8_t* destination, uint8_t const* source, uint32_t width)
+    {
+        uint32_t x = 0;
+#if BLEND_SSE2
+        auto zero = _mm_setzero_si128();
+        for (; x + 4 <= width; x += 4)
+        {
+            auto sourcePixels = _mm_loadu_si128(reinterpret_cast<__m128i const*>(source + static_cast<size_t>(x) * 4));
+            auto destinationPixels = _mm_loadu_si128(reinterpret_cast<__m128i const*>(destination + static_cast<size_t>(x) * 4));
+            auto low = BlendHalf(_mm_unpacklo_epi8(sourcePixels, zero), _mm_unpacklo_epi8(destinationPixels, zero));
+            auto high = BlendHalf(_mm_unpackhi_epi8(sourcePixels, zero), _mm_unpackhi_epi8(destinationPixels, zero));
+            auto result = _mm_add_epi8(sourcePixels, _mm_packus_epi16(low, high));
+            _mm_storeu_si128(reinterpret_cast<__m128i*>(destination + static_cast<size_t>(x) * 4), result);
+        }
+#endif
+        for (; x < width; x++)
+        {
+            auto offset = static_cast<size_t>(x) * 4;
+            StorePixel(destination + offset, BlendPixel(LoadPixel(source + offset), LoadPixel(destination + offset)));
+        }
+    }
+
+    void SkipFrame(uint8_t*, uint32_t, uint8_t const*, uint32_t, uint32_t, uint32_t)
+    {
+    }
+
+    template <FrameBlendClass Class>
+    void BlendFrame(uint8_t* destination, uint32_t destinationPitch, uint8_t const* source, uint32_t sourcePitch, uint32_t width, uint32_t height)
+    {
+        for (uint32_t y = 0; y < height; y++)
+        {
+            auto destinationRow = destination + static_cast<size_t>(y) * destinationPitch;
+            auto sourceRow = source + static_cast<size_t>(y) * sourcePitch;
+            if constexpr (Class == FrameBlendClass::Opaque)
+            {
+                std::memcpy(destinationRow, sourceRow, static_cast<size_t>(width) * 4);
+            }
+            else if constexpr (Class == FrameBlendClass::Keyed)
+            {
+                KeyRow(destinationRow, sourceRow, width);
+            }
+            else
+            {
+                BlendRow(destinationRow, sourceRow, width);
+            }
+        }
+    }
+}
+
+FrameBlendKernel SelectFrameBlendKernel(FrameBlendClass blendClass) noexcept
+{
+    switch (blendClass)
+    {
+    case FrameBlendClass::Empty:
+        return SkipFrame;
+    case FrameBlendClass::Opaque:
+        return BlendFrame<FrameBlendClass::Opaque>;
+    case FrameBlendClass::Keyed:
+        return BlendFrame<FrameBlendClass::Keyed>;
+    default:
+        return BlendFrame<FrameBlendClass::Blended>;
+    }
+}
+
+void BlendFrameGeneric(uint8_t* destination, uint32_t destinationPitch, uint8_t const* source, uint32_t sourcePitch, uint32_t width, uint32_t height)
+{
+    for (uint32_t y = 0; y < height; y++)
+    {
+        auto destinationRow = destination + static_cast<size_t>(y) * destinationPitch;
+        auto sourceRow = source + static_cast<size_t>(y) * sourcePitch;
+        for (uint32_t x = 0; x < width; x++)
+        {
+            auto offset = static_cast<size_t>(x) * 4;
+            auto pixel = LoadPixel(sourceRow + offset);
+            auto alpha = pixel >> 24;
+            if (alpha == 255)
+            {
+                StorePixel(destinationRow + offset, pixel);
+            }
+            else if (pixel != 0)
+            {
+                StorePixel(destinationRow + offset, BlendPixel(pixel, LoadPixel(destinationRow + offset)));
+            }
+        }
+    }
+}
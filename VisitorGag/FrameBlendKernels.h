@@ -0,0 +1,24 @@
+#pragma once
+#include <cstdint>
+#include "FrameBlend.h"
+
+// CPU versions of the draws each FrameBlendClass allows. The player draws
+// with D2D and only binds a composite mode to each class, these are for
+// compositing on the CPU (GifCompositor).
+//
+// No Windows dependencies so that it can be built and benchmarked on its own.
+
+// Draws source over destination, both premultiplied BGRA8 with the same
+// size. The source has to be in the class the kernel was picked for.
+using FrameBlendKernel = void (*)(uint8_t* destination, uint32_t destinationPitch, uint8_t const* source, uint32_t sourcePitch, uint32_t width, uint32_t height);
+
+// Each class gets its own instance of one kernel template, so none of them
+// test pixels they don't have to and only Blended does any math. Empty
+// frames get a kernel that does nothing. Keyed and Blended use SSE2 where
+// it's available. Every kernel gives the same results as BlendFrameGeneric
+// for frames in its class.
+FrameBlendKernel SelectFrameBlendKernel(FrameBlendClass blendClass) noexcept;
+
+// Source-over that tests every pixel, which is what any frame would go
+// through without being classified
+void BlendFrameGeneric(uint8_t* destination, uint32_t destinationPitch, uint8_t const* source, uint32_t sourcePitch, uint32_t width, uint32_t height);
@@ -0,0 +1,271 @@
+#include "FrameCoverage.h"
+#include <algorithm>
+
+#if defined(_M_X64) || defined(_M_IX86) || defined(__SSE2__)
+#include <emmintrin.h>
+#define COVERAGE_SSE2 1
+#endif
+
+namespace
+{
+    inline bool IsOpaque(uint8_t const* pixel) noexcept
+    {
+        return pixel[3] != 0;
+    }
+
+#ifdef COVERAGE_SSE2
+    inline __m128i Load4(uint8_t const* pixels) noexcept
+    {
+        return _mm_loadu_si128(reinterpret_cast<__m128i const*>(pixels));
+    }
+
+    // All ones in the lanes of the four BGRA8 pixels that aren't transparent
+    inline __m128i OpaqueLanes(__m128i pixels) noexcept
+    {
+        auto alpha = _mm_srli_epi32(pixels, 24);
+        return _mm_xor_si128(_mm_cmpeq_epi32(alpha, _mm_setzero_si128()), _mm_set1_epi32(-1));
+    }
+
+    // One bit per pixel, lowest pixel first
+    inline int OpaqueBits(__m128i pixels) noexcept
+    {
+        return _mm_movemask_ps(_mm_castsi128_ps(OpaqueLanes(pixels)));
+    }
+
+    // Whether any of sixteen pixels isn't transparent
+    inline bool AnyOpaque16(uint8_t const* pixels) noexcept
+    {
+        auto merged = _mm_or_si128(_mm_or_si128(Load4(pixels), Load4(pixels + 16)), _mm_or_si128(Load4(pixels + 32), Load4(pixels + 48)));
+        return OpaqueBits(merged) != 0;
+    }
+#endif
+
+    // Returns the first non-transparent pixel in [0, width), or width
+    int32_t FirstOpaque(uint8_t const* row, int32_t width) noexcept
+    {
+        int32_t x = 0;
+#ifdef COVERAGE_SSE2
+        // Skip transparent pixels sixteen, then four at a time
+        for (; x + 16 <= width; x += 16)
+        {
+            if (AnyOpaque16(row + x * 4))
+            {
+                break;
+            }
+        }
+        for (; x + 4 <= width; x += 4)
+        {
+            if (OpaqueBits(Load4(row + x * 4)) != 0)
+            {
+                break;
+            }
+        }
+#endif
+        for (; x < width; x++)
+        {
+            if (IsOpaque(row + x * 4))
+            {
+                return x;
+            }
+        }
+        return width;
+    }
+
+    // Returns one past the last non-transparent pixel in [0, width), or 0
+    int32_t LastOpaque(uint8_t const* row, int32_t width) noexcept
+    {
+        auto x = width;
+#ifdef COVERAGE_SSE2
+        for (; x >= 16; x -= 16)
+        {
+            if (AnyOpaque16(row + (x - 16) * 4))
+            {
+                break;
+            }
+        }
+        for (; x >= 4; x -= 4)
+        {
+            if (OpaqueBits(Load4(row + (x - 4) * 4)) != 0)
+            {
+                break;
+            }
+        }
+#endif
+        for (; x > 0; x--)
+        {
+            if (IsOpaque(row + (x - 1) * 4))
+            {
+                return x;
+            }
+        }
+        return 0;
+    }
+
+    // Returns the first transparent pixel in [0, width), or width
+    int32_t FirstTransparent(uint8_t const* row, int32_t width) noexcept
+    {
+        int32_t x = 0;
+#ifdef COVERAGE_SSE2
+        for (; x + 4 <= width; x += 4)
+        {
+            if (OpaqueBits(Load4(row + x * 4)) != 0xF)
+            {
+                break;
+            }
+        }
+#endif
+        for (; x < width; x++)
+        {
+            if (!IsOpaque(row + x * 4))
+            {
+                return x;
+            }
+        }
+        return width;
+    }
+
+    uint64_t CountOpaque(uint8_t const* row, int32_t start, int32_t end) noexcept
+    {
+        uint64_t count = 0;
+        auto x = start;
+#ifdef COVERAGE_SSE2
+        // Opaque lanes are -1, so subtracting them counts per lane. A row
+        // can't overflow an int32 lane.
+        auto counts = _mm_setzero_si128();
+        for (; x + 4 <= end; x += 4)
+        {
+            counts = _mm_sub_epi32(counts, OpaqueLanes(Load4(row + x * 4)));
+        }
+        counts = _mm_add_epi32(counts, _mm_shuffle_epi32(counts, _MM_SHUFFLE(1, 0, 3, 2)));
+        counts = _mm_add_epi32(counts, _mm_shuffle_epi32(counts, _MM_SHUFFLE(2, 3, 0, 1)));
+        count = static_cast<uint32_t>(_mm_cvtsi128_si32(counts));
+#endif
+        for (; x < end; x++)
+        {
+            count += IsOpaque(row + x * 4);
+        }
+        return count;
+    }
+
+    bool SameSpans(OpaqueSpan const* first, OpaqueSpan const* second, size_t count) noexcept
+    {
+        for (size_t i = 0; i < count; i++)
+        {
+            if (first[i].Start != second[i].Start || first[i].Length != second[i].Length)
+            {
+                return false;
+            }
+        }
+        return true;
+    }
+}
+
+uint64_t FrameCoverage::BlendedPixels() const noexcept
+{
+    if (Rects.empty())
+    {
+        return static_cast<uint64_t>(Bounds.Width) * Bounds.Height;
+    }
+    uint64_t pixels = 0;
+    for (auto&& rect : Rects)
+    {
+        pixels += static_cast<uint64_t>(rect.Width) * rect.Height;
+    }
+    return pixels;
+}
+
+void FindOpaqueSpans(uint8_t const* row, int32_t rowIndex, int32_t start, int32_t end, std::vector<OpaqueSpan>& spans)
+{
+    auto x = start;
+    while (x < end)
+    {
+        x += FirstOpaque(row + x * 4, end - x);
+        if (x >= end)
+        {
+            break;
+        }
+        auto spanStart = x;
+        x += FirstTransparent(row + x * 4, end - x);
+        spans.push_back({ rowIndex, spanStart, x - spanStart });
+    }
+}
+
+FrameCoverage AnalyzeFrameCoverage(uint8_t const* pixels, uint32_t width, uint32_t height, uint32_t rowPitch, FrameCoverageOptions const& options)
+{
+    FrameCoverage coverage;
+    auto frameWidth = static_cast<int32_t>(width);
+    auto frameHeight = static_cast<int32_t>(height);
+
+    // Tight bounds first
+    int32_t left = frameWidth;
+    int32_t right = 0;
+    int32_t top = frameHeight;
+    int32_t bottom = 0;
+    for (int32_t y = 0; y < frameHeight; y++)
+    {
+        auto row = pixels + static_cast<size_t>(y) * rowPitch;
+        auto first = FirstOpaque(row, frameWidth);
+        if (first == frameWidth)
+        {
+            continue;
+        }
+        // Only the parts outside what we already know about need a look
+        left = std::min(left, first);
+        right = std::max(right, first + 1);
+        if (right < frameWidth)
+        {
+            right = std::max(right, right + LastOpaque(row + right * 4, frameWidth - right));
+        }
+        top = std::min(top, y);
+        bottom = y + 1;
+    }
+    if (right <= left || bottom <= top)
+    {
+        return coverage;
+    }
+    coverage.Bounds = { left, top, right - left, bottom - top };
+
+    for (auto y = top; y < bottom; y++)
+    {
+        coverage.OpaquePixels += CountOpaque(pixels + static_cast<size_t>(y) * rowPitch, left, right);
+    }
+    auto boundsPixels = static_cast<uint64_t>(coverage.Bounds.Width) * coverage.Bounds.Height;
+    if (static_cast<float>(coverage.OpaquePixels) >= options.SpanThreshold * static_cast<float>(boundsPixels))
+    {
+        return coverage;
+    }
+
+    // Mostly transparent, find the spans and merge rows with identical
+    // spans into rects
+    std::vector<OpaqueSpan> spans;
+    std::vector<OpaqueSpan> previous;
+    std::vector<size_t> openRects;
+    for (auto y = top; y < bottom; y++)
+    {
+        spans.clear();
+        FindOpaqueSpans(pixels + static_cast<size_t>(y) * rowPitch, y, left, right, spans);
+        if (!spans.empty() && spans.size() == previous.size() && SameSpans(spans.data(), previous.data(), spans.size()))
+        {
+            for (auto index : openRects)
+            {
+                coverage.Rects[index].Height++;
+            }
+        }
+        else
+        {
+            openRects.clear();
+            for (auto&& span : spans)
+            {
+                openRects.push_back(coverage.Rects.size());
+                coverage.Rects.push_back({ span.Start, y, span.Length, 1 });
+            }
+            if (coverage.Rects.size() > options.MaxRects)
+            {
+                coverage.Rects.clear();
+                return coverage;
+            }
+        }
+        std::swap(spans, previous);
+    }
+    return coverage;
+}
@@ -0,0 +1,55 @@
+#pragma once
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+#include "FrameDeduplicator.h"
+
+// A run of non-transparent pixels in one row, relative to the frame
+struct OpaqueSpan
+{
+    int32_t Row = 0;
+    int32_t Start = 0;
+    int32_t Length = 0;
+};
+
+// Which parts of a frame actually have pixels in them. Encoders often pad
+// frames with fully transparent pixels, which we'd otherwise upload and
+// blend for nothing.
+struct FrameCoverage
+{
+    // Tight bounds of the non-transparent pixels, relative to the frame.
+    // Empty (zero width) if the frame is fully transparent.
+    FrameRegion Bounds;
+    uint64_t OpaquePixels = 0;
+    // Only filled in for mostly transparent frames: the opaque spans merged
+    // into a handful of rects (relative to the frame) that cover exactly
+    // the non-transparent pixels. Empty means draw all of Bounds.
+    std::vector<FrameRegion> Rects;
+
+    bool IsEmpty() const noexcept { return Bounds.Width == 0 || Bounds.Height == 0; }
+    // How many pixels drawing the frame will touch
+    uint64_t BlendedPixels() const noexcept;
+};
+
+struct FrameCoverageStats
+{
+    // Pixels in the frames as encoded, and how many of those we actually
+    // upload and blend
+    uint64_t FramePixels = 0;
+    uint64_t BlendedPixels = 0;
+};
+
+struct FrameCoverageOptions
+{
+    // Spans are only worth it if less than this fraction of the bounds is
+    // opaque
+    float SpanThreshold = 0.5f;
+    // More rects than this and the per-draw overhead outweighs the savings
+    size_t MaxRects = 32;
+};
+
+// Expects premultiplied BGRA8, so a pixel is transparent iff its alpha is 0
+FrameCoverage AnalyzeFrameCoverage(uint8_t const* pixels, uint32_t width, uint32_t height, uint32_t rowPitch, FrameCoverageOptions const& options = {});
+
+// Appends the opaque spans of a single row
+void FindOpaqueSpans(uint8_t const* row, int32_t rowIndex, int32_t start, int32_t end, std::vector<OpaqueSpan>& spans);
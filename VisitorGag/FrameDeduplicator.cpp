@@ -0,0 +1,86 @@
+#include "FrameDeduplicator.h"
+
+namespace
+{
+    constexpr uint64_t Prime1 = 0x9E3779B185EBCA87ull;
+    constexpr uint64_t Prime2 = 0xC2B2AE3D27D4EB4Full;
+
+    inline uint64_t Rotate(uint64_t value, int bits) noexcept
+    {
+        return (value << bits) | (value >> (64 - bits));
+    }
+
+    inline uint64_t Mix(uint64_t lane, uint64_t word) noexcept
+    {
+        lane += word * Prime2;
+        lane = Rotate(lane, 31);
+        return lane * Prime1;
+    }
+
+    inline uint64_t Finalize(uint64_t hash) noexcept
+    {
+        hash ^= hash >> 33;
+        hash *= Prime2;
+        hash ^= hash >> 29;
+        hash *= Prime1;
+        hash ^= hash >> 32;
+        return hash;
+    }
+}
+
+void FrameDeduplicator::Reset(size_t frameCount)
+{
+    m_canonical.assign(frameCount, Unknown);
+    m_regions.assign(frameCount, {});
+    m_buckets.clear();
+    m_stats = {};
+}
+
+uint64_t FrameDeduplicator::Hash(FrameRegion const& region, uint8_t const* pixels, uint32_t rowPitch) noexcept
+{
+    uint64_t lanes[4] = { Prime1, Prime2, ~Prime1, ~Prime2 };
+    auto rowBytes = static_cast<size_t>(region.Width) * 4;
+    for (int32_t y = 0; y < region.Height; y++)
+    {
+        auto row = pixels + static_cast<size_t>(y) * rowPitch;
+        size_t i = 0;
+        for (; i + 32 <= rowBytes; i += 32)
+        {
+            uint64_t words[4];
+            std::memcpy(words, row + i, sizeof(words));
+            lanes[0] = Mix(lanes[0], words[0]);
+            lanes[1] = Mix(lanes[1], words[1]);
+            lanes[2] = Mix(lanes[2], words[2]);
+            lanes[3] = Mix(lanes[3], words[3]);
+        }
+        // Rows are a multiple of 4 bytes, finish off a pixel at a time
+        for (; i < rowBytes; i += 4)
+        {
+            uint32_t word = 0;
+            std::memcpy(&word, row + i, sizeof(word));
+            lanes[0] = Mix(lanes[0], word);
+        }
+    }
+
+    auto hash = Rotate(lanes[0], 1) + Rotate(lanes[1], 7) + Rotate(lanes[2], 12) + Rotate(lanes[3], 18);
+    hash = Mix(hash, (static_cast<uint64_t>(static_cast<uint32_t>(region.X)) << 32) | static_cast<uint32_t>(region.Y));
+    hash = Mix(hash, (static_cast<uint64_t>(static_cast<uint32_t>(region.Width)) << 32) | static_cast<uint32_t>(region.Height));
+    return Finalize(hash);
+}
+
+bool FrameDeduplicator::Equal(FrameRegion const& region, uint8_t const* pixels, uint32_t rowPitch, uint8_t const* other) noexcept
+{
+    if (other == nullptr)
+    {
+        return false;
+    }
+    auto rowBytes = static_cast<size_t>(region.Width) * 4;
+    for (int32_t y = 0; y < region.Height; y++)
+    {
+        if (std::memcmp(pixels + static_cast<size_t>(y) * rowPitch, other + static_cast<size_t>(y) * rowBytes, rowBytes) != 0)
+        {
+            return false;
+        }
+    }
+    return true;
+}
@@ -0,0 +1,96 @@
+#pragma once
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <unordered_map>
+#include <vector>
+
+struct FrameRegion
+{
+    int32_t X = 0;
+    int32_t Y = 0;
+    int32_t Width = 0;
+    int32_t Height = 0;
+
+    bool operator==(FrameRegion const& other) const noexcept { return X == other.X && Y == other.Y && Width == other.Width && Height == other.Height; }
+};
+
+struct FrameDedupStats
+{
+    uint32_t DuplicateFrames = 0;
+    // Pixel bytes that didn't need their own copy
+    uint64_t BytesSaved = 0;
+    // Spent hashing and confirming matches
+    std::chrono::microseconds Elapsed = {};
+};
+
+// Finds frames whose pixels (and placement) exactly match an earlier frame
+// so that they can share storage. Frames are hashed as they arrive and any
+// hash match is confirmed byte-for-byte before it's trusted.
+//
+// Gif frames are fully opaque or fully transparent per pixel, so drawing
+// the same frame twice in a row leaves the canvas unchanged. IsHold uses
+// that to let playback treat consecutive duplicates as one longer frame.
+struct FrameDeduplicator
+{
+    void Reset(size_t frameCount);
+
+    bool IsKnown(size_t index) const noexcept { return m_canonical[index] != Unknown; }
+    // The first frame with the same contents, which is the frame itself if
+    // it's unique (or hasn't been seen yet)
+    size_t CanonicalOf(size_t index) const noexcept { return m_canonical[index] == Unknown ? index : m_canonical[index]; }
+    bool IsDuplicate(size_t index) const noexcept { return CanonicalOf(index) != index; }
+    // True if the frame is identical to the one right before it
+    bool IsHold(size_t index) const noexcept { return index > 0 && IsKnown(index) && IsKnown(index - 1) && CanonicalOf(index) == CanonicalOf(index - 1); }
+
+    // Records the frame and returns its canonical index. Candidates are
+    // confirmed by asking fetchPixels(candidateIndex) for a pointer to the
+    // earlier frame's pixels (tightly packed, width * 4 bytes per row).
+    template <typename FetchPixels>
+    size_t Add(size_t index, FrameRegion const& region, uint8_t const* pixels, uint32_t rowPitch, FetchPixels&& fetchPixels)
+    {
+        auto start = std::chrono::steady_clock::now();
+        auto hash = Hash(region, pixels, rowPitch);
+        auto& candidates = m_buckets[hash];
+        auto canonical = index;
+        for (auto candidate : candidates)
+        {
+            if (m_regions[candidate] == region && Equal(region, pixels, rowPitch, fetchPixels(candidate)))
+            {
+                canonical = candidate;
+                break;
+            }
+        }
+        m_canonical[index] = canonical;
+        m_regions[index] = region;
+        if (canonical == index)
+        {
+            candidates.push_back(index);
+        }
+        else
+        {
+            m_stats.DuplicateFrames++;
+            m_stats.BytesSaved += static_cast<uint64_t>(region.Width) * region.Height * 4;
+        }
+        m_stats.Elapsed += std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now() - start);
+        return canonical;
+    }
+
+    FrameDedupStats const& Stats() const noexcept { return m_stats; }
+
+    // Four independent multiply-mix lanes over 8 byte words, which keeps
+    // the loop free of cross-iteration dependencies so it pipelines (and
+    // auto-vectorizes) well.
+    static uint64_t Hash(FrameRegion const& region, uint8_t const* pixels, uint32_t rowPitch) noexcept;
+
+private:
+    static bool Equal(FrameRegion const& region, uint8_t const* pixels, uint32_t rowPitch, uint8_t const* other) noexcept;
+
+private:
+    static constexpr size_t Unknown = SIZE_MAX;
+    std::vector<size_t> m_canonical;
+    std::vector<FrameRegion> m_regions;
+    std::unordered_map<uint64_t, std::vector<size_t>> m_buckets;
+    FrameDedupStats m_stats;
+};
@@ -0,0 +1,88 @@
+#include "FrameResidencyManager.h"
+
+FrameResidencyManager::FrameResidencyManager(uint64_t budgetBytes)
+{
+    m_budgetBytes = budgetBytes;
+}
+
+void FrameResidencyManager::Reset(std::vector<uint64_t> const& frameBytes, uint64_t fixedBytes)
+{
+    m_frameBytes = frameBytes;
+    m_residency.assign(frameBytes.size(), FrameResidency::Encoded);
+    m_usage = {};
+    m_usage.BudgetBytes = m_budgetBytes;
+    m_usage.FixedBytes = fixedBytes;
+    m_usage.EncodedFrames = static_cast<uint32_t>(m_frameBytes.size());
+}
+
+void FrameResidencyManager::SetFrameBytes(size_t index, uint64_t bytes)
+{
+    if (m_residency[index] == FrameResidency::Encoded)
+    {
+        m_frameBytes[index] = bytes;
+    }
+}
+
+bool FrameResidencyManager::CanPromote(size_t index, FrameResidency residency) const noexcept
+{
+    if (m_budgetBytes == 0 || residency == FrameResidency::Encoded)
+    {
+        return true;
+    }
+    auto current = m_residency[index];
+    if (current == residency)
+    {
+        return true;
+    }
+    auto total = m_usage.TotalBytes();
+    if (current != FrameResidency::Encoded)
+    {
+        total -= m_frameBytes[index];
+    }
+    return total + m_frameBytes[index] <= m_budgetBytes;
+}
+
+FrameResidency FrameResidencyManager::Place(size_t index) const noexcept
+{
+    // Pixels that have been decoded are either uploaded or thrown away,
+    // there's no reason to keep both copies around.
+    if (CanPromote(index, FrameResidency::Gpu))
+    {
+        return FrameResidency::Gpu;
+    }
+    return FrameResidency::Encoded;
+}
+
+void FrameResidencyManager::SetResidency(size_t index, FrameResidency residency)
+{
+    auto bytes = m_frameBytes[index];
+    switch (m_residency[index])
+    {
+    case FrameResidency::Cpu:
+        m_usage.CpuBytes -= bytes;
+        m_usage.CpuFrames--;
+        break;
+    case FrameResidency::Gpu:
+        m_usage.GpuBytes -= bytes;
+        m_usage.GpuFrames--;
+        break;
+    default:
+        m_usage.EncodedFrames--;
+        break;
+    }
+    switch (residency)
+    {
+    case FrameResidency::Cpu:
+        m_usage.CpuBytes += bytes;
+        m_usage.CpuFrames++;
+        break;
+    case FrameResidency::Gpu:
+        m_usage.GpuBytes += bytes;
+        m_usage.GpuFrames++;
+        break;
+    default:
+        m_usage.EncodedFrames++;
+        break;
+    }
+    m_residency[index] = residency;
+}
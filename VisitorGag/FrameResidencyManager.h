@@ -0,0 +1,66 @@
+#pragma once
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+// Where a frame's pixels currently live. Every frame can always be
+// re-materialized from the encoded gif, so Encoded costs nothing extra.
+enum class FrameResidency
+{
+    Encoded,
+    Cpu,
+    Gpu,
+};
+
+struct FrameMemoryUsage
+{
+    uint64_t BudgetBytes = 0;
+    uint64_t FixedBytes = 0;
+    uint64_t CpuBytes = 0;
+    uint64_t GpuBytes = 0;
+    uint32_t EncodedFrames = 0;
+    uint32_t CpuFrames = 0;
+    uint32_t GpuFrames = 0;
+
+    uint64_t TotalBytes() const noexcept { return FixedBytes + CpuBytes + GpuBytes; }
+};
+
+// Decides which tier each frame lives in given a byte budget. It only does
+// the bookkeeping, the caller is responsible for actually moving the data
+// and reporting the result back through SetResidency.
+//
+// Playback walks the frames in order and wraps around, which is the worst
+// case for LRU. Instead, the manager pins as many frames as fit (in
+// playback order) and everything else is streamed from its encoded form
+// when it is drawn.
+struct FrameResidencyManager
+{
+    // A budget of zero means unlimited
+    FrameResidencyManager(uint64_t budgetBytes = 0);
+
+    // Starts tracking a new set of frames, all of which begin in the Encoded
+    // tier. Fixed bytes cover things that don't scale with the frame count
+    // (render targets, the encoded file, etc).
+    void Reset(std::vector<uint64_t> const& frameBytes, uint64_t fixedBytes);
+    void SetFixedBytes(uint64_t fixedBytes) noexcept { m_usage.FixedBytes = fixedBytes; }
+    // Frames that haven't been decoded yet can be tracked with an estimate
+    // and corrected later. Only valid while the frame is Encoded.
+    void SetFrameBytes(size_t index, uint64_t bytes);
+
+    // Returns true if moving the frame to the given tier keeps us in budget
+    bool CanPromote(size_t index, FrameResidency residency) const noexcept;
+    // The tier a freshly decoded frame should end up in
+    FrameResidency Place(size_t index) const noexcept;
+    void SetResidency(size_t index, FrameResidency residency);
+
+    FrameResidency Residency(size_t index) const noexcept { return m_residency[index]; }
+    size_t FrameCount() const noexcept { return m_residency.size(); }
+    uint64_t BudgetBytes() const noexcept { return m_budgetBytes; }
+    FrameMemoryUsage Usage() const noexcept { return m_usage; }
+
+private:
+    uint64_t m_budgetBytes = 0;
+    std::vector<uint64_t> m_frameBytes;
+    std::vector<FrameResidency> m_residency;
+    FrameMemoryUsage m_usage = {};
+};
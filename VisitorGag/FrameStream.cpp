@@ -0,0 +1,65 @@
+#include "FrameStream.h"
+
+void FrameStream::Begin(clock::time_point start, size_t expectedFrames)
+{
+    m_start = start;
+    m_available = 0;
+    m_expected = expectedFrames;
+    m_stalled = false;
+    m_stats = {};
+}
+
+void FrameStream::Publish(clock::time_point now)
+{
+    if (m_available >= m_expected)
+    {
+        return;
+    }
+    m_available++;
+    auto elapsed = std::chrono::duration_cast<std::chrono::microseconds>(now - m_start);
+    if (m_available == 1)
+    {
+        m_stats.TimeToFirstFrame = elapsed;
+    }
+    if (m_available == m_expected)
+    {
+        m_stats.TotalLoadTime = elapsed;
+    }
+}
+
+bool FrameStream::TryGetNext(size_t current, size_t& next) const noexcept
+{
+    if (m_expected == 0)
+    {
+        return false;
+    }
+    // We can only wrap around once everything has been seen
+    auto candidate = (current + 1) % m_expected;
+    if (candidate >= m_available)
+    {
+        return false;
+    }
+    next = candidate;
+    return true;
+}
+
+void FrameStream::BeginStall(clock::time_point now)
+{
+    if (!m_stalled)
+    {
+        m_stalled = true;
+        m_stallStart = now;
+        m_stats.Stalls++;
+    }
+}
+
+bool FrameStream::EndStall(clock::time_point now)
+{
+    if (!m_stalled)
+    {
+        return false;
+    }
+    m_stalled = false;
+    m_stats.StalledTime += std::chrono::duration_cast<std::chrono::microseconds>(now - m_stallStart);
+    return true;
+}
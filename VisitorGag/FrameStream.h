@@ -0,0 +1,49 @@
+#pragma once
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+
+struct FrameStreamStats
+{
+    std::chrono::microseconds TimeToFirstFrame{};
+    std::chrono::microseconds TotalLoadTime{};
+    uint32_t Stalls = 0;
+    std::chrono::microseconds StalledTime{};
+};
+
+// Consumer-side bookkeeping for frames that arrive while playback is
+// already running. Frames are published strictly in order by the producer
+// (the decoder), and playback must stall rather than skip or wrap when it
+// catches up to the last published frame.
+//
+// Not thread safe, the producer is expected to hand frames over to the
+// consumer's thread (e.g. through an MpscQueue) before publishing them.
+struct FrameStream
+{
+    using clock = std::chrono::steady_clock;
+
+    void Begin(clock::time_point start, size_t expectedFrames);
+    void Publish(clock::time_point now);
+
+    // Returns the frame that should be shown after current, or false if it
+    // hasn't been published yet.
+    bool TryGetNext(size_t current, size_t& next) const noexcept;
+
+    void BeginStall(clock::time_point now);
+    // Returns false if we weren't stalled
+    bool EndStall(clock::time_point now);
+
+    size_t Available() const noexcept { return m_available; }
+    size_t Expected() const noexcept { return m_expected; }
+    bool IsComplete() const noexcept { return m_available == m_expected; }
+    bool IsStalled() const noexcept { return m_stalled; }
+    FrameStreamStats const& Stats() const noexcept { return m_stats; }
+
+private:
+    clock::time_point m_start = {};
+    clock::time_point m_stallStart = {};
+    size_t m_available = 0;
+    size_t m_expected = 0;
+    bool m_stalled = false;
+    FrameStreamStats m_stats = {};
+};
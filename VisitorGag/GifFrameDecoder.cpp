@@ -0,0 +1,300 @@
+#include "GifFrameDecoder.h"
+#include <algorithm>
+#include <cstring>
+#include <stdexcept>
+
+namespace
+{
+    constexpr uint32_t MaxCodeSize = 12;
+    constexpr uint32_t MaxCodes = 1 << MaxCodeSize;
+    constexpr uint32_t OpaqueBlack = 0xFF000000;
+
+    inline size_t ColorTableEntries(uint8_t packed)
+    {
+        return static_cast<size_t>(1) << ((packed & 0x07) + 1);
+    }
+
+    // Reads LSB-first codes out of the image data's sub-blocks
+    struct CodeReader
+    {
+        CodeReader(uint8_t const* data, size_t size, size_t offset) : m_data(data), m_size(size), m_offset(offset) {}
+
+        // False once the data runs out
+        bool Read(uint32_t codeSize, uint32_t& code)
+        {
+            while (m_count < codeSize)
+            {
+                if (m_blockRemaining == 0)
+                {
+                    if (m_offset >= m_size || m_data[m_offset] == 0)
+                    {
+                        return false;
+                    }
+                    m_blockRemaining = m_data[m_offset++];
+                }
+                if (m_offset >= m_size)
+                {
+                    return false;
+                }
+                m_bits |= static_cast<uint32_t>(m_data[m_offset++]) << m_count;
+                m_count += 8;
+                m_blockRemaining--;
+            }
+            code = m_bits & ((1u << codeSize) - 1);
+            m_bits >>= codeSize;
+            m_count -= codeSize;
+            return true;
+        }
+
+    private:
+        uint8_t const* m_data = nullptr;
+        size_t m_size = 0;
+        size_t m_offset = 0;
+        size_t m_blockRemaining = 0;
+        uint32_t m_bits = 0;
+        uint32_t m_count = 0;
+    };
+
+    // Collects a row of palette indices at a time and writes the clipped
+    // part of it through the palette. Interlaced frames arrive in four
+    // passes, the rows land wherever they belong.
+    struct RowWriter
+    {
+        RowWriter(uint32_t width, uint32_t height, bool interlaced, uint32_t const* palette, FrameDestination const& destination, std::vector<uint8_t>& row)
+            : m_width(width), m_height(height), m_interlaced(interlaced), m_palette(palette), m_destination(destination), m_row(row)
+        {
+            m_row.resize(width);
+        }
+
+        bool IsDone() const noexcept { return m_rowsWritten >= m_height; }
+
+        void Put(uint8_t const* indices, size_t count)
+        {
+            while (count > 0 && !IsDone())
+            {
+                auto take = std::min(count, static_cast<size_t>(m_width - m_x));
+                std::memcpy(m_row.data() + m_x, indices, take);
+                m_x += static_cast<uint32_t>(take);
+                indices += take;
+                count -= take;
+                if (m_x == m_width)
+                {
+                    FlushRow();
+                }
+            }
+        }
+
+        // Whatever the data didn't cover comes out transparent
+        void Finish()
+        {
+            while (!IsDone())
+            {
+                auto&& clip = m_destination.Clip;
+                if (m_y >= clip.Y && m_y < clip.Y + clip.Height)
+                {
+                    auto out = m_destination.Bytes + static_cast<size_t>(m_y - clip.Y) * m_destination.RowPitch;
+                    auto start = std::max(static_cast<int32_t>(m_x), clip.X);
+                    auto end = clip.X + clip.Width;
+                    if (start < end)
+                    {
+                        std::memset(out + static_cast<size_t>(start - clip.X) * 4, 0, static_cast<size_t>(end - start) * 4);
+                    }
+                }
+                m_x = m_width;
+                AdvanceRow();
+            }
+        }
+
+    private:
+        void FlushRow()
+        {
+            auto&& clip = m_destination.Clip;
+            if (m_y >= clip.Y && m_y < clip.Y + clip.Height)
+            {
+                auto out = m_destination.Bytes + static_cast<size_t>(m_y - clip.Y) * m_destination.RowPitch;
+                auto in = m_row.data() + clip.X;
+                for (int32_t x = 0; x < clip.Width; x++)
+                {
+                    std::memcpy(out + static_cast<size_t>(x) * 4, &m_palette[in[x]], 4);
+                }
+            }
+            AdvanceRow();
+        }
+
+        void AdvanceRow()
+        {
+            static constexpr int32_t PassStart[] = { 0, 4, 2, 1 };
+            static constexpr int32_t PassStep[] = { 8, 8, 4, 2 };
+            m_x = 0;
+            m_rowsWritten++;
+            if (!m_interlaced)
+            {
+                m_y++;
+                return;
+            }
+            m_y += PassStep[m_pass];
+            while (m_y >= static_cast<int32_t>(m_height) && m_pass < 3)
+            {
+                m_pass++;
+                m_y = PassStart[m_pass];
+            }
+        }
+
+    private:
+        uint32_t m_width = 0;
+        uint32_t m_height = 0;
+        bool m_interlaced = false;
+        uint32_t const* m_palette = nullptr;
+        FrameDestination const& m_destination;
+        std::vector<uint8_t>& m_row;
+        uint32_t m_x = 0;
+        int32_t m_y = 0;
+        uint32_t m_pass = 0;
+        uint32_t m_rowsWritten = 0;
+    };
+}
+
+GifFrameDecoder::GifFrameDecoder(uint8_t const* data, size_t size, GifIndex const& index) : m_data(data), m_size(size), m_index(index)
+{
+    m_prefix.resize(MaxCodes);
+    m_suffix.resize(MaxCodes);
+    m_stack.reserve(MaxCodes + 1);
+}
+
+size_t GifFrameDecoder::LoadPalette(size_t frame)
+{
+    // A local color table wins over the global one
+    size_t tableOffset = 0;
+    size_t entries = 0;
+    auto descriptorOffset = m_index.DescriptorOffsets[frame];
+    auto descriptorPacked = m_data[descriptorOffset + 9];
+    auto screenPacked = m_data[10];
+    if (descriptorPacked & 0x80)
+    {
+        tableOffset = descriptorOffset + 10;
+        entries = ColorTableEntries(descriptorPacked);
+    }
+    else if (screenPacked & 0x80)
+    {
+        tableOffset = 13;
+        entries = ColorTableEntries(screenPacked);
+    }
+    entries = std::min(entries, (m_size - std::min(tableOffset, m_size)) / 3);
+
+    std::fill(std::begin(m_palette), std::end(m_palette), OpaqueBlack);
+    for (size_t i = 0; i < entries; i++)
+    {
+        auto rgb = m_data + tableOffset + i * 3;
+        m_palette[i] = OpaqueBlack | (static_cast<uint32_t>(rgb[0]) << 16) | (static_cast<uint32_t>(rgb[1]) << 8) | rgb[2];
+    }
+    auto transparentIndex = m_index.TransparentIndex[frame];
+    if (transparentIndex >= 0)
+    {
+        m_palette[transparentIndex] = 0;
+    }
+    return entries;
+}
+
+void GifFrameDecoder::Decode(size_t frame, FrameDestination const& destination)
+{
+    uint32_t width = m_index.FrameWidth[frame];
+    uint32_t height = m_index.FrameHeight[frame];
+    auto&& clip = destination.Clip;
+    if (clip.X < 0 || clip.Y < 0 || clip.Width < 0 || clip.Height < 0 ||
+        static_cast<uint32_t>(clip.X + clip.Width) > width || static_cast<uint32_t>(clip.Y + clip.Height) > height)
+    {
+        throw std::invalid_argument("Clip must be inside the frame");
+    }
+
+    LoadPalette(frame);
+    RowWriter writer(width, height, m_index.Interlaced[frame], m_palette, destination, m_row);
+
+    auto dataOffset = m_index.DataOffsets[frame];
+    uint32_t minCodeSize = m_data[dataOffset];
+    if (minCodeSize < 2 || minCodeSize >= MaxCodeSize)
+    {
+        writer.Finish();
+        return;
+    }
+    uint32_t clearCode = 1u << minCodeSize;
+    uint32_t endCode = clearCode + 1;
+    for (uint32_t i = 0; i < clearCode; i++)
+    {
+        m_prefix[i] = 0;
+        m_suffix[i] = static_cast<uint8_t>(i);
+    }
+
+    CodeReader reader(m_data, m_size, dataOffset + 1);
+    auto codeSize = minCodeSize + 1;
+    auto nextCode = clearCode + 2;
+    uint32_t previous = MaxCodes;
+    uint8_t firstIndex = 0;
+    uint32_t code = 0;
+    while (!writer.IsDone() && reader.Read(codeSize, code))
+    {
+        if (code == clearCode)
+        {
+            codeSize = minCodeSize + 1;
+            nextCode = clearCode + 2;
+            previous = MaxCodes;
+            continue;
+        }
+        if (code == endCode)
+        {
+            break;
+        }
+        if (previous == MaxCodes)
+        {
+            if (code > clearCode)
+            {
+                break;
+            }
+            firstIndex = static_cast<uint8_t>(code);
+            writer.Put(&firstIndex, 1);
+            previous = code;
+            continue;
+        }
+        if (code > nextCode)
+        {
+            break;
+        }
+
+        // Walk the string back to its first index. The code we haven't
+        // added yet is the previous string plus its own first index.
+        auto current = code;
+        m_stack.clear();
+        if (current == nextCode)
+        {
+            m_stack.push_back(firstIndex);
+            current = previous;
+        }
+        while (current >= clearCode)
+        {
+            m_stack.push_back(m_suffix[current]);
+            current = m_prefix[current];
+        }
+        firstIndex = m_suffix[current];
+        m_stack.push_back(firstIndex);
+        std::reverse(m_stack.begin(), m_stack.end());
+        writer.Put(m_stack.data(), m_stack.size());
+
+        if (nextCode < MaxCodes)
+        {
+            m_prefix[nextCode] = static_cast<uint16_t>(previous);
+            m_suffix[nextCode] = firstIndex;
+            nextCode++;
+            if (nextCode == (1u << codeSize) && codeSize < MaxCodeSize)
+            {
+                codeSize++;
+            }
+        }
+        previous = code;
+    }
+    writer.Finish();
+}
+
+void GifFrameDecoder::Decode(size_t frame, uint8_t* bytes, uint32_t rowPitch)
+{
+    FrameDestination destination = { bytes, rowPitch, { 0, 0, m_index.FrameWidth[frame], m_index.FrameHeight[frame] } };
+    Decode(frame, destination);
+}
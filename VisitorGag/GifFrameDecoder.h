@@ -0,0 +1,51 @@
+#pragma once
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+#include "GifIndex.h"
+#include "FrameDeduplicator.h"
+
+// Where a decoder writes a frame. The caller owns the memory, which can be
+// anything with rows of BGRA8 pixels: a pool buffer, a mapped texture or
+// a region of an atlas. Only the pixels inside Clip (relative to the
+// frame) are written, and Bytes points at Clip's top-left pixel.
+struct FrameDestination
+{
+    uint8_t* Bytes = nullptr;
+    uint32_t RowPitch = 0;
+    FrameRegion Clip;
+};
+
+// Turns a frame's LZW data straight into premultiplied BGRA8 without going
+// through any intermediate bitmap, so each decoded pixel is written once.
+// It reads from the encoded gif and its index, which must outlive it. The
+// decoder keeps its code table between calls, so use one per thread.
+//
+// Every pixel inside the clip is written, even if the image data is cut
+// short (those pixels come out transparent). Decode throws
+// std::invalid_argument if the clip isn't inside the frame.
+struct GifFrameDecoder
+{
+    GifFrameDecoder(uint8_t const* data, size_t size, GifIndex const& index);
+
+    void Decode(size_t frame, FrameDestination const& destination);
+    // Decodes the whole frame with tightly packed rows
+    void Decode(size_t frame, uint8_t* bytes, uint32_t rowPitch);
+
+    GifIndex const& Index() const noexcept { return m_index; }
+
+private:
+    // Returns the number of entries
+    size_t LoadPalette(size_t frame);
+
+private:
+    uint8_t const* m_data = nullptr;
+    size_t m_size = 0;
+    GifIndex const& m_index;
+    // BGRA8 for every palette entry, with the transparent one zeroed
+    uint32_t m_palette[256] = {};
+    std::vector<uint16_t> m_prefix;
+    std::vector<uint8_t> m_suffix;
+    std::vector<uint8_t> m_stack;
+    std::vector<uint8_t> m_row;
+};
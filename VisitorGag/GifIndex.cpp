@@ -0,0 +1,171 @@
+#include "GifIndex.h"
+#include <algorithm>
+#include <cstring>
+#include <stdexcept>
+
+namespace
+{
+    constexpr size_t InvalidOffset = static_cast<size_t>(-1);
+
+    inline uint16_t ReadUInt16(uint8_t const* bytes)
+    {
+        return static_cast<uint16_t>(bytes[0] | (bytes[1] << 8));
+    }
+
+    // Returns the offset just past the block terminator, or InvalidOffset
+    // if the data ends first.
+    size_t SkipSubBlocks(uint8_t const* data, size_t size, size_t offset)
+    {
+        while (offset < size)
+        {
+            auto length = data[offset];
+            offset += 1 + static_cast<size_t>(length);
+            if (length == 0)
+            {
+                return offset;
+            }
+        }
+        return InvalidOffset;
+    }
+
+    inline size_t ColorTableSize(uint8_t packed)
+    {
+        return 3 * (static_cast<size_t>(1) << ((packed & 0x07) + 1));
+    }
+}
+
+GifIndex GifIndex::Build(uint8_t const* data, size_t size, uint32_t zeroDelayMs)
+{
+    if (size < 13 || (std::memcmp(data, "GIF87a", 6) != 0 && std::memcmp(data, "GIF89a", 6) != 0))
+    {
+        throw std::runtime_error("Not a gif");
+    }
+
+    GifIndex index;
+    index.Width = ReadUInt16(data + 6);
+    index.Height = ReadUInt16(data + 8);
+    size_t offset = 13;
+    auto screenPacked = data[10];
+    if (screenPacked & 0x80)
+    {
+        offset += ColorTableSize(screenPacked);
+    }
+
+    // Graphic control extension state, applies to the next image only
+    uint16_t delay = 0;
+    auto disposal = GifDisposal::Unspecified;
+    int16_t transparentIndex = -1;
+
+    while (offset < size)
+    {
+        auto introducer = data[offset];
+        if (introducer == 0x3B)
+        {
+            break;
+        }
+        else if (introducer == 0x21)
+        {
+            if (offset + 2 >= size)
+            {
+                break;
+            }
+            auto label = data[offset + 1];
+            auto blockStart = offset + 2;
+            if (label == 0xF9 && blockStart + 5 <= size && data[blockStart] >= 4)
+            {
+                auto packed = data[blockStart + 1];
+                disposal = static_cast<GifDisposal>((packed >> 2) & 0x07);
+                delay = ReadUInt16(data + blockStart + 2);
+                transparentIndex = (packed & 0x01) ? static_cast<int16_t>(data[blockStart + 4]) : -1;
+            }
+            else if (label == 0xFF && blockStart + 12 <= size && data[blockStart] == 11 &&
+                (std::memcmp(data + blockStart + 1, "NETSCAPE2.0", 11) == 0 ||
+                 std::memcmp(data + blockStart + 1, "ANIMEXTS1.0", 11) == 0))
+            {
+                auto subBlock = blockStart + 12;
+                if (subBlock + 4 <= size && data[subBlock] >= 3 && data[subBlock + 1] == 1)
+                {
+                    index.LoopCount = ReadUInt16(data + subBlock + 2);
+                }
+            }
+            offset = SkipSubBlocks(data, size, blockStart);
+        }
+        else if (introducer == 0x2C)
+        {
+            if (offset + 10 > size)
+            {
+                break;
+            }
+            auto descriptor = data + offset;
+            auto packed = descriptor[9];
+            auto dataOffset = offset + 10;
+            if (packed & 0x80)
+            {
+                dataOffset += ColorTableSize(packed);
+            }
+            if (dataOffset >= size)
+            {
+                break;
+            }
+            // Skip the LZW minimum code size and then the image data
+            auto end = SkipSubBlocks(data, size, dataOffset + 1);
+            if (end == InvalidOffset)
+            {
+                break;
+            }
+
+            index.DescriptorOffsets.push_back(offset);
+            index.DataOffsets.push_back(dataOffset);
+            index.Left.push_back(ReadUInt16(descriptor + 1));
+            index.Top.push_back(ReadUInt16(descriptor + 3));
+            index.FrameWidth.push_back(ReadUInt16(descriptor + 5));
+            index.FrameHeight.push_back(ReadUInt16(descriptor + 7));
+            index.Delays.push_back(delay);
+            index.Disposal.push_back(disposal);
+            index.TransparentIndex.push_back(transparentIndex);
+            index.Interlaced.push_back((packed & 0x40) != 0);
+
+            delay = 0;
+            disposal = GifDisposal::Unspecified;
+            transparentIndex = -1;
+            offset = end;
+        }
+        else
+        {
+            // Garbage between blocks, treat it like the end of the file
+            break;
+        }
+
+        if (offset == InvalidOffset)
+        {
+            break;
+        }
+    }
+
+    if (index.FrameCount() == 0)
+    {
+        throw std::runtime_error("Gif has no frames");
+    }
+
+    index.StartTimesMs.resize(index.FrameCount() + 1);
+    index.StartTimesMs[0] = 0;
+    for (size_t i = 0; i < index.FrameCount(); i++)
+    {
+        uint64_t delayMs = index.Delays[i] == 0 ? zeroDelayMs : static_cast<uint64_t>(index.Delays[i]) * 10;
+        index.StartTimesMs[i + 1] = index.StartTimesMs[i] + delayMs;
+    }
+
+    return index;
+}
+
+size_t GifIndex::FrameAt(uint64_t timeMs) const noexcept
+{
+    if (FrameCount() == 0)
+    {
+        return 0;
+    }
+    // The first start time that is past timeMs belongs to the next frame
+    auto next = std::upper_bound(StartTimesMs.begin(), StartTimesMs.end(), timeMs);
+    auto frame = static_cast<size_t>(std::distance(StartTimesMs.begin(), next)) - 1;
+    return std::min(frame, FrameCount() - 1);
+}
@@ -0,0 +1,54 @@
+#pragma once
+#include <cstddef>
+#include <cstdint>
+#include <optional>
+#include <vector>
+
+enum class GifDisposal : uint8_t
+{
+    Unspecified = 0,
+    DoNotDispose = 1,
+    RestoreToBackground = 2,
+    RestoreToPrevious = 3,
+};
+
+// A table of every frame in a gif, built by walking the block structure
+// once without decoding any pixel data. Each field is its own array (one
+// entry per frame) so that scans over a single property stay in cache.
+//
+// Build throws std::runtime_error if the data isn't a gif. Truncated files
+// are indexed up to the last complete frame.
+struct GifIndex
+{
+    // Frames with a delay of zero are shown for zeroDelayMs when building
+    // the timeline, which matches what the player does.
+    static GifIndex Build(uint8_t const* data, size_t size, uint32_t zeroDelayMs = 100);
+
+    size_t FrameCount() const noexcept { return DataOffsets.size(); }
+    uint64_t DurationMs() const noexcept { return StartTimesMs.empty() ? 0 : StartTimesMs.back(); }
+    // The frame being shown at the given time, clamped to the last frame
+    size_t FrameAt(uint64_t timeMs) const noexcept;
+
+    uint32_t Width = 0;
+    uint32_t Height = 0;
+    // From the NETSCAPE2.0 application extension. Zero means forever, and
+    // no value means the gif should play once.
+    std::optional<uint16_t> LoopCount;
+
+    // Offset of the image descriptor (0x2C)
+    std::vector<uint64_t> DescriptorOffsets;
+    // Offset of the LZW minimum code size byte that starts the image data
+    std::vector<uint64_t> DataOffsets;
+    std::vector<uint16_t> Left;
+    std::vector<uint16_t> Top;
+    std::vector<uint16_t> FrameWidth;
+    std::vector<uint16_t> FrameHeight;
+    // In the gif's native 10ms units
+    std::vector<uint16_t> Delays;
+    std::vector<GifDisposal> Disposal;
+    // -1 if the frame has no transparent color
+    std::vector<int16_t> TransparentIndex;
+    std::vector<bool> Interlaced;
+    // Prefix sum of the frame delays, FrameCount() + 1 entries
+    std::vector<uint64_t> StartTimesMs;
+};
@@ -0,0 +1,69 @@
+#include "HibernationStateMachine.h"
+
+bool HibernationStateMachine::TryBeginHibernate(clock::time_point now)
+{
+    if (m_state != HibernationState::Awake)
+    {
+        return false;
+    }
+    m_state = HibernationState::Hibernating;
+    m_transitionStart = now;
+    return true;
+}
+
+bool HibernationStateMachine::CompleteHibernate(clock::time_point now, uint64_t idleBytes)
+{
+    if (m_state != HibernationState::Hibernating)
+    {
+        return false;
+    }
+    if (m_wakePending)
+    {
+        m_wakePending = false;
+        m_state = HibernationState::Waking;
+        m_transitionStart = now;
+        return false;
+    }
+    m_state = HibernationState::Hibernated;
+    m_stats.Hibernations++;
+    m_stats.LastHibernateDuration = std::chrono::duration_cast<std::chrono::microseconds>(now - m_transitionStart);
+    m_stats.IdleBytes = idleBytes;
+    return true;
+}
+
+bool HibernationStateMachine::TryBeginWake(clock::time_point now)
+{
+    if (m_state == HibernationState::Hibernating)
+    {
+        m_wakePending = true;
+        return false;
+    }
+    if (m_state != HibernationState::Hibernated)
+    {
+        return false;
+    }
+    m_state = HibernationState::Waking;
+    m_transitionStart = now;
+    return true;
+}
+
+void HibernationStateMachine::CompleteWake(clock::time_point now, uint64_t awakeBytes)
+{
+    if (m_state != HibernationState::Waking)
+    {
+        return;
+    }
+    m_state = HibernationState::Awake;
+    m_stats.LastWakeDuration = std::chrono::duration_cast<std::chrono::microseconds>(now - m_transitionStart);
+    m_stats.AwakeBytes = awakeBytes;
+}
+
+std::chrono::microseconds HibernationStateMachine::WakeLeadTime() const noexcept
+{
+    // Before the first wake we have nothing to go on
+    if (m_stats.LastWakeDuration.count() == 0)
+    {
+        return std::chrono::milliseconds(500);
+    }
+    return m_stats.LastWakeDuration * 2;
+}
@@ -0,0 +1,55 @@
+#pragma once
+#include <chrono>
+#include <cstdint>
+
+enum class HibernationState
+{
+    Awake,
+    Hibernating,
+    Hibernated,
+    Waking,
+};
+
+struct HibernationStats
+{
+    uint32_t Hibernations = 0;
+    std::chrono::microseconds LastHibernateDuration{};
+    std::chrono::microseconds LastWakeDuration{};
+    uint64_t AwakeBytes = 0;
+    uint64_t IdleBytes = 0;
+};
+
+// Tracks whether the visitor's resources are released between appearances
+// and how long it takes to get them back. The caller does the actual work
+// between the Begin/Complete calls and supplies the timestamps, which keeps
+// this free of any particular clock.
+struct HibernationStateMachine
+{
+    using clock = std::chrono::steady_clock;
+
+    // Returns false if we aren't currently awake
+    bool TryBeginHibernate(clock::time_point now);
+    // Returns false if a wake was asked for while hibernating. The
+    // hibernation is abandoned and we're Waking instead, so the caller has
+    // to finish waking up.
+    bool CompleteHibernate(clock::time_point now, uint64_t idleBytes);
+    // Returns false if we aren't currently hibernated. A wake that comes in
+    // while hibernating is held on to until CompleteHibernate.
+    bool TryBeginWake(clock::time_point now);
+    void CompleteWake(clock::time_point now, uint64_t awakeBytes);
+    // Whether hibernating should stop short of tearing anything else down
+    bool WakePending() const noexcept { return m_wakePending; }
+
+    // How far ahead of a reveal waking should start so that it's done in
+    // time. Based on the last wake with some headroom.
+    std::chrono::microseconds WakeLeadTime() const noexcept;
+
+    HibernationState State() const noexcept { return m_state; }
+    HibernationStats const& Stats() const noexcept { return m_stats; }
+
+private:
+    HibernationState m_state = HibernationState::Awake;
+    clock::time_point m_transitionStart = {};
+    bool m_wakePending = false;
+    HibernationStats m_stats = {};
+};
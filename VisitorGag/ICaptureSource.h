@@ -1,11 +1,25 @@
 #pragma once
 
+struct CaptureReuseStats
+{
+	uint32_t Captures = 0;
+	// Captures that handed back the previous capture's pixels
+	uint32_t Reuses = 0;
+};
+
 struct ICaptureSource
 {
 	virtual ~ICaptureSource() {};
 
 	virtual RECT DesktopCoordinates() = 0;
 	virtual winrt::com_ptr<ID3D11Texture2D> Capture() = 0;
+	// Only the pixels inside the region (in the capture's coordinates) have
+	// to be current. Sources that can tell what changed on the desktop may
+	// hand back an earlier capture, which must not be modified.
+	virtual winrt::com_ptr<ID3D11Texture2D> CaptureRegion(RECT const&) { return Capture(); }
+	virtual CaptureReuseStats ReuseStats() { return {}; }
+	// Lets go of anything kept between captures, the next capture starts over
+	virtual void Trim() {}
 };
 
 struct ICaptureSourceFactory
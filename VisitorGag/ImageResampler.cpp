@@ -0,0 +1,438 @@
+#include "ImageResampler.h"
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <stdexcept>
+
+#if defined(_M_X64) || defined(_M_IX86) || defined(__SSE2__)
+#include <emmintrin.h>
+#define RESAMPLER_SSE2 1
+#endif
+
+namespace
+{
+    constexpr int32_t WeightBits = 14;
+    constexpr int32_t WeightOne = 1 << WeightBits;
+    // The horizontal pass keeps 6 fractional bits, which leaves room in an
+    // int16 for Lanczos overshooting past 255
+    constexpr int32_t HorizontalShift = 8;
+    constexpr int32_t VerticalShift = WeightBits * 2 - HorizontalShift;
+    constexpr double Pi = 3.14159265358979323846;
+
+    // Weights for one axis of one frame. Source indices are relative to the
+    // frame padded by Padding transparent pixels on both sides, so the
+    // passes never have to check bounds.
+    struct AxisWeights
+    {
+        // First output pixel and count, on the scaled canvas
+        int32_t Offset = 0;
+        int32_t Length = 0;
+        // Per output pixel, always even so that taps can be done in pairs
+        int32_t Taps = 0;
+        int32_t Padding = 0;
+        std::vector<int32_t> First;
+        // Length * Taps
+        std::vector<int16_t> Weights;
+    };
+
+    double FilterSupport(ResampleFilter filter)
+    {
+        switch (filter)
+        {
+        case ResampleFilter::Box:
+            return 0.5;
+        case ResampleFilter::Bilinear:
+            return 1.0;
+        case ResampleFilter::Lanczos:
+            return 3.0;
+        }
+        return 1.0;
+    }
+
+    double FilterWeight(ResampleFilter filter, double x)
+    {
+        switch (filter)
+        {
+        case ResampleFilter::Box:
+            return (x > -0.5 && x <= 0.5) ? 1.0 : 0.0;
+        case ResampleFilter::Bilinear:
+            return std::max(1.0 - std::abs(x), 0.0);
+        case ResampleFilter::Lanczos:
+        {
+            if (x == 0.0)
+            {
+                return 1.0;
+            }
+            if (x <= -3.0 || x >= 3.0)
+            {
+                return 0.0;
+            }
+            auto px = Pi * x;
+            return 3.0 * std::sin(px) * std::sin(px / 3.0) / (px * px);
+        }
+        }
+        return 0.0;
+    }
+
+    struct Tap
+    {
+        // Relative to the frame
+        int32_t Source;
+        int32_t Weight;
+    };
+
+    // One axis of the canvas and where the frame sits on it
+    struct Axis
+    {
+        Axis(uint32_t length, uint32_t scaledLength, int32_t frameOffset, int32_t frameLength, ResampleFilter filter)
+        {
+            Length = static_cast<int32_t>(length);
+            ScaledLength = static_cast<int32_t>(scaledLength);
+            FrameOffset = frameOffset;
+            FrameEnd = frameOffset + frameLength;
+            Filter = filter;
+            InverseScale = static_cast<double>(length) / static_cast<double>(scaledLength);
+            // Widen the filter when shrinking so that every source pixel counts
+            FilterScale = std::max(InverseScale, 1.0);
+            Support = FilterSupport(filter) * FilterScale;
+        }
+
+        int32_t Length = 0;
+        int32_t ScaledLength = 0;
+        int32_t FrameOffset = 0;
+        int32_t FrameEnd = 0;
+        ResampleFilter Filter = ResampleFilter::Lanczos;
+        double InverseScale = 1.0;
+        double FilterScale = 1.0;
+        double Support = 0.0;
+    };
+
+    // The fixed point taps of one output pixel that fall inside the frame.
+    // Weights are normalized over the whole canvas so that a pixel inside
+    // the frame adds up to exactly one.
+    void ComputeTaps(Axis const& axis, int32_t output, std::vector<double>& weights, std::vector<Tap>& taps)
+    {
+        taps.clear();
+        auto center = (output + 0.5) * axis.InverseScale - 0.5;
+        auto low = std::max(static_cast<int32_t>(std::ceil(center - axis.Support)), 0);
+        auto high = std::min(static_cast<int32_t>(std::floor(center + axis.Support)), axis.Length - 1);
+        weights.clear();
+        double total = 0.0;
+        for (auto source = low; source <= high; source++)
+        {
+            auto weight = FilterWeight(axis.Filter, (source - center) / axis.FilterScale);
+            weights.push_back(weight);
+            total += weight;
+        }
+        if (total == 0.0)
+        {
+            // Can only happen right at the edges, use the nearest pixel
+            low = high = std::clamp(static_cast<int32_t>(std::lround(center)), 0, axis.Length - 1);
+            weights.assign(1, 1.0);
+            total = 1.0;
+        }
+
+        int32_t fixedTotal = 0;
+        size_t largest = 0;
+        for (size_t i = 0; i < weights.size(); i++)
+        {
+            taps.push_back({ low + static_cast<int32_t>(i), static_cast<int32_t>(std::lround(weights[i] / total * WeightOne)) });
+            fixedTotal += taps.back().Weight;
+            if (std::abs(weights[i]) > std::abs(weights[largest]))
+            {
+                largest = i;
+            }
+        }
+        taps[largest].Weight += WeightOne - fixedTotal;
+
+        // Then drop whatever falls outside the frame
+        auto kept = std::remove_if(taps.begin(), taps.end(), [&](Tap const& tap)
+            {
+                return tap.Source < axis.FrameOffset || tap.Source >= axis.FrameEnd || tap.Weight == 0;
+            });
+        taps.erase(kept, taps.end());
+        for (auto&& tap : taps)
+        {
+            tap.Source -= axis.FrameOffset;
+        }
+    }
+
+    // The outputs that the frame contributes to, found by walking in from
+    // just past where the filter could reach
+    void ScaledSpan(Axis const& axis, int32_t& offset, int32_t& length)
+    {
+        auto scale = 1.0 / axis.InverseScale;
+        auto first = std::max(static_cast<int32_t>(std::floor((axis.FrameOffset - axis.Support) * scale)) - 1, 0);
+        auto last = std::min(static_cast<int32_t>(std::ceil((axis.FrameEnd + axis.Support) * scale)) + 1, axis.ScaledLength - 1);
+        std::vector<double> weights;
+        std::vector<Tap> taps;
+        for (; first <= last; first++)
+        {
+            ComputeTaps(axis, first, weights, taps);
+            if (!taps.empty())
+            {
+                break;
+            }
+        }
+        if (first > last)
+        {
+            // The frame is too small to show up at all, keep a single
+            // transparent pixel where it would have been
+            offset = std::clamp(static_cast<int32_t>(std::floor(axis.FrameOffset * scale)), 0, axis.ScaledLength - 1);
+            length = 1;
+            return;
+        }
+        for (; last > first; last--)
+        {
+            ComputeTaps(axis, last, weights, taps);
+            if (!taps.empty())
+            {
+                break;
+            }
+        }
+        offset = first;
+        length = last - first + 1;
+    }
+
+    AxisWeights ComputeWeights(uint32_t length, uint32_t scaledLength, int32_t frameOffset, int32_t frameLength, ResampleFilter filter)
+    {
+        Axis canvas(length, scaledLength, frameOffset, frameLength, filter);
+        AxisWeights axis;
+        ScaledSpan(canvas, axis.Offset, axis.Length);
+
+        std::vector<std::vector<Tap>> outputs(axis.Length);
+        std::vector<double> weights;
+        int32_t taps = 0;
+        for (int32_t i = 0; i < axis.Length; i++)
+        {
+            auto&& output = outputs[i];
+            ComputeTaps(canvas, axis.Offset + i, weights, output);
+            if (!output.empty())
+            {
+                taps = std::max(taps, output.back().Source - output.front().Source + 1);
+            }
+        }
+        axis.Taps = std::max((taps + 1) & ~1, 2);
+        axis.Padding = axis.Taps;
+        axis.First.resize(axis.Length);
+        axis.Weights.assign(static_cast<size_t>(axis.Length) * axis.Taps, 0);
+        for (int32_t i = 0; i < axis.Length; i++)
+        {
+            // Outputs without taps stay transparent
+            auto&& output = outputs[i];
+            auto first = output.empty() ? 0 : output.front().Source;
+            axis.First[i] = first + axis.Padding;
+            for (auto&& tap : output)
+            {
+                axis.Weights[static_cast<size_t>(i) * axis.Taps + (tap.Source - first)] = static_cast<int16_t>(tap.Weight);
+            }
+        }
+        return axis;
+    }
+
+#if !RESAMPLER_SSE2
+    int16_t SaturateInt16(int32_t value)
+    {
+        return static_cast<int16_t>(std::clamp(value, -32768, 32767));
+    }
+#endif
+
+    // One row of the padded source into clipLength pixels of 4 int16s
+    void ResampleRow(uint8_t const* source, AxisWeights const& axis, int32_t clipOffset, int32_t clipLength, int16_t* destination)
+    {
+        for (int32_t x = 0; x < clipLength; x++)
+        {
+            auto output = clipOffset + x;
+            auto pixels = source + static_cast<size_t>(axis.First[output]) * 4;
+            auto weights = axis.Weights.data() + static_cast<size_t>(output) * axis.Taps;
+#if RESAMPLER_SSE2
+            auto zero = _mm_setzero_si128();
+            auto sum = _mm_setzero_si128();
+            for (int32_t tap = 0; tap < axis.Taps; tap += 2)
+            {
+                // [b0 g0 r0 a0 b1 g1 r1 a1] -> [b0 b1 g0 g1 r0 r1 a0 a1]
+                auto pair = _mm_unpacklo_epi8(_mm_loadl_epi64(reinterpret_cast<__m128i const*>(pixels + tap * 4)), zero);
+                pair = _mm_unpacklo_epi16(pair, _mm_srli_si128(pair, 8));
+                int32_t weightPair = 0;
+                std::memcpy(&weightPair, weights + tap, sizeof(weightPair));
+                sum = _mm_add_epi32(sum, _mm_madd_epi16(pair, _mm_set1_epi32(weightPair)));
+            }
+            sum = _mm_srai_epi32(_mm_add_epi32(sum, _mm_set1_epi32(1 << (HorizontalShift - 1))), HorizontalShift);
+            _mm_storel_epi64(reinterpret_cast<__m128i*>(destination + static_cast<size_t>(x) * 4), _mm_packs_epi32(sum, sum));
+#else
+            int32_t sums[4] = {};
+            for (int32_t tap = 0; tap < axis.Taps; tap++)
+            {
+                for (int32_t channel = 0; channel < 4; channel++)
+                {
+                    sums[channel] += pixels[tap * 4 + channel] * weights[tap];
+                }
+            }
+            for (int32_t channel = 0; channel < 4; channel++)
+            {
+                destination[static_cast<size_t>(x) * 4 + channel] = SaturateInt16((sums[channel] + (1 << (HorizontalShift - 1))) >> HorizontalShift);
+            }
+#endif
+        }
+    }
+
+    void ResamplePixelVertical(int16_t const* const* rows, int16_t const* weights, int32_t taps, size_t x, uint8_t* destination)
+    {
+        int32_t sums[4] = {};
+        for (int32_t tap = 0; tap < taps; tap++)
+        {
+            for (int32_t channel = 0; channel < 4; channel++)
+            {
+                sums[channel] += rows[tap][x * 4 + channel] * weights[tap];
+            }
+        }
+        uint8_t values[4] = {};
+        for (int32_t channel = 0; channel < 4; channel++)
+        {
+            values[channel] = static_cast<uint8_t>(std::clamp((sums[channel] + (1 << (VerticalShift - 1))) >> VerticalShift, 0, 255));
+        }
+        // Keep it a valid premultiplied color
+        for (int32_t channel = 0; channel < 3; channel++)
+        {
+            destination[channel] = std::min(values[channel], values[3]);
+        }
+        destination[3] = values[3];
+    }
+
+    // rows points at the Taps intermediate rows for one output row
+    void ResampleColumn(int16_t const* const* rows, int16_t const* weights, int32_t taps, int32_t clipLength, uint8_t* destination)
+    {
+        int32_t x = 0;
+#if RESAMPLER_SSE2
+        for (; x + 2 <= clipLength; x += 2)
+        {
+            auto offset = static_cast<size_t>(x) * 4;
+            auto first = _mm_setzero_si128();
+            auto second = _mm_setzero_si128();
+            for (int32_t tap = 0; tap < taps; tap += 2)
+            {
+                // Two pixels from two rows, interleaved by row
+                auto top = _mm_loadu_si128(reinterpret_cast<__m128i const*>(rows[tap] + offset));
+                auto bottom = _mm_loadu_si128(reinterpret_cast<__m128i const*>(rows[tap + 1] + offset));
+                auto weightPair = _mm_set1_epi32(static_cast<int32_t>(static_cast<uint16_t>(weights[tap]) | (static_cast<uint32_t>(static_cast<uint16_t>(weights[tap + 1])) << 16)));
+                first = _mm_add_epi32(first, _mm_madd_epi16(_mm_unpacklo_epi16(top, bottom), weightPair));
+                second = _mm_add_epi32(second, _mm_madd_epi16(_mm_unpackhi_epi16(top, bottom), weightPair));
+            }
+            auto rounding = _mm_set1_epi32(1 << (VerticalShift - 1));
+            first = _mm_srai_epi32(_mm_add_epi32(first, rounding), VerticalShift);
+            second = _mm_srai_epi32(_mm_add_epi32(second, rounding), VerticalShift);
+            auto packed = _mm_packus_epi16(_mm_packs_epi32(first, second), _mm_setzero_si128());
+            // Broadcast each pixel's alpha and clamp the colors to it
+            auto alpha = _mm_srli_epi32(packed, 24);
+            alpha = _mm_or_si128(alpha, _mm_slli_epi32(alpha, 8));
+            alpha = _mm_or_si128(alpha, _mm_slli_epi32(alpha, 16));
+            packed = _mm_min_epu8(packed, alpha);
+            _mm_storel_epi64(reinterpret_cast<__m128i*>(destination + offset), packed);
+        }
+#endif
+        for (; x < clipLength; x++)
+        {
+            ResamplePixelVertical(rows, weights, taps, static_cast<size_t>(x), destination + static_cast<size_t>(x) * 4);
+        }
+    }
+}
+
+void ImageScale::Apply(uint32_t width, uint32_t height, uint32_t& scaledWidth, uint32_t& scaledHeight) const noexcept
+{
+    auto factor = std::isfinite(Scale) && Scale > 0.0f ? static_cast<double>(Scale) : 1.0;
+    auto scaledW = std::max(static_cast<double>(width) * factor, 1.0);
+    auto scaledH = std::max(static_cast<double>(height) * factor, 1.0);
+    auto fit = [&](uint32_t maxWidth, uint32_t maxHeight)
+    {
+        if (maxWidth != 0 && scaledW > maxWidth)
+        {
+            scaledH = std::max(scaledH * maxWidth / scaledW, 1.0);
+            scaledW = maxWidth;
+        }
+        if (maxHeight != 0 && scaledH > maxHeight)
+        {
+            scaledW = std::max(scaledW * maxHeight / scaledH, 1.0);
+            scaledH = maxHeight;
+        }
+    };
+    fit(MaxWidth, MaxHeight);
+    fit(MaxSize, MaxSize);
+    scaledWidth = std::max(static_cast<uint32_t>(std::lround(scaledW)), 1u);
+    scaledHeight = std::max(static_cast<uint32_t>(std::lround(scaledH)), 1u);
+}
+
+FrameResampler::FrameResampler(uint32_t width, uint32_t height, uint32_t scaledWidth, uint32_t scaledHeight, ResampleFilter filter)
+{
+    if (width == 0 || height == 0 || scaledWidth == 0 || scaledHeight == 0)
+    {
+        throw std::invalid_argument("Can't resample an empty canvas");
+    }
+    m_width = width;
+    m_height = height;
+    m_scaledWidth = scaledWidth;
+    m_scaledHeight = scaledHeight;
+    m_filter = filter;
+}
+
+TileRect FrameResampler::ScaledRect(TileRect const& frameRect) const
+{
+    if (IsIdentity())
+    {
+        return frameRect;
+    }
+    // Only the edges need their weights worked out
+    TileRect rect;
+    ScaledSpan({ m_width, m_scaledWidth, frameRect.X, frameRect.Width, m_filter }, rect.X, rect.Width);
+    ScaledSpan({ m_height, m_scaledHeight, frameRect.Y, frameRect.Height, m_filter }, rect.Y, rect.Height);
+    return rect;
+}
+
+void FrameResampler::Resample(TileRect const& frameRect, uint8_t const* source, uint32_t sourcePitch, TileRect const& clip, uint8_t* destination, uint32_t destinationPitch) const
+{
+    auto horizontal = ComputeWeights(m_width, m_scaledWidth, frameRect.X, frameRect.Width, m_filter);
+    auto vertical = ComputeWeights(m_height, m_scaledHeight, frameRect.Y, frameRect.Height, m_filter);
+    if (clip.X < 0 || clip.Y < 0 || clip.Width <= 0 || clip.Height <= 0 || clip.Right() > horizontal.Length || clip.Bottom() > vertical.Length)
+    {
+        throw std::invalid_argument("Clip must be inside the scaled frame");
+    }
+
+    // Only the source rows the clip needs go through the horizontal pass,
+    // the rest of the padding stays transparent
+    auto firstRow = vertical.First[clip.Y];
+    auto lastRow = firstRow;
+    for (auto y = clip.Y; y < clip.Bottom(); y++)
+    {
+        firstRow = std::min(firstRow, vertical.First[y]);
+        lastRow = std::max(lastRow, vertical.First[y] + vertical.Taps);
+    }
+    auto rowLength = static_cast<size_t>(clip.Width) * 4;
+    std::vector<int16_t> intermediate(static_cast<size_t>(lastRow - firstRow) * rowLength, 0);
+    std::vector<uint8_t> paddedRow((static_cast<size_t>(frameRect.Width) + 2 * horizontal.Padding) * 4, 0);
+    for (auto row = firstRow; row < lastRow; row++)
+    {
+        auto sourceRow = row - vertical.Padding;
+        if (sourceRow < 0 || sourceRow >= frameRect.Height)
+        {
+            continue;
+        }
+        std::memcpy(paddedRow.data() + static_cast<size_t>(horizontal.Padding) * 4, source + static_cast<size_t>(sourceRow) * sourcePitch, static_cast<size_t>(frameRect.Width) * 4);
+        ResampleRow(paddedRow.data(), horizontal, clip.X, clip.Width, intermediate.data() + static_cast<size_t>(row - firstRow) * rowLength);
+    }
+
+    std::vector<int16_t const*> rows(vertical.Taps);
+    for (auto y = clip.Y; y < clip.Bottom(); y++)
+    {
+        for (int32_t tap = 0; tap < vertical.Taps; tap++)
+        {
+            rows[tap] = intermediate.data() + static_cast<size_t>(vertical.First[y] + tap - firstRow) * rowLength;
+        }
+        auto weights = vertical.Weights.data() + static_cast<size_t>(y) * vertical.Taps;
+        ResampleColumn(rows.data(), weights, vertical.Taps, clip.Width, destination + static_cast<size_t>(y - clip.Y) * destinationPitch);
+    }
+}
+
+void FrameResampler::Resample(TileRect const& frameRect, uint8_t const* source, uint32_t sourcePitch, uint8_t* destination, uint32_t destinationPitch) const
+{
+    auto scaledRect = ScaledRect(frameRect);
+    Resample(frameRect, source, sourcePitch, { 0, 0, scaledRect.Width, scaledRect.Height }, destination, destinationPitch);
+}
@@ -0,0 +1,75 @@
+#pragma once
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+#include "TileGrid.h"
+
+enum class ResampleFilter
+{
+    // Averages whatever each output pixel covers, cheapest and softest
+    Box,
+    Bilinear,
+    // Three lobes, sharpest
+    Lanczos,
+};
+
+// How big to draw a gif. The gif's own size is multiplied by Scale and
+// then shrunk to fit within MaxWidth x MaxHeight (if set), keeping the
+// aspect ratio.
+struct ImageScale
+{
+    float Scale = 1.0f;
+    uint32_t MaxWidth = 0;
+    uint32_t MaxHeight = 0;
+    ResampleFilter Filter = ResampleFilter::Lanczos;
+
+    // Nothing bigger than this on either side, which is as big as a D3D11
+    // texture can be
+    static constexpr uint32_t MaxSize = 16384;
+
+    // Never smaller than 1x1 or bigger than MaxSize x MaxSize. A scale
+    // that isn't a positive number counts as 1.
+    void Apply(uint32_t width, uint32_t height, uint32_t& scaledWidth, uint32_t& scaledHeight) const noexcept;
+    bool operator==(ImageScale const& other) const noexcept { return Scale == other.Scale && MaxWidth == other.MaxWidth && MaxHeight == other.MaxHeight && Filter == other.Filter; }
+    bool operator!=(ImageScale const& other) const noexcept { return !(*this == other); }
+};
+
+// Resamples premultiplied BGRA8 gif frames from the gif's canvas onto a
+// canvas of another size with a separable filter. A frame usually covers
+// only part of the canvas. Everything outside it counts as transparent, so
+// its edges blend with whatever is under them once drawn. Past the canvas
+// edges the filter is renormalized instead.
+//
+// Weights are 1.14 fixed point. Both passes use SSE2 where it's available,
+// and the scalar fallback gives bit-identical results. Resample doesn't
+// touch any state, so one resampler can be used from any number of threads.
+//
+// No Windows dependencies so that it can be built and benchmarked on its own.
+struct FrameResampler
+{
+    FrameResampler() {}
+    FrameResampler(uint32_t width, uint32_t height, uint32_t scaledWidth, uint32_t scaledHeight, ResampleFilter filter);
+
+    uint32_t Width() const noexcept { return m_width; }
+    uint32_t Height() const noexcept { return m_height; }
+    uint32_t ScaledWidth() const noexcept { return m_scaledWidth; }
+    uint32_t ScaledHeight() const noexcept { return m_scaledHeight; }
+    ResampleFilter Filter() const noexcept { return m_filter; }
+    bool IsIdentity() const noexcept { return m_width == m_scaledWidth && m_height == m_scaledHeight; }
+
+    // Where a frame lands on the scaled canvas, including the pixels its
+    // edges bleed into. Never empty.
+    TileRect ScaledRect(TileRect const& frameRect) const;
+    // Writes the part of the scaled frame inside clip, which is relative to
+    // ScaledRect(frameRect). destination points at the clip's top-left.
+    void Resample(TileRect const& frameRect, uint8_t const* source, uint32_t sourcePitch, TileRect const& clip, uint8_t* destination, uint32_t destinationPitch) const;
+    // Writes all of ScaledRect(frameRect)
+    void Resample(TileRect const& frameRect, uint8_t const* source, uint32_t sourcePitch, uint8_t* destination, uint32_t destinationPitch) const;
+
+private:
+    uint32_t m_width = 0;
+    uint32_t m_height = 0;
+    uint32_t m_scaledWidth = 0;
+    uint32_t m_scaledHeight = 0;
+    ResampleFilter m_filter = ResampleFilter::Lanczos;
+};
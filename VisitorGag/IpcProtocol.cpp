@@ -0,0 +1,219 @@
+#include "IpcProtocol.h"
+#include <charconv>
+
+namespace
+{
+    std::string_view NextToken(std::string_view& rest)
+    {
+        auto start = rest.find_first_not_of(' ');
+        if (start == std::string_view::npos)
+        {
+            rest = {};
+            return {};
+        }
+        rest.remove_prefix(start);
+        auto end = rest.find(' ');
+        auto token = rest.substr(0, end);
+        rest.remove_prefix(end == std::string_view::npos ? rest.size() : end);
+        return token;
+    }
+
+    std::string_view Trim(std::string_view value)
+    {
+        auto start = value.find_first_not_of(' ');
+        if (start == std::string_view::npos)
+        {
+            return {};
+        }
+        auto end = value.find_last_not_of(' ');
+        return value.substr(start, end - start + 1);
+    }
+
+    bool ParseUInt32(std::string_view token, uint32_t& value)
+    {
+        if (token.empty())
+        {
+            return false;
+        }
+        auto result = std::from_chars(token.data(), token.data() + token.size(), value);
+        return result.ec == std::errc() && result.ptr == token.data() + token.size();
+    }
+}
+
+std::optional<IpcCommand> ParseIpcCommand(std::string_view line, std::string& error)
+{
+    auto rest = line;
+    auto name = NextToken(rest);
+    IpcCommand command;
+    if (name == "show" || name == "stats")
+    {
+        command.Type = name == "show" ? IpcCommandType::Show : IpcCommandType::Stats;
+        if (!Trim(rest).empty())
+        {
+            error = "unexpected arguments";
+            return std::nullopt;
+        }
+    }
+    else if (name == "load")
+    {
+        // Paths can have spaces, so take the rest of the line
+        command.Type = IpcCommandType::Load;
+        command.Path = std::string(Trim(rest));
+        if (command.Path.empty())
+        {
+            error = "missing path";
+            return std::nullopt;
+        }
+    }
+    else if (name == "schedule")
+    {
+        command.Type = IpcCommandType::Schedule;
+        if (!ParseUInt32(NextToken(rest), command.MinDelayMs) ||
+            !ParseUInt32(NextToken(rest), command.MaxDelayMs) ||
+            !Trim(rest).empty())
+        {
+            error = "expected \"schedule <min ms> <max ms>\"";
+            return std::nullopt;
+        }
+        if (command.MinDelayMs > command.MaxDelayMs)
+        {
+            error = "min delay is greater than max delay";
+            return std::nullopt;
+        }
+    }
+    else
+    {
+        error = name.empty() ? "empty command" : "unknown command";
+        return std::nullopt;
+    }
+    return std::optional(std::move(command));
+}
+
+std::string FormatIpcResponse(bool success, std::string_view message)
+{
+    std::string response = success ? "ok" : "error";
+    if (!message.empty())
+    {
+        response += ' ';
+        // Keep the response on a single line
+        for (auto c : message)
+        {
+            response += (c == '\n' || c == '\r') ? ' ' : c;
+        }
+    }
+    response += '\n';
+    return response;
+}
+
+bool IpcLineBuffer::Append(char const* data, size_t size)
+{
+    m_buffer.append(data, size);
+    auto newline = m_buffer.find('\n', m_scanned);
+    auto pending = newline == std::string::npos ? m_buffer.size() : newline;
+    return pending <= MaxLineLength;
+}
+
+bool IpcLineBuffer::TryPopLine(std::string& line)
+{
+    auto newline = m_buffer.find('\n', m_scanned);
+    if (newline == std::string::npos)
+    {
+        m_scanned = m_buffer.size();
+        return false;
+    }
+    auto length = newline;
+    if (length > 0 && m_buffer[length - 1] == '\r')
+    {
+        length--;
+    }
+    line.assign(m_buffer, 0, length);
+    m_buffer.erase(0, newline + 1);
+    m_scanned = 0;
+    return true;
+}
+
+std::string HandleIpcLines(std::vector<std::string> const& lines, IpcBatchHandler const& handler)
+{
+    std::vector<std::optional<std::string>> results(lines.size());
+    std::vector<IpcCommand> commands;
+    for (size_t i = 0; i < lines.size(); i++)
+    {
+        std::string error;
+        if (auto command = ParseIpcCommand(lines[i], error))
+        {
+            commands.push_back(std::move(command.value()));
+        }
+        else
+        {
+            results[i] = FormatIpcResponse(false, error);
+        }
+    }
+
+    std::vector<std::string> handled;
+    if (!commands.empty())
+    {
+        auto responses = handler(commands);
+        if (!responses.has_value())
+        {
+            return {};
+        }
+        handled = std::move(responses.value());
+    }
+
+    std::string responses;
+    size_t nextHandled = 0;
+    for (auto&& result : results)
+    {
+        if (result.has_value())
+        {
+            responses += result.value();
+        }
+        else if (nextHandled < handled.size())
+        {
+            responses += handled[nextHandled++];
+        }
+        else
+        {
+            responses += FormatIpcResponse(false, "command failed");
+        }
+    }
+    return responses;
+}
+
+void ServeIpcClient(IpcRead const& read, IpcWrite const& write, IpcBatchHandler const& handler)
+{
+    IpcLineBuffer buffer;
+    std::vector<std::string> lines;
+    std::string line;
+    char readBuffer[IpcLineBuffer::MaxLineLength] = {};
+    while (true)
+    {
+        auto bytesRead = read(readBuffer, sizeof(readBuffer));
+        if (bytesRead == 0)
+        {
+            return;
+        }
+        if (!buffer.Append(readBuffer, bytesRead))
+        {
+            auto response = FormatIpcResponse(false, "line too long");
+            write(response.data(), response.size());
+            return;
+        }
+
+        // Everything that arrived together is handled together
+        lines.clear();
+        while (buffer.TryPopLine(line))
+        {
+            lines.push_back(line);
+        }
+        if (lines.empty())
+        {
+            continue;
+        }
+        auto responses = HandleIpcLines(lines, handler);
+        if (responses.empty() || !write(responses.data(), responses.size()))
+        {
+            return;
+        }
+    }
+}
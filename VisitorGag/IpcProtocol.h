@@ -0,0 +1,81 @@
+#pragma once
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <optional>
+#include <string>
+#include <string_view>
+#include <vector>
+
+// The resident mode protocol is newline-delimited UTF-8 text so that it's
+// easy to drive by hand. Each request line gets exactly one response line,
+// in order. A client may write several requests at once and they will be
+// handled as a single batch.
+//
+//   show                        Show the visitor now
+//   load <path>                 Load a gif, replacing the current one
+//   schedule <min ms> <max ms>  Reappear at random within the range after
+//                               being dismissed, "schedule 0 0" disables it
+//   stats                       Report playback and memory stats
+//
+// Responses start with "ok" or "error", optionally followed by a space and
+// a message.
+
+enum class IpcCommandType
+{
+    Show,
+    Load,
+    Schedule,
+    Stats,
+};
+
+struct IpcCommand
+{
+    IpcCommandType Type = IpcCommandType::Show;
+    std::string Path;
+    uint32_t MinDelayMs = 0;
+    uint32_t MaxDelayMs = 0;
+};
+
+// Returns nullopt and fills in error if the line isn't a valid request
+std::optional<IpcCommand> ParseIpcCommand(std::string_view line, std::string& error);
+std::string FormatIpcResponse(bool success, std::string_view message = {});
+
+// Accumulates bytes from a stream and splits them into lines. Carriage
+// returns before the newline are dropped.
+struct IpcLineBuffer
+{
+    // Lines longer than this are an error rather than an unbounded buffer
+    static constexpr size_t MaxLineLength = 4096;
+
+    // Returns false if the pending line grew past MaxLineLength, in which
+    // case the buffer should be discarded along with the connection.
+    bool Append(char const* data, size_t size);
+    bool TryPopLine(std::string& line);
+    void Clear() noexcept { m_buffer.clear(); m_scanned = 0; }
+
+private:
+    std::string m_buffer;
+    // How much of the buffer is known not to contain a newline
+    size_t m_scanned = 0;
+};
+
+// Handles a batch of commands and returns one response line (see
+// FormatIpcResponse) per command, in order. Returning nullopt drops the
+// client, e.g. because the server is shutting down.
+using IpcBatchHandler = std::function<std::optional<std::vector<std::string>>(std::vector<IpcCommand> const&)>;
+// Blocks until something arrives and returns how many bytes were read, or
+// zero once the client is gone
+using IpcRead = std::function<size_t(char* data, size_t size)>;
+// Returns false if the client is gone
+using IpcWrite = std::function<bool(char const* data, size_t size)>;
+
+// Answers a batch of request lines. Parse errors are answered directly and
+// every valid command goes to the handler in one call. Returns an empty
+// string if the handler dropped the client.
+std::string HandleIpcLines(std::vector<std::string> const& lines, IpcBatchHandler const& handler);
+
+// Serves one client until it disconnects, independent of the transport.
+// Every complete line read in one go is handled as a single batch, and the
+// responses are written back with a single write.
+void ServeIpcClient(IpcRead const& read, IpcWrite const& write, IpcBatchHandler const& handler);
@@ -0,0 +1,279 @@
+#include "LifecycleSimulation.h"
+#include "HibernationStateMachine.h"
+#include <algorithm>
+#include <memory>
+#include <queue>
+#include <vector>
+
+namespace
+{
+    using clock = VisitorLifecycle::clock;
+
+    enum class SimulationEventType
+    {
+        Load,
+        Shown,
+        Click,
+        Hidden,
+        Timer,
+        Hibernated,
+        Woken,
+    };
+
+    struct SimulationEvent
+    {
+        clock::time_point Time = {};
+        // Breaks ties so that runs are repeatable
+        uint64_t Sequence = 0;
+        size_t Visitor = 0;
+        SimulationEventType Type = SimulationEventType::Load;
+
+        bool operator>(SimulationEvent const& other) const noexcept
+        {
+            return Time != other.Time ? Time > other.Time : Sequence > other.Sequence;
+        }
+    };
+
+    struct Simulation;
+
+    struct SimulatedVisitor : IVisitorHost
+    {
+        SimulatedVisitor(Simulation& simulation, size_t index, LifecycleSimulationOptions const& options, uint64_t seed);
+
+        void ShowVisitor() override;
+        void HideVisitor() override;
+        void HibernateVisitor() override;
+        void WakeVisitor() override;
+        std::chrono::microseconds WakeLeadTime() override { return m_options.WakeTime * 2; }
+        void OnHibernated();
+        void BeginWake();
+
+        Simulation& m_simulation;
+        size_t m_index = 0;
+        LifecycleSimulationOptions const& m_options;
+        VisitorLifecycle Lifecycle;
+        HibernationStateMachine Hibernation;
+        // When an in-flight hibernate or wake finishes
+        clock::time_point m_hibernatedAt = {};
+        clock::time_point m_wokenAt = {};
+        std::optional<clock::time_point> ArmedDeadline;
+    };
+
+    struct Simulation
+    {
+        Simulation(LifecycleSimulationOptions const& options) : m_options(options), m_random(options.Seed)
+        {
+            m_visitors.reserve(options.Visitors);
+            for (uint32_t i = 0; i < options.Visitors; i++)
+            {
+                m_visitors.push_back(std::make_unique<SimulatedVisitor>(*this, i, options, m_random()));
+                m_bytes += options.AwakeBytes;
+            }
+        }
+
+        void Post(clock::time_point time, size_t visitor, SimulationEventType type)
+        {
+            m_events.push({ time, m_sequence++, visitor, type });
+        }
+
+        template <typename Duration>
+        Duration Random(Duration min, Duration max)
+        {
+            std::uniform_int_distribution<typename Duration::rep> dist(min.count(), std::max(min, max).count());
+            return Duration(dist(m_random));
+        }
+
+        // The capture device only does one capture at a time
+        clock::time_point ReserveCapture(clock::time_point earliest)
+        {
+            auto start = std::max(earliest, m_captureFreeAt);
+            m_captureFreeAt = start + m_options.CaptureTime;
+            return m_captureFreeAt;
+        }
+
+        void AddBytes(int64_t delta)
+        {
+            AccumulateBytes();
+            m_bytes = static_cast<uint64_t>(static_cast<int64_t>(m_bytes) + delta);
+            m_result.PeakBytes = std::max(m_result.PeakBytes, m_bytes);
+        }
+
+        void AccumulateBytes()
+        {
+            auto elapsed = std::chrono::duration<double>(Now - m_bytesSince).count();
+            m_byteSeconds += static_cast<double>(m_bytes) * elapsed;
+            m_bytesSince = Now;
+        }
+
+        LifecycleSimulationResult& Result() noexcept { return m_result; }
+
+        void ArmTimer(SimulatedVisitor& visitor)
+        {
+            auto deadline = visitor.Lifecycle.NextDeadline();
+            if (deadline.has_value() && deadline != visitor.ArmedDeadline)
+            {
+                Post(deadline.value(), visitor.m_index, SimulationEventType::Timer);
+            }
+            visitor.ArmedDeadline = deadline;
+        }
+
+        LifecycleSimulationResult Run()
+        {
+            auto wallStart = std::chrono::steady_clock::now();
+            auto end = clock::time_point{} + m_options.Duration;
+            m_result.PeakBytes = m_bytes;
+
+            // Everyone starts up within the first second
+            for (size_t i = 0; i < m_visitors.size(); i++)
+            {
+                Post(clock::time_point{} + Random(std::chrono::milliseconds(0), std::chrono::milliseconds(1000)), i, SimulationEventType::Load);
+            }
+
+            while (!m_events.empty() && m_events.top().Time <= end)
+            {
+                auto event = m_events.top();
+                m_events.pop();
+                Now = event.Time;
+                m_result.Events++;
+
+                auto&& visitor = *m_visitors[event.Visitor];
+                auto&& lifecycle = visitor.Lifecycle;
+                switch (event.Type)
+                {
+                case SimulationEventType::Load:
+                    lifecycle.OnGifLoaded(Now);
+                    break;
+                case SimulationEventType::Shown:
+                    lifecycle.OnShown(Now);
+                    m_visible++;
+                    m_result.PeakVisible = std::max(m_result.PeakVisible, m_visible);
+                    Post(Now + Random(m_options.MinClickDelay, m_options.MaxClickDelay), event.Visitor, SimulationEventType::Click);
+                    break;
+                case SimulationEventType::Click:
+                    m_visible--;
+                    lifecycle.OnClicked(Now);
+                    break;
+                case SimulationEventType::Hidden:
+                    lifecycle.OnHidden(Now);
+                    break;
+                case SimulationEventType::Timer:
+                    if (visitor.ArmedDeadline.has_value() && visitor.ArmedDeadline.value() <= Now)
+                    {
+                        visitor.ArmedDeadline.reset();
+                        lifecycle.OnTimer(Now);
+                    }
+                    break;
+                case SimulationEventType::Hibernated:
+                    visitor.OnHibernated();
+                    break;
+                case SimulationEventType::Woken:
+                    visitor.Hibernation.CompleteWake(Now, m_options.AwakeBytes);
+                    break;
+                }
+                ArmTimer(visitor);
+            }
+
+            Now = end;
+            AccumulateBytes();
+            m_result.AverageBytes = static_cast<uint64_t>(m_byteSeconds / std::chrono::duration<double>(m_options.Duration).count());
+
+            for (auto&& visitor : m_visitors)
+            {
+                auto&& stats = visitor->Lifecycle.Stats();
+                m_result.Totals.Shows += stats.Shows;
+                m_result.Totals.Hides += stats.Hides;
+                m_result.Totals.Hibernations += stats.Hibernations;
+                m_result.Totals.Wakes += stats.Wakes;
+                m_result.Totals.VisibleTime += stats.VisibleTime;
+                m_result.Totals.TotalShowLatency += stats.TotalShowLatency;
+                m_result.Totals.MaxShowLatency = std::max(m_result.Totals.MaxShowLatency, stats.MaxShowLatency);
+            }
+            m_result.Elapsed = std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now() - wallStart);
+            return m_result;
+        }
+
+        clock::time_point Now = {};
+
+    private:
+        LifecycleSimulationOptions const& m_options;
+        std::mt19937_64 m_random;
+        std::vector<std::unique_ptr<SimulatedVisitor>> m_visitors;
+        std::priority_queue<SimulationEvent, std::vector<SimulationEvent>, std::greater<SimulationEvent>> m_events;
+        uint64_t m_sequence = 0;
+        clock::time_point m_captureFreeAt = {};
+        uint64_t m_bytes = 0;
+        double m_byteSeconds = 0;
+        clock::time_point m_bytesSince = {};
+        uint32_t m_visible = 0;
+        LifecycleSimulationResult m_result = {};
+    };
+
+    SimulatedVisitor::SimulatedVisitor(Simulation& simulation, size_t index, LifecycleSimulationOptions const& options, uint64_t seed)
+        : m_simulation(simulation), m_index(index), m_options(options), Lifecycle(*this, false, options.Hibernate, seed)
+    {
+        Lifecycle.SetSchedule(options.MinDelayMs, options.MaxDelayMs);
+    }
+
+    void SimulatedVisitor::ShowVisitor()
+    {
+        // Can't capture until we're awake, then the animation plays
+        auto captured = m_simulation.ReserveCapture(std::max(m_simulation.Now, m_wokenAt));
+        m_simulation.Post(captured + m_options.AnimationTime, m_index, SimulationEventType::Shown);
+    }
+
+    void SimulatedVisitor::HideVisitor()
+    {
+        m_simulation.Post(m_simulation.Now + m_options.AnimationTime, m_index, SimulationEventType::Hidden);
+    }
+
+    void SimulatedVisitor::HibernateVisitor()
+    {
+        if (Hibernation.TryBeginHibernate(m_simulation.Now))
+        {
+            m_hibernatedAt = m_simulation.Now + m_options.HibernateTime;
+            m_simulation.Post(m_hibernatedAt, m_index, SimulationEventType::Hibernated);
+        }
+    }
+
+    void SimulatedVisitor::WakeVisitor()
+    {
+        if (Hibernation.TryBeginWake(m_simulation.Now))
+        {
+            m_simulation.AddBytes(static_cast<int64_t>(m_options.AwakeBytes) - static_cast<int64_t>(m_options.IdleBytes));
+            BeginWake();
+        }
+        else if (Hibernation.WakePending())
+        {
+            // Picked up once hibernating is done
+            m_wokenAt = m_hibernatedAt + m_options.WakeTime;
+            m_simulation.Result().WakesWhileHibernating++;
+        }
+    }
+
+    void SimulatedVisitor::OnHibernated()
+    {
+        if (Hibernation.CompleteHibernate(m_simulation.Now, m_options.IdleBytes))
+        {
+            if (Lifecycle.IsVisible())
+            {
+                m_simulation.Result().HibernatedWhileVisible++;
+            }
+            m_simulation.AddBytes(static_cast<int64_t>(m_options.IdleBytes) - static_cast<int64_t>(m_options.AwakeBytes));
+            return;
+        }
+        // A wake came in, so we never let go of anything
+        BeginWake();
+    }
+
+    void SimulatedVisitor::BeginWake()
+    {
+        m_wokenAt = m_simulation.Now + m_options.WakeTime;
+        m_simulation.Post(m_wokenAt, m_index, SimulationEventType::Woken);
+    }
+}
+
+LifecycleSimulationResult RunLifecycleSimulation(LifecycleSimulationOptions const& options)
+{
+    Simulation simulation(options);
+    return simulation.Run();
+}
@@ -0,0 +1,51 @@
+#pragma once
+#include <chrono>
+#include <cstdint>
+#include "VisitorLifecycle.h"
+
+// Runs any number of VisitorLifecycles against stubbed capture, animation
+// and hibernation back ends on a virtual clock, so that days of operation
+// take seconds. The back ends share a single capture device, so reveals
+// that come due at the same time queue up behind each other. Hibernating
+// and waking take time and go through HibernationStateMachine like the
+// app does, so a reveal can come due while the visitor is still going to
+// sleep.
+struct LifecycleSimulationOptions
+{
+    uint32_t Visitors = 1;
+    std::chrono::hours Duration{ 24 };
+    uint64_t Seed = 1;
+    bool Hibernate = false;
+    uint32_t MinDelayMs = 5000;
+    uint32_t MaxDelayMs = 30000;
+
+    std::chrono::milliseconds CaptureTime{ 30 };
+    std::chrono::milliseconds AnimationTime{ 800 };
+    // How long people take to click the visitor away
+    std::chrono::milliseconds MinClickDelay{ 1000 };
+    std::chrono::milliseconds MaxClickDelay{ 20000 };
+    std::chrono::milliseconds HibernateTime{ 20 };
+    std::chrono::milliseconds WakeTime{ 40 };
+    uint64_t AwakeBytes = 64ull * 1024 * 1024;
+    uint64_t IdleBytes = 4ull * 1024 * 1024;
+};
+
+struct LifecycleSimulationResult
+{
+    uint64_t Events = 0;
+    // Summed over every visitor, except MaxShowLatency
+    VisitorLifecycleStats Totals;
+    uint64_t PeakBytes = 0;
+    // Averaged over the simulated time
+    uint64_t AverageBytes = 0;
+    uint32_t PeakVisible = 0;
+    // Wakes asked for before hibernating had finished
+    uint32_t WakesWhileHibernating = 0;
+    // Hibernations that finished with the visitor on screen. Anything but
+    // zero means a wake got lost.
+    uint32_t HibernatedWhileVisible = 0;
+    // Real time it took to run
+    std::chrono::microseconds Elapsed{};
+};
+
+LifecycleSimulationResult RunLifecycleSimulation(LifecycleSimulationOptions const& options);
@@ -11,6 +11,9 @@ namespace winrt
 const std::wstring MainWindow::ClassName = L"VisitorGag.MainWindow";
 std::once_flag MainWindowClassRegistration;
 
+// Posted to ourselves from the cloak hook, wparam is non-zero when cloaked
+static constexpr UINT CloakChangedMessage = WM_APP + 1;
+
 void MainWindow::RegisterWindowClass()
 {
     auto instance = winrt::check_pointer(GetModuleHandleW(nullptr));
@@ -42,6 +45,35 @@ MainWindow::MainWindow(std::wstring const& titleString, int width, int height)
     winrt::check_bool(CreateWindowExW(exStyle, ClassName.c_str(), titleString.c_str(), style,
         CW_USEDEFAULT, CW_USEDEFAULT, adjustedWidth, adjustedHeight, nullptr, nullptr, instance, this));
     WINRT_ASSERT(m_window);
+
+    // Listen for the things that make drawing pointless. The display state
+    // notification is sent right away with the current state.
+    m_cloakHook.reset(SetWinEventHook(EVENT_OBJECT_CLOAKED, EVENT_OBJECT_UNCLOAKED, nullptr, OnWinEvent,
+        GetCurrentProcessId(), GetCurrentThreadId(), WINEVENT_OUTOFCONTEXT));
+    m_sessionNotify = WTSRegisterSessionNotification(m_window, NOTIFY_FOR_THIS_SESSION);
+    m_displayNotify.reset(RegisterPowerSettingNotification(m_window, &GUID_CONSOLE_DISPLAY_STATE, DEVICE_NOTIFY_WINDOW_HANDLE));
+}
+
+MainWindow::~MainWindow()
+{
+    if (m_sessionNotify)
+    {
+        WTSUnRegisterSessionNotification(m_window);
+    }
+}
+
+void CALLBACK MainWindow::OnWinEvent(HWINEVENTHOOK, DWORD event, HWND window, LONG objectId, LONG childId, DWORD, DWORD)
+{
+    if (objectId != OBJID_WINDOW || childId != CHILDID_SELF || window == nullptr)
+    {
+        return;
+    }
+    wchar_t className[64] = {};
+    GetClassNameW(window, className, ARRAYSIZE(className));
+    if (ClassName == className)
+    {
+        PostMessageW(window, CloakChangedMessage, event == EVENT_OBJECT_CLOAKED, 0);
+    }
 }
 
 LRESULT MainWindow::MessageHandler(UINT const message, WPARAM const wparam, LPARAM const lparam)
@@ -55,7 +87,30 @@ LRESULT MainWindow::MessageHandler(UINT const message, WPARAM const wparam, LPAR
         }
         break;
     case WM_DPICHANGED:
+        // The suggested rect is ignored, App rescales the gif and sizes the
+        // window for whichever monitor it picks before showing it
         break;
+    case CloakChangedMessage:
+        RaiseSuspendSignal(SuspendReason::Occluded, wparam != 0);
+        break;
+    case WM_WTSSESSION_CHANGE:
+        if (wparam == WTS_SESSION_LOCK || wparam == WTS_SESSION_UNLOCK)
+        {
+            RaiseSuspendSignal(SuspendReason::SessionLocked, wparam == WTS_SESSION_LOCK);
+        }
+        break;
+    case WM_POWERBROADCAST:
+        if (wparam == PBT_POWERSETTINGCHANGE)
+        {
+            auto setting = reinterpret_cast<POWERBROADCAST_SETTING const*>(lparam);
+            if (setting->PowerSetting == GUID_CONSOLE_DISPLAY_STATE && setting->DataLength >= sizeof(DWORD))
+            {
+                // 0 is off, 1 is on and 2 is dimmed
+                auto state = *reinterpret_cast<DWORD const*>(setting->Data);
+                RaiseSuspendSignal(SuspendReason::DisplayOff, state == 0);
+            }
+        }
+        return TRUE;
     default:
         return base_type::MessageHandler(message, wparam, lparam);
     }
@@ -77,3 +132,16 @@ void MainWindow::OnLButtonUp(std::function<void()> const& callback)
 {
     m_lButtonUp = callback;
 }
+
+void MainWindow::OnSuspendSignal(std::function<void(SuspendReason, bool)> const& callback)
+{
+    m_suspendSignal = callback;
+}
+
+void MainWindow::RaiseSuspendSignal(SuspendReason reason, bool active)
+{
+    if (m_suspendSignal != nullptr)
+    {
+        m_suspendSignal(reason, active);
+    }
+}
@@ -1,24 +1,35 @@
 #pragma once
 #include <robmikh.common/DesktopWindow.h>
+#include "PlaybackSuspension.h"
 
 struct MainWindow : robmikh::common::desktop::DesktopWindow<MainWindow>
 {
 	static const std::wstring ClassName;
 	MainWindow(std::wstring const& titleString, int width, int height);
+	~MainWindow();
 	LRESULT MessageHandler(UINT const message, WPARAM const wparam, LPARAM const lparam);
 
 	void Show(int32_t x, int32_t y, winrt::Windows::Graphics::SizeInt32 const& size);
 	void Hide();
 	void OnLButtonUp(std::function<void()> const& callback);
+	// Raised when the window gets cloaked, the session locks or the display
+	// turns off, and again when that stops being the case
+	void OnSuspendSignal(std::function<void(SuspendReason, bool)> const& callback);
 
 private:
 	static void RegisterWindowClass();
+	static void CALLBACK OnWinEvent(HWINEVENTHOOK hook, DWORD event, HWND window, LONG objectId, LONG childId, DWORD eventThread, DWORD eventTime);
+	void RaiseSuspendSignal(SuspendReason reason, bool active);
 
 	void PlayShowAnimation(winrt::Windows::Foundation::TimeSpan const& duration);
 	void PlayHideAnimation(winrt::Windows::Foundation::TimeSpan const& duration);
 
 private:
 	std::function<void()> m_lButtonUp;
+	std::function<void(SuspendReason, bool)> m_suspendSignal;
+	wil::unique_hwineventhook m_cloakHook;
+	wil::unique_hpowernotify m_displayNotify;
+	bool m_sessionNotify = false;
 	winrt::Windows::UI::Composition::Compositor m_compositor{ nullptr };
 	winrt::Windows::UI::Composition::Visual m_leftShadeVisual{ nullptr };
 	winrt::Windows::UI::Composition::Visual m_rightShadeVisual{ nullptr };
@@ -0,0 +1,215 @@
+#include "MemoryAccounting.h"
+#include <algorithm>
+#include <atomic>
+#include <cstdio>
+
+namespace
+{
+    // Each thread adds up its own changes and only folds them into the
+    // shared counters every so often, so the common case doesn't need a
+    // single interlocked instruction. Anything big enough to matter for the
+    // peak is folded in right away.
+    constexpr uint32_t FlushEveryOps = 64;
+    constexpr int64_t FlushEveryBytes = 256 * 1024;
+
+    struct SharedCounters
+    {
+        // Signed, frees can be folded in before the allocations they free
+        std::atomic<int64_t> LiveBytes{ 0 };
+        std::atomic<uint64_t> PeakBytes{ 0 };
+        std::atomic<uint64_t> Allocations{ 0 };
+        std::atomic<uint64_t> Frees{ 0 };
+    };
+
+    struct alignas(64) TagCounters
+    {
+        SharedCounters Kinds[2];
+    };
+
+    struct LocalCounters
+    {
+        int64_t LiveBytes;
+        uint64_t Allocations;
+        uint64_t Frees;
+        uint32_t Pending;
+    };
+
+    // Folds in whatever a thread still has batched up when it exits
+    struct ThreadExitFlush
+    {
+        ~ThreadExitFlush();
+    };
+
+    // These are constant initialized and trivially destructible, so they're
+    // safe to use from allocations made before main or during thread exit
+    TagCounters g_counters[MemoryTagCount];
+    thread_local LocalCounters t_local[MemoryTagCount][2];
+    thread_local MemoryTag t_currentTag = MemoryTag::App;
+    thread_local bool t_exitFlushArmed = false;
+    // Set once the exit flush has run. Other thread_local destructors can
+    // still allocate and free after that, those changes are folded in
+    // right away.
+    thread_local bool t_exited = false;
+    // Only touched once per thread, since the first touch registers its
+    // destructor
+    thread_local ThreadExitFlush t_exitFlush;
+
+    void Flush(MemoryTag tag, MemoryKind kind) noexcept
+    {
+        auto&& local = t_local[static_cast<size_t>(tag)][static_cast<size_t>(kind)];
+        auto&& shared = g_counters[static_cast<size_t>(tag)].Kinds[static_cast<size_t>(kind)];
+        shared.Allocations.fetch_add(local.Allocations, std::memory_order_relaxed);
+        shared.Frees.fetch_add(local.Frees, std::memory_order_relaxed);
+        auto live = shared.LiveBytes.fetch_add(local.LiveBytes, std::memory_order_relaxed) + local.LiveBytes;
+        if (live > 0)
+        {
+            auto peak = shared.PeakBytes.load(std::memory_order_relaxed);
+            while (static_cast<uint64_t>(live) > peak && !shared.PeakBytes.compare_exchange_weak(peak, static_cast<uint64_t>(live), std::memory_order_relaxed))
+            {
+            }
+        }
+        local = {};
+    }
+
+    void FlushThread() noexcept
+    {
+        for (size_t i = 0; i < MemoryTagCount; i++)
+        {
+            Flush(static_cast<MemoryTag>(i), MemoryKind::Heap);
+            Flush(static_cast<MemoryTag>(i), MemoryKind::Texture);
+        }
+    }
+
+    ThreadExitFlush::~ThreadExitFlush()
+    {
+        FlushThread();
+        t_exited = true;
+    }
+
+    void ArmExitFlush() noexcept
+    {
+        t_exitFlushArmed = true;
+        static_cast<void>(&t_exitFlush);
+    }
+
+    MemoryCounters Read(SharedCounters const& counters) noexcept
+    {
+        MemoryCounters result;
+        result.LiveBytes = static_cast<uint64_t>(std::max<int64_t>(counters.LiveBytes.load(std::memory_order_relaxed), 0));
+        result.PeakBytes = counters.PeakBytes.load(std::memory_order_relaxed);
+        result.Allocations = counters.Allocations.load(std::memory_order_relaxed);
+        result.Frees = counters.Frees.load(std::memory_order_relaxed);
+        return result;
+    }
+}
+
+char const* MemoryTagName(MemoryTag tag) noexcept
+{
+    switch (tag)
+    {
+    case MemoryTag::App:
+        return "app";
+    case MemoryTag::Decoder:
+        return "decoder";
+    case MemoryTag::Player:
+        return "player";
+    case MemoryTag::Capture:
+        return "capture";
+    }
+    return "unknown";
+}
+
+void RecordAllocation(MemoryTag tag, MemoryKind kind, uint64_t bytes) noexcept
+{
+    if (!t_exitFlushArmed)
+    {
+        ArmExitFlush();
+    }
+    auto&& local = t_local[static_cast<size_t>(tag)][static_cast<size_t>(kind)];
+    local.Allocations++;
+    local.LiveBytes += static_cast<int64_t>(bytes);
+    if (++local.Pending >= FlushEveryOps || local.LiveBytes >= FlushEveryBytes || t_exited)
+    {
+        Flush(tag, kind);
+    }
+}
+
+void RecordFree(MemoryTag tag, MemoryKind kind, uint64_t bytes) noexcept
+{
+    if (!t_exitFlushArmed)
+    {
+        ArmExitFlush();
+    }
+    auto&& local = t_local[static_cast<size_t>(tag)][static_cast<size_t>(kind)];
+    local.Frees++;
+    local.LiveBytes -= static_cast<int64_t>(bytes);
+    if (++local.Pending >= FlushEveryOps || local.LiveBytes <= -FlushEveryBytes || t_exited)
+    {
+        Flush(tag, kind);
+    }
+}
+
+MemoryReport ReadMemoryReport() noexcept
+{
+    // At least the calling thread's numbers are exact
+    FlushThread();
+    MemoryReport report;
+    for (size_t i = 0; i < MemoryTagCount; i++)
+    {
+        report.Tags[i].Heap = Read(g_counters[i].Kinds[static_cast<size_t>(MemoryKind::Heap)]);
+        report.Tags[i].Textures = Read(g_counters[i].Kinds[static_cast<size_t>(MemoryKind::Texture)]);
+    }
+    return report;
+}
+
+std::string FormatMemoryReport(MemoryReport const& report)
+{
+    auto toMB = [](uint64_t bytes) { return static_cast<double>(bytes) / (1024.0 * 1024.0); };
+    std::string result;
+    char line[160] = {};
+    for (size_t i = 0; i < MemoryTagCount; i++)
+    {
+        auto&& usage = report.Tags[i];
+        snprintf(line, sizeof(line), "%s%s heap %.1f MB (peak %.1f MB, %llu allocs)",
+            i == 0 ? "" : ", ",
+            MemoryTagName(static_cast<MemoryTag>(i)),
+            toMB(usage.Heap.LiveBytes), toMB(usage.Heap.PeakBytes),
+            static_cast<unsigned long long>(usage.Heap.Allocations));
+        result += line;
+        if (usage.Textures.Allocations > 0)
+        {
+            snprintf(line, sizeof(line), " textures %.1f MB (peak %.1f MB, %llu allocs)",
+                toMB(usage.Textures.LiveBytes), toMB(usage.Textures.PeakBytes),
+                static_cast<unsigned long long>(usage.Textures.Allocations));
+            result += line;
+        }
+    }
+    return result;
+}
+
+MemoryTag CurrentMemoryTag() noexcept
+{
+    return t_currentTag;
+}
+
+void SetThreadMemoryTag(MemoryTag tag) noexcept
+{
+    t_currentTag = tag;
+}
+
+void FlushThreadMemoryCounters() noexcept
+{
+    FlushThread();
+}
+
+MemoryTagScope::MemoryTagScope(MemoryTag tag) noexcept
+{
+    m_previous = t_currentTag;
+    t_currentTag = tag;
+}
+
+MemoryTagScope::~MemoryTagScope()
+{
+    FlushThread();
+    t_currentTag = m_previous;
+}
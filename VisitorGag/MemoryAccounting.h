@@ -0,0 +1,78 @@
+#pragma once
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <string>
+
+// Who memory is charged to. Heap allocations go to the tag of the thread
+// that made them (see MemoryTagScope), textures are charged explicitly.
+enum class MemoryTag : uint32_t
+{
+    // Everything that isn't tagged, including WinRT and window plumbing
+    App,
+    Decoder,
+    Player,
+    Capture,
+};
+static constexpr size_t MemoryTagCount = 4;
+
+enum class MemoryKind : uint32_t
+{
+    Heap,
+    Texture,
+};
+
+struct MemoryCounters
+{
+    uint64_t LiveBytes = 0;
+    uint64_t PeakBytes = 0;
+    uint64_t Allocations = 0;
+    uint64_t Frees = 0;
+};
+
+struct MemoryTagUsage
+{
+    MemoryCounters Heap;
+    MemoryCounters Textures;
+};
+
+struct MemoryReport
+{
+    std::array<MemoryTagUsage, MemoryTagCount> Tags;
+};
+
+// Cheap enough to stay on in release builds: each thread batches its
+// changes and folds them into the shared counters every 64 operations,
+// every 256 KB, when a MemoryTagScope ends and when the thread exits.
+// Reports can therefore lag behind other threads by up to that much, and
+// peaks are only as exact as the batching allows.
+//
+// No Windows dependencies so that it can be built and benchmarked on its
+// own. The heap side only sees allocations once MemoryAccountingHooks.cpp
+// is linked in.
+char const* MemoryTagName(MemoryTag tag) noexcept;
+void RecordAllocation(MemoryTag tag, MemoryKind kind, uint64_t bytes) noexcept;
+void RecordFree(MemoryTag tag, MemoryKind kind, uint64_t bytes) noexcept;
+MemoryReport ReadMemoryReport() noexcept;
+// One line, e.g. "decoder heap 1.2 MB (peak 3.4 MB, 567 allocs) ..."
+std::string FormatMemoryReport(MemoryReport const& report);
+
+MemoryTag CurrentMemoryTag() noexcept;
+// Sets the tag for everything the calling thread allocates from now on,
+// for threads that only ever work for one subsystem
+void SetThreadMemoryTag(MemoryTag tag) noexcept;
+// Folds the calling thread's batched changes into the shared counters
+void FlushThreadMemoryCounters() noexcept;
+
+// Charges the calling thread's heap allocations to a tag until it goes out
+// of scope. Must not span a co_await, the coroutine may resume elsewhere.
+struct MemoryTagScope
+{
+    explicit MemoryTagScope(MemoryTag tag) noexcept;
+    ~MemoryTagScope();
+    MemoryTagScope(MemoryTagScope const&) = delete;
+    MemoryTagScope& operator=(MemoryTagScope const&) = delete;
+
+private:
+    MemoryTag m_previous = MemoryTag::App;
+};
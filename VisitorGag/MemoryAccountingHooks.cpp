@@ -0,0 +1,109 @@
+#include "MemoryAccounting.h"
+#include <cstdint>
+#include <cstdlib>
+#include <new>
+
+// Replaces the global allocation functions so that every heap allocation is
+// charged to the allocating thread's tag. Every form that the default
+// implementations might not route through operator new(size_t) and
+// operator delete(void*) is replaced too. Over-aligned allocations keep
+// the default implementation and aren't counted.
+//
+// Each block carries a header with its size and tag so that it can be
+// charged back to the same tag no matter which thread frees it. The header
+// is 16 bytes to keep the alignment malloc gives us.
+
+namespace
+{
+    struct AllocationHeader
+    {
+        uint64_t Size;
+        MemoryTag Tag;
+        uint32_t Reserved;
+    };
+    static_assert(sizeof(AllocationHeader) == 16);
+}
+
+void* operator new(std::size_t size)
+{
+    // The header would wrap around to a tiny block
+    if (size > SIZE_MAX - sizeof(AllocationHeader))
+    {
+        throw std::bad_alloc();
+    }
+    while (true)
+    {
+        if (auto block = static_cast<AllocationHeader*>(std::malloc(size + sizeof(AllocationHeader))))
+        {
+            auto tag = CurrentMemoryTag();
+            block->Size = size;
+            block->Tag = tag;
+            RecordAllocation(tag, MemoryKind::Heap, size);
+            return block + 1;
+        }
+        auto handler = std::get_new_handler();
+        if (handler == nullptr)
+        {
+            throw std::bad_alloc();
+        }
+        handler();
+    }
+}
+
+void operator delete(void* pointer) noexcept
+{
+    if (pointer == nullptr)
+    {
+        return;
+    }
+    auto block = static_cast<AllocationHeader*>(pointer) - 1;
+    RecordFree(block->Tag, MemoryKind::Heap, block->Size);
+    std::free(block);
+}
+
+void* operator new[](std::size_t size)
+{
+    return operator new(size);
+}
+
+void* operator new(std::size_t size, std::nothrow_t const&) noexcept
+{
+    try
+    {
+        return operator new(size);
+    }
+    catch (std::bad_alloc const&)
+    {
+        return nullptr;
+    }
+}
+
+void* operator new[](std::size_t size, std::nothrow_t const&) noexcept
+{
+    return operator new(size, std::nothrow);
+}
+
+void operator delete[](void* pointer) noexcept
+{
+    operator delete(pointer);
+}
+
+void operator delete(void* pointer, std::size_t) noexcept
+{
+    operator delete(pointer);
+}
+
+void operator delete[](void* pointer, std::size_t) noexcept
+{
+    operator delete(pointer);
+}
+
+void operator delete(void* pointer, std::nothrow_t const&) noexcept
+{
+    operator delete(pointer);
+}
+
+void operator delete[](void* pointer, std::nothrow_t const&) noexcept
+{
+    operator delete(pointer);
+}
@@ -0,0 +1,66 @@
+#pragma once
+#include <atomic>
+#include <optional>
+#include <utility>
+
+// An unbounded, lock-free, multi-producer single-consumer queue (based on
+// Dmitry Vyukov's intrusive MPSC node queue). Push may be called from any
+// thread. TryPop must only ever be called from a single consumer thread.
+//
+// A producer that has been preempted halfway through Push can briefly hide
+// the items pushed after it. The consumer simply sees an empty queue and
+// picks them up on its next drain, so producers should always make sure a
+// drain is scheduled after pushing.
+template <typename T>
+struct MpscQueue
+{
+    MpscQueue()
+    {
+        auto stub = new Node();
+        m_head.store(stub, std::memory_order_relaxed);
+        m_tail = stub;
+    }
+
+    ~MpscQueue()
+    {
+        while (TryPop().has_value());
+        delete m_tail;
+    }
+
+    MpscQueue(MpscQueue const&) = delete;
+    MpscQueue& operator=(MpscQueue const&) = delete;
+
+    void Push(T value)
+    {
+        auto node = new Node();
+        node->Value.emplace(std::move(value));
+        auto previous = m_head.exchange(node, std::memory_order_acq_rel);
+        previous->Next.store(node, std::memory_order_release);
+    }
+
+    std::optional<T> TryPop()
+    {
+        auto tail = m_tail;
+        auto next = tail->Next.load(std::memory_order_acquire);
+        if (next == nullptr)
+        {
+            return std::nullopt;
+        }
+        // The next node becomes the new stub
+        std::optional<T> result(std::move(next->Value));
+        next->Value.reset();
+        m_tail = next;
+        delete tail;
+        return result;
+    }
+
+private:
+    struct Node
+    {
+        std::atomic<Node*> Next = nullptr;
+        std::optional<T> Value;
+    };
+
+    std::atomic<Node*> m_head;
+    Node* m_tail = nullptr;
+};
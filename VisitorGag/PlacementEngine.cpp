@@ -0,0 +1,185 @@
+#include "PlacementEngine.h"
+#include <algorithm>
+#include <limits>
+
+#if defined(_M_X64) || defined(_M_IX86) || defined(__SSE2__)
+#include <emmintrin.h>
+#define PLACEMENT_SSE2 1
+#endif
+
+namespace
+{
+    // Integer BT.709 luma, weights sum to 256
+    inline uint32_t Luminance(uint8_t const* bgra)
+    {
+        return (19u * bgra[0] + 183u * bgra[1] + 54u * bgra[2]) >> 8;
+    }
+
+#if PLACEMENT_SSE2
+    // Luminance of four pixels, one per 32-bit lane, exactly as above
+    inline __m128i Luminance4(uint8_t const* bgra)
+    {
+        auto weights = _mm_setr_epi16(19, 183, 54, 0, 19, 183, 54, 0);
+        auto zero = _mm_setzero_si128();
+        auto pixels = _mm_loadu_si128(reinterpret_cast<__m128i const*>(bgra));
+        // Blue and green, then red and alpha, of two pixels each
+        auto low = _mm_castsi128_ps(_mm_madd_epi16(_mm_unpacklo_epi8(pixels, zero), weights));
+        auto high = _mm_castsi128_ps(_mm_madd_epi16(_mm_unpackhi_epi8(pixels, zero), weights));
+        auto blueGreen = _mm_castps_si128(_mm_shuffle_ps(low, high, _MM_SHUFFLE(2, 0, 2, 0)));
+        auto redAlpha = _mm_castps_si128(_mm_shuffle_ps(low, high, _MM_SHUFFLE(3, 1, 3, 1)));
+        return _mm_srli_epi32(_mm_add_epi32(blueGreen, redAlpha), 8);
+    }
+
+    inline uint32_t HorizontalSum(__m128i value)
+    {
+        value = _mm_add_epi32(value, _mm_srli_si128(value, 8));
+        value = _mm_add_epi32(value, _mm_srli_si128(value, 4));
+        return static_cast<uint32_t>(_mm_cvtsi128_si32(value));
+    }
+#endif
+
+    // Adds up the luminance and squared luminance of a run of pixels
+    inline void SumLuminance(uint8_t const* bgra, uint32_t count, uint32_t& sum, uint32_t& squares)
+    {
+        uint32_t i = 0;
+#if PLACEMENT_SSE2
+        if (count >= 8)
+        {
+            // Eight pixels at a time as 16-bit lanes, madd then adds up
+            // pairs of sums and pairs of squares
+            auto ones = _mm_set1_epi16(1);
+            auto sums = _mm_setzero_si128();
+            auto squareSums = _mm_setzero_si128();
+            for (; i + 8 <= count; i += 8)
+            {
+                auto luminance = _mm_packs_epi32(Luminance4(bgra + i * 4), Luminance4(bgra + i * 4 + 16));
+                sums = _mm_add_epi32(sums, _mm_madd_epi16(luminance, ones));
+                squareSums = _mm_add_epi32(squareSums, _mm_madd_epi16(luminance, luminance));
+            }
+            sum += HorizontalSum(sums);
+            squares += HorizontalSum(squareSums);
+        }
+#endif
+        for (; i < count; i++)
+        {
+            auto luminance = Luminance(bgra + i * 4);
+            sum += luminance;
+            squares += luminance * luminance;
+        }
+    }
+}
+
+PlacementEngine::PlacementEngine(uint32_t cellSize)
+{
+    m_cellSize = std::max(cellSize, 1u);
+}
+
+void PlacementEngine::Analyze(uint8_t const* bytes, uint32_t width, uint32_t height, uint32_t rowPitch)
+{
+    m_width = width;
+    m_height = height;
+    m_cellsX = width / m_cellSize;
+    m_cellsY = height / m_cellSize;
+
+    auto stride = static_cast<size_t>(m_cellsX) + 1;
+    m_sum.assign(stride * (static_cast<size_t>(m_cellsY) + 1), 0);
+    m_sumSquares.assign(m_sum.size(), 0);
+
+    std::vector<uint64_t> cellSums(m_cellsX);
+    std::vector<uint64_t> cellSquares(m_cellsX);
+    for (uint32_t cellY = 0; cellY < m_cellsY; cellY++)
+    {
+        std::fill(cellSums.begin(), cellSums.end(), 0);
+        std::fill(cellSquares.begin(), cellSquares.end(), 0);
+        for (uint32_t row = 0; row < m_cellSize; row++)
+        {
+            auto line = bytes + static_cast<size_t>(cellY * m_cellSize + row) * rowPitch;
+            for (uint32_t cellX = 0; cellX < m_cellsX; cellX++)
+            {
+                uint32_t sum = 0;
+                uint32_t squares = 0;
+                SumLuminance(line + static_cast<size_t>(cellX) * m_cellSize * 4, m_cellSize, sum, squares);
+                cellSums[cellX] += sum;
+                cellSquares[cellX] += squares;
+            }
+        }
+
+        // Accumulate into the summed-area tables
+        auto previousSum = m_sum.data() + static_cast<size_t>(cellY) * stride;
+        auto previousSquares = m_sumSquares.data() + static_cast<size_t>(cellY) * stride;
+        auto currentSum = previousSum + stride;
+        auto currentSquares = previousSquares + stride;
+        uint64_t rowSum = 0;
+        uint64_t rowSquares = 0;
+        for (uint32_t cellX = 0; cellX < m_cellsX; cellX++)
+        {
+            rowSum += cellSums[cellX];
+            rowSquares += cellSquares[cellX];
+            currentSum[cellX + 1] = previousSum[cellX + 1] + rowSum;
+            currentSquares[cellX + 1] = previousSquares[cellX + 1] + rowSquares;
+        }
+    }
+}
+
+void PlacementEngine::ScoreCandidates(uint32_t regionWidth, uint32_t regionHeight)
+{
+    m_candidates.clear();
+    if (regionWidth == 0 || regionHeight == 0 || regionWidth > m_width || regionHeight > m_height)
+    {
+        return;
+    }
+
+    // Round the region up to whole cells, but never past the image
+    auto regionCellsX = std::min((regionWidth + m_cellSize - 1) / m_cellSize, m_cellsX);
+    auto regionCellsY = std::min((regionHeight + m_cellSize - 1) / m_cellSize, m_cellsY);
+    if (regionCellsX == 0 || regionCellsY == 0)
+    {
+        // The image is smaller than a single cell, anywhere is as good as anywhere else
+        m_candidates.push_back({ 0, 0 });
+        return;
+    }
+    auto positionsX = m_cellsX - regionCellsX + 1;
+    auto positionsY = m_cellsY - regionCellsY + 1;
+    auto stride = static_cast<size_t>(m_cellsX) + 1;
+    auto inverseCount = 1.0 / (static_cast<double>(regionCellsX) * regionCellsY * m_cellSize * m_cellSize);
+
+    // Each row of candidates is scored with a straight-line loop over
+    // contiguous table rows, there are far fewer candidates than pixels.
+    m_scores.resize(static_cast<size_t>(positionsX) * positionsY);
+    auto bestScore = std::numeric_limits<double>::max();
+    for (uint32_t y = 0; y < positionsY; y++)
+    {
+        auto sumTop = m_sum.data() + static_cast<size_t>(y) * stride;
+        auto sumBottom = sumTop + static_cast<size_t>(regionCellsY) * stride;
+        auto squaresTop = m_sumSquares.data() + static_cast<size_t>(y) * stride;
+        auto squaresBottom = squaresTop + static_cast<size_t>(regionCellsY) * stride;
+        auto scores = m_scores.data() + static_cast<size_t>(y) * positionsX;
+        for (uint32_t x = 0; x < positionsX; x++)
+        {
+            auto sum = sumBottom[x + regionCellsX] - sumBottom[x] - sumTop[x + regionCellsX] + sumTop[x];
+            auto squares = squaresBottom[x + regionCellsX] - squaresBottom[x] - squaresTop[x + regionCellsX] + squaresTop[x];
+            auto mean = static_cast<double>(sum) * inverseCount;
+            scores[x] = static_cast<double>(squares) * inverseCount - mean * mean;
+        }
+        bestScore = std::min(bestScore, *std::min_element(scores, scores + positionsX));
+    }
+
+    auto threshold = bestScore * 1.05 + 1.0;
+    auto maxX = static_cast<int32_t>(m_width - regionWidth);
+    auto maxY = static_cast<int32_t>(m_height - regionHeight);
+    for (uint32_t y = 0; y < positionsY; y++)
+    {
+        auto scores = m_scores.data() + static_cast<size_t>(y) * positionsX;
+        for (uint32_t x = 0; x < positionsX; x++)
+        {
+            if (scores[x] <= threshold)
+            {
+                m_candidates.push_back(
+                    {
+                        std::min(static_cast<int32_t>(x * m_cellSize), maxX),
+                        std::min(static_cast<int32_t>(y * m_cellSize), maxY),
+                    });
+            }
+        }
+    }
+}
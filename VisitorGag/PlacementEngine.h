@@ -0,0 +1,57 @@
+#pragma once
+#include <cstdint>
+#include <optional>
+#include <random>
+#include <vector>
+
+// PlacementEngine has no Windows dependencies so that it can be built and
+// profiled on its own. It expects tightly-defined BGRA8 input (the format
+// our capture sources produce).
+
+struct PlacementPoint
+{
+    int32_t X = 0;
+    int32_t Y = 0;
+};
+
+struct PlacementEngine
+{
+    PlacementEngine(uint32_t cellSize = 8);
+
+    // Downsamples the image into cells and builds summed-area tables of
+    // the per-cell luminance sums and squared sums.
+    void Analyze(uint8_t const* bytes, uint32_t width, uint32_t height, uint32_t rowPitch);
+
+    // Picks the top-left corner (in source pixels) of a region of the given
+    // size with low luminance variance. Ties within a small tolerance of the
+    // best score are broken randomly so the visitor doesn't always pick the
+    // same spot on a mostly empty desktop.
+    template <typename RandomEngine>
+    std::optional<PlacementPoint> FindQuietRegion(uint32_t regionWidth, uint32_t regionHeight, RandomEngine&& random)
+    {
+        ScoreCandidates(regionWidth, regionHeight);
+        if (m_candidates.empty())
+        {
+            return std::nullopt;
+        }
+        std::uniform_int_distribution<size_t> dist(0, m_candidates.size() - 1);
+        return std::optional(m_candidates[dist(random)]);
+    }
+
+    uint32_t CellSize() const noexcept { return m_cellSize; }
+
+private:
+    void ScoreCandidates(uint32_t regionWidth, uint32_t regionHeight);
+
+private:
+    uint32_t m_cellSize = 8;
+    uint32_t m_width = 0;
+    uint32_t m_height = 0;
+    uint32_t m_cellsX = 0;
+    uint32_t m_cellsY = 0;
+    // (m_cellsX + 1) * (m_cellsY + 1) entries each, first row/column are zero
+    std::vector<uint64_t> m_sum;
+    std::vector<uint64_t> m_sumSquares;
+    std::vector<double> m_scores;
+    std::vector<PlacementPoint> m_candidates;
+};
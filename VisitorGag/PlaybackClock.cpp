@@ -0,0 +1,178 @@
+#include "PlaybackClock.h"
+#include <algorithm>
+#include <stdexcept>
+
+PlaybackClock::PlaybackClock(clock::duration batchWindow, clock::time_point now)
+    : m_batchWindow(batchWindow), m_start(now)
+{
+}
+
+PlaybackClock::ClientId PlaybackClock::Register()
+{
+    ClientId client = 0;
+    if (!m_freeIds.empty())
+    {
+        client = m_freeIds.back();
+        m_freeIds.pop_back();
+    }
+    else
+    {
+        client = static_cast<ClientId>(m_positions.size());
+        m_positions.push_back(NotQueued);
+        m_registered.push_back(false);
+    }
+    m_registered[client] = true;
+    m_clients++;
+    return client;
+}
+
+void PlaybackClock::Unregister(ClientId client)
+{
+    if (client >= m_registered.size() || !m_registered[client])
+    {
+        throw std::invalid_argument("Unknown playback clock client");
+    }
+    Cancel(client);
+    m_registered[client] = false;
+    m_freeIds.push_back(client);
+    m_clients--;
+}
+
+void PlaybackClock::Schedule(ClientId client, clock::time_point deadline)
+{
+    if (client >= m_registered.size() || !m_registered[client])
+    {
+        throw std::invalid_argument("Unknown playback clock client");
+    }
+    auto position = m_positions[client];
+    if (position == NotQueued)
+    {
+        m_heap.push_back({ deadline, client });
+        m_positions[client] = m_heap.size() - 1;
+        SiftUp(m_heap.size() - 1);
+        return;
+    }
+    auto earlier = deadline < m_heap[position].Time;
+    m_heap[position].Time = deadline;
+    if (earlier)
+    {
+        SiftUp(position);
+    }
+    else
+    {
+        SiftDown(position);
+    }
+}
+
+void PlaybackClock::Cancel(ClientId client)
+{
+    if (IsScheduled(client))
+    {
+        Remove(m_positions[client]);
+    }
+}
+
+std::optional<PlaybackClock::clock::time_point> PlaybackClock::NextWake() const
+{
+    if (m_heap.empty())
+    {
+        return std::nullopt;
+    }
+    return m_heap.front().Time;
+}
+
+void PlaybackClock::CollectDue(clock::time_point now, std::vector<ClientId>& due)
+{
+    m_wakeups++;
+    auto horizon = now + m_batchWindow;
+    size_t fanOut = 0;
+    while (!m_heap.empty() && m_heap.front().Time <= horizon)
+    {
+        due.push_back(m_heap.front().Client);
+        Remove(0);
+        fanOut++;
+    }
+    m_ticks += fanOut;
+    m_maxFanOut = std::max(m_maxFanOut, fanOut);
+}
+
+PlaybackClockStats PlaybackClock::Stats(clock::time_point now) const
+{
+    PlaybackClockStats stats;
+    stats.Clients = m_clients;
+    stats.Wakeups = m_wakeups;
+    stats.Ticks = m_ticks;
+    stats.MaxFanOut = m_maxFanOut;
+    stats.Elapsed = std::chrono::duration_cast<std::chrono::microseconds>(now - m_start);
+    return stats;
+}
+
+void PlaybackClock::Remove(size_t position)
+{
+    m_positions[m_heap[position].Client] = NotQueued;
+    auto last = m_heap.back();
+    m_heap.pop_back();
+    if (position == m_heap.size())
+    {
+        return;
+    }
+    // Fill the hole with the last deadline, which can belong either above
+    // or below it
+    auto earlier = last.Time < m_heap[position].Time;
+    Place(position, last);
+    if (earlier)
+    {
+        SiftUp(position);
+    }
+    else
+    {
+        SiftDown(position);
+    }
+}
+
+void PlaybackClock::Place(size_t position, Deadline deadline)
+{
+    m_heap[position] = deadline;
+    m_positions[deadline.Client] = position;
+}
+
+void PlaybackClock::SiftUp(size_t position)
+{
+    auto deadline = m_heap[position];
+    while (position > 0)
+    {
+        auto parent = (position - 1) / 2;
+        if (!(deadline.Time < m_heap[parent].Time))
+        {
+            break;
+        }
+        Place(position, m_heap[parent]);
+        position = parent;
+    }
+    Place(position, deadline);
+}
+
+void PlaybackClock::SiftDown(size_t position)
+{
+    auto deadline = m_heap[position];
+    auto count = m_heap.size();
+    while (true)
+    {
+        auto child = position * 2 + 1;
+        if (child >= count)
+        {
+            break;
+        }
+        if (child + 1 < count && m_heap[child + 1].Time < m_heap[child].Time)
+        {
+            child++;
+        }
+        if (!(m_heap[child].Time < deadline.Time))
+        {
+            break;
+        }
+        Place(position, m_heap[child]);
+        position = child;
+    }
+    Place(position, deadline);
+}
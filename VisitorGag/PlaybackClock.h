@@ -0,0 +1,83 @@
+#pragma once
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <optional>
+#include <vector>
+
+struct PlaybackClockStats
+{
+    size_t Clients = 0;
+    uint64_t Wakeups = 0;
+    // Clients ticked, summed over every wakeup
+    uint64_t Ticks = 0;
+    // Most clients ticked by a single wakeup
+    size_t MaxFanOut = 0;
+    // Since the clock was created
+    std::chrono::microseconds Elapsed{};
+
+    double WakeupsPerSecond() const noexcept { return Elapsed.count() > 0 ? static_cast<double>(Wakeups) * 1000000.0 / static_cast<double>(Elapsed.count()) : 0.0; }
+    double AverageFanOut() const noexcept { return Wakeups > 0 ? static_cast<double>(Ticks) / static_cast<double>(Wakeups) : 0.0; }
+};
+
+// One timer's worth of deadlines for any number of players. Each client
+// has at most one pending deadline, kept in an indexed min-heap so that
+// moving or cancelling it is O(log n). A wakeup hands back every client
+// that's due within the batch window, so players whose frames line up
+// (give or take the window) are ticked together instead of each waking up
+// on their own. The window must not be more than the clients are willing
+// to run early by (PlaybackSuspension's tolerance for the player). Like
+// PlaybackSuspension the caller supplies the timestamps.
+//
+// No Windows dependencies so that it can be built and benchmarked on its own.
+struct PlaybackClock
+{
+    using clock = std::chrono::steady_clock;
+    using ClientId = uint32_t;
+
+    explicit PlaybackClock(clock::duration batchWindow = std::chrono::milliseconds(4), clock::time_point now = clock::now());
+
+    ClientId Register();
+    // Also cancels its deadline. Ids are reused.
+    void Unregister(ClientId client);
+    // Replaces the client's pending deadline, if it has one
+    void Schedule(ClientId client, clock::time_point deadline);
+    void Cancel(ClientId client);
+    bool IsScheduled(ClientId client) const noexcept { return client < m_positions.size() && m_positions[client] != NotQueued; }
+
+    // When the owner should wake up next, no value if nothing is pending
+    std::optional<clock::time_point> NextWake() const;
+    // Counts as a wakeup. Removes every deadline that's due by now plus the
+    // batch window and appends their clients to due, earliest first.
+    void CollectDue(clock::time_point now, std::vector<ClientId>& due);
+
+    size_t PendingCount() const noexcept { return m_heap.size(); }
+    PlaybackClockStats Stats(clock::time_point now) const;
+
+private:
+    static constexpr size_t NotQueued = SIZE_MAX;
+
+    struct Deadline
+    {
+        clock::time_point Time;
+        ClientId Client;
+    };
+
+    void Remove(size_t position);
+    void Place(size_t position, Deadline deadline);
+    void SiftUp(size_t position);
+    void SiftDown(size_t position);
+
+private:
+    clock::duration m_batchWindow;
+    clock::time_point m_start;
+    std::vector<Deadline> m_heap;
+    // Where each client's deadline is in m_heap, indexed by client id
+    std::vector<size_t> m_positions;
+    std::vector<bool> m_registered;
+    std::vector<ClientId> m_freeIds;
+    size_t m_clients = 0;
+    uint64_t m_wakeups = 0;
+    uint64_t m_ticks = 0;
+    size_t m_maxFanOut = 0;
+};
@@ -0,0 +1,61 @@
+#include "PlaybackCursor.h"
+
+void PlaybackCursor::Reset(PlaybackMode mode, size_t frameCount)
+{
+    m_mode = mode;
+    m_frameCount = frameCount;
+    m_forward = true;
+}
+
+size_t PlaybackCursor::First() const noexcept
+{
+    if (m_mode == PlaybackMode::Reverse && m_frameCount > 0)
+    {
+        return m_frameCount - 1;
+    }
+    return 0;
+}
+
+size_t PlaybackCursor::Next(size_t current, bool& wrapped) noexcept
+{
+    wrapped = false;
+    if (m_frameCount <= 1)
+    {
+        wrapped = true;
+        return 0;
+    }
+
+    switch (m_mode)
+    {
+    case PlaybackMode::Reverse:
+        if (current == 0)
+        {
+            wrapped = true;
+            return m_frameCount - 1;
+        }
+        return current - 1;
+    case PlaybackMode::PingPong:
+        if (m_forward)
+        {
+            if (current + 1 < m_frameCount)
+            {
+                return current + 1;
+            }
+            m_forward = false;
+        }
+        // Heading back towards the first frame, which ends the cycle
+        if (current <= 1)
+        {
+            m_forward = true;
+            wrapped = true;
+            return 0;
+        }
+        return current - 1;
+    default:
+        {
+            auto next = (current + 1) % m_frameCount;
+            wrapped = next == 0;
+            return next;
+        }
+    }
+}
@@ -0,0 +1,26 @@
+#pragma once
+#include <cstddef>
+
+enum class PlaybackMode
+{
+    Forward,
+    Reverse,
+    PingPong,
+};
+
+// Walks frame indices in the order a playback mode shows them. A cycle is
+// complete (and Next reports a wrap) when the cursor gets back to its first
+// frame.
+struct PlaybackCursor
+{
+    void Reset(PlaybackMode mode, size_t frameCount);
+    size_t First() const noexcept;
+    size_t Next(size_t current, bool& wrapped) noexcept;
+
+    PlaybackMode Mode() const noexcept { return m_mode; }
+
+private:
+    PlaybackMode m_mode = PlaybackMode::Forward;
+    size_t m_frameCount = 0;
+    bool m_forward = true;
+};
@@ -0,0 +1,101 @@
+#include "PlaybackSuspension.h"
+#include <algorithm>
+
+PlaybackSuspension::PlaybackSuspension(clock::duration debounce, clock::duration tolerance)
+    : m_debounce(debounce), m_tolerance(tolerance)
+{
+}
+
+void PlaybackSuspension::Signal(SuspendReason reason, bool active, clock::time_point now)
+{
+    auto bit = static_cast<uint32_t>(reason);
+    auto pending = active ? (m_pendingReasons | bit) : (m_pendingReasons & ~bit);
+    if (pending == m_pendingReasons)
+    {
+        return;
+    }
+    m_pendingReasons = pending;
+
+    // Whether we end up suspended only depends on whether any reason is
+    // active, so changes that keep that the same don't need a wakeup.
+    if ((m_pendingReasons != 0) == IsSuspended())
+    {
+        if (m_settleAt.has_value())
+        {
+            m_stats.DebouncedSignals++;
+        }
+        m_activeReasons = IsSuspended() ? m_pendingReasons : 0;
+        m_settleAt.reset();
+        return;
+    }
+    // Every change restarts the debounce period
+    m_settleAt = now + m_debounce;
+}
+
+void PlaybackSuspension::ArmFrame(clock::time_point deadline)
+{
+    m_frameDeadline = deadline;
+}
+
+void PlaybackSuspension::DisarmFrame()
+{
+    m_frameDeadline.reset();
+}
+
+std::optional<PlaybackSuspension::clock::time_point> PlaybackSuspension::NextWake() const
+{
+    std::optional<clock::time_point> wake = m_settleAt;
+    if (m_frameDeadline.has_value() && !IsSuspended())
+    {
+        wake = wake.has_value() ? std::min(wake.value(), m_frameDeadline.value()) : m_frameDeadline;
+    }
+    return wake;
+}
+
+WakeActions PlaybackSuspension::Poll(clock::time_point now)
+{
+    WakeActions actions;
+    auto horizon = now + m_tolerance;
+    uint32_t handled = 0;
+
+    if (m_settleAt.has_value() && m_settleAt.value() <= horizon)
+    {
+        auto wasSuspended = IsSuspended();
+        m_activeReasons = m_pendingReasons;
+        m_settleAt.reset();
+        handled++;
+        if (!wasSuspended && IsSuspended())
+        {
+            actions.Suspend = true;
+            m_suspendedAt = now;
+            m_stats.Suspensions++;
+        }
+        else if (wasSuspended && !IsSuspended())
+        {
+            actions.Resume = true;
+            m_stats.SuspendedTime += std::chrono::duration_cast<std::chrono::microseconds>(now - m_suspendedAt);
+        }
+    }
+
+    if (m_frameDeadline.has_value() && !IsSuspended() && m_frameDeadline.value() <= horizon)
+    {
+        actions.AdvanceFrame = true;
+        if (m_frameDeadline.value() < now)
+        {
+            actions.Lag = std::chrono::duration_cast<std::chrono::microseconds>(now - m_frameDeadline.value());
+        }
+        else
+        {
+            actions.Early = std::chrono::duration_cast<std::chrono::microseconds>(m_frameDeadline.value() - now);
+        }
+        // The owner arms the next one once the frame is drawn
+        m_frameDeadline.reset();
+        handled++;
+    }
+
+    if (handled > 1)
+    {
+        m_stats.CoalescedWakes++;
+    }
+    return actions;
+}
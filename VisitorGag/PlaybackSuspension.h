@@ -0,0 +1,76 @@
+#pragma once
+#include <chrono>
+#include <cstdint>
+#include <optional>
+
+// Things that make it pointless to keep drawing
+enum class SuspendReason : uint32_t
+{
+    Occluded = 1 << 0,
+    SessionLocked = 1 << 1,
+    DisplayOff = 1 << 2,
+};
+
+struct SuspensionStats
+{
+    uint32_t Suspensions = 0;
+    std::chrono::microseconds SuspendedTime{};
+    // Signals that flipped back before they settled
+    uint32_t DebouncedSignals = 0;
+    // Wakeups that handled more than one event
+    uint32_t CoalescedWakes = 0;
+};
+
+// What the owner should do after waking up
+struct WakeActions
+{
+    bool Suspend = false;
+    bool Resume = false;
+    bool AdvanceFrame = false;
+    // How far past its deadline the frame is, e.g. because we were
+    // suspended through it. Zero if it's on time.
+    std::chrono::microseconds Lag{};
+    // How far ahead of its deadline the frame is, if the wakeup came early
+    // but within the tolerance. The next frame should be timed from the
+    // deadline so that early wakeups don't add up.
+    std::chrono::microseconds Early{};
+};
+
+// Decides when the player has to wake up, folding the frame timer and
+// suspend/resume signals into a single timer. Signals only take effect once
+// they've held for the debounce period so that a burst of them (e.g. the
+// display turning off right after the session locks) costs one wakeup, and
+// anything due within the tolerance of a wakeup is handled by it. Like
+// HibernationStateMachine the caller supplies the timestamps.
+struct PlaybackSuspension
+{
+    using clock = std::chrono::steady_clock;
+
+    PlaybackSuspension(
+        clock::duration debounce = std::chrono::milliseconds(100),
+        clock::duration tolerance = std::chrono::milliseconds(8));
+
+    void Signal(SuspendReason reason, bool active, clock::time_point now);
+    // The next frame is due at the given time. While suspended the deadline
+    // is remembered but doesn't wake us.
+    void ArmFrame(clock::time_point deadline);
+    void DisarmFrame();
+
+    // When the owner should wake up next, no value if nothing is pending
+    std::optional<clock::time_point> NextWake() const;
+    // Handles everything that's due (give or take the tolerance)
+    WakeActions Poll(clock::time_point now);
+
+    bool IsSuspended() const noexcept { return m_activeReasons != 0; }
+    SuspensionStats const& Stats() const noexcept { return m_stats; }
+
+private:
+    clock::duration m_debounce;
+    clock::duration m_tolerance;
+    uint32_t m_activeReasons = 0;
+    uint32_t m_pendingReasons = 0;
+    std::optional<clock::time_point> m_settleAt;
+    std::optional<clock::time_point> m_frameDeadline;
+    clock::time_point m_suspendedAt = {};
+    SuspensionStats m_stats = {};
+};
@@ -0,0 +1,80 @@
+#pragma once
+#include <cstdint>
+#include <functional>
+#include <optional>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+struct ResourcePoolStats
+{
+    // Every TryAcquire, and how many of those were satisfied from the pool
+    uint64_t Acquires = 0;
+    uint64_t Reuses = 0;
+    // Resources handed back, and how many of those were dropped because the
+    // pool was full
+    uint64_t Releases = 0;
+    uint64_t Evictions = 0;
+    uint64_t RetainedBytes = 0;
+    uint64_t PeakRetainedBytes = 0;
+};
+
+// Keeps released resources around so that a later request for the same key
+// (e.g. a texture of the same size and format) can reuse one instead of
+// allocating. Keys must match exactly, callers that want size classes
+// should round before building the key. Not thread safe.
+template <typename Key, typename Resource, typename Hash = std::hash<Key>>
+struct ResourcePool
+{
+    // A limit of zero means unlimited
+    ResourcePool(uint64_t maxRetainedBytes = 0) : m_maxRetainedBytes(maxRetainedBytes) {}
+
+    ResourcePool(ResourcePool const&) = delete;
+    ResourcePool& operator=(ResourcePool const&) = delete;
+
+    std::optional<Resource> TryAcquire(Key const& key)
+    {
+        m_stats.Acquires++;
+        auto search = m_free.find(key);
+        if (search == m_free.end() || search->second.empty())
+        {
+            return std::nullopt;
+        }
+        auto& entries = search->second;
+        auto entry = std::move(entries.back());
+        entries.pop_back();
+        m_stats.Reuses++;
+        m_stats.RetainedBytes -= entry.second;
+        return std::optional<Resource>(std::move(entry.first));
+    }
+
+    void Release(Key const& key, Resource&& resource, uint64_t bytes)
+    {
+        m_stats.Releases++;
+        if (m_maxRetainedBytes != 0 && m_stats.RetainedBytes + bytes > m_maxRetainedBytes)
+        {
+            m_stats.Evictions++;
+            return;
+        }
+        m_free[key].emplace_back(std::move(resource), bytes);
+        m_stats.RetainedBytes += bytes;
+        if (m_stats.RetainedBytes > m_stats.PeakRetainedBytes)
+        {
+            m_stats.PeakRetainedBytes = m_stats.RetainedBytes;
+        }
+    }
+
+    // Drops everything that's currently pooled
+    void Trim()
+    {
+        m_free.clear();
+        m_stats.RetainedBytes = 0;
+    }
+
+    ResourcePoolStats const& Stats() const noexcept { return m_stats; }
+
+private:
+    uint64_t m_maxRetainedBytes = 0;
+    std::unordered_map<Key, std::vector<std::pair<Resource, uint64_t>>, Hash> m_free;
+    ResourcePoolStats m_stats;
+};
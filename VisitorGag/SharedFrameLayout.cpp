@@ -0,0 +1,176 @@
+#include "SharedFrameLayout.h"
+#include <cstring>
+#include <new>
+
+static constexpr uint32_t SharedFrameMagic = 0x46475356; // "VSGF"
+static constexpr uint32_t SharedFrameVersion = 2;
+static constexpr uint64_t FrameAlignment = 64;
+
+static_assert(std::atomic<uint32_t>::is_always_lock_free, "The header's atomics are shared between processes");
+
+static uint64_t AlignUp(uint64_t value, uint64_t alignment)
+{
+    return (value + alignment - 1) / alignment * alignment;
+}
+
+SharedFrameLayout ComputeSharedFrameLayout(std::vector<FrameRegion> const& frames, uint64_t contentSize)
+{
+    SharedFrameLayout layout;
+    layout.Entries.reserve(frames.size());
+    layout.ContentOffset = sizeof(SharedFrameHeader) + sizeof(SharedFrameEntry) * frames.size();
+    auto offset = AlignUp(layout.ContentOffset + contentSize, FrameAlignment);
+    for (auto&& frame : frames)
+    {
+        SharedFrameEntry entry;
+        entry.Rect = frame;
+        entry.RowPitch = static_cast<uint32_t>(frame.Width) * 4;
+        entry.Offset = offset;
+        offset = AlignUp(offset + static_cast<uint64_t>(entry.RowPitch) * static_cast<uint32_t>(frame.Height), FrameAlignment);
+        layout.Entries.push_back(entry);
+    }
+    layout.TotalBytes = offset;
+    return layout;
+}
+
+uint64_t HashSharedFrameContent(uint8_t const* data, size_t size) noexcept
+{
+    // FNV-1a over 8 byte words, then whatever is left a byte at a time
+    uint64_t hash = 0xcbf29ce484222325ull;
+    size_t i = 0;
+    for (; i + 8 <= size; i += 8)
+    {
+        uint64_t word = 0;
+        std::memcpy(&word, data + i, sizeof(word));
+        hash = (hash ^ word) * 0x100000001b3ull;
+    }
+    for (; i < size; i++)
+    {
+        hash = (hash ^ data[i]) * 0x100000001b3ull;
+    }
+    return hash;
+}
+
+void InitializeSharedFrames(void* segment, SharedFrameLayout const& layout, uint32_t width, uint32_t height, uint8_t const* content, uint64_t contentSize, uint64_t contentHash, uint32_t writer)
+{
+    auto header = new (segment) SharedFrameHeader();
+    header->Version = SharedFrameVersion;
+    header->ContentHash = contentHash;
+    header->ContentSize = contentSize;
+    header->ContentOffset = layout.ContentOffset;
+    header->TotalBytes = layout.TotalBytes;
+    header->Width = width;
+    header->Height = height;
+    header->FrameCount = static_cast<uint32_t>(layout.Entries.size());
+    auto entries = reinterpret_cast<SharedFrameEntry*>(header + 1);
+    std::memcpy(entries, layout.Entries.data(), sizeof(SharedFrameEntry) * layout.Entries.size());
+    std::memcpy(static_cast<uint8_t*>(segment) + layout.ContentOffset, content, static_cast<size_t>(contentSize));
+    header->Writer.store(writer);
+    // Written last so that nobody trusts a half-written header
+    header->Magic.store(SharedFrameMagic, std::memory_order_release);
+}
+
+SharedFrameHeader const* ValidateSharedFrames(void const* segment, size_t mappedBytes, uint8_t const* content, uint64_t contentSize, uint64_t contentHash)
+{
+    if (segment == nullptr || mappedBytes < sizeof(SharedFrameHeader))
+    {
+        return nullptr;
+    }
+    auto header = reinterpret_cast<SharedFrameHeader const*>(segment);
+    if (header->Magic.load(std::memory_order_acquire) != SharedFrameMagic ||
+        header->Version != SharedFrameVersion ||
+        header->ContentHash != contentHash ||
+        header->ContentSize != contentSize ||
+        header->TotalBytes > mappedBytes)
+    {
+        return nullptr;
+    }
+    auto tableEnd = sizeof(SharedFrameHeader) + sizeof(SharedFrameEntry) * static_cast<uint64_t>(header->FrameCount);
+    auto contentEnd = header->ContentOffset + header->ContentSize;
+    if (header->ContentOffset < tableEnd || contentEnd < header->ContentOffset || contentEnd > header->TotalBytes)
+    {
+        return nullptr;
+    }
+    // The hash only says which segment to look at, the gif has to match
+    // byte for byte before we trust its frames
+    if (std::memcmp(reinterpret_cast<uint8_t const*>(segment) + header->ContentOffset, content, static_cast<size_t>(contentSize)) != 0)
+    {
+        return nullptr;
+    }
+    auto entries = SharedFrameEntries(segment);
+    for (uint32_t i = 0; i < header->FrameCount; i++)
+    {
+        auto&& entry = entries[i];
+        if (entry.Rect.Width < 0 || entry.Rect.Height < 0 ||
+            entry.RowPitch < static_cast<uint64_t>(entry.Rect.Width) * 4 ||
+            entry.Offset < contentEnd ||
+            entry.Offset + static_cast<uint64_t>(entry.RowPitch) * static_cast<uint32_t>(entry.Rect.Height) > header->TotalBytes)
+        {
+            return nullptr;
+        }
+    }
+    return header;
+}
+
+SharedFrameEntry const* SharedFrameEntries(void const* segment)
+{
+    return reinterpret_cast<SharedFrameEntry const*>(reinterpret_cast<SharedFrameHeader const*>(segment) + 1);
+}
+
+bool AttachSharedFrameUser(SharedFrameHeader& header, uint32_t processId, SharedFrameProcessCheck const& isAlive)
+{
+    for (auto&& slot : header.Users)
+    {
+        auto user = slot.load();
+        if (user != 0 && user != processId && !isAlive(user))
+        {
+            // Died without detaching. If someone else got here first the
+            // exchange just fails.
+            slot.compare_exchange_strong(user, 0);
+        }
+    }
+    for (auto&& slot : header.Users)
+    {
+        uint32_t free = 0;
+        if (slot.compare_exchange_strong(free, processId))
+        {
+            return true;
+        }
+    }
+    return false;
+}
+
+void DetachSharedFrameUser(SharedFrameHeader& header, uint32_t processId) noexcept
+{
+    for (auto&& slot : header.Users)
+    {
+        auto user = processId;
+        if (slot.compare_exchange_strong(user, 0))
+        {
+            return;
+        }
+    }
+}
+
+uint32_t CountSharedFrameUsers(SharedFrameHeader const& header) noexcept
+{
+    uint32_t count = 0;
+    for (auto&& slot : header.Users)
+    {
+        count += slot.load() != 0;
+    }
+    return count;
+}
+
+bool ReclaimSharedFrames(SharedFrameHeader& header, uint32_t processId, SharedFrameProcessCheck const& isAlive)
+{
+    if (header.State.load(std::memory_order_acquire) != static_cast<uint32_t>(SharedFrameState::Writing))
+    {
+        return false;
+    }
+    auto writer = header.Writer.load();
+    if (writer == 0 || writer == processId || isAlive(writer))
+    {
+        return false;
+    }
+    return header.Writer.compare_exchange_strong(writer, processId);
+}
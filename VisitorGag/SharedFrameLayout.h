@@ -0,0 +1,105 @@
+#pragma once
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <vector>
+#include "FrameDeduplicator.h"
+
+// The layout of a shared memory segment holding every decoded frame of a
+// gif, so that processes showing the same gif only decode it once. The
+// segment starts with a SharedFrameHeader, followed by one SharedFrameEntry
+// per frame, a copy of the encoded gif, and then the frames' premultiplied
+// BGRA8 pixels. Nothing in here knows how the memory is actually shared.
+//
+// Processes are tracked by id rather than by a counter, so that whoever
+// opens the segment next can clean up after one that died without saying
+// goodbye.
+
+// How many processes can have the segment mapped at once
+constexpr uint32_t MaxSharedFrameUsers = 64;
+
+// Whether the process with the given id is still running
+using SharedFrameProcessCheck = std::function<bool(uint32_t processId)>;
+
+enum class SharedFrameState : uint32_t
+{
+    // The publisher is still filling in frames
+    Writing = 0,
+    Ready = 1,
+    // The publisher gave up (e.g. the decoder disagreed with the index)
+    Abandoned = 2,
+};
+
+struct SharedFrameHeader
+{
+    // Stored last by InitializeSharedFrames
+    std::atomic<uint32_t> Magic = 0;
+    uint32_t Version = 0;
+    // Identifies the encoded gif the frames came from
+    uint64_t ContentHash = 0;
+    uint64_t ContentSize = 0;
+    // Where the copy of the encoded gif starts, to confirm hash matches
+    uint64_t ContentOffset = 0;
+    uint64_t TotalBytes = 0;
+    uint32_t Width = 0;
+    uint32_t Height = 0;
+    uint32_t FrameCount = 0;
+    uint32_t Reserved = 0;
+    std::atomic<uint32_t> State = 0;
+    // The process filling in frames while Writing
+    std::atomic<uint32_t> Writer = 0;
+    // Ids of the processes that have the segment mapped, zero when free
+    std::atomic<uint32_t> Users[MaxSharedFrameUsers] = {};
+};
+
+struct SharedFrameEntry
+{
+    FrameRegion Rect;
+    uint32_t RowPitch = 0;
+    uint32_t Reserved = 0;
+    // From the start of the segment
+    uint64_t Offset = 0;
+};
+
+struct SharedFrameLayout
+{
+    uint64_t ContentOffset = 0;
+    uint64_t TotalBytes = 0;
+    std::vector<SharedFrameEntry> Entries;
+};
+
+struct SharedFrameStats
+{
+    bool Attached = false;
+    bool Publisher = false;
+    bool Ready = false;
+    uint32_t Users = 0;
+    uint64_t Bytes = 0;
+};
+
+// Frames are tightly packed rows, each frame starting on a 64 byte boundary
+SharedFrameLayout ComputeSharedFrameLayout(std::vector<FrameRegion> const& frames, uint64_t contentSize);
+
+uint64_t HashSharedFrameContent(uint8_t const* data, size_t size) noexcept;
+
+// Writes the header, frame table and content, leaving the segment in the
+// Writing state with writer as its publisher
+void InitializeSharedFrames(void* segment, SharedFrameLayout const& layout, uint32_t width, uint32_t height, uint8_t const* content, uint64_t contentSize, uint64_t contentHash, uint32_t writer);
+
+// Returns null unless the segment looks like one InitializeSharedFrames
+// wrote for exactly the same content and every frame lies within
+// mappedBytes
+SharedFrameHeader const* ValidateSharedFrames(void const* segment, size_t mappedBytes, uint8_t const* content, uint64_t contentSize, uint64_t contentHash);
+
+SharedFrameEntry const* SharedFrameEntries(void const* segment);
+
+// Takes a user slot for processId, first freeing any whose process has
+// died. Returns false if every slot belongs to a live process.
+bool AttachSharedFrameUser(SharedFrameHeader& header, uint32_t processId, SharedFrameProcessCheck const& isAlive);
+void DetachSharedFrameUser(SharedFrameHeader& header, uint32_t processId) noexcept;
+uint32_t CountSharedFrameUsers(SharedFrameHeader const& header) noexcept;
+
+// Makes processId the publisher of a segment whose writer died before it
+// was Ready. The new publisher writes every frame again.
+bool ReclaimSharedFrames(SharedFrameHeader& header, uint32_t processId, SharedFrameProcessCheck const& isAlive);
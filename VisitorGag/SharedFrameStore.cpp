@@ -0,0 +1,197 @@
+#include "pch.h"
+#include "SharedFrameStore.h"
+
+// Past this it's cheaper for every process to keep streaming from its own
+// encoded copy than to commit this much shared memory
+static constexpr uint64_t MaxSharedFrameBytes = 1024ull * 1024 * 1024;
+
+namespace
+{
+    bool IsProcessAlive(uint32_t processId)
+    {
+        wil::unique_handle process(OpenProcess(SYNCHRONIZE, FALSE, processId));
+        if (!process)
+        {
+            // Still running, just not something we're allowed to open
+            return GetLastError() == ERROR_ACCESS_DENIED;
+        }
+        return WaitForSingleObject(process.get(), 0) == WAIT_TIMEOUT;
+    }
+
+    // Full access for the current user and the system, nobody else
+    wil::unique_hlocal_security_descriptor CreateSegmentSecurityDescriptor()
+    {
+        auto user = wil::get_token_information<TOKEN_USER>();
+        wil::unique_hlocal_string userSid;
+        winrt::check_bool(ConvertSidToStringSidW(user->User.Sid, &userSid));
+        auto sddl = std::wstring(L"D:P(A;;GA;;;SY)(A;;GA;;;") + userSid.get() + L")";
+        wil::unique_hlocal_security_descriptor descriptor;
+        winrt::check_bool(ConvertStringSecurityDescriptorToSecurityDescriptorW(sddl.c_str(), SDDL_REVISION_1, &descriptor, nullptr));
+        return descriptor;
+    }
+}
+
+std::shared_ptr<SharedFrameStore> SharedFrameStore::Open(PooledBuffer const& encoded, GifIndex const& index, uint32_t frameCount)
+{
+    if (index.FrameCount() != frameCount)
+    {
+        return nullptr;
+    }
+    std::vector<FrameRegion> frames;
+    frames.reserve(index.FrameCount());
+    for (size_t i = 0; i < index.FrameCount(); i++)
+    {
+        frames.push_back({ index.Left[i], index.Top[i], index.FrameWidth[i], index.FrameHeight[i] });
+    }
+    auto contentSize = static_cast<uint64_t>(encoded.Size());
+    auto layout = ComputeSharedFrameLayout(frames, contentSize);
+    if (layout.TotalBytes > MaxSharedFrameBytes)
+    {
+        return nullptr;
+    }
+    auto contentHash = HashSharedFrameContent(encoded.Data(), encoded.Size());
+    auto processId = static_cast<uint32_t>(GetCurrentProcessId());
+
+    auto descriptor = CreateSegmentSecurityDescriptor();
+    SECURITY_ATTRIBUTES security = { sizeof(security), descriptor.get(), FALSE };
+    wchar_t name[MAX_PATH] = {};
+    swprintf_s(name, L"Local\\VisitorGag.Frames.%016llx.%llx", contentHash, contentSize);
+    std::shared_ptr<SharedFrameStore> store(new SharedFrameStore());
+    store->m_mapping.reset(CreateFileMappingW(INVALID_HANDLE_VALUE, &security, PAGE_READWRITE,
+        static_cast<DWORD>(layout.TotalBytes >> 32), static_cast<DWORD>(layout.TotalBytes), name));
+    if (!store->m_mapping)
+    {
+        throw winrt::hresult_error(HRESULT_FROM_WIN32(GetLastError()), L"Couldn't create the shared frame segment");
+    }
+    auto created = GetLastError() != ERROR_ALREADY_EXISTS;
+
+    if (!created)
+    {
+        store->m_view.reset(reinterpret_cast<uint8_t*>(MapViewOfFile(store->m_mapping.get(), FILE_MAP_READ, 0, 0, 0)));
+        if (!store->m_view)
+        {
+            return nullptr;
+        }
+        MEMORY_BASIC_INFORMATION info = {};
+        if (VirtualQuery(store->m_view.get(), &info, sizeof(info)) == 0 ||
+            ValidateSharedFrames(store->m_view.get(), info.RegionSize, encoded.Data(), contentSize, contentHash) == nullptr)
+        {
+            return nullptr;
+        }
+        store->m_headerView.reset(reinterpret_cast<SharedFrameHeader*>(MapViewOfFile(store->m_mapping.get(), FILE_MAP_WRITE, 0, 0, sizeof(SharedFrameHeader))));
+        if (!store->m_headerView)
+        {
+            return nullptr;
+        }
+        // Whoever was decoding died before finishing, so we finish instead
+        if (ReclaimSharedFrames(*store->m_headerView, processId, IsProcessAlive))
+        {
+            store->m_publisher = true;
+            store->m_headerView.reset();
+            store->m_view.reset();
+        }
+    }
+    else
+    {
+        store->m_publisher = true;
+    }
+
+    SharedFrameHeader* header = nullptr;
+    if (store->m_publisher)
+    {
+        store->m_view.reset(reinterpret_cast<uint8_t*>(MapViewOfFile(store->m_mapping.get(), FILE_MAP_WRITE, 0, 0, 0)));
+        if (!store->m_view)
+        {
+            return nullptr;
+        }
+        if (created)
+        {
+            InitializeSharedFrames(store->m_view.get(), layout, index.Width, index.Height, encoded.Data(), contentSize, contentHash, processId);
+        }
+        header = reinterpret_cast<SharedFrameHeader*>(store->m_view.get());
+    }
+    else
+    {
+        header = store->m_headerView.get();
+    }
+    if (!AttachSharedFrameUser(*header, processId, IsProcessAlive))
+    {
+        return nullptr;
+    }
+    store->m_header = header;
+    store->m_entries = SharedFrameEntries(store->m_view.get());
+    return store;
+}
+
+SharedFrameStore::~SharedFrameStore()
+{
+    if (m_header != nullptr)
+    {
+        if (m_publisher && !IsReady())
+        {
+            Abandon();
+        }
+        DetachSharedFrameUser(*m_header, static_cast<uint32_t>(GetCurrentProcessId()));
+    }
+}
+
+bool SharedFrameStore::IsReady() const noexcept
+{
+    return m_header->State.load(std::memory_order_acquire) == static_cast<uint32_t>(SharedFrameState::Ready);
+}
+
+uint8_t const* SharedFrameStore::FrameBytes(size_t index, uint32_t& rowPitch) const noexcept
+{
+    if (index >= m_header->FrameCount || !IsReady())
+    {
+        return nullptr;
+    }
+    auto&& entry = m_entries[index];
+    rowPitch = entry.RowPitch;
+    return m_view.get() + entry.Offset;
+}
+
+bool SharedFrameStore::WriteFrame(size_t index, FrameRegion const& rect, uint8_t const* bytes, uint32_t rowPitch)
+{
+    WINRT_ASSERT(m_publisher);
+    if (m_header->State.load() != static_cast<uint32_t>(SharedFrameState::Writing))
+    {
+        return false;
+    }
+    if (index >= m_header->FrameCount || !(m_entries[index].Rect == rect))
+    {
+        Abandon();
+        return false;
+    }
+    auto&& entry = m_entries[index];
+    auto destination = m_view.get() + entry.Offset;
+    auto rowBytes = static_cast<size_t>(rect.Width) * 4;
+    for (int32_t y = 0; y < rect.Height; y++)
+    {
+        std::copy_n(bytes + static_cast<size_t>(y) * rowPitch, rowBytes, destination + static_cast<size_t>(y) * entry.RowPitch);
+    }
+    return true;
+}
+
+void SharedFrameStore::Publish()
+{
+    WINRT_ASSERT(m_publisher);
+    auto expected = static_cast<uint32_t>(SharedFrameState::Writing);
+    m_header->State.compare_exchange_strong(expected, static_cast<uint32_t>(SharedFrameState::Ready), std::memory_order_release);
+}
+
+void SharedFrameStore::Abandon()
+{
+    m_header->State.store(static_cast<uint32_t>(SharedFrameState::Abandoned), std::memory_order_release);
+}
+
+SharedFrameStats SharedFrameStore::Stats() const noexcept
+{
+    SharedFrameStats stats;
+    stats.Attached = true;
+    stats.Publisher = m_publisher;
+    stats.Ready = IsReady();
+    stats.Users = CountSharedFrameUsers(*m_header);
+    stats.Bytes = m_header->TotalBytes;
+    return stats;
+}
@@ -0,0 +1,48 @@
+#pragma once
+#include "SharedFrameLayout.h"
+#include "GifIndex.h"
+#include "BufferPool.h"
+
+// Every decoded frame of a gif in a named file mapping, keyed by the
+// encoded gif's contents. The first process to show a gif creates the
+// segment and fills it in as frames are decoded, everyone after that maps
+// it read-only and skips decoding altogether. The kernel frees the segment
+// once the last process with a handle to it goes away. If the publisher
+// dies partway through, the next process to open the segment takes over.
+//
+// The segment lives in the session's Local namespace and only the current
+// user can open it. Creating global objects needs a privilege most users
+// don't have, so rather than quietly sharing with fewer processes than
+// asked, failing to create the segment throws.
+struct SharedFrameStore
+{
+    // Returns null if the gif can't be shared: it's too big, the index
+    // doesn't cover every frame, someone else is still setting the segment
+    // up, or too many processes are already using it.
+    static std::shared_ptr<SharedFrameStore> Open(PooledBuffer const& encoded, GifIndex const& index, uint32_t frameCount);
+    ~SharedFrameStore();
+
+    bool IsPublisher() const noexcept { return m_publisher; }
+    bool IsReady() const noexcept;
+    // Null until every frame has been published
+    uint8_t const* FrameBytes(size_t index, uint32_t& rowPitch) const noexcept;
+    // Publisher only. Abandons the segment and returns false if the frame
+    // doesn't match the layout the index gave us.
+    bool WriteFrame(size_t index, FrameRegion const& rect, uint8_t const* bytes, uint32_t rowPitch);
+    void Publish();
+    SharedFrameStats Stats() const noexcept;
+
+private:
+    SharedFrameStore() {}
+    void Abandon();
+
+private:
+    wil::unique_handle m_mapping;
+    // Read-only for everyone but the publisher
+    wil::unique_mapview_ptr<uint8_t> m_view;
+    // The header is always writable so that we can claim a user slot
+    wil::unique_mapview_ptr<SharedFrameHeader> m_headerView;
+    SharedFrameHeader* m_header = nullptr;
+    SharedFrameEntry const* m_entries = nullptr;
+    bool m_publisher = false;
+};
@@ -0,0 +1,117 @@
+#include "pch.h"
+#include "SharedPlaybackClock.h"
+
+namespace winrt
+{
+    using namespace Windows::Foundation;
+    using namespace Windows::System;
+}
+
+SharedPlaybackClock::SharedPlaybackClock(winrt::DispatcherQueue const& dispatcherQueue)
+{
+    m_dispatcherQueue = dispatcherQueue;
+    m_timer = m_dispatcherQueue.CreateTimer();
+    m_timer.IsRepeating(false);
+    m_tick = m_timer.Tick(winrt::auto_revoke, { this, &SharedPlaybackClock::OnTick });
+}
+
+SharedPlaybackClock::ClientId SharedPlaybackClock::Register(std::function<void()> tick)
+{
+    std::lock_guard lock(m_lock);
+    auto client = m_clock.Register();
+    if (client >= m_callbacks.size())
+    {
+        m_callbacks.resize(client + 1);
+    }
+    m_callbacks[client] = std::move(tick);
+    m_stats.Publish(m_clock.Stats(std::chrono::steady_clock::now()));
+    return client;
+}
+
+void SharedPlaybackClock::Unregister(ClientId client)
+{
+    std::lock_guard lock(m_lock);
+    m_clock.Unregister(client);
+    m_callbacks[client] = nullptr;
+    // A timer that's still armed for it just finds nothing due
+    m_stats.Publish(m_clock.Stats(std::chrono::steady_clock::now()));
+}
+
+void SharedPlaybackClock::Schedule(ClientId client, std::chrono::steady_clock::time_point deadline)
+{
+    {
+        std::lock_guard lock(m_lock);
+        m_clock.Schedule(client, deadline);
+    }
+    ArmTimer();
+}
+
+void SharedPlaybackClock::Cancel(ClientId client)
+{
+    {
+        std::lock_guard lock(m_lock);
+        m_clock.Cancel(client);
+    }
+    ArmTimer();
+}
+
+void SharedPlaybackClock::OnTick(winrt::DispatcherQueueTimer const&, winrt::IInspectable const&)
+{
+    m_armedFor.reset();
+    auto now = std::chrono::steady_clock::now();
+    {
+        // Callbacks run without the lock since they schedule themselves again
+        std::lock_guard lock(m_lock);
+        m_due.clear();
+        m_clock.CollectDue(now, m_due);
+        m_dueCallbacks.clear();
+        for (auto client : m_due)
+        {
+            m_dueCallbacks.push_back(m_callbacks[client]);
+        }
+    }
+    {
+        m_ticking = true;
+        auto endTick = wil::scope_exit([&]()
+            {
+                m_ticking = false;
+            });
+        for (auto&& callback : m_dueCallbacks)
+        {
+            if (callback != nullptr)
+            {
+                callback();
+            }
+        }
+    }
+    {
+        std::lock_guard lock(m_lock);
+        m_stats.Publish(m_clock.Stats(now));
+    }
+    ArmTimer();
+}
+
+void SharedPlaybackClock::ArmTimer()
+{
+    if (m_ticking)
+    {
+        return;
+    }
+    std::optional<std::chrono::steady_clock::time_point> wake;
+    {
+        std::lock_guard lock(m_lock);
+        wake = m_clock.NextWake();
+    }
+    if (wake == m_armedFor)
+    {
+        return;
+    }
+    m_timer.Stop();
+    m_armedFor = wake;
+    if (wake.has_value())
+    {
+        auto interval = std::max(wake.value() - std::chrono::steady_clock::now(), std::chrono::steady_clock::duration::zero());
+        m_timer.Interval(std::chrono::duration_cast<winrt::TimeSpan>(interval));
+        m_timer.Start();
+    }
+}
@@ -0,0 +1,46 @@
+#pragma once
+#include "PlaybackClock.h"
+#include "SnapshotCell.h"
+
+// Drives every player that lives on one DispatcherQueue from a single
+// timer. Players register a tick callback and schedule their next wakeup
+// with it instead of each arming a timer of their own. Schedule and Cancel
+// must be called on the clock's queue, which is also where the callbacks
+// run. Register, Unregister and Stats may be called from any thread.
+struct SharedPlaybackClock
+{
+    using ClientId = PlaybackClock::ClientId;
+
+    explicit SharedPlaybackClock(winrt::Windows::System::DispatcherQueue const& dispatcherQueue);
+
+    winrt::Windows::System::DispatcherQueue DispatcherQueue() const noexcept { return m_dispatcherQueue; }
+    PlaybackClockStats Stats() const { return m_stats.Read(); }
+
+    ClientId Register(std::function<void()> tick);
+    // Doesn't touch the timer, so it's safe once the queue has shut down
+    void Unregister(ClientId client);
+    void Schedule(ClientId client, std::chrono::steady_clock::time_point deadline);
+    void Cancel(ClientId client);
+
+private:
+    void OnTick(winrt::Windows::System::DispatcherQueueTimer const& timer, winrt::Windows::Foundation::IInspectable const& args);
+    void ArmTimer();
+
+private:
+    winrt::Windows::System::DispatcherQueue m_dispatcherQueue{ nullptr };
+    winrt::Windows::System::DispatcherQueueTimer m_timer{ nullptr };
+    winrt::Windows::System::DispatcherQueueTimer::Tick_revoker m_tick;
+    PlaybackClock m_clock;
+    // Guards m_clock and m_callbacks against Register and Unregister
+    std::mutex m_lock;
+    // Indexed by client id
+    std::vector<std::function<void()>> m_callbacks;
+    std::vector<ClientId> m_due;
+    std::vector<std::function<void()>> m_dueCallbacks;
+    // When the timer is set to go off, if it's running
+    std::optional<std::chrono::steady_clock::time_point> m_armedFor;
+    // Clients reschedule from their callbacks, the timer is armed once
+    // they've all run
+    bool m_ticking = false;
+    SnapshotCell<PlaybackClockStats> m_stats;
+};
@@ -0,0 +1,27 @@
+#pragma once
+#include <mutex>
+
+// Hands the latest copy of some state from the thread that owns it to
+// whoever wants to look at it. Publish and Read may be called from any
+// thread. Readers never see a half-written value, only ever the most
+// recent complete one (or a default constructed one before the first
+// Publish). Meant for small, cheap to copy values like stats.
+template <typename T>
+struct SnapshotCell
+{
+    void Publish(T const& value)
+    {
+        std::lock_guard lock(m_lock);
+        m_value = value;
+    }
+
+    T Read() const
+    {
+        std::lock_guard lock(m_lock);
+        return m_value;
+    }
+
+private:
+    mutable std::mutex m_lock;
+    T m_value = {};
+};
@@ -0,0 +1,201 @@
+#include "TaskGraph.h"
+#include <algorithm>
+#include <condition_variable>
+#include <exception>
+#include <mutex>
+#include <set>
+#include <stdexcept>
+#include <thread>
+
+TaskGraph::TaskId TaskGraph::Add(std::string name, std::vector<TaskId> const& dependencies, std::function<void()> work, TaskAffinity affinity)
+{
+    auto id = m_tasks.size();
+    for (auto&& dependency : dependencies)
+    {
+        if (dependency >= id)
+        {
+            throw std::runtime_error("Tasks can only depend on tasks that were added before them");
+        }
+    }
+
+    Task task;
+    task.Name = std::move(name);
+    task.Work = std::move(work);
+    task.Affinity = affinity;
+    task.Dependencies = dependencies;
+    for (auto&& dependency : task.Dependencies)
+    {
+        m_tasks[dependency].Dependents.push_back(id);
+    }
+    m_tasks.push_back(std::move(task));
+    return id;
+}
+
+TaskGraphStats TaskGraph::Run(uint32_t maxWorkers)
+{
+    using clock = std::chrono::steady_clock;
+    auto start = clock::now();
+    auto taskCount = m_tasks.size();
+
+    TaskGraphStats stats;
+    stats.Tasks.resize(taskCount);
+    for (size_t i = 0; i < taskCount; i++)
+    {
+        stats.Tasks[i].Name = m_tasks[i].Name;
+    }
+
+    std::mutex lock;
+    std::condition_variable changed;
+    std::vector<size_t> pending(taskCount);
+    // Set once something a task depends on has failed or been skipped
+    std::vector<bool> poisoned(taskCount, false);
+    // Ordered so that running inline follows the order tasks were added in
+    std::set<TaskId> readyAny;
+    std::set<TaskId> readyCaller;
+    size_t finished = 0;
+    std::exception_ptr error;
+
+    auto makeReady = [&](TaskId id)
+    {
+        if (m_tasks[id].Affinity == TaskAffinity::Caller)
+        {
+            readyCaller.insert(id);
+        }
+        else
+        {
+            readyAny.insert(id);
+        }
+    };
+    for (size_t i = 0; i < taskCount; i++)
+    {
+        pending[i] = m_tasks[i].Dependencies.size();
+        if (pending[i] == 0)
+        {
+            makeReady(i);
+        }
+    }
+
+    auto execute = [&](TaskId id, bool skip)
+    {
+        auto&& timing = stats.Tasks[id];
+        auto taskStart = clock::now();
+        bool succeeded = false;
+        if (!skip)
+        {
+            try
+            {
+                m_tasks[id].Work();
+                succeeded = true;
+            }
+            catch (...)
+            {
+                std::lock_guard guard(lock);
+                if (!error)
+                {
+                    error = std::current_exception();
+                }
+            }
+            timing.Ran = true;
+        }
+        auto taskEnd = clock::now();
+        timing.Start = std::chrono::duration_cast<std::chrono::microseconds>(taskStart - start);
+        timing.Duration = std::chrono::duration_cast<std::chrono::microseconds>(taskEnd - taskStart);
+
+        std::lock_guard guard(lock);
+        finished++;
+        for (auto&& dependent : m_tasks[id].Dependents)
+        {
+            if (!succeeded)
+            {
+                poisoned[dependent] = true;
+            }
+            if (--pending[dependent] == 0)
+            {
+                makeReady(dependent);
+            }
+        }
+        changed.notify_all();
+    };
+
+    // Takes the next task from the given queues, or returns false once
+    // every task has finished
+    auto takeNext = [&](bool takeCaller, bool takeAny, TaskId& id, bool& skip)
+    {
+        std::unique_lock guard(lock);
+        changed.wait(guard, [&]()
+            {
+                return finished == taskCount ||
+                    (takeCaller && !readyCaller.empty()) ||
+                    (takeAny && !readyAny.empty());
+            });
+        if (finished == taskCount)
+        {
+            return false;
+        }
+        auto nextCaller = takeCaller && !readyCaller.empty() ? *readyCaller.begin() : taskCount;
+        auto nextAny = takeAny && !readyAny.empty() ? *readyAny.begin() : taskCount;
+        if (nextCaller < nextAny)
+        {
+            readyCaller.erase(readyCaller.begin());
+            id = nextCaller;
+        }
+        else
+        {
+            readyAny.erase(readyAny.begin());
+            id = nextAny;
+        }
+        skip = poisoned[id];
+        return true;
+    };
+
+    auto anyTasks = static_cast<size_t>(std::count_if(m_tasks.begin(), m_tasks.end(), [](auto&& task) { return task.Affinity == TaskAffinity::Any; }));
+    auto workerCount = std::min(static_cast<size_t>(maxWorkers), anyTasks);
+    std::vector<std::thread> workers;
+    workers.reserve(workerCount);
+    for (size_t i = 0; i < workerCount; i++)
+    {
+        workers.emplace_back([&]()
+            {
+                TaskId id = 0;
+                bool skip = false;
+                while (takeNext(false, true, id, skip))
+                {
+                    execute(id, skip);
+                }
+            });
+    }
+    {
+        // Without workers the calling thread picks up everything
+        TaskId id = 0;
+        bool skip = false;
+        while (takeNext(true, workerCount == 0, id, skip))
+        {
+            execute(id, skip);
+        }
+    }
+    for (auto&& worker : workers)
+    {
+        worker.join();
+    }
+
+    stats.Elapsed = std::chrono::duration_cast<std::chrono::microseconds>(clock::now() - start);
+    // Dependencies always come first, so one pass in order is enough
+    std::vector<std::chrono::microseconds> chainEnd(taskCount);
+    for (size_t i = 0; i < taskCount; i++)
+    {
+        std::chrono::microseconds chainStart{};
+        for (auto&& dependency : m_tasks[i].Dependencies)
+        {
+            chainStart = std::max(chainStart, chainEnd[dependency]);
+        }
+        chainEnd[i] = chainStart + stats.Tasks[i].Duration;
+        stats.Work += stats.Tasks[i].Duration;
+        stats.CriticalPath = std::max(stats.CriticalPath, chainEnd[i]);
+    }
+
+    if (error)
+    {
+        std::rethrow_exception(error);
+    }
+    return stats;
+}
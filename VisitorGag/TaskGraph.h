@@ -0,0 +1,72 @@
+#pragma once
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <string>
+#include <vector>
+
+enum class TaskAffinity
+{
+    // Runs on any worker thread
+    Any,
+    // Runs on the thread that called Run, e.g. for work that has to happen
+    // on a UI thread
+    Caller,
+};
+
+struct TaskTiming
+{
+    std::string Name;
+    // Relative to the start of Run
+    std::chrono::microseconds Start{};
+    std::chrono::microseconds Duration{};
+    // False if the task was skipped because something it depends on threw
+    bool Ran = false;
+};
+
+struct TaskGraphStats
+{
+    std::vector<TaskTiming> Tasks;
+    // Wall clock time for the whole graph
+    std::chrono::microseconds Elapsed{};
+    // What running every task one after the other would have taken
+    std::chrono::microseconds Work{};
+    // The longest chain of dependent tasks, the best any schedule could do
+    std::chrono::microseconds CriticalPath{};
+};
+
+// A small dependency graph of one-shot tasks. Tasks can only depend on tasks
+// that were added before them, so the graph can't have cycles and the order
+// they were added in is always a valid serial schedule.
+//
+// No Windows dependencies so that it can be built and tested on its own.
+struct TaskGraph
+{
+    using TaskId = size_t;
+
+    // Throws std::runtime_error if a dependency doesn't exist yet
+    TaskId Add(std::string name, std::vector<TaskId> const& dependencies, std::function<void()> work, TaskAffinity affinity = TaskAffinity::Any);
+
+    // Runs every task once all of its dependencies have finished. Tasks with
+    // Any affinity are spread over up to maxWorkers threads, with zero
+    // workers everything runs on the calling thread in the order it was
+    // added. If a task throws, the tasks that depend on it are skipped and
+    // the first exception is rethrown once everything else has finished.
+    TaskGraphStats Run(uint32_t maxWorkers);
+
+    size_t TaskCount() const noexcept { return m_tasks.size(); }
+
+private:
+    struct Task
+    {
+        std::string Name;
+        std::function<void()> Work;
+        TaskAffinity Affinity = TaskAffinity::Any;
+        std::vector<TaskId> Dependencies;
+        std::vector<TaskId> Dependents;
+    };
+
+private:
+    std::vector<Task> m_tasks;
+};
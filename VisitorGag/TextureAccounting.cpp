@@ -0,0 +1,62 @@
+#include "pch.h"
+#include "TextureAccounting.h"
+
+// {5C6F9E0A-3B8D-4F43-9A6E-2E51C0B7D114}
+static constexpr GUID TextureAllocationGuid = { 0x5c6f9e0a, 0x3b8d, 0x4f43, { 0x9a, 0x6e, 0x2e, 0x51, 0xc0, 0xb7, 0xd1, 0x14 } };
+
+// Lives exactly as long as the texture that holds on to it
+struct TextureAllocation : IUnknown
+{
+    TextureAllocation(MemoryTag tag, uint64_t bytes) : m_tag(tag), m_bytes(bytes)
+    {
+        RecordAllocation(m_tag, MemoryKind::Texture, m_bytes);
+    }
+
+    ~TextureAllocation()
+    {
+        RecordFree(m_tag, MemoryKind::Texture, m_bytes);
+    }
+
+    HRESULT STDMETHODCALLTYPE QueryInterface(REFIID iid, void** object) override
+    {
+        if (iid == __uuidof(IUnknown))
+        {
+            AddRef();
+            *object = static_cast<IUnknown*>(this);
+            return S_OK;
+        }
+        *object = nullptr;
+        return E_NOINTERFACE;
+    }
+
+    ULONG STDMETHODCALLTYPE AddRef() override
+    {
+        return ++m_refs;
+    }
+
+    ULONG STDMETHODCALLTYPE Release() override
+    {
+        auto refs = --m_refs;
+        if (refs == 0)
+        {
+            delete this;
+        }
+        return refs;
+    }
+
+private:
+    std::atomic<ULONG> m_refs = 1;
+    MemoryTag m_tag = MemoryTag::App;
+    uint64_t m_bytes = 0;
+};
+
+void TrackTexture(ID3D11Texture2D* texture, MemoryTag tag)
+{
+    D3D11_TEXTURE2D_DESC desc = {};
+    texture->GetDesc(&desc);
+    // Every texture we create is 32bpp with a single mip
+    auto bytes = static_cast<uint64_t>(desc.Width) * desc.Height * desc.ArraySize * 4;
+    winrt::com_ptr<IUnknown> allocation;
+    allocation.attach(new TextureAllocation(tag, bytes));
+    winrt::check_hresult(texture->SetPrivateDataInterface(TextureAllocationGuid, allocation.get()));
+}
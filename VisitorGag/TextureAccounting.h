@@ -0,0 +1,8 @@
+#pragma once
+#include "MemoryAccounting.h"
+
+// Charges a texture's bytes to a tag until the texture is destroyed. The
+// bookkeeping rides along as private data on the texture, so it doesn't
+// matter who releases the last reference. Tracking the same texture again
+// moves it to the new tag.
+void TrackTexture(ID3D11Texture2D* texture, MemoryTag tag);
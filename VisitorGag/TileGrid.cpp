@@ -0,0 +1,86 @@
+#include "TileGrid.h"
+#include <algorithm>
+#include <stdexcept>
+
+TileGrid::TileGrid(uint32_t width, uint32_t height, uint32_t tileSize)
+{
+    if (tileSize == 0)
+    {
+        throw std::invalid_argument("Tile size must be non-zero");
+    }
+    m_width = width;
+    m_height = height;
+    m_tileSize = tileSize;
+    m_columns = (width + tileSize - 1) / tileSize;
+    m_rows = (height + tileSize - 1) / tileSize;
+}
+
+TileRect TileGrid::TileBounds(size_t tile) const noexcept
+{
+    auto column = static_cast<uint32_t>(tile % m_columns);
+    auto row = static_cast<uint32_t>(tile / m_columns);
+    auto x = column * m_tileSize;
+    auto y = row * m_tileSize;
+    return TileRect
+    {
+        static_cast<int32_t>(x),
+        static_cast<int32_t>(y),
+        static_cast<int32_t>(std::min(m_tileSize, m_width - x)),
+        static_cast<int32_t>(std::min(m_tileSize, m_height - y)),
+    };
+}
+
+void TileGrid::TilesIntersecting(TileRect const& rect, std::vector<size_t>& tiles) const
+{
+    auto clipped = Intersect(rect, { 0, 0, static_cast<int32_t>(m_width), static_cast<int32_t>(m_height) });
+    if (!clipped.has_value())
+    {
+        return;
+    }
+    // Only the corners matter, everything in between is covered
+    auto firstColumn = static_cast<uint32_t>(clipped->X) / m_tileSize;
+    auto lastColumn = static_cast<uint32_t>(clipped->Right() - 1) / m_tileSize;
+    auto firstRow = static_cast<uint32_t>(clipped->Y) / m_tileSize;
+    auto lastRow = static_cast<uint32_t>(clipped->Bottom() - 1) / m_tileSize;
+    for (auto row = firstRow; row <= lastRow; row++)
+    {
+        for (auto column = firstColumn; column <= lastColumn; column++)
+        {
+            tiles.push_back(static_cast<size_t>(row) * m_columns + column);
+        }
+    }
+}
+
+size_t TileGrid::MarkTilesIntersecting(std::vector<TileRect> const& rects, std::vector<bool>& marked) const
+{
+    marked.assign(TileCount(), false);
+    size_t count = 0;
+    std::vector<size_t> tiles;
+    for (auto&& rect : rects)
+    {
+        tiles.clear();
+        TilesIntersecting(rect, tiles);
+        for (auto tile : tiles)
+        {
+            if (!marked[tile])
+            {
+                marked[tile] = true;
+                count++;
+            }
+        }
+    }
+    return count;
+}
+
+std::optional<TileRect> TileGrid::Intersect(TileRect const& first, TileRect const& second) noexcept
+{
+    auto left = std::max(first.X, second.X);
+    auto top = std::max(first.Y, second.Y);
+    auto right = std::min(first.Right(), second.Right());
+    auto bottom = std::min(first.Bottom(), second.Bottom());
+    if (right <= left || bottom <= top)
+    {
+        return std::nullopt;
+    }
+    return std::optional(TileRect{ left, top, right - left, bottom - top });
+}
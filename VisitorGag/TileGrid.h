@@ -0,0 +1,49 @@
+#pragma once
+#include <cstddef>
+#include <cstdint>
+#include <optional>
+#include <vector>
+
+struct TileRect
+{
+    int32_t X = 0;
+    int32_t Y = 0;
+    int32_t Width = 0;
+    int32_t Height = 0;
+
+    int32_t Right() const noexcept { return X + Width; }
+    int32_t Bottom() const noexcept { return Y + Height; }
+};
+
+// Splits a canvas into fixed-size tiles so that no single texture has to
+// cover the whole thing. Tiles along the right and bottom edges are
+// clipped to the canvas. Tiles are numbered in row-major order.
+struct TileGrid
+{
+    TileGrid() {}
+    TileGrid(uint32_t width, uint32_t height, uint32_t tileSize);
+
+    uint32_t Width() const noexcept { return m_width; }
+    uint32_t Height() const noexcept { return m_height; }
+    uint32_t TileSize() const noexcept { return m_tileSize; }
+    uint32_t Columns() const noexcept { return m_columns; }
+    uint32_t Rows() const noexcept { return m_rows; }
+    size_t TileCount() const noexcept { return static_cast<size_t>(m_columns) * m_rows; }
+
+    TileRect TileBounds(size_t tile) const noexcept;
+    // Appends the tiles that overlap the rect (clipped to the canvas) in
+    // row-major order
+    void TilesIntersecting(TileRect const& rect, std::vector<size_t>& tiles) const;
+    // Marks every tile overlapped by any of the rects, i.e. the tiles that
+    // will ever have content. Returns how many were marked.
+    size_t MarkTilesIntersecting(std::vector<TileRect> const& rects, std::vector<bool>& marked) const;
+
+    static std::optional<TileRect> Intersect(TileRect const& first, TileRect const& second) noexcept;
+
+private:
+    uint32_t m_width = 0;
+    uint32_t m_height = 0;
+    uint32_t m_tileSize = 0;
+    uint32_t m_columns = 0;
+    uint32_t m_rows = 0;
+};
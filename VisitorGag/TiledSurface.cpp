@@ -0,0 +1,43 @@
+#include "pch.h"
+#include "TiledSurface.h"
+
+namespace winrt
+{
+    using namespace Windows::UI::Composition;
+}
+
+void CopyToSurfaceRegion(
+    winrt::com_ptr<ID3D11DeviceContext> const& d3dContext,
+    winrt::CompositionDrawingSurface const& surface,
+    TileRect const& destination,
+    winrt::com_ptr<ID3D11Texture2D> const& source,
+    int32_t sourceX,
+    int32_t sourceY)
+{
+    auto surfaceInterop = surface.as<ABI::Windows::UI::Composition::ICompositionDrawingSurfaceInterop>();
+    RECT updateRect = { destination.X, destination.Y, destination.Right(), destination.Bottom() };
+    POINT point = {};
+    winrt::com_ptr<ID3D11Texture2D> updateTexture;
+    winrt::check_hresult(surfaceInterop->BeginDraw(&updateRect, winrt::guid_of<ID3D11Texture2D>(), updateTexture.put_void(), &point));
+    auto endDraw = wil::scope_exit([surfaceInterop]()
+        {
+            winrt::check_hresult(surfaceInterop->EndDraw());
+        });
+
+    // The offset we get back already points at the top-left of the update rect
+    D3D11_BOX region = {};
+    region.left = static_cast<uint32_t>(sourceX);
+    region.right = static_cast<uint32_t>(sourceX + destination.Width);
+    region.top = static_cast<uint32_t>(sourceY);
+    region.bottom = static_cast<uint32_t>(sourceY + destination.Height);
+    region.back = 1;
+    d3dContext->CopySubresourceRegion(updateTexture.get(), 0, point.x, point.y, 0, source.get(), 0, &region);
+}
+
+void ResizeDrawingSurface(
+    winrt::CompositionDrawingSurface const& surface,
+    winrt::Windows::Graphics::SizeInt32 const& size)
+{
+    auto surfaceInterop = surface.as<ABI::Windows::UI::Composition::ICompositionDrawingSurfaceInterop>();
+    winrt::check_hresult(surfaceInterop->Resize({ size.Width, size.Height }));
+}
@@ -0,0 +1,19 @@
+#pragma once
+#include "TileGrid.h"
+
+// Copies part of a texture into a region of a composition surface. Only the
+// destination rect is updated, so with a virtual surface only the parts we
+// actually touch need to be backed by memory.
+void CopyToSurfaceRegion(
+    winrt::com_ptr<ID3D11DeviceContext> const& d3dContext,
+    winrt::Windows::UI::Composition::CompositionDrawingSurface const& surface,
+    TileRect const& destination,
+    winrt::com_ptr<ID3D11Texture2D> const& source,
+    int32_t sourceX,
+    int32_t sourceY);
+
+// Goes through the interop rather than the projection so that it can be
+// called from a render thread that doesn't own the compositor.
+void ResizeDrawingSurface(
+    winrt::Windows::UI::Composition::CompositionDrawingSurface const& surface,
+    winrt::Windows::Graphics::SizeInt32 const& size);
@@ -0,0 +1,157 @@
+#include "VisitorLifecycle.h"
+#include <algorithm>
+
+VisitorLifecycle::VisitorLifecycle(IVisitorHost& host, bool resident, bool hibernate, uint64_t seed)
+    : m_host(host), m_resident(resident), m_hibernate(hibernate), m_random(seed)
+{
+    // In resident mode we wait to be told what to do
+    if (resident)
+    {
+        m_minDelayMs = 0;
+        m_maxDelayMs = 0;
+    }
+}
+
+void VisitorLifecycle::SetSchedule(uint32_t minDelayMs, uint32_t maxDelayMs)
+{
+    m_minDelayMs = minDelayMs;
+    m_maxDelayMs = std::max(minDelayMs, maxDelayMs);
+}
+
+void VisitorLifecycle::OnGifLoaded(clock::time_point now)
+{
+    if (m_state == VisitorState::Unloaded)
+    {
+        m_state = VisitorState::Hidden;
+    }
+    // Resident instances only show up when asked
+    if (!m_resident && !IsVisible())
+    {
+        Show(now);
+    }
+}
+
+ShowResult VisitorLifecycle::RequestShow(clock::time_point now)
+{
+    if (m_state == VisitorState::Unloaded)
+    {
+        return ShowResult::NotLoaded;
+    }
+    if (IsVisible())
+    {
+        return ShowResult::AlreadyVisible;
+    }
+    Show(now);
+    return ShowResult::Shown;
+}
+
+void VisitorLifecycle::OnClicked(clock::time_point now)
+{
+    if (m_state != VisitorState::Showing && m_state != VisitorState::Visible)
+    {
+        return;
+    }
+    if (m_state == VisitorState::Visible)
+    {
+        m_stats.VisibleTime += std::chrono::duration_cast<std::chrono::microseconds>(now - m_shownAt);
+    }
+    m_state = VisitorState::Hiding;
+    m_stats.Hides++;
+    m_host.HideVisitor();
+}
+
+void VisitorLifecycle::OnShown(clock::time_point now)
+{
+    if (m_state != VisitorState::Showing)
+    {
+        return;
+    }
+    m_state = VisitorState::Visible;
+    m_shownAt = now;
+    auto latency = std::chrono::duration_cast<std::chrono::microseconds>(now - m_showDue);
+    m_stats.TotalShowLatency += latency;
+    m_stats.MaxShowLatency = std::max(m_stats.MaxShowLatency, latency);
+}
+
+void VisitorLifecycle::OnHidden(clock::time_point now)
+{
+    if (m_state != VisitorState::Hiding)
+    {
+        return;
+    }
+    m_state = VisitorState::Hidden;
+    ScheduleNext(now);
+}
+
+void VisitorLifecycle::OnTimer(clock::time_point now)
+{
+    if (m_wakeAt.has_value() && m_wakeAt.value() <= now)
+    {
+        m_wakeAt.reset();
+        Wake();
+    }
+    if (m_showAt.has_value() && m_showAt.value() <= now)
+    {
+        auto due = m_showAt.value();
+        m_showAt.reset();
+        if (m_state == VisitorState::Hidden)
+        {
+            Show(due);
+        }
+    }
+}
+
+std::optional<VisitorLifecycle::clock::time_point> VisitorLifecycle::NextDeadline() const
+{
+    if (m_wakeAt.has_value() && m_showAt.has_value())
+    {
+        return std::min(m_wakeAt.value(), m_showAt.value());
+    }
+    return m_wakeAt.has_value() ? m_wakeAt : m_showAt;
+}
+
+void VisitorLifecycle::Show(clock::time_point due)
+{
+    // Someone asking for the visitor beats whatever was scheduled
+    m_wakeAt.reset();
+    m_showAt.reset();
+    Wake();
+    m_state = VisitorState::Showing;
+    m_showDue = due;
+    m_stats.Shows++;
+    m_host.ShowVisitor();
+}
+
+void VisitorLifecycle::ScheduleNext(clock::time_point now)
+{
+    if (m_hibernate && !m_hibernated)
+    {
+        m_hibernated = true;
+        m_stats.Hibernations++;
+        m_host.HibernateVisitor();
+    }
+    if (m_maxDelayMs == 0)
+    {
+        return;
+    }
+    std::uniform_int_distribution<uint32_t> dist(m_minDelayMs, m_maxDelayMs);
+    auto delay = std::chrono::milliseconds(dist(m_random));
+    m_showAt = now + delay;
+    if (m_hibernated)
+    {
+        // Wake back up a little before the next reveal
+        auto leadTime = std::min(std::chrono::duration_cast<std::chrono::milliseconds>(m_host.WakeLeadTime()), delay);
+        m_wakeAt = now + (delay - leadTime);
+    }
+}
+
+void VisitorLifecycle::Wake()
+{
+    if (!m_hibernated)
+    {
+        return;
+    }
+    m_hibernated = false;
+    m_stats.Wakes++;
+    m_host.WakeVisitor();
+}
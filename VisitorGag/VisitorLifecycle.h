@@ -0,0 +1,101 @@
+#pragma once
+#include <chrono>
+#include <cstdint>
+#include <optional>
+#include <random>
+
+// The parts of the app the lifecycle drives. Show and Hide start
+// animations, the host reports back through OnShown and OnHidden once
+// they're done.
+struct IVisitorHost
+{
+    virtual ~IVisitorHost() = default;
+
+    // Capture the screen, start playing and begin the show animation
+    virtual void ShowVisitor() = 0;
+    virtual void HideVisitor() = 0;
+    virtual void HibernateVisitor() = 0;
+    virtual void WakeVisitor() = 0;
+    // How long before a reveal waking should start
+    virtual std::chrono::microseconds WakeLeadTime() = 0;
+};
+
+enum class VisitorState
+{
+    // No gif yet
+    Unloaded,
+    Hidden,
+    Showing,
+    Visible,
+    Hiding,
+};
+
+enum class ShowResult
+{
+    Shown,
+    NotLoaded,
+    AlreadyVisible,
+};
+
+struct VisitorLifecycleStats
+{
+    uint32_t Shows = 0;
+    uint32_t Hides = 0;
+    uint32_t Hibernations = 0;
+    uint32_t Wakes = 0;
+    std::chrono::microseconds VisibleTime{};
+    // From when a scheduled reveal was due to when the visitor was fully
+    // shown, which includes the show animation
+    std::chrono::microseconds TotalShowLatency{};
+    std::chrono::microseconds MaxShowLatency{};
+};
+
+// When the visitor shows up and goes away, without any Win32 or WinRT.
+// Like HibernationStateMachine the caller supplies the timestamps, and
+// anything the lifecycle wants to happen later is reported through
+// NextDeadline for the caller to arm a timer with. Given the same seed and
+// the same sequence of calls it always makes the same decisions.
+struct VisitorLifecycle
+{
+    using clock = std::chrono::steady_clock;
+
+    VisitorLifecycle(IVisitorHost& host, bool resident, bool hibernate, uint64_t seed);
+
+    // Zero for both means only show up when asked to
+    void SetSchedule(uint32_t minDelayMs, uint32_t maxDelayMs);
+    void OnGifLoaded(clock::time_point now);
+    ShowResult RequestShow(clock::time_point now);
+    void OnClicked(clock::time_point now);
+    void OnShown(clock::time_point now);
+    void OnHidden(clock::time_point now);
+    // Handles whatever is due
+    void OnTimer(clock::time_point now);
+
+    std::optional<clock::time_point> NextDeadline() const;
+    bool IsLoaded() const noexcept { return m_state != VisitorState::Unloaded; }
+    bool IsVisible() const noexcept { return m_state == VisitorState::Showing || m_state == VisitorState::Visible || m_state == VisitorState::Hiding; }
+    bool IsHibernated() const noexcept { return m_hibernated; }
+    VisitorState State() const noexcept { return m_state; }
+    VisitorLifecycleStats const& Stats() const noexcept { return m_stats; }
+
+private:
+    void Show(clock::time_point due);
+    void ScheduleNext(clock::time_point now);
+    void Wake();
+
+private:
+    IVisitorHost& m_host;
+    bool m_resident = false;
+    bool m_hibernate = false;
+    bool m_hibernated = false;
+    uint32_t m_minDelayMs = 5000;
+    uint32_t m_maxDelayMs = 30000;
+    std::mt19937_64 m_random;
+    VisitorState m_state = VisitorState::Unloaded;
+    std::optional<clock::time_point> m_wakeAt;
+    std::optional<clock::time_point> m_showAt;
+    // When the current reveal was asked for, and when it finished
+    clock::time_point m_showDue = {};
+    clock::time_point m_shownAt = {};
+    VisitorLifecycleStats m_stats = {};
+};
@@ -2,6 +2,7 @@
 #include "MainWindow.h"
 #include "CompositionGifPlayer.h"
 #include "App.h"
+#include "LifecycleSimulation.h"
 
 namespace winrt
 {
@@ -25,16 +26,9 @@ namespace util
     using namespace robmikh::common::desktop;
 }
 
-struct Options
-{
-    bool DxDebug = false;
-    std::optional<std::filesystem::path> FilePath = std::nullopt;
-    CaptureMode CaptureMode = CaptureMode::Default;
-    bool DemoMode = false;
-    bool NoLoop = false;
-};
-
-std::optional<Options> ParseOptions(int argc, wchar_t* argv[]);
+std::optional<AppOptions> ParseOptions(int argc, wchar_t* argv[]);
+void SendCommands(std::wstring const& commands);
+void RunSimulation(LifecycleSimulationOptions const& options);
 
 int __stdcall WinMain(HINSTANCE, HINSTANCE, PSTR, int)
 {
@@ -73,7 +67,7 @@ int __stdcall WinMain(HINSTANCE, HINSTANCE, PSTR, int)
     auto controller = util::CreateDispatcherQueueControllerForCurrentThread();
 
     // Create our app
-    auto app = App(options.DxDebug, options.FilePath, options.CaptureMode, options.DemoMode, !options.NoLoop);
+    auto app = App(options);
 
     // Run the rest of our initialization asynchronously on the DispatcherQueue
     auto queue = controller.DispatcherQueue();
@@ -107,7 +101,7 @@ int __stdcall WinMain(HINSTANCE, HINSTANCE, PSTR, int)
     return util::ShutdownDispatcherQueueControllerAndWait(controller, static_cast<int>(msg.wParam));
 }
 
-std::optional<Options> ParseOptions(int argc, wchar_t* argv[])
+std::optional<AppOptions> ParseOptions(int argc, wchar_t* argv[])
 {
     using namespace robmikh::common::wcli::impl;
 
@@ -125,10 +119,35 @@ std::optional<Options> ParseOptions(int argc, wchar_t* argv[])
         wprintf(L"  -forceWGC                 (optional) Force the use of Windows.Graphics.Capture.\n");
         wprintf(L"  -forceDDA                 (optional) Force the use of the Desktop Duplication API.\n");
         wprintf(L"  -demoMode                 (optional) Always show the visitor in the same spot for demoing.\n");
-        wprintf(L"  -noLoop                   (optional) Don't loop the gif.\n");
+        wprintf(L"  -noLoop                   (optional) Don't loop the gif, even if its loop count asks for it.\n");
+        wprintf(L"  -smartPlacement           (optional) Prefer low-detail areas of the screen for the visitor.\n");
+        wprintf(L"  -hibernate                (optional) Release resources while the visitor is away.\n");
+        wprintf(L"  -progressive              (optional) Start playing before the whole gif is decoded.\n");
+        wprintf(L"  -resident                 (optional) Stay running and wait for commands from \"-send\".\n");
+        wprintf(L"  -shareFrames              (optional) Share decoded frames with other instances showing the same gif.\n");
+        wprintf(L"  -serialStartup            (optional) Run the startup tasks one after the other, for comparison.\n");
+        wprintf(L"  -flipbook                 (optional) Pre-render every frame during the first loop and only swap\n");
+        wprintf(L"                            them in afterwards, if they fit in memory.\n");
+        wprintf(L"  -scaleWithDpi             (optional) Scale the gif by the DPI of the monitor the visitor shows up on.\n");
         wprintf(L"\n");
         wprintf(L"Options:\n");
         wprintf(L"  -gif <path to gif file>   (optional) Path to a gif file. A picker will be shown if none is provided.\n");
+        wprintf(L"  -maxMemoryMB <megabytes>  (optional) Memory budget for decoded frames. Frames that don't fit are decoded on demand.\n");
+        wprintf(L"  -playbackMode <mode>      (optional) One of \"forward\" (default), \"reverse\" or \"pingpong\".\n");
+        wprintf(L"  -speed <multiplier>       (optional) Playback speed, e.g. 0.5 for half speed.\n");
+        wprintf(L"  -memoryLog <seconds>      (optional) Print how much memory each part of the app is using every\n");
+        wprintf(L"                            so many seconds.\n");
+        wprintf(L"  -scale <factor>           (optional) Draw the gif at a different size, e.g. 0.5 for half size.\n");
+        wprintf(L"  -maxSize <width>x<height> (optional) Shrink the gif to fit within the given size, keeping its\n");
+        wprintf(L"                            aspect ratio.\n");
+        wprintf(L"  -scaleFilter <filter>     (optional) One of \"box\", \"bilinear\" or \"lanczos\" (default).\n");
+        wprintf(L"  -send <commands>          (optional) Send commands to a resident instance and exit. Separate\n");
+        wprintf(L"                            multiple commands with ';'. Commands: show, load <path>,\n");
+        wprintf(L"                            schedule <min ms> <max ms>, stats.\n");
+        wprintf(L"  -simulate <hours>         (optional) Simulate the visitor's schedule for the given number of hours\n");
+        wprintf(L"                            on a virtual clock, print statistics and exit. Honors \"-hibernate\".\n");
+        wprintf(L"  -visitors <count>         (optional) Number of visitors to simulate at once (default 1).\n");
+        wprintf(L"  -seed <number>            (optional) Seed for the simulation (default 1).\n");
         wprintf(L"\n");
         return std::nullopt;
     }
@@ -138,6 +157,50 @@ std::optional<Options> ParseOptions(int argc, wchar_t* argv[])
     auto captureMode = CaptureMode::Default;
     bool demoMode = GetFlag(args, L"-demoMode") || GetFlag(args, L"/demoMode");
     bool noLoop = GetFlag(args, L"-noLoop") || GetFlag(args, L"/noLoop");
+    bool smartPlacement = GetFlag(args, L"-smartPlacement") || GetFlag(args, L"/smartPlacement");
+    bool hibernate = GetFlag(args, L"-hibernate") || GetFlag(args, L"/hibernate");
+    bool progressive = GetFlag(args, L"-progressive") || GetFlag(args, L"/progressive");
+    bool resident = GetFlag(args, L"-resident") || GetFlag(args, L"/resident");
+    bool shareFrames = GetFlag(args, L"-shareFrames") || GetFlag(args, L"/shareFrames");
+    bool serialStartup = GetFlag(args, L"-serialStartup") || GetFlag(args, L"/serialStartup");
+    bool flipbook = GetFlag(args, L"-flipbook") || GetFlag(args, L"/flipbook");
+    bool scaleWithDpi = GetFlag(args, L"-scaleWithDpi") || GetFlag(args, L"/scaleWithDpi");
+    {
+        // Talking to a resident instance doesn't need anything else
+        auto sendString = GetFlagValue(args, L"-send", L"/send");
+        if (!sendString.empty())
+        {
+            SendCommands(sendString);
+            return std::nullopt;
+        }
+    }
+    {
+        // Neither does simulating
+        auto simulateString = GetFlagValue(args, L"-simulate", L"/simulate");
+        if (!simulateString.empty())
+        {
+            LifecycleSimulationOptions simulation = {};
+            simulation.Duration = std::chrono::hours(std::wcstoul(simulateString.c_str(), nullptr, 10));
+            simulation.Hibernate = hibernate;
+            auto visitorsString = GetFlagValue(args, L"-visitors", L"/visitors");
+            if (!visitorsString.empty())
+            {
+                simulation.Visitors = static_cast<uint32_t>(std::wcstoul(visitorsString.c_str(), nullptr, 10));
+            }
+            auto seedString = GetFlagValue(args, L"-seed", L"/seed");
+            if (!seedString.empty())
+            {
+                simulation.Seed = std::wcstoull(seedString.c_str(), nullptr, 10);
+            }
+            if (simulation.Duration.count() == 0 || simulation.Visitors == 0)
+            {
+                wprintf(L"Invalid value for \"-simulate\" or \"-visitors\"!\n");
+                return std::nullopt;
+            }
+            RunSimulation(simulation);
+            return std::nullopt;
+        }
+    }
     if (forceWGC && forceDDA)
     {
         wprintf(L"Both \"-forceWGC\" and \"-forceDDA\" cannot be set!\n");
@@ -159,6 +222,104 @@ std::optional<Options> ParseOptions(int argc, wchar_t* argv[])
             filePath = std::optional(std::filesystem::path(pathString));
         }
     }
+    uint32_t maxMemoryMB = 0;
+    {
+        auto maxMemoryString = GetFlagValue(args, L"-maxMemoryMB", L"/maxMemoryMB");
+        if (!maxMemoryString.empty())
+        {
+            maxMemoryMB = static_cast<uint32_t>(std::wcstoul(maxMemoryString.c_str(), nullptr, 10));
+            if (maxMemoryMB == 0)
+            {
+                wprintf(L"Invalid value for \"-maxMemoryMB\"!\n");
+                return std::nullopt;
+            }
+        }
+    }
+    auto playbackMode = PlaybackMode::Forward;
+    {
+        auto playbackModeString = GetFlagValue(args, L"-playbackMode", L"/playbackMode");
+        if (playbackModeString == L"reverse")
+        {
+            playbackMode = PlaybackMode::Reverse;
+        }
+        else if (playbackModeString == L"pingpong")
+        {
+            playbackMode = PlaybackMode::PingPong;
+        }
+        else if (!playbackModeString.empty() && playbackModeString != L"forward")
+        {
+            wprintf(L"Invalid value for \"-playbackMode\"!\n");
+            return std::nullopt;
+        }
+    }
+    float speed = 1.0f;
+    {
+        auto speedString = GetFlagValue(args, L"-speed", L"/speed");
+        if (!speedString.empty())
+        {
+            speed = std::wcstof(speedString.c_str(), nullptr);
+            if (!std::isfinite(speed) || !(speed > 0.0f))
+            {
+                wprintf(L"Invalid value for \"-speed\"!\n");
+                return std::nullopt;
+            }
+        }
+    }
+    uint32_t memoryLogSeconds = 0;
+    {
+        auto memoryLogString = GetFlagValue(args, L"-memoryLog", L"/memoryLog");
+        if (!memoryLogString.empty())
+        {
+            memoryLogSeconds = static_cast<uint32_t>(std::wcstoul(memoryLogString.c_str(), nullptr, 10));
+            if (memoryLogSeconds == 0)
+            {
+                wprintf(L"Invalid value for \"-memoryLog\"!\n");
+                return std::nullopt;
+            }
+        }
+    }
+    ImageScale scale = {};
+    {
+        auto scaleString = GetFlagValue(args, L"-scale", L"/scale");
+        if (!scaleString.empty())
+        {
+            scale.Scale = std::wcstof(scaleString.c_str(), nullptr);
+            if (!std::isfinite(scale.Scale) || !(scale.Scale > 0.0f))
+            {
+                wprintf(L"Invalid value for \"-scale\"!\n");
+                return std::nullopt;
+            }
+        }
+        auto maxSizeString = GetFlagValue(args, L"-maxSize", L"/maxSize");
+        if (!maxSizeString.empty())
+        {
+            wchar_t* end = nullptr;
+            scale.MaxWidth = static_cast<uint32_t>(std::wcstoul(maxSizeString.c_str(), &end, 10));
+            if (*end == L'x')
+            {
+                scale.MaxHeight = static_cast<uint32_t>(std::wcstoul(end + 1, &end, 10));
+            }
+            if (scale.MaxWidth == 0 || scale.MaxHeight == 0 || *end != L'\0')
+            {
+                wprintf(L"Invalid value for \"-maxSize\"!\n");
+                return std::nullopt;
+            }
+        }
+        auto scaleFilterString = GetFlagValue(args, L"-scaleFilter", L"/scaleFilter");
+        if (scaleFilterString == L"box")
+        {
+            scale.Filter = ResampleFilter::Box;
+        }
+        else if (scaleFilterString == L"bilinear")
+        {
+            scale.Filter = ResampleFilter::Bilinear;
+        }
+        else if (!scaleFilterString.empty() && scaleFilterString != L"lanczos")
+        {
+            wprintf(L"Invalid value for \"-scaleFilter\"!\n");
+            return std::nullopt;
+        }
+    }
 
     if (dxDebug)
     {
@@ -184,6 +345,108 @@ std::optional<Options> ParseOptions(int argc, wchar_t* argv[])
     {
         wprintf(L"Gif will not loop...\n");
     }
+    if (smartPlacement)
+    {
+        wprintf(L"Using smart placement...\n");
+    }
+    if (maxMemoryMB != 0)
+    {
+        wprintf(L"Limiting frame memory to %u MB...\n", maxMemoryMB);
+    }
+    if (hibernate)
+    {
+        wprintf(L"Hibernating between visits...\n");
+    }
+    if (progressive)
+    {
+        wprintf(L"Using progressive playback...\n");
+    }
+    if (playbackMode == PlaybackMode::Reverse)
+    {
+        wprintf(L"Playing the gif in reverse...\n");
+    }
+    else if (playbackMode == PlaybackMode::PingPong)
+    {
+        wprintf(L"Playing the gif back and forth...\n");
+    }
+    if (speed != 1.0f)
+    {
+        wprintf(L"Playing at %.2fx speed...\n", speed);
+    }
+    if (resident)
+    {
+        wprintf(L"Running in resident mode...\n");
+    }
+    if (shareFrames)
+    {
+        wprintf(L"Sharing decoded frames with other instances...\n");
+    }
+    if (serialStartup)
+    {
+        wprintf(L"Running startup serially...\n");
+    }
+    if (memoryLogSeconds != 0)
+    {
+        wprintf(L"Logging memory usage every %u seconds...\n", memoryLogSeconds);
+    }
+    if (flipbook)
+    {
+        wprintf(L"Using flipbook playback...\n");
+    }
+    if (scale.Scale != 1.0f)
+    {
+        wprintf(L"Scaling the gif by %.2fx...\n", scale.Scale);
+    }
+    if (scale.MaxWidth != 0)
+    {
+        wprintf(L"Fitting the gif within %ux%u...\n", scale.MaxWidth, scale.MaxHeight);
+    }
+    if (scaleWithDpi)
+    {
+        wprintf(L"Scaling the gif with the monitor's DPI...\n");
+    }
     
-    return std::optional(Options{ dxDebug, filePath, captureMode, demoMode, noLoop });
-}
\ No newline at end of file
+    return std::optional(AppOptions{ dxDebug, filePath, captureMode, demoMode, noLoop, smartPlacement, maxMemoryMB, hibernate, progressive, playbackMode, speed, resident, shareFrames, serialStartup, memoryLogSeconds, flipbook, scale, scaleWithDpi });
+}
+
+void SendCommands(std::wstring const& commands)
+{
+    // Each ';' separated command goes on its own line, all in one write
+    auto request = winrt::to_string(commands);
+    std::replace(request.begin(), request.end(), ';', '\n');
+    try
+    {
+        auto start = std::chrono::steady_clock::now();
+        auto responses = SendPipeCommands(ResidentPipeName, request);
+        auto elapsed = std::chrono::steady_clock::now() - start;
+        wprintf(L"%s", winrt::to_hstring(responses).c_str());
+        wprintf(L"Answered in %.2f ms\n", static_cast<double>(std::chrono::duration_cast<std::chrono::microseconds>(elapsed).count()) / 1000.0);
+    }
+    catch (winrt::hresult_error const& error)
+    {
+        wprintf(L"Failed to reach a resident instance: %s\n", error.message().c_str());
+    }
+}
+
+void RunSimulation(LifecycleSimulationOptions const& options)
+{
+    wprintf(L"Simulating %u visitor(s) for %lld hour(s) with seed %llu...\n",
+        options.Visitors, static_cast<long long>(options.Duration.count()), options.Seed);
+    auto result = RunLifecycleSimulation(options);
+    auto&& totals = result.Totals;
+    auto toMs = [](std::chrono::microseconds time) { return static_cast<double>(time.count()) / 1000.0; };
+    auto toMB = [](uint64_t bytes) { return static_cast<double>(bytes) / (1024.0 * 1024.0); };
+    wprintf(L"Shows: %u, hides: %u, hibernations: %u, wakes: %u\n", totals.Shows, totals.Hides, totals.Hibernations, totals.Wakes);
+    if (result.WakesWhileHibernating > 0 || result.HibernatedWhileVisible > 0)
+    {
+        wprintf(L"Wakes while hibernating: %u, hibernated while visible: %u\n", result.WakesWhileHibernating, result.HibernatedWhileVisible);
+    }
+    if (totals.Shows > 0)
+    {
+        wprintf(L"Show latency: %.1f ms average, %.1f ms max\n", toMs(totals.TotalShowLatency) / totals.Shows, toMs(totals.MaxShowLatency));
+    }
+    wprintf(L"Visible for %.1f hour(s) in total, at most %u visitor(s) at once\n",
+        static_cast<double>(totals.VisibleTime.count()) / 3600000000.0, result.PeakVisible);
+    wprintf(L"Memory: %.1f MB peak, %.1f MB average\n", toMB(result.PeakBytes), toMB(result.AverageBytes));
+    wprintf(L"Processed %llu event(s) in %.1f ms\n", result.Events, toMs(result.Elapsed));
+}
@@ -2,6 +2,8 @@
 
 // Windows
 #include <windows.h>
+#include <wtsapi32.h>
+#include <sddl.h>
 
 // Must come before C++/WinRT
 #include <wil/cppwinrt.h>
@@ -30,6 +32,7 @@
 
 // WIL
 #include <wil/resource.h>
+#include <wil/token_helpers.h>
 
 // DirectX
 #include <d3d11_4.h>
@@ -40,6 +43,7 @@
 // Shell
 #include <shobjidl.h>
 #include <shellapi.h>
+#include <ShellScalingApi.h>
 
 // STL
 #include <vector>
@@ -52,6 +56,8 @@
 #include <random>
 #include <functional>
 #include <filesystem>
+#include <thread>
+#include <cmath>
 
 // robmikh.common
 #include <robmikh.common/composition.interop.h>